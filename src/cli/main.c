@@ -44,20 +44,16 @@
 #include <unistd.h>
 #include <inttypes.h>
 #include <libintl.h>
+#include <glib/gstdio.h>
 
 static void generate_thumbnail_cache()
 {
   const int max_mip = DT_MIPMAP_2;
-  fprintf(stderr, _("creating cache directories\n"));
-  char filename[PATH_MAX] = {0};
   for(int k=DT_MIPMAP_0;k<=max_mip;k++)
   {
-    snprintf(filename, sizeof(filename), "%s.d/%d", darktable.mipmap_cache->cachedir, k);
-    fprintf(stderr, _("creating cache directory '%s'\n"), filename);
-    int mkd = g_mkdir_with_parents(filename, 0750);
-    if(mkd)
+    if(!darktable.mipmap_cache->store[k])
     {
-      fprintf(stderr, _("could not create directory '%s'!\n"), filename);
+      fprintf(stderr, _("could not open the thumbnail cache in '%s.d'!\n"), darktable.mipmap_cache->cachedir);
       return;
     }
   }
@@ -75,9 +71,13 @@ static void generate_thumbnail_cache()
   const size_t bufsize = (size_t)4 * darktable.mipmap_cache->max_width[max_mip]
                          * darktable.mipmap_cache->max_height[max_mip];
   uint8_t *tmp = (uint8_t *)dt_alloc_align(16, bufsize);
-  if(!tmp)
+  // temp memory for the compressed thumbnails:
+  uint8_t *blob = (uint8_t *)malloc(bufsize);
+  if(!tmp || !blob)
   {
     fprintf(stderr, "couldn't allocate temporary memory!\n");
+    dt_free_align(tmp);
+    free(blob);
     sqlite3_finalize(stmt);
     return;
   }
@@ -85,13 +85,10 @@ static void generate_thumbnail_cache()
   while(sqlite3_step(stmt) == SQLITE_ROW)
   {
     const int32_t imgid = sqlite3_column_int(stmt, 0);
-    // check whether all of these files are already there
+    // check whether all of these thumbnails are already there
     int all_exist = 1;
     for(int k=max_mip;k>=DT_MIPMAP_0;k--)
-    {
-      snprintf(filename, sizeof(filename), "%s.d/%d/%d.jpg", darktable.mipmap_cache->cachedir, k, imgid);
-      all_exist &= !access(filename, R_OK); 
-    }
+      all_exist &= dt_thumbnail_store_contains(darktable.mipmap_cache->store[k], imgid);
     if(all_exist) goto next;
     dt_mipmap_buffer_t buf;
     // get largest thumbnail for this image
@@ -106,25 +103,11 @@ static void generate_thumbnail_cache()
       // use exactly the same mechanism as the cache internally to rescale the thumbnail:
       dt_iop_flip_and_zoom_8(buf.buf, buf.width, buf.height, tmp, wd, ht, 0, &width, &height);
 
-      snprintf(filename, sizeof(filename), "%s.d/%d/%d.jpg", darktable.mipmap_cache->cachedir, k, imgid);
-      FILE *f = fopen(filename, "wb");
-      if(f)
-      {
-        // allocate temp memory:
-        uint8_t *blob = (uint8_t *)malloc(bufsize);
-        if(!blob) goto write_error;
-        const int32_t length
-          = dt_imageio_jpeg_compress(tmp, blob, width, height, cache_quality);
-        assert(length <= bufsize);
-        int written = fwrite(blob, sizeof(uint8_t), length, f);
-        if(written != length)
-        {
-write_error:
-          unlink(filename);
-        }
-        free(blob);
-        fclose(f);
-      }
+      const int32_t length
+        = dt_imageio_jpeg_compress(tmp, blob, width, height, cache_quality);
+      assert(length <= bufsize);
+      // the store collects these and appends them in batches:
+      if(length > 0) dt_thumbnail_store_write(darktable.mipmap_cache->store[k], imgid, blob, length);
     }
     dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
 next:
@@ -132,6 +115,7 @@ next:
     fprintf(stderr, "\rimage %zu/%zu (%.02f%%)            ", counter, image_count,
             100.0 * counter / (float)image_count);
   }
+  free(blob);
   dt_free_align(tmp);
   sqlite3_finalize(stmt);
   fprintf(stderr, "done                     \n");
@@ -140,8 +124,195 @@ next:
 static void usage(const char *progname)
 {
   fprintf(stderr, "usage: %s <input file> [<xmp file>] <output file> [--width <max width>,--height <max "
-                  "height>,--bpp <bpp>,--hq <0|1|true|false>,--upscale <0|1|true|false>,--verbose] [--core <darktable options>] [--generate-cache]\n",
-          progname);
+                  "height>,--bpp <bpp>,--hq <0|1|true|false>,--upscale <0|1|true|false>,--pipe-profile <json file>,--verbose] [--core <darktable options>] [--generate-cache]\n"
+                  "       %s --output <output template> [<input file|directory|-> ...] "
+                  "[--input-list <file|->,--threads <n>,--width <max width>,--height <max height>,"
+                  "--hq <0|1|true|false>,--upscale <0|1|true|false>,--pipe-profile <json file>,--verbose] [--core <darktable options>]\n",
+          progname, progname);
+}
+
+/** one image to process in batch mode, with an optional xmp file to apply. */
+typedef struct dt_cli_input_t
+{
+  gchar *filename;
+  gchar *xmp_filename;
+} dt_cli_input_t;
+
+static void free_input(gpointer data)
+{
+  dt_cli_input_t *input = (dt_cli_input_t *)data;
+  g_free(input->filename);
+  g_free(input->xmp_filename);
+  free(input);
+}
+
+static GList *add_input(GList *inputs, const char *filename, const char *xmp_filename)
+{
+  dt_cli_input_t *input = (dt_cli_input_t *)malloc(sizeof(dt_cli_input_t));
+  input->filename = g_strdup(filename);
+  input->xmp_filename = g_strdup(xmp_filename);
+  return g_list_prepend(inputs, input);
+}
+
+// add a file or all files in a directory (not recursing into sub directories). unsupported files get
+// filtered out by dt_image_import() later on.
+static GList *add_path(GList *inputs, const char *path)
+{
+  if(!g_file_test(path, G_FILE_TEST_IS_DIR)) return add_input(inputs, path, NULL);
+
+  GDir *dir = g_dir_open(path, 0, NULL);
+  if(!dir)
+  {
+    fprintf(stderr, _("error: can't open directory %s"), path);
+    fprintf(stderr, "\n");
+    return inputs;
+  }
+  GList *names = NULL;
+  const gchar *name;
+  while((name = g_dir_read_name(dir)) != NULL)
+  {
+    if(g_str_has_suffix(name, ".xmp") || g_str_has_suffix(name, ".XMP")) continue;
+    gchar *filename = g_build_filename(path, name, NULL);
+    if(g_file_test(filename, G_FILE_TEST_IS_REGULAR))
+      names = g_list_prepend(names, filename);
+    else
+      g_free(filename);
+  }
+  g_dir_close(dir);
+
+  // keep the output sequence numbers stable between runs
+  names = g_list_sort(names, (GCompareFunc)g_strcmp0);
+  for(GList *iter = names; iter; iter = g_list_next(iter)) inputs = add_input(inputs, iter->data, NULL);
+  g_list_free_full(names, g_free);
+  return inputs;
+}
+
+// read a manifest with one input per line, optionally followed by a tab and the xmp file to apply.
+// empty lines and lines starting with '#' are skipped, "-" reads from stdin.
+static GList *add_input_list(GList *inputs, const char *manifest)
+{
+  FILE *f = strcmp(manifest, "-") ? g_fopen(manifest, "rb") : stdin;
+  if(!f)
+  {
+    fprintf(stderr, _("error: can't open file %s"), manifest);
+    fprintf(stderr, "\n");
+    return inputs;
+  }
+  char line[2 * PATH_MAX];
+  while(fgets(line, sizeof(line), f))
+  {
+    char *xmp = strchr(line, '\t');
+    if(xmp) *xmp++ = '\0';
+    g_strstrip(line);
+    if(line[0] == '\0' || line[0] == '#') continue;
+    if(xmp)
+    {
+      g_strstrip(xmp);
+      if(xmp[0] == '\0') xmp = NULL;
+    }
+    inputs = xmp ? add_input(inputs, line, xmp) : add_path(inputs, line);
+  }
+  if(f != stdin) fclose(f);
+  return inputs;
+}
+
+static int import_image(const char *image_filename, const char *xmp_filename, gboolean verbose)
+{
+  dt_film_t film;
+  gchar *directory = g_path_get_dirname(image_filename);
+  const int filmid = dt_film_new(&film, directory);
+  g_free(directory);
+  const int id = filmid ? dt_image_import(filmid, image_filename, TRUE) : 0;
+  if(!id)
+  {
+    fprintf(stderr, _("error: can't open file %s"), image_filename);
+    fprintf(stderr, "\n");
+    return 0;
+  }
+
+  // attach xmp, if requested:
+  if(xmp_filename)
+  {
+    dt_image_t *image = dt_image_cache_get(darktable.image_cache, id, 'w');
+    dt_exif_xmp_read(image, xmp_filename, 1);
+    // don't write new xmp:
+    dt_image_cache_write_release(darktable.image_cache, image, DT_IMAGE_CACHE_RELAXED);
+  }
+
+  // print the history stack
+  if(verbose)
+  {
+    gchar *history = dt_history_get_items_as_string(id);
+    if(history)
+      printf("%s\n", history);
+    else
+      printf("[%s]\n", _("empty history stack"));
+    g_free(history);
+  }
+  return id;
+}
+
+/** shared state of the export threads. */
+typedef struct dt_cli_export_t
+{
+  dt_imageio_module_format_t *format;
+  dt_imageio_module_storage_t *storage;
+  dt_imageio_module_data_t *sdata, *fdata;
+  gboolean high_quality, upscale, parallel;
+
+  dt_pthread_mutex_t mutex; // protects everything below
+  pthread_cond_t cond;
+  GList *images;
+  int total, started, failed;
+  size_t memory_used, memory_budget, memory_pipe;
+} dt_cli_export_t;
+
+static void *export_worker(void *data)
+{
+  dt_cli_export_t *e = (dt_cli_export_t *)data;
+
+  // every thread needs its own format parameters
+  dt_imageio_module_data_t *fdata = e->fdata;
+  if(e->parallel)
+  {
+    fdata = e->format->get_params(e->format);
+    memcpy(fdata, e->fdata, e->format->params_size(e->format));
+  }
+
+  dt_pthread_mutex_lock(&e->mutex);
+  while(e->images)
+  {
+    const int id = GPOINTER_TO_INT(e->images->data);
+    e->images = g_list_delete_link(e->images, e->images);
+    const int num = ++e->started;
+
+    // like the export job of the gui: full input buffer plus the two cache lines of the pipe, four floats per
+    // pixel, and what the modules may take for tiling
+    size_t memory = e->memory_pipe;
+    const dt_image_t *image = dt_image_cache_get(darktable.image_cache, id, 'r');
+    if(image)
+    {
+      memory += (size_t)3 * 4 * sizeof(float) * image->width * image->height;
+      dt_image_cache_read_release(darktable.image_cache, image);
+    }
+    // wait for running exports to free up memory, but always let one through:
+    while(e->memory_used && e->memory_used + memory > e->memory_budget)
+      dt_pthread_cond_wait(&e->cond, &e->mutex);
+    e->memory_used += memory;
+    dt_pthread_mutex_unlock(&e->mutex);
+
+    const int err
+        = e->storage->store(e->storage, e->sdata, id, e->format, fdata, num, e->total, e->high_quality, e->upscale);
+
+    dt_pthread_mutex_lock(&e->mutex);
+    e->memory_used -= memory;
+    if(err) e->failed++;
+    pthread_cond_broadcast(&e->cond);
+  }
+  dt_pthread_mutex_unlock(&e->mutex);
+
+  if(e->parallel) e->format->free_params(e->format, fdata);
+  return NULL;
 }
 
 int main(int argc, char *arg[])
@@ -156,14 +327,18 @@ int main(int argc, char *arg[])
   char *image_filename = NULL;
   char *xmp_filename = NULL;
   char *output_filename = NULL;
+  char *output_template = NULL;
+  char *pipe_profile = NULL;
+  GList *input_lists = NULL;
+  GList *positional = NULL;
   int file_counter = 0;
-  int width = 0, height = 0, bpp = 0;
+  int width = 0, height = 0, bpp = 0, threads = 0;
   gboolean verbose = FALSE, high_quality = TRUE, upscale = FALSE, generate_cache = FALSE;
 
   int k;
   for(k = 1; k < argc; k++)
   {
-    if(arg[k][0] == '-')
+    if(arg[k][0] == '-' && arg[k][1] != '\0')
     {
       if(!strcmp(arg[k], "--help"))
       {
@@ -179,6 +354,26 @@ int main(int argc, char *arg[])
       {
         generate_cache = TRUE;
       }
+      else if(!strcmp(arg[k], "--output") && k + 1 < argc)
+      {
+        k++;
+        output_template = arg[k];
+      }
+      else if(!strcmp(arg[k], "--input-list") && k + 1 < argc)
+      {
+        k++;
+        input_lists = g_list_append(input_lists, arg[k]);
+      }
+      else if(!strcmp(arg[k], "--threads") && k + 1 < argc)
+      {
+        k++;
+        threads = MAX(atoi(arg[k]), 1);
+      }
+      else if(!strcmp(arg[k], "--pipe-profile") && k + 1 < argc)
+      {
+        k++;
+        pipe_profile = arg[k];
+      }
       else if(!strcmp(arg[k], "--width"))
       {
         k++;
@@ -241,6 +436,7 @@ int main(int argc, char *arg[])
     }
     else
     {
+      positional = g_list_append(positional, arg[k]);
       if(file_counter == 0)
         image_filename = arg[k];
       else if(file_counter == 1)
@@ -251,17 +447,36 @@ int main(int argc, char *arg[])
     }
   }
 
+  // batch mode: everything that isn't an option is an input, the output is a variable pattern
+  const gboolean batch = output_template || input_lists;
+
   int m_argc = 0;
-  char *m_arg[5 + argc - k];
+  char *m_arg[7 + argc - k];
   m_arg[m_argc++] = "darktable-cli";
   m_arg[m_argc++] = "--library";
   m_arg[m_argc++] = ":memory:";
   m_arg[m_argc++] = "--conf";
   m_arg[m_argc++] = "write_sidecar_files=FALSE";
+  if(pipe_profile)
+  {
+    m_arg[m_argc++] = "--pipe-profile";
+    m_arg[m_argc++] = pipe_profile;
+  }
   for(; k < argc; k++) m_arg[m_argc++] = arg[k];
   m_arg[m_argc] = NULL;
 
-  if(!generate_cache)
+  if(generate_cache)
+    ;
+  else if(batch)
+  {
+    if(!output_template)
+    {
+      usage(arg[0]);
+      exit(1);
+    }
+    output_filename = output_template;
+  }
+  else
   {
     if(file_counter < 2 || file_counter > 3)
     {
@@ -293,39 +508,39 @@ int main(int argc, char *arg[])
     exit(0);
   }
 
-  dt_film_t film;
-  int id = 0;
-  int filmid = 0;
-
-  gchar *directory = g_path_get_dirname(image_filename);
-  filmid = dt_film_new(&film, directory);
-  id = dt_image_import(filmid, image_filename, TRUE);
-  if(!id)
-  {
-    fprintf(stderr, _("error: can't open file %s"), image_filename);
-    fprintf(stderr, "\n");
-    exit(1);
-  }
-  g_free(directory);
-
-  // attach xmp, if requested:
-  if(xmp_filename)
+  // import everything up front, the database is only touched from this thread. all images share this one
+  // process and thus the loaded modules and caches.
+  GList *images = NULL;
+  if(batch)
   {
-    dt_image_t *image = dt_image_cache_get(darktable.image_cache, id, 'w');
-    dt_exif_xmp_read(image, xmp_filename, 1);
-    // don't write new xmp:
-    dt_image_cache_write_release(darktable.image_cache, image, DT_IMAGE_CACHE_RELAXED);
+    GList *inputs = NULL;
+    // a bare "-" reads the list of inputs from stdin, like --input-list -
+    for(GList *iter = positional; iter; iter = g_list_next(iter))
+      inputs = strcmp(iter->data, "-") ? add_path(inputs, iter->data) : add_input_list(inputs, "-");
+    for(GList *iter = input_lists; iter; iter = g_list_next(iter)) inputs = add_input_list(inputs, iter->data);
+    inputs = g_list_reverse(inputs);
+    for(GList *iter = inputs; iter; iter = g_list_next(iter))
+    {
+      dt_cli_input_t *input = (dt_cli_input_t *)iter->data;
+      const int id = import_image(input->filename, input->xmp_filename, verbose);
+      if(id) images = g_list_prepend(images, GINT_TO_POINTER(id));
+    }
+    g_list_free_full(inputs, free_input);
+    images = g_list_reverse(images);
+    if(!images)
+    {
+      fprintf(stderr, "%s\n", _("no images to export"));
+      exit(1);
+    }
   }
-
-  // print the history stack
-  if(verbose)
+  else
   {
-    gchar *history = dt_history_get_items_as_string(id);
-    if(history)
-      printf("%s\n", history);
-    else
-      printf("[%s]\n", _("empty history stack"));
+    const int id = import_image(image_filename, xmp_filename, verbose);
+    if(!id) exit(1);
+    images = g_list_append(images, GINT_TO_POINTER(id));
   }
+  g_list_free(positional);
+  g_list_free(input_lists);
 
   // try to find out the export format from the output_filename
   char *ext = output_filename + strlen(output_filename);
@@ -402,13 +617,54 @@ int main(int argc, char *arg[])
 
   if(storage->initialize_store)
   {
-    GList *single_image = g_list_append(NULL, GINT_TO_POINTER(id));
-    storage->initialize_store(storage, sdata, &format, &fdata, &single_image, high_quality, upscale);
-    g_list_free(single_image);
+    storage->initialize_store(storage, sdata, &format, &fdata, &images, high_quality, upscale);
   }
   // TODO: add a callback to set the bpp without going through the config
 
-  storage->store(storage, sdata, id, format, fdata, 1, 1, high_quality, upscale);
+  dt_cli_export_t e = { 0 };
+  e.format = format;
+  e.storage = storage;
+  e.sdata = sdata;
+  e.fdata = fdata;
+  e.high_quality = high_quality;
+  e.upscale = upscale;
+  e.images = images;
+  e.total = g_list_length(images);
+  // leave half of the physical memory to the rest of the system (dt_get_total_memory() is in kb):
+  e.memory_budget = dt_get_total_memory() * (1024 / 2);
+  e.memory_pipe = (size_t)MAX(dt_conf_get_int("host_memory_limit"), 0) << 20;
+  dt_pthread_mutex_init(&e.mutex, NULL);
+  pthread_cond_init(&e.cond, NULL);
+
+  // same rules as the export job in the gui: only run in parallel if the modules can do that
+  if(!threads) threads = dt_conf_get_int("parallel_export_threads");
+  if(!(storage->flags(storage) & STORAGE_FLAGS_SUPPORT_PARALLEL)
+     || (format->flags(fdata) & FORMAT_FLAGS_NO_PARALLEL_EXPORT))
+    threads = 1;
+  threads = CLAMP(threads, 1, MAX(e.total, 1));
+  e.parallel = threads > 1;
+
+  if(e.parallel)
+  {
+    pthread_t *workers = (pthread_t *)malloc(sizeof(pthread_t) * threads);
+    int started = 0;
+    for(int t = 0; t < threads; t++)
+    {
+      if(pthread_create(&workers[started], NULL, export_worker, &e))
+        fprintf(stderr, "[darktable-cli] couldn't start export thread %d\n", t);
+      else
+        started++;
+    }
+    // the images of the threads which didn't start are ours
+    if(started < threads) export_worker(&e);
+    for(int t = 0; t < started; t++) pthread_join(workers[t], NULL);
+    free(workers);
+  }
+  else
+    export_worker(&e);
+
+  pthread_cond_destroy(&e.cond);
+  dt_pthread_mutex_destroy(&e.mutex);
 
   // cleanup time
   if(storage->finalize_store) storage->finalize_store(storage, sdata);
@@ -416,6 +672,8 @@ int main(int argc, char *arg[])
   format->free_params(format, fdata);
 
   dt_cleanup();
+
+  return e.failed ? 1 : 0;
 }
 
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
@@ -69,6 +69,7 @@ typedef struct dt_bilateral_t
   int width, height;
   float sigma_s, sigma_r;
   float *buf;
+  size_t buf_size; // allocated number of floats, might be more than the grid needs
 } dt_bilateral_t;
 
 static void image_to_grid(const dt_bilateral_t *const b, const int i, const int j, const float L, float *x,
@@ -79,13 +80,18 @@ static void image_to_grid(const dt_bilateral_t *const b, const int i, const int
   *z = CLAMPS(L / b->sigma_r, 0, b->size_z - 1);
 }
 
-dt_bilateral_t *dt_bilateral_init(const int width,     // width of input image
-                                  const int height,    // height of input image
-                                  const float sigma_s, // spatial sigma (blur pixel coords)
-                                  const float sigma_r) // range sigma (blur luma values)
+// like dt_bilateral_init(), but reuses the grid of b if it is large enough. b may be NULL.
+dt_bilateral_t *dt_bilateral_reinit(dt_bilateral_t *b,
+                                    const int width,     // width of input image
+                                    const int height,    // height of input image
+                                    const float sigma_s, // spatial sigma (blur pixel coords)
+                                    const float sigma_r) // range sigma (blur luma values)
 {
-  dt_bilateral_t *b = (dt_bilateral_t *)malloc(sizeof(dt_bilateral_t));
-  if(!b) return NULL;
+  if(!b)
+  {
+    b = (dt_bilateral_t *)calloc(1, sizeof(dt_bilateral_t));
+    if(!b) return NULL;
+  }
   // if(width/sigma_s < 4 || width/sigma_s > 1000) fprintf(stderr, "[bilateral] need to clamp sigma_s!\n");
   // if(height/sigma_s < 4 || height/sigma_s > 1000) fprintf(stderr, "[bilateral] need to clamp sigma_s!\n");
   // if(100.0/sigma_r < 4 || 100.0/sigma_r > 100) fprintf(stderr, "[bilateral] need to clamp sigma_r!\n");
@@ -99,9 +105,15 @@ dt_bilateral_t *dt_bilateral_init(const int width,     // width of input image
   b->height = height;
   b->sigma_s = MAX(height / (b->size_y - 1.0f), width / (b->size_x - 1.0f));
   b->sigma_r = 100.0f / (b->size_z - 1.0f);
-  b->buf = dt_alloc_align(16, b->size_x * b->size_y * b->size_z * sizeof(float));
+  const size_t size = b->size_x * b->size_y * b->size_z;
+  if(size > b->buf_size)
+  {
+    dt_free_align(b->buf);
+    b->buf = dt_alloc_align(16, size * sizeof(float));
+    b->buf_size = size;
+  }
 
-  memset(b->buf, 0, b->size_x * b->size_y * b->size_z * sizeof(float));
+  memset(b->buf, 0, size * sizeof(float));
 #if 0
   fprintf(stderr, "[bilateral] created grid [%d %d %d]"
           " with sigma (%f %f) (%f %f)\n", b->size_x, b->size_y, b->size_z,
@@ -110,46 +122,76 @@ dt_bilateral_t *dt_bilateral_init(const int width,     // width of input image
   return b;
 }
 
+dt_bilateral_t *dt_bilateral_init(const int width,     // width of input image
+                                  const int height,    // height of input image
+                                  const float sigma_s, // spatial sigma (blur pixel coords)
+                                  const float sigma_r) // range sigma (blur luma values)
+{
+  return dt_bilateral_reinit(NULL, width, height, sigma_s, sigma_r);
+}
+
 void dt_bilateral_splat(dt_bilateral_t *b, const float *const in)
 {
   const int ox = 1;
   const int oy = b->size_x;
   const int oz = b->size_y * b->size_x;
-// splat into downsampled grid
+  const float norm = 100.0f / (b->sigma_s * b->sigma_s);
+  // splat into downsampled grid. every thread owns a slab of grid rows and goes through all pixel rows
+  // touching it, so no two threads write to the same cell and we need no atomics. only the pixel rows
+  // between two slabs are visited twice.
+  const int slabs = MAX(1, MIN(omp_get_max_threads(), (int)b->size_y / 2));
 #ifdef _OPENMP
-#pragma omp parallel for default(none) shared(b)
+#pragma omp parallel for schedule(static, 1)
 #endif
-  for(int j = 0; j < b->height; j++)
+  for(int slab = 0; slab < slabs; slab++)
   {
-    size_t index = 4 * j * b->width;
-    for(int i = 0; i < b->width; i++)
+    const int y0 = b->size_y * slab / slabs;
+    const int y1 = b->size_y * (slab + 1) / slabs;
+    // conservative range of pixel rows which splat into grid rows [y0, y1)
+    const int j0 = MAX(0, (int)((y0 - 1) * b->sigma_s) - 1);
+    const int j1 = MIN(b->height, (int)(y1 * b->sigma_s) + 2);
+    for(int j = j0; j < j1; j++)
     {
-      float x, y, z;
-      const float L = in[index];
-      image_to_grid(b, i, j, L, &x, &y, &z);
-      const int xi = MIN((int)x, b->size_x - 2);
+      const float y = CLAMPS(j / b->sigma_s, 0, b->size_y - 1);
       const int yi = MIN((int)y, b->size_y - 2);
-      const int zi = MIN((int)z, b->size_z - 2);
-      const float xf = x - xi;
+      if(yi < y0 - 1 || yi >= y1) continue;
       const float yf = y - yi;
-      const float zf = z - zi;
-      // nearest neighbour splatting:
-      const size_t grid_index = xi + b->size_x * (yi + b->size_y * zi);
-      // sum up payload here, doesn't have to be same as edge stopping data
-      // for cross bilateral applications.
-      // also note that this is not clipped (as L->z is), so potentially hdr/out of gamut
-      // should not cause clipping here.
-      for(int k = 0; k < 8; k++)
+      const int lower = yi >= y0, upper = yi + 1 < y1;
+      size_t index = (size_t)4 * j * b->width;
+      for(int i = 0; i < b->width; i++)
       {
-        const size_t ii = grid_index + ((k & 1) ? ox : 0) + ((k & 2) ? oy : 0) + ((k & 4) ? oz : 0);
-        const float contrib = ((k & 1) ? xf : (1.0f - xf)) * ((k & 2) ? yf : (1.0f - yf))
-                              * ((k & 4) ? zf : (1.0f - zf)) * 100.0f / (b->sigma_s * b->sigma_s);
-#ifdef _OPENMP
-#pragma omp atomic
-#endif
-        b->buf[ii] += contrib;
+        const float L = in[index];
+        const float x = CLAMPS(i / b->sigma_s, 0, b->size_x - 1);
+        const float z = CLAMPS(L / b->sigma_r, 0, b->size_z - 1);
+        const int xi = MIN((int)x, b->size_x - 2);
+        const int zi = MIN((int)z, b->size_z - 2);
+        const float xf = x - xi;
+        const float zf = z - zi;
+        // nearest neighbour splatting:
+        const size_t grid_index = xi + b->size_x * (yi + b->size_y * zi);
+        // sum up payload here, doesn't have to be same as edge stopping data
+        // for cross bilateral applications.
+        // also note that this is not clipped (as L->z is), so potentially hdr/out of gamut
+        // should not cause clipping here.
+        const float w[4] = { (1.0f - xf) * (1.0f - zf) * norm, xf * (1.0f - zf) * norm, (1.0f - xf) * zf * norm,
+                             xf * zf * norm };
+        if(lower)
+        {
+          const float wy = 1.0f - yf;
+          b->buf[grid_index] += w[0] * wy;
+          b->buf[grid_index + ox] += w[1] * wy;
+          b->buf[grid_index + oz] += w[2] * wy;
+          b->buf[grid_index + ox + oz] += w[3] * wy;
+        }
+        if(upper)
+        {
+          b->buf[grid_index + oy] += w[0] * yf;
+          b->buf[grid_index + ox + oy] += w[1] * yf;
+          b->buf[grid_index + oy + oz] += w[2] * yf;
+          b->buf[grid_index + ox + oy + oz] += w[3] * yf;
+        }
+        index += 4;
       }
-      index += 4;
     }
   }
 }
@@ -160,7 +202,7 @@ static void blur_line_z(float *buf, const int offset1, const int offset2, const
   const float w1 = 4.f / 16.f;
   const float w2 = 2.f / 16.f;
 #ifdef _OPENMP
-#pragma omp parallel for default(none) shared(buf)
+#pragma omp parallel for
 #endif
   for(int k = 0; k < size1; k++)
   {
@@ -198,7 +240,7 @@ static void blur_line(float *buf, const int offset1, const int offset2, const in
   const float w1 = 4.f / 16.f;
   const float w2 = 1.f / 16.f;
 #ifdef _OPENMP
-#pragma omp parallel for default(none) shared(buf)
+#pragma omp parallel for
 #endif
   for(int k = 0; k < size1; k++)
   {
@@ -250,7 +292,7 @@ void dt_bilateral_slice(const dt_bilateral_t *const b, const float *const in, fl
   const int oy = b->size_x;
   const int oz = b->size_y * b->size_x;
 #ifdef _OPENMP
-#pragma omp parallel for default(none) shared(out)
+#pragma omp parallel for
 #endif
   for(int j = 0; j < b->height; j++)
   {
@@ -295,7 +337,7 @@ void dt_bilateral_slice_to_output(const dt_bilateral_t *const b, const float *co
   const int oy = b->size_x;
   const int oz = b->size_y * b->size_x;
 #ifdef _OPENMP
-#pragma omp parallel for default(none) shared(out)
+#pragma omp parallel for
 #endif
   for(int j = 0; j < b->height; j++)
   {
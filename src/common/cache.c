@@ -18,56 +18,118 @@
 
 #include "common/cache.h"
 #include "common/dtpthread.h"
+#ifndef DT_UNIT_TEST
 #include "common/darktable.h"
+#endif
 
 #include <stdlib.h>
 #include <stdio.h>
 #include <inttypes.h>
 #include <assert.h>
 
-// this implements a concurrent LRU cache
+// this implements a concurrent LRU cache, sharded by key.
+
+static inline dt_cache_shard_t *_cache_shard(dt_cache_t *cache, const uint32_t key)
+{
+  if(!cache->shard_bits) return cache->shards;
+  // fibonacci hashing, consecutive image ids end up in different shards:
+  return cache->shards + ((key * 2654435769u) >> (32 - cache->shard_bits));
+}
+
+// the lru lists are intrusive and doubly linked, all of these are O(1).
+// need the shard lock to be held.
+static inline void _lru_remove(dt_cache_shard_t *shard, dt_cache_entry_t *entry)
+{
+  if(entry->lru_prev) entry->lru_prev->lru_next = entry->lru_next;
+  else shard->lru_head = entry->lru_next;
+  if(entry->lru_next) entry->lru_next->lru_prev = entry->lru_prev;
+  else shard->lru_tail = entry->lru_prev;
+  entry->lru_prev = entry->lru_next = 0;
+}
+
+static inline void _lru_append(dt_cache_shard_t *shard, dt_cache_entry_t *entry)
+{
+  entry->used = g_get_monotonic_time();
+  entry->lru_next = 0;
+  entry->lru_prev = shard->lru_tail;
+  if(shard->lru_tail) shard->lru_tail->lru_next = entry;
+  else shard->lru_head = entry;
+  shard->lru_tail = entry;
+}
+
+static inline void _lru_bubble_up(dt_cache_shard_t *shard, dt_cache_entry_t *entry)
+{
+  if(shard->lru_tail == entry)
+  {
+    entry->used = g_get_monotonic_time();
+    return;
+  }
+  _lru_remove(shard, entry);
+  _lru_append(shard, entry);
+}
 
 void dt_cache_init(
     dt_cache_t *cache,
     size_t entry_size,
     size_t cost_quota)
 {
-  cache->cost = 0;
-  cache->lru = 0;
+  // as many shards as possible while every shard still gets a useful part of the quota:
+  uint32_t bits = 0;
+  while((1u << (bits + 1)) <= DT_CACHE_MAX_SHARDS
+        && cost_quota / (1u << (bits + 1)) >= DT_CACHE_MIN_SHARD_QUOTA)
+    bits++;
+  const uint32_t num_shards = 1u << bits;
+
+  cache->shard_bits = bits;
+  cache->shards = (dt_cache_shard_t *)calloc(num_shards, sizeof(dt_cache_shard_t));
   cache->entry_size = entry_size;
+  cache->cost = 0;
   cache->cost_quota = cost_quota;
-  dt_pthread_mutex_init(&cache->lock, 0);
   cache->allocate = 0;
   cache->allocate_data = 0;
   cache->cleanup = 0;
   cache->cleanup_data = 0;
-  cache->hashtable = g_hash_table_new(0, 0);
+  for(uint32_t k = 0; k < num_shards; k++)
+  {
+    dt_cache_shard_t *shard = cache->shards + k;
+    dt_pthread_mutex_init(&shard->lock, 0);
+    shard->cost = 0;
+    shard->hashtable = g_hash_table_new(0, 0);
+    shard->lru_head = shard->lru_tail = 0;
+  }
 }
 
 void dt_cache_cleanup(dt_cache_t *cache)
 {
-  g_hash_table_destroy(cache->hashtable);
-  GList *l = cache->lru;
-  while(l)
+  const uint32_t num_shards = 1u << cache->shard_bits;
+  for(uint32_t k = 0; k < num_shards; k++)
   {
-    dt_cache_entry_t *entry = (dt_cache_entry_t *)l->data;
-    if(cache->cleanup)
-      cache->cleanup(cache->cleanup_data, entry);
-    else
-      dt_free_align(entry->data);
-    dt_pthread_rwlock_destroy(&entry->lock);
-    g_slice_free1(sizeof(*entry), entry);
-    l = g_list_next(l);
+    dt_cache_shard_t *shard = cache->shards + k;
+    g_hash_table_destroy(shard->hashtable);
+    dt_cache_entry_t *entry = shard->lru_head;
+    while(entry)
+    {
+      dt_cache_entry_t *next = entry->lru_next;
+      if(cache->cleanup)
+        cache->cleanup(cache->cleanup_data, entry);
+      else
+        dt_free_align(entry->data);
+      dt_pthread_rwlock_destroy(&entry->lock);
+      g_slice_free1(sizeof(*entry), entry);
+      entry = next;
+    }
+    dt_pthread_mutex_destroy(&shard->lock);
   }
-  g_list_free(cache->lru);
-  dt_pthread_mutex_destroy(&cache->lock);
+  free(cache->shards);
+  cache->shards = 0;
 }
 
 int32_t dt_cache_contains(dt_cache_t *cache, const uint32_t key)
 {
-  dt_pthread_mutex_lock(&cache->lock);
-  int32_t result = g_hash_table_contains(cache->hashtable, GINT_TO_POINTER(key));
-  dt_pthread_mutex_unlock(&cache->lock);
+  dt_cache_shard_t *shard = _cache_shard(cache, key);
+  dt_pthread_mutex_lock(&shard->lock);
+  int32_t result = g_hash_table_contains(shard->hashtable, GINT_TO_POINTER(key));
+  dt_pthread_mutex_unlock(&shard->lock);
   return result;
 }
 
@@ -76,22 +138,27 @@ int dt_cache_for_all(
     int (*process)(const uint32_t key, const void *data, void *user_data),
     void *user_data)
 {
-  dt_pthread_mutex_lock(&cache->lock);
-  GHashTableIter iter;
-  gpointer key, value;
-
-  g_hash_table_iter_init (&iter, cache->hashtable);
-  while (g_hash_table_iter_next (&iter, &key, &value))
+  const uint32_t num_shards = 1u << cache->shard_bits;
+  for(uint32_t k = 0; k < num_shards; k++)
   {
-    dt_cache_entry_t *entry = (dt_cache_entry_t *)value;
-    const int err = process(GPOINTER_TO_INT(key), entry->data, user_data);
-    if(err)
+    dt_cache_shard_t *shard = cache->shards + k;
+    dt_pthread_mutex_lock(&shard->lock);
+    GHashTableIter iter;
+    gpointer key, value;
+
+    g_hash_table_iter_init (&iter, shard->hashtable);
+    while (g_hash_table_iter_next (&iter, &key, &value))
     {
-      dt_pthread_mutex_unlock(&cache->lock);
-      return err;
+      dt_cache_entry_t *entry = (dt_cache_entry_t *)value;
+      const int err = process(GPOINTER_TO_INT(key), entry->data, user_data);
+      if(err)
+      {
+        dt_pthread_mutex_unlock(&shard->lock);
+        return err;
+      }
     }
+    dt_pthread_mutex_unlock(&shard->lock);
   }
-  dt_pthread_mutex_unlock(&cache->lock);
   return 0;
 }
 
@@ -102,10 +169,11 @@ dt_cache_entry_t *dt_cache_testget(dt_cache_t *cache, const uint32_t key, char m
   gpointer orig_key, value;
   gboolean res;
   int result;
+  dt_cache_shard_t *shard = _cache_shard(cache, key);
   double start = dt_get_wtime();
-  dt_pthread_mutex_lock(&cache->lock);
+  dt_pthread_mutex_lock(&shard->lock);
   res = g_hash_table_lookup_extended(
-      cache->hashtable, GINT_TO_POINTER(key), &orig_key, &value);
+      shard->hashtable, GINT_TO_POINTER(key), &orig_key, &value);
   if(res)
   {
     dt_cache_entry_t *entry = (dt_cache_entry_t *)value;
@@ -115,25 +183,97 @@ dt_cache_entry_t *dt_cache_testget(dt_cache_t *cache, const uint32_t key, char m
     if(result)
     { // need to give up mutex so other threads have a chance to get in between and
       // free the lock we're trying to acquire:
-      dt_pthread_mutex_unlock(&cache->lock);
+      dt_pthread_mutex_unlock(&shard->lock);
       return 0;
     }
     // bubble up in lru list:
-    cache->lru = g_list_remove_link(cache->lru, entry->link);
-    cache->lru = g_list_concat(cache->lru, entry->link);
-    dt_pthread_mutex_unlock(&cache->lock);
+    _lru_bubble_up(shard, entry);
+    dt_pthread_mutex_unlock(&shard->lock);
     double end = dt_get_wtime();
     if(end - start > 0.1)
       fprintf(stderr, "try+ wait time %.06fs mode %c \n", end - start, mode);
     return entry;
   }
-  dt_pthread_mutex_unlock(&cache->lock);
+  dt_pthread_mutex_unlock(&shard->lock);
   double end = dt_get_wtime();
   if(end - start > 0.1)
     fprintf(stderr, "try- wait time %.06fs\n", end - start);
   return 0;
 }
 
+// drops an entry we hold the write lock of. needs the shard lock to be held.
+static void _cache_shard_evict(dt_cache_t *cache, dt_cache_shard_t *shard, dt_cache_entry_t *entry)
+{
+  g_hash_table_remove(shard->hashtable, GINT_TO_POINTER(entry->key));
+  _lru_remove(shard, entry);
+  shard->cost -= entry->cost;
+  __sync_fetch_and_sub(&cache->cost, entry->cost);
+
+  if(cache->cleanup)
+    cache->cleanup(cache->cleanup_data, entry);
+  else
+    dt_free_align(entry->data);
+  dt_pthread_rwlock_unlock(&entry->lock);
+  dt_pthread_rwlock_destroy(&entry->lock);
+  g_slice_free1(sizeof(*entry), entry);
+}
+
+// best-effort garbage collection of one shard until the whole cache meets the fill ratio.
+// needs the shard lock to be held.
+static void _cache_shard_gc(dt_cache_t *cache, dt_cache_shard_t *shard, const float fill_ratio)
+{
+  dt_cache_entry_t *entry = shard->lru_head;
+  while(entry)
+  {
+    dt_cache_entry_t *next = entry->lru_next; // we might remove this element, so remember the next one
+    if(cache->cost < cache->cost_quota * fill_ratio) break;
+
+    // if still locked by anyone else give up:
+    if(!dt_pthread_rwlock_trywrlock(&entry->lock)) _cache_shard_evict(cache, shard, entry);
+    entry = next;
+  }
+}
+
+// when the shard of a new entry can't make room by itself (too few or only locked entries), evict from the
+// others, always from the one with the least recently used entry. we hold the lock of our own shard, so the
+// others are only tried, and skipped if busy.
+static void _cache_gc_others(dt_cache_t *cache, dt_cache_shard_t *own, const float fill_ratio)
+{
+  const uint32_t num_shards = 1u << cache->shard_bits;
+  uint32_t skip = 1u << (own - cache->shards); // shards with nothing we can evict
+  while(cache->cost >= cache->cost_quota * fill_ratio)
+  {
+    dt_cache_shard_t *oldest = NULL;
+    gint64 oldest_used = G_MAXINT64;
+    for(uint32_t k = 0; k < num_shards; k++)
+    {
+      dt_cache_shard_t *shard = cache->shards + k;
+      if((skip & (1u << k)) || dt_pthread_mutex_trylock(&shard->lock)) continue;
+      if(shard->lru_head && shard->lru_head->used < oldest_used)
+      {
+        oldest = shard;
+        oldest_used = shard->lru_head->used;
+      }
+      dt_pthread_mutex_unlock(&shard->lock);
+    }
+    if(!oldest) return;
+
+    // the first entry nobody else holds
+    gboolean evicted = FALSE;
+    if(!dt_pthread_mutex_trylock(&oldest->lock))
+    {
+      for(dt_cache_entry_t *entry = oldest->lru_head; entry && !evicted; entry = entry->lru_next)
+        if(!dt_pthread_rwlock_trywrlock(&entry->lock))
+        {
+          _cache_shard_evict(cache, oldest, entry);
+          evicted = TRUE;
+        }
+      dt_pthread_mutex_unlock(&oldest->lock);
+    }
+    if(!evicted) skip |= 1u << (oldest - cache->shards);
+  }
+}
+
 // if found, the data void* is returned. if not, it is set to be
 // the given *data and a new hash table entry is created, which can be
 // found using the given key later on.
@@ -142,11 +282,12 @@ dt_cache_entry_t *dt_cache_get_with_caller(dt_cache_t *cache, const uint32_t key
   gpointer orig_key, value;
   gboolean res;
   int result;
+  dt_cache_shard_t *shard = _cache_shard(cache, key);
   double start = dt_get_wtime();
 restart:
-  dt_pthread_mutex_lock(&cache->lock);
+  dt_pthread_mutex_lock(&shard->lock);
   res = g_hash_table_lookup_extended(
-      cache->hashtable, GINT_TO_POINTER(key), &orig_key, &value);
+      shard->hashtable, GINT_TO_POINTER(key), &orig_key, &value);
   if(res)
   { // yay, found. read lock and pass on.
     dt_cache_entry_t *entry = (dt_cache_entry_t *)value;
@@ -155,14 +296,13 @@ restart:
     if(result)
     { // need to give up mutex so other threads have a chance to get in between and
       // free the lock we're trying to acquire:
-      dt_pthread_mutex_unlock(&cache->lock);
+      dt_pthread_mutex_unlock(&shard->lock);
       g_usleep(5);
       goto restart;
     }
     // bubble up in lru list:
-    cache->lru = g_list_remove_link(cache->lru, entry->link);
-    cache->lru = g_list_concat(cache->lru, entry->link);
-    dt_pthread_mutex_unlock(&cache->lock);
+    _lru_bubble_up(shard, entry);
+    dt_pthread_mutex_unlock(&shard->lock);
     return entry;
   }
 
@@ -173,7 +313,8 @@ restart:
   if(cache->cost > 0.8f * cache->cost_quota)
   {
     // need to roll back all the way to get a consistent lock state:
-    dt_cache_gc(cache, 0.8f);
+    _cache_shard_gc(cache, shard, 0.8f);
+    if(cache->cost > 0.8f * cache->cost_quota) _cache_gc_others(cache, shard, 0.8f);
   }
 
   // here dies your 32-bit system:
@@ -182,9 +323,9 @@ restart:
   if(ret) fprintf(stderr, "rwlock init: %d\n", ret);
   entry->data = 0;
   entry->cost = 1;
-  entry->link = g_list_append(0, entry);
+  entry->lru_prev = entry->lru_next = 0;
   entry->key = key;
-  g_hash_table_insert(cache->hashtable, GINT_TO_POINTER(key), entry);
+  g_hash_table_insert(shard->hashtable, GINT_TO_POINTER(key), entry);
   // if allocate callback is given, always return a write lock
   int write = ((mode == 'w') || cache->allocate);
   if(cache->allocate)
@@ -194,12 +335,13 @@ restart:
   // write lock in case the caller requests it:
   if(write) dt_pthread_rwlock_wrlock_with_caller(&entry->lock, file, line);
   else      dt_pthread_rwlock_rdlock_with_caller(&entry->lock, file, line);
-  cache->cost += entry->cost;
+  shard->cost += entry->cost;
+  __sync_fetch_and_add(&cache->cost, entry->cost);
 
   // put at end of lru list (most recently used):
-  cache->lru = g_list_concat(cache->lru, entry->link);
+  _lru_append(shard, entry);
 
-  dt_pthread_mutex_unlock(&cache->lock);
+  dt_pthread_mutex_unlock(&shard->lock);
   double end = dt_get_wtime();
   if(end - start > 0.1)
     fprintf(stderr, "wait time %.06fs\n", end - start);
@@ -212,30 +354,31 @@ int dt_cache_remove(dt_cache_t *cache, const uint32_t key)
   gboolean res;
   int result;
   dt_cache_entry_t *entry;
+  dt_cache_shard_t *shard = _cache_shard(cache, key);
 restart:
-  dt_pthread_mutex_lock(&cache->lock);
+  dt_pthread_mutex_lock(&shard->lock);
 
   res = g_hash_table_lookup_extended(
-      cache->hashtable, GINT_TO_POINTER(key), &orig_key, &value);
+      shard->hashtable, GINT_TO_POINTER(key), &orig_key, &value);
   entry = (dt_cache_entry_t *)value;
   if(!res)
   { // not found in cache, not deleting.
-    dt_pthread_mutex_unlock(&cache->lock);
+    dt_pthread_mutex_unlock(&shard->lock);
     return 1;
   }
   // need write lock to be able to delete:
   result = dt_pthread_rwlock_trywrlock(&entry->lock);
   if(result)
   {
-    dt_pthread_mutex_unlock(&cache->lock);
+    dt_pthread_mutex_unlock(&shard->lock);
     g_usleep(5);
     goto restart;
   }
 
-  gboolean removed = g_hash_table_remove(cache->hashtable, GINT_TO_POINTER(key));
+  gboolean removed = g_hash_table_remove(shard->hashtable, GINT_TO_POINTER(key));
   (void)removed; // make non-assert compile happy
   assert(removed);
-  cache->lru = g_list_delete_link(cache->lru, entry->link);
+  _lru_remove(shard, entry);
 
   if(cache->cleanup)
     cache->cleanup(cache->cleanup_data, entry);
@@ -243,41 +386,24 @@ restart:
     dt_free_align(entry->data);
   dt_pthread_rwlock_unlock(&entry->lock);
   dt_pthread_rwlock_destroy(&entry->lock);
-  cache->cost -= entry->cost;
+  shard->cost -= entry->cost;
+  __sync_fetch_and_sub(&cache->cost, entry->cost);
   g_slice_free1(sizeof(*entry), entry);
 
-  dt_pthread_mutex_unlock(&cache->lock);
+  dt_pthread_mutex_unlock(&shard->lock);
   return 0;
 }
 
 // best-effort garbage collection. never blocks, never fails. well, sometimes it just doesn't free anything.
 void dt_cache_gc(dt_cache_t *cache, const float fill_ratio)
 {
-  GList *l = cache->lru;
-  int cnt = 0;
-  while(l)
+  const uint32_t num_shards = 1u << cache->shard_bits;
+  for(uint32_t k = 0; k < num_shards && cache->cost >= cache->cost_quota * fill_ratio; k++)
   {
-    cnt++;
-    dt_cache_entry_t *entry = (dt_cache_entry_t *)l->data;
-    assert(entry->link->data == entry);
-    l = g_list_next(l); // we might remove this element, so walk to the next one while we still have the pointer..
-    if(cache->cost < cache->cost_quota * fill_ratio) break;
-
-    // if still locked by anyone else give up:
-    if(dt_pthread_rwlock_trywrlock(&entry->lock)) continue;
-
-    // delete!
-    g_hash_table_remove(cache->hashtable, GINT_TO_POINTER(entry->key));
-    cache->lru = g_list_delete_link(cache->lru, entry->link);
-    cache->cost -= entry->cost;
-
-    if(cache->cleanup)
-      cache->cleanup(cache->cleanup_data, entry);
-    else
-      dt_free_align(entry->data);
-    dt_pthread_rwlock_unlock(&entry->lock);
-    dt_pthread_rwlock_destroy(&entry->lock);
-    g_slice_free1(sizeof(*entry), entry);
+    dt_cache_shard_t *shard = cache->shards + k;
+    dt_pthread_mutex_lock(&shard->lock);
+    _cache_shard_gc(cache, shard, fill_ratio);
+    dt_pthread_mutex_unlock(&shard->lock);
   }
 }
 
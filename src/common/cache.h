@@ -28,23 +28,42 @@ typedef struct dt_cache_entry_t
 {
   void *data;
   size_t cost;
-  GList *link;
+  struct dt_cache_entry_t *lru_prev, *lru_next; // intrusive lru list of the shard this entry lives in
+  gint64 used; // monotonic time of the last use, to compare lru entries between shards
   dt_pthread_rwlock_t lock;
   uint32_t key;
 }
 dt_cache_entry_t;
 
+// the cache is split into independent shards by key, so threads working on
+// different images mostly don't contend on the same mutex. the quota is global,
+// eviction happens from the lru end of the shard the new entry goes to, and if
+// that isn't enough from the other shards, least recently used entries first.
+#define DT_CACHE_MAX_SHARDS 32
+// don't split caches with tiny quotas (counting full buffers, say) further than that:
+#define DT_CACHE_MIN_SHARD_QUOTA 64
+
+typedef struct dt_cache_shard_t
+{
+  dt_pthread_mutex_t lock; // protects the hashtable, the lru list and the cost of this shard
+
+  size_t cost; // user supplied cost of the entries in this shard
+
+  GHashTable *hashtable;      // stores (key, entry) pairs
+  dt_cache_entry_t *lru_head; // about to be kicked from cache
+  dt_cache_entry_t *lru_tail; // most recently used
+}
+dt_cache_shard_t;
+
 typedef struct dt_cache_t
 {
-  dt_pthread_mutex_t lock; // big fat lock. we're only expecting a couple hand full of cpu threads to use this concurrently.
+  dt_cache_shard_t *shards;
+  uint32_t shard_bits; // 1 << shard_bits shards
 
   size_t entry_size; // cache line allocation
-  size_t cost;       // user supplied cost per cache line (bytes?)
+  size_t cost;       // user supplied cost per cache line (bytes?), sum over all shards. atomic.
   size_t cost_quota; // quota to try and meet. but don't use as hard limit.
 
-  GHashTable *hashtable; // stores (key, entry) pairs
-  GList *lru;            // last element is most recently used, first is about to be kicked from cache.
-
   // callback functions for cache misses/garbage collection
   void (*allocate)(void *userdata, dt_cache_entry_t *entry);
   void (*cleanup)(void *userdata, dt_cache_entry_t *entry);
@@ -0,0 +1,247 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2010 Henrik Andersson.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DT_COMMON_CLAHE_H
+#define DT_COMMON_CLAHE_H
+
+// contrast limited adaptive histogram equalization of a luminance buffer in [0,1],
+// as used by the local contrast (rlce) module.
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DT_CLAHE_BINS 256
+// smallest tile edge of the tiled version, and how many tables of DT_CLAHE_BINS + 1 floats it may keep
+#define DT_CLAHE_MIN_TILE 16
+#define DT_CLAHE_MAX_TILES (1 << 15)
+
+#define DT_CLAHE_ROUND_POSITIVE(f) ((unsigned int)((f)+0.5))
+
+/* clip histogram and redistribute clipped entries */
+static inline void dt_clahe_clip_histogram(int *const clippedhist, const int *const hist, const int bins,
+                                           const int limit)
+{
+  memcpy(clippedhist, hist, (bins + 1) * sizeof(int));
+  int ce = 0, ceb = 0;
+  do
+  {
+    ceb = ce;
+    ce = 0;
+    for(int b = 0; b <= bins; b++)
+    {
+      int d = clippedhist[b] - limit;
+      if(d > 0)
+      {
+        ce += d;
+        clippedhist[b] = limit;
+      }
+    }
+
+    int d = (ce / (float)(bins + 1));
+    int m = ce % (bins + 1);
+    for(int h = 0; h <= bins; h++) clippedhist[h] += d;
+
+    if(m != 0)
+    {
+      int s = bins / (float)m;
+      for(int h = 0; h <= bins; h += s) ++clippedhist[h];
+    }
+  } while(ce != ceb);
+}
+
+/* build cdf of clipped histogram and evaluate it at bin v */
+static inline float dt_clahe_cdf(const int *const clippedhist, const int bins, const int v)
+{
+  int hMin = bins;
+  for(int h = 0; h < hMin; h++)
+    if(clippedhist[h] != 0) hMin = h;
+
+  int cdf = 0;
+  for(int h = hMin; h <= v; h++) cdf += clippedhist[h];
+
+  int cdfMax = cdf;
+  for(int h = v + 1; h <= bins; h++) cdfMax += clippedhist[h];
+
+  int cdfMin = clippedhist[hMin];
+
+  return (cdf - cdfMin) / (float)(cdfMax - cdfMin);
+}
+
+/* the same cdf as above, tabulated for all bins and clamped to [0,1] */
+static inline void dt_clahe_cdf_table(const int *const clippedhist, const int bins, float *const table)
+{
+  int hMin = bins;
+  for(int h = 0; h < hMin; h++)
+    if(clippedhist[h] != 0) hMin = h;
+
+  int cdfMax = 0;
+  for(int h = hMin; h <= bins; h++) cdfMax += clippedhist[h];
+  const int cdfMin = clippedhist[hMin];
+  const float norm = cdfMax > cdfMin ? 1.0f / (cdfMax - cdfMin) : 0.0f;
+
+  int cdf = 0;
+  for(int h = 0; h <= bins; h++)
+  {
+    if(h >= hMin) cdf += clippedhist[h];
+    table[h] = fminf(1.0f, fmaxf(0.0f, (cdf - cdfMin) * norm));
+  }
+}
+
+/* exact clahe: one histogram per output pixel, slid along the rows.
+   O(width * height * (rad + bins)). */
+static void dt_clahe_sliding(const float *const luminance, float *const dest, const int width, const int height,
+                             const int rad, const float slope)
+{
+  const int bins = DT_CLAHE_BINS;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for(int j = 0; j < height; j++)
+  {
+    int yMin = fmax(0, j - rad);
+    int yMax = fmin(height, j + rad + 1);
+    int h = yMax - yMin;
+
+    int xMin0 = fmax(0, 0 - rad);
+    int xMax0 = fmin(width - 1, rad);
+
+    int hist[bins + 1];
+    int clippedhist[bins + 1];
+
+    /* initially fill histogram */
+    memset(hist, 0, (bins + 1) * sizeof(int));
+    for(int yi = yMin; yi < yMax; ++yi)
+      for(int xi = xMin0; xi < xMax0; ++xi)
+        ++hist[DT_CLAHE_ROUND_POSITIVE(luminance[(size_t)yi * width + xi] * (float)bins)];
+
+    // Destination row
+    float *ld = dest + (size_t)j * width;
+
+    for(int i = 0; i < width; i++)
+    {
+
+      int v = DT_CLAHE_ROUND_POSITIVE(luminance[(size_t)j * width + i] * (float)bins);
+
+      int xMin = fmax(0, i - rad);
+      int xMax = i + rad + 1;
+      int w = fmin(width, xMax) - xMin;
+      int n = h * w;
+
+      int limit = (int)(slope * n / bins + 0.5f);
+
+      /* remove left behind values from histogram */
+      if(xMin > 0)
+      {
+        int xMin1 = xMin - 1;
+        for(int yi = yMin; yi < yMax; ++yi)
+          --hist[DT_CLAHE_ROUND_POSITIVE(luminance[(size_t)yi * width + xMin1] * (float)bins)];
+      }
+
+      /* add newly included values to histogram */
+      if(xMax <= width)
+      {
+        int xMax1 = xMax - 1;
+        for(int yi = yMin; yi < yMax; ++yi)
+          ++hist[DT_CLAHE_ROUND_POSITIVE(luminance[(size_t)yi * width + xMax1] * (float)bins)];
+      }
+
+      dt_clahe_clip_histogram(clippedhist, hist, bins, limit);
+      *ld = dt_clahe_cdf(clippedhist, bins, v);
+
+      ld++;
+    }
+  }
+}
+
+/* tiled clahe: one clipped cdf per tile of the size of the sliding window, bilinearly
+   interpolated between the four closest tile centers. O(width * height + tiles * bins).
+   tiles are at least DT_CLAHE_MIN_TILE pixels wide, and grow until there are no more than DT_CLAHE_MAX_TILES
+   of them. the sliding window costs a cdf per pixel even for small radii, so it is only the last resort. */
+static void dt_clahe_tiled(const float *const luminance, float *const dest, const int width, const int height,
+                           const int rad, const float slope)
+{
+  const int bins = DT_CLAHE_BINS;
+  int tile = 2 * rad + 1 < DT_CLAHE_MIN_TILE ? DT_CLAHE_MIN_TILE : 2 * rad + 1;
+  while((size_t)((width + tile - 1) / tile) * ((height + tile - 1) / tile) > DT_CLAHE_MAX_TILES) tile++;
+  const int nx = (width + tile - 1) / tile;
+  const int ny = (height + tile - 1) / tile;
+  float *const tables = (float *)malloc(sizeof(float) * (bins + 1) * nx * ny);
+  if(!tables)
+  {
+    // slower, but needs no memory
+    dt_clahe_sliding(luminance, dest, width, height, rad, slope);
+    return;
+  }
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for(int t = 0; t < nx * ny; t++)
+  {
+    const int x0 = (t % nx) * tile, x1 = fmin(width, x0 + tile);
+    const int y0 = (t / nx) * tile, y1 = fmin(height, y0 + tile);
+
+    int hist[bins + 1];
+    int clippedhist[bins + 1];
+    memset(hist, 0, (bins + 1) * sizeof(int));
+    for(int yi = y0; yi < y1; yi++)
+      for(int xi = x0; xi < x1; xi++)
+        ++hist[DT_CLAHE_ROUND_POSITIVE(luminance[(size_t)yi * width + xi] * (float)bins)];
+
+    const int n = (x1 - x0) * (y1 - y0);
+    const int limit = (int)(slope * n / bins + 0.5f);
+    dt_clahe_clip_histogram(clippedhist, hist, bins, limit);
+    dt_clahe_cdf_table(clippedhist, bins, tables + (size_t)t * (bins + 1));
+  }
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for(int j = 0; j < height; j++)
+  {
+    // position relative to the tile centers
+    const float gy = (j + 0.5f) / tile - 0.5f;
+    const int ty0 = fminf(ny - 1, fmaxf(0.0f, floorf(gy)));
+    const int ty1 = ty0 + 1 < ny ? ty0 + 1 : ty0;
+    const float wy = fminf(1.0f, fmaxf(0.0f, gy - ty0));
+    float *ld = dest + (size_t)j * width;
+    for(int i = 0; i < width; i++)
+    {
+      const float gx = (i + 0.5f) / tile - 0.5f;
+      const int tx0 = fminf(nx - 1, fmaxf(0.0f, floorf(gx)));
+      const int tx1 = tx0 + 1 < nx ? tx0 + 1 : tx0;
+      const float wx = fminf(1.0f, fmaxf(0.0f, gx - tx0));
+
+      const int v = DT_CLAHE_ROUND_POSITIVE(luminance[(size_t)j * width + i] * (float)bins);
+      const float m00 = tables[((size_t)ty0 * nx + tx0) * (bins + 1) + v];
+      const float m01 = tables[((size_t)ty0 * nx + tx1) * (bins + 1) + v];
+      const float m10 = tables[((size_t)ty1 * nx + tx0) * (bins + 1) + v];
+      const float m11 = tables[((size_t)ty1 * nx + tx1) * (bins + 1) + v];
+      ld[i] = (1.0f - wy) * ((1.0f - wx) * m00 + wx * m01) + wy * ((1.0f - wx) * m10 + wx * m11);
+    }
+  }
+
+  free(tables);
+}
+
+#endif
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
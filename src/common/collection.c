@@ -53,6 +53,8 @@ static uint32_t _dt_collection_compute_count(const dt_collection_t *collection);
  * we need 2 different since there are different kinds of signals we need to listen to. */
 static void _dt_collection_recount_callback_1(gpointer instace, gpointer user_data);
 static void _dt_collection_recount_callback_2(gpointer instance, uint8_t id, gpointer user_data);
+/* a single new image doesn't need the whole collection to be rebuilt */
+static void _dt_collection_image_import_callback(gpointer instance, guint imgid, gpointer user_data);
 
 
 const dt_collection_t *dt_collection_new(const dt_collection_t *clone)
@@ -82,7 +84,7 @@ const dt_collection_t *dt_collection_new(const dt_collection_t *clone)
                             G_CALLBACK(_dt_collection_recount_callback_1), collection);
 
   dt_control_signal_connect(darktable.signals, DT_SIGNAL_IMAGE_IMPORT,
-                            G_CALLBACK(_dt_collection_recount_callback_2), collection);
+                            G_CALLBACK(_dt_collection_image_import_callback), collection);
   dt_control_signal_connect(darktable.signals, DT_SIGNAL_FILMROLLS_IMPORTED,
                             G_CALLBACK(_dt_collection_recount_callback_2), collection);
 
@@ -95,6 +97,8 @@ void dt_collection_free(const dt_collection_t *collection)
                                (gpointer)collection);
   dt_control_signal_disconnect(darktable.signals, G_CALLBACK(_dt_collection_recount_callback_2),
                                (gpointer)collection);
+  dt_control_signal_disconnect(darktable.signals, G_CALLBACK(_dt_collection_image_import_callback),
+                               (gpointer)collection);
 
   g_free(collection->query);
   g_free(collection->where_ext);
@@ -106,13 +110,11 @@ const dt_collection_params_t *dt_collection_params(const dt_collection_t *collec
   return &collection->params;
 }
 
-int dt_collection_update(const dt_collection_t *collection)
+/* builds the filter part of the collection query, shared by the query itself and the membership test */
+static gchar *_dt_collection_where(const dt_collection_t *collection)
 {
-  uint32_t result;
-  gchar *wq, *sq, *selq, *query;
-  wq = sq = selq = query = NULL;
+  gchar *wq = NULL;
 
-  /* build where part */
   if(!(collection->params.query_flags & COLLECTION_QUERY_USE_ONLY_WHERE_EXT))
   {
     int need_operator = 0;
@@ -161,6 +163,18 @@ int dt_collection_update(const dt_collection_t *collection)
     wq = dt_util_dstrcat(wq, " and (group_id = id or group_id = %d)", darktable.gui->expanded_group_id);
   }
 
+  return wq;
+}
+
+int dt_collection_update(const dt_collection_t *collection)
+{
+  uint32_t result;
+  gchar *wq, *sq, *selq, *query;
+  sq = selq = query = NULL;
+
+  /* build where part */
+  wq = _dt_collection_where(collection);
+
   /* build select part includes where */
   if(collection->params.sort == DT_COLLECTION_SORT_COLOR
      && (collection->params.query_flags & COLLECTION_QUERY_USE_SORT))
@@ -425,6 +439,80 @@ static uint32_t _dt_collection_compute_count(const dt_collection_t *collection)
   return count;
 }
 
+int dt_collection_image_is_member(const dt_collection_t *collection, int imgid)
+{
+  /* the extended where part is a free form clause, we can't restrict it to one image */
+  if(collection->params.query_flags & COLLECTION_QUERY_USE_ONLY_WHERE_EXT) return -1;
+
+  sqlite3_stmt *stmt;
+  int member = 0;
+  gchar *wq = _dt_collection_where(collection);
+  gchar *query = dt_util_dstrcat(NULL, "select id from images where id = ?1 and (%s)", wq);
+
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+  if(sqlite3_step(stmt) == SQLITE_ROW) member = 1;
+  sqlite3_finalize(stmt);
+
+  g_free(query);
+  g_free(wq);
+  return member;
+}
+
+int dt_collection_image_sort_position(const dt_collection_t *collection, int imgid, const int32_t *ids,
+                                      int count)
+{
+  if(!(collection->params.query_flags & COLLECTION_QUERY_USE_SORT)
+     || (collection->params.query_flags & COLLECTION_QUERY_USE_ONLY_WHERE_EXT))
+    return -1;
+
+  /* the same select and sort as dt_collection_update(), restricted to the two images being compared */
+  gchar *sq = dt_collection_get_sort_query(collection);
+  gchar *query;
+  if(collection->params.sort == DT_COLLECTION_SORT_COLOR)
+    query = dt_util_dstrcat(NULL, "select distinct id from (select * from images where id in (?1, ?2)) as a "
+                                  "left outer join color_labels as b on a.id = b.imgid %s limit 1",
+                            sq ? sq : "");
+  else
+    query = dt_util_dstrcat(NULL, "select id from images where id in (?1, ?2) %s limit 1", sq ? sq : "");
+
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+  /* binary search for the first image which sorts behind ours */
+  int lo = 0, hi = count;
+  while(lo < hi)
+  {
+    const int mid = lo + (hi - lo) / 2;
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, ids[mid]);
+    const int first = (sqlite3_step(stmt) == SQLITE_ROW) ? sqlite3_column_int(stmt, 0) : imgid;
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    if(first == imgid)
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+  sqlite3_finalize(stmt);
+
+  g_free(query);
+  g_free(sq);
+  return lo;
+}
+
+void dt_collection_images_changed(const dt_collection_t *collection, GList *imgs, int member)
+{
+  const uint32_t old_count = collection->count;
+  ((dt_collection_t *)collection)->count = _dt_collection_compute_count(collection);
+  if(collection->clone || !imgs)
+  {
+    g_list_free(imgs);
+    return;
+  }
+  if(old_count != collection->count) dt_collection_hint_message(collection);
+  dt_control_signal_raise(darktable.signals, DT_SIGNAL_COLLECTION_IMAGES_CHANGED, imgs, member);
+}
+
 uint32_t dt_collection_get_count(const dt_collection_t *collection)
 {
   return collection->count;
@@ -991,6 +1079,16 @@ static void _dt_collection_recount_callback_2(gpointer instance, uint8_t id, gpo
   }
 }
 
+static void _dt_collection_image_import_callback(gpointer instance, guint imgid, gpointer user_data)
+{
+  dt_collection_t *collection = (dt_collection_t *)user_data;
+  const int member = dt_collection_image_is_member(collection, imgid);
+  if(member < 0)
+    _dt_collection_recount_callback_2(instance, imgid, user_data);
+  else if(member)
+    dt_collection_images_changed(collection, g_list_prepend(NULL, GINT_TO_POINTER(imgid)), TRUE);
+}
+
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
 // kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
@@ -182,6 +182,15 @@ gchar *dt_collection_get_sort_query(const dt_collection_t *collection);
 
 /** get the count of query */
 uint32_t dt_collection_get_count(const dt_collection_t *collection);
+/** check if an image passes the filters of the collection, -1 if that can't be told without the full query */
+int dt_collection_image_is_member(const dt_collection_t *collection, int imgid);
+/** returns where the image goes among the count image ids, which are in the order of the collection.
+ * -1 if the collection isn't sorted. */
+int dt_collection_image_sort_position(const dt_collection_t *collection, int imgid, const int32_t *ids,
+                                      int count);
+/** the images in imgs joined (member) or left the collection while its query stayed the same. updates the
+ * count and raises DT_SIGNAL_COLLECTION_IMAGES_CHANGED, which takes over the list. */
+void dt_collection_images_changed(const dt_collection_t *collection, GList *imgs, int member);
 
 /** get selected image ids order as current selection. no more than limit many images are returned, <0 ==
  * unlimited */
@@ -51,6 +51,7 @@
 #include "common/points.h"
 #include "develop/imageop.h"
 #include "develop/blend.h"
+#include "develop/pixelpipe_cache.h"
 #include "libs/lib.h"
 #include "views/view.h"
 #include "views/undo.h"
@@ -129,6 +130,7 @@ static int usage(const char *argv0)
 #endif
   printf(" [--conf <key>=<value>]");
   printf(" [--noiseprofiles <noiseprofiles json file>]");
+  printf(" [--pipe-profile <json file>]");
   printf("\n");
   return 1;
 }
@@ -650,6 +652,14 @@ int dt_init(int argc, char *argv[], const int init_gui, lua_State *L)
       {
         noiseprofiles_from_command = argv[++k];
       }
+      else if(!strcmp(argv[k], "--pipe-profile") && argc > k + 1)
+      {
+        k++;
+        if(darktable.pipe_profile) fclose(darktable.pipe_profile);
+        darktable.pipe_profile = g_fopen(argv[k], "w");
+        if(!darktable.pipe_profile)
+          fprintf(stderr, "[dt_init] can't open `%s' to write the pixelpipe profile\n", argv[k]);
+      }
       else if(!strcmp(argv[k], "--luacmd") && argc > k + 1)
       {
 #ifdef USE_LUA
@@ -855,6 +865,27 @@ int dt_init(int argc, char *argv[], const int init_gui, lua_State *L)
   darktable.mipmap_cache = (dt_mipmap_cache_t *)calloc(1, sizeof(dt_mipmap_cache_t));
   dt_mipmap_cache_init(darktable.mipmap_cache);
 
+  // intermediate pixelpipe buffers shared between all pipes, a budget of 0 disables it.
+  const int64_t pixelpipe_cache_memory = dt_conf_get_int64("pixelpipe_cache_memory");
+  if(pixelpipe_cache_memory > 0)
+  {
+    darktable.pixelpipe_cache
+        = (dt_dev_pixelpipe_shared_cache_t *)calloc(1, sizeof(dt_dev_pixelpipe_shared_cache_t));
+    dt_dev_pixelpipe_shared_cache_init(darktable.pixelpipe_cache, pixelpipe_cache_memory);
+  }
+  else
+    darktable.pixelpipe_cache = NULL;
+
+  // rasterized drawn masks, shared between all pipes as well.
+  const int64_t mask_cache_memory = dt_conf_get_int64("mask_cache_memory");
+  if(mask_cache_memory > 0)
+  {
+    darktable.mask_cache = (dt_dev_pixelpipe_shared_cache_t *)calloc(1, sizeof(dt_dev_pixelpipe_shared_cache_t));
+    dt_dev_pixelpipe_shared_cache_init(darktable.mask_cache, mask_cache_memory);
+  }
+  else
+    darktable.mask_cache = NULL;
+
   // The GUI must be initialized before the views, because the init()
   // functions of the views depend on darktable.control->accels_* to register
   // their keyboard accelerators
@@ -1000,6 +1031,21 @@ void dt_cleanup()
   free(darktable.image_cache);
   dt_mipmap_cache_cleanup(darktable.mipmap_cache);
   free(darktable.mipmap_cache);
+  if(darktable.pixelpipe_cache)
+  {
+    dt_dev_pixelpipe_shared_cache_cleanup(darktable.pixelpipe_cache);
+    free(darktable.pixelpipe_cache);
+  }
+  if(darktable.mask_cache)
+  {
+    dt_dev_pixelpipe_shared_cache_cleanup(darktable.mask_cache);
+    free(darktable.mask_cache);
+  }
+  if(darktable.pipe_profile)
+  {
+    fclose(darktable.pipe_profile);
+    darktable.pipe_profile = NULL;
+  }
   if(init_gui)
   {
     dt_control_cleanup(darktable.control);
@@ -1123,6 +1169,9 @@ void dt_configure_defaults()
   const int bits = (sizeof(void *) == 4) ? 32 : 64;
   fprintf(stderr, "[defaults] found a %d-bit system with %zu kb ram and %d cores (%d atom based)\n", bits,
           mem, threads, atom_cores);
+  // an eighth of the memory for the shared pixelpipe cache. a full 40 megapixel buffer alone is 640MB.
+  const int64_t pixelpipe_cache_memory = CLAMPS((int64_t)mem * 1024 / 8, (int64_t)512 << 20, (int64_t)4 << 30);
+  dt_conf_set_int64("pixelpipe_cache_memory", pixelpipe_cache_memory);
   if(mem > (2u << 20) && threads > 4)
   {
     fprintf(stderr, "[defaults] setting high quality defaults\n");
@@ -140,6 +140,7 @@ struct dt_control_t;
 struct dt_develop_t;
 struct dt_mipmap_cache_t;
 struct dt_image_cache_t;
+struct dt_dev_pixelpipe_shared_cache_t;
 struct dt_lib_t;
 struct dt_conf_t;
 struct dt_points_t;
@@ -187,6 +188,9 @@ typedef struct darktable_t
   struct dt_gui_gtk_t *gui;
   struct dt_mipmap_cache_t *mipmap_cache;
   struct dt_image_cache_t *image_cache;
+  struct dt_dev_pixelpipe_shared_cache_t *pixelpipe_cache;
+  struct dt_dev_pixelpipe_shared_cache_t *mask_cache; // rasterized drawn masks
+  FILE *pipe_profile; // --pipe-profile: profiling data of every pipe is appended here
   struct dt_bauhaus_t *bauhaus;
   const struct dt_database_t *db;
   const struct dt_fswatch_t *fswatch;
@@ -256,6 +260,16 @@ static inline void dt_get_times(dt_times_t *t)
 
 void dt_show_times(const dt_times_t *start, const char *prefix, const char *suffix, ...);
 
+/** cpu time in seconds used by the calling thread only, 0 where the platform can't tell. */
+static inline double dt_get_thread_cputime(void)
+{
+#ifdef CLOCK_THREAD_CPUTIME_ID
+  struct timespec ts;
+  if(!clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts)) return ts.tv_sec + ts.tv_nsec * (1.0 / 1000000000.0);
+#endif
+  return 0.0;
+}
+
 /** \brief check if file is a supported image */
 gboolean dt_supported_image(const gchar *filename);
 
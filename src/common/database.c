@@ -36,7 +36,9 @@
 
 // whenever _create_schema() gets changed you HAVE to bump this version and add an update path to
 // _upgrade_schema_step()!
-#define CURRENT_DATABASE_VERSION 10
+#define CURRENT_DATABASE_VERSION 11
+// how long a write waits for the lock another connection holds, in ms
+#define DT_DATABASE_BUSY_TIMEOUT 10000
 
 typedef struct dt_database_t
 {
@@ -48,8 +50,86 @@ typedef struct dt_database_t
 
   /* ondisk DB */
   sqlite3 *handle;
+
+  /* with write ahead logging every thread gets its own read only connection, see dt_database_get_reader() */
+  gboolean wal;
+
+  /* all dt_database_thread_t, so they can be closed together with the database */
+  GList *threads;
+
+  /* transactions on the main handle, see dt_database_start_transaction(). the mutex is recursive and held by
+   * the thread owning the transaction, the rest is only touched while holding it. the depth is also read
+   * atomically without it. */
+  dt_pthread_mutex_t transaction_mutex;
+  gint transaction_depth;
+  gboolean transaction_open, transaction_rollback;
 } dt_database_t;
 
+/* what a thread keeps around for the database: its read only connection, the connection of its own
+ * transactions (see dt_database_start_own_transaction()) and its prepared statements */
+typedef struct dt_database_thread_t
+{
+  const dt_database_t *db; // NULL once the database is gone
+  sqlite3 *reader;
+  sqlite3 *writer;
+  int writer_depth; // while > 0, dt_database_get() hands out the writer to this thread
+  gboolean writer_open, writer_rollback;
+  GHashTable *statements[3]; // sql -> sqlite3_stmt, for the main handle, the reader and the writer
+} dt_database_thread_t;
+
+static void _database_thread_close(dt_database_thread_t *thread)
+{
+  for(int k = 0; k < 3; k++)
+    if(thread->statements[k])
+    {
+      g_hash_table_destroy(thread->statements[k]);
+      thread->statements[k] = NULL;
+    }
+  if(thread->reader) sqlite3_close(thread->reader);
+  thread->reader = NULL;
+  if(thread->writer) sqlite3_close(thread->writer);
+  thread->writer = NULL;
+  thread->writer_depth = 0;
+}
+
+/* guards the threads lists and dt_database_thread_t.db. it is not part of the database, so a thread exiting
+ * while the database is destroyed doesn't lock a mutex that is going away. */
+static GMutex _database_threads_mutex;
+
+/* called when a thread exits */
+static void _database_thread_free(gpointer data)
+{
+  dt_database_thread_t *thread = (dt_database_thread_t *)data;
+  g_mutex_lock(&_database_threads_mutex);
+  dt_database_t *db = (dt_database_t *)thread->db;
+  // if the database is gone already, it closed our connection and statements, too
+  if(db)
+  {
+    db->threads = g_list_remove(db->threads, thread);
+    _database_thread_close(thread);
+  }
+  g_mutex_unlock(&_database_threads_mutex);
+  g_free(thread);
+}
+
+static GPrivate _database_thread = G_PRIVATE_INIT(_database_thread_free);
+
+static dt_database_thread_t *_database_thread_get(const dt_database_t *db)
+{
+  dt_database_thread_t *thread = (dt_database_thread_t *)g_private_get(&_database_thread);
+  if(thread && thread->db == db) return thread;
+  if(!thread)
+  {
+    thread = (dt_database_thread_t *)g_malloc0(sizeof(dt_database_thread_t));
+    g_private_set(&_database_thread, thread);
+  }
+  g_mutex_lock(&_database_threads_mutex);
+  thread->db = db;
+  ((dt_database_t *)db)->threads = g_list_prepend(db->threads, thread);
+  g_mutex_unlock(&_database_threads_mutex);
+  return thread;
+}
+
 
 /* migrates database from old place to new */
 static void _database_migrate_to_xdg_structure();
@@ -711,6 +791,23 @@ static int _upgrade_schema_step(dt_database_t *db, int version)
     }
     sqlite3_exec(db->handle, "COMMIT", NULL, NULL, NULL);
     new_version = 10;
+  }
+  else if(version == 10)
+  {
+    // 10 -> 11 remember the directory of film rolls as seen by the crawler
+    sqlite3_exec(db->handle, "BEGIN TRANSACTION", NULL, NULL, NULL);
+    if(sqlite3_exec(db->handle, "ALTER TABLE film_rolls ADD COLUMN crawler_mtime INTEGER", NULL, NULL, NULL)
+       != SQLITE_OK
+       || sqlite3_exec(db->handle, "ALTER TABLE film_rolls ADD COLUMN crawler_inode INTEGER", NULL, NULL, NULL)
+          != SQLITE_OK)
+    {
+      fprintf(stderr, "[init] can't add `crawler_mtime' and `crawler_inode' columns to database\n");
+      fprintf(stderr, "[init]   %s\n", sqlite3_errmsg(db->handle));
+      sqlite3_exec(db->handle, "ROLLBACK TRANSACTION", NULL, NULL, NULL);
+      return version;
+    }
+    sqlite3_exec(db->handle, "COMMIT", NULL, NULL, NULL);
+    new_version = 11;
   } // maybe in the future, see commented out code elsewhere
     //   else if(version == XXX)
     //   {
@@ -764,7 +861,7 @@ static void _create_schema(dt_database_t *db)
                         //                        "folder VARCHAR(1024), external_drive VARCHAR(1024))", //
                         //                        FIXME: make sure to bump CURRENT_DATABASE_VERSION and add a
                         //                        case to _upgrade_schema_step when adding this!
-                        "folder VARCHAR(1024) NOT NULL)",
+                        "folder VARCHAR(1024) NOT NULL, crawler_mtime INTEGER, crawler_inode INTEGER)",
                         NULL, NULL, NULL);
   DT_DEBUG_SQLITE3_EXEC(db->handle, "CREATE INDEX film_rolls_folder_index ON film_rolls (folder)", NULL, NULL,
                         NULL);
@@ -956,6 +1053,12 @@ dt_database_t *dt_database_init(const char *alternative)
   db->dbfilename = g_strdup(dbfilename);
   db->is_new_database = FALSE;
   db->lock_acquired = FALSE;
+  db->wal = FALSE;
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  dt_pthread_mutex_init(&db->transaction_mutex, &attr);
+  pthread_mutexattr_destroy(&attr);
 
 /* having more than one instance of darktable using the same database is a bad idea */
 /* try to get a lock for the database */
@@ -1051,6 +1154,7 @@ dt_database_t *dt_database_init(const char *alternative)
     g_free(dbname);
     g_free(db->lockfile);
     g_free(db->dbfilename);
+    dt_pthread_mutex_destroy(&db->transaction_mutex);
     g_free(db);
     return NULL;
   }
@@ -1060,10 +1164,34 @@ dt_database_t *dt_database_init(const char *alternative)
   */
   sqlite3_exec(db->handle, "attach database ':memory:' as memory", NULL, NULL, NULL);
 
-  sqlite3_exec(db->handle, "PRAGMA synchronous = OFF", NULL, NULL, NULL);
-  sqlite3_exec(db->handle, "PRAGMA journal_mode = MEMORY", NULL, NULL, NULL);
+  // the page size can't be changed anymore once the database is in wal mode
   sqlite3_exec(db->handle, "PRAGMA page_size = 32768", NULL, NULL, NULL);
 
+  // write ahead logging lets readers on other connections run alongside the writer. it is at least as crash
+  // safe as what we had before, a crash only loses the most recent transactions.
+  if(strcmp(dbfilename, ":memory:") && dt_conf_get_bool("database_wal"))
+  {
+    sqlite3_stmt *wal_stmt;
+    if(sqlite3_prepare_v2(db->handle, "PRAGMA journal_mode = WAL", -1, &wal_stmt, NULL) == SQLITE_OK)
+    {
+      if(sqlite3_step(wal_stmt) == SQLITE_ROW)
+        db->wal = !g_ascii_strcasecmp((const char *)sqlite3_column_text(wal_stmt, 0), "wal");
+      sqlite3_finalize(wal_stmt);
+    }
+    if(!db->wal) fprintf(stderr, "[init] can't switch database to write ahead logging, using memory journal\n");
+  }
+  if(db->wal)
+  {
+    sqlite3_exec(db->handle, "PRAGMA synchronous = NORMAL", NULL, NULL, NULL);
+    // writes wait for the transaction a thread might run on its own connection
+    sqlite3_busy_timeout(db->handle, DT_DATABASE_BUSY_TIMEOUT);
+  }
+  else
+  {
+    sqlite3_exec(db->handle, "PRAGMA synchronous = OFF", NULL, NULL, NULL);
+    sqlite3_exec(db->handle, "PRAGMA journal_mode = MEMORY", NULL, NULL, NULL);
+  }
+
   /* now that we got a functional database that is locked for us we can make sure that the schema is set up */
   // does the db contain the new 'db_info' table?
   sqlite3_stmt *stmt;
@@ -1180,6 +1308,21 @@ error:
 
 void dt_database_destroy(const dt_database_t *db)
 {
+  // the connections and statements of the other threads have to go before the main handle. we close them
+  // here, threads which are still exiting then only free their part.
+  dt_database_t *d = (dt_database_t *)db;
+  g_mutex_lock(&_database_threads_mutex);
+  for(GList *iter = d->threads; iter; iter = g_list_next(iter))
+  {
+    dt_database_thread_t *thread = (dt_database_thread_t *)iter->data;
+    _database_thread_close(thread);
+    thread->db = NULL;
+  }
+  g_list_free(d->threads);
+  d->threads = NULL;
+  g_mutex_unlock(&_database_threads_mutex);
+  dt_pthread_mutex_destroy(&d->transaction_mutex);
+
   sqlite3_close(db->handle);
   unlink(db->lockfile);
   g_free(db->lockfile);
@@ -1187,11 +1330,175 @@ void dt_database_destroy(const dt_database_t *db)
   g_free((dt_database_t *)db);
 }
 
+// the thread's own transaction, if it is in one
+static dt_database_thread_t *_database_thread_own_transaction(const dt_database_t *db)
+{
+  dt_database_thread_t *thread = (dt_database_thread_t *)g_private_get(&_database_thread);
+  return (thread && thread->writer_depth && thread->db == db) ? thread : NULL;
+}
+
 sqlite3 *dt_database_get(const dt_database_t *db)
 {
+  // a thread with a transaction of its own runs everything on its writer, to see its own changes
+  const dt_database_thread_t *thread = (const dt_database_thread_t *)g_private_get(&_database_thread);
+  if(thread && thread->writer_depth && thread->db == db) return thread->writer;
   return db->handle;
 }
 
+sqlite3 *dt_database_get_reader(const dt_database_t *db)
+{
+  // the reader must not miss what this thread wrote: in its own transaction that is only on its writer, and
+  // while there is a transaction on the main handle this thread's writes might be part of it
+  const dt_database_thread_t *own = _database_thread_own_transaction(db);
+  if(own) return own->writer;
+  if(!db->wal || g_atomic_int_get(&db->transaction_depth)) return db->handle;
+
+  dt_database_thread_t *thread = _database_thread_get(db);
+  if(!thread->reader)
+  {
+    if(sqlite3_open_v2(db->dbfilename, &thread->reader, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK)
+    {
+      fprintf(stderr, "[database] can't open read only connection: %s\n", sqlite3_errmsg(thread->reader));
+      sqlite3_close(thread->reader);
+      thread->reader = NULL;
+      return db->handle;
+    }
+    // a checkpoint may need the wal index for a moment
+    sqlite3_busy_timeout(thread->reader, 1000);
+  }
+  return thread->reader;
+}
+
+sqlite3_stmt *dt_database_prepare_cached(const dt_database_t *db, sqlite3 *handle, const char *sql)
+{
+  dt_database_thread_t *thread = _database_thread_get(db);
+  const int k = (handle == db->handle) ? 0 : (handle == thread->reader) ? 1 : 2;
+  if(k == 2 && handle != thread->writer) return NULL;
+
+  if(!thread->statements[k])
+    thread->statements[k]
+        = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)sqlite3_finalize);
+
+  sqlite3_stmt *stmt = (sqlite3_stmt *)g_hash_table_lookup(thread->statements[k], sql);
+  if(stmt)
+  {
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    return stmt;
+  }
+
+  DT_DEBUG_SQLITE3_PREPARE_V2(handle, sql, -1, &stmt, NULL);
+  if(stmt) g_hash_table_insert(thread->statements[k], g_strdup(sql), stmt);
+  return stmt;
+}
+
+// wal only lets one connection write at a time. taking the lock right away makes sqlite wait for it, a
+// deferred transaction which reads first can't wait for another writer once it wants to write.
+static const char *_database_begin(const dt_database_t *db)
+{
+  return db->wal ? "BEGIN IMMEDIATE TRANSACTION" : "BEGIN TRANSACTION";
+}
+
+gboolean dt_database_start_transaction(const dt_database_t *db)
+{
+  dt_database_thread_t *thread = _database_thread_own_transaction(db);
+  if(thread)
+  {
+    thread->writer_depth++;
+    return thread->writer_open;
+  }
+
+  dt_database_t *d = (dt_database_t *)db;
+  dt_pthread_mutex_lock(&d->transaction_mutex);
+  // nested ones just become part of the outermost transaction
+  if(g_atomic_int_add(&d->transaction_depth, 1) > 0) return d->transaction_open;
+
+  d->transaction_rollback = FALSE;
+  d->transaction_open = (sqlite3_exec(d->handle, _database_begin(db), NULL, NULL, NULL) == SQLITE_OK);
+  if(!d->transaction_open)
+    fprintf(stderr, "[database] can't begin transaction: %s\n", sqlite3_errmsg(d->handle));
+  return d->transaction_open;
+}
+
+gboolean dt_database_start_own_transaction(const dt_database_t *db)
+{
+  if(!db->wal) return dt_database_start_transaction(db);
+
+  dt_database_thread_t *thread = _database_thread_get(db);
+  if(thread->writer_depth++ > 0) return thread->writer_open;
+
+  if(!thread->writer)
+  {
+    if(sqlite3_open_v2(db->dbfilename, &thread->writer, SQLITE_OPEN_READWRITE, NULL) != SQLITE_OK)
+    {
+      fprintf(stderr, "[database] can't open connection: %s\n", sqlite3_errmsg(thread->writer));
+      sqlite3_close(thread->writer);
+      thread->writer = NULL;
+      thread->writer_depth = 0;
+      return dt_database_start_transaction(db);
+    }
+    sqlite3_exec(thread->writer, "PRAGMA synchronous = NORMAL", NULL, NULL, NULL);
+    sqlite3_busy_timeout(thread->writer, DT_DATABASE_BUSY_TIMEOUT);
+  }
+  thread->writer_rollback = FALSE;
+  thread->writer_open = (sqlite3_exec(thread->writer, _database_begin(db), NULL, NULL, NULL) == SQLITE_OK);
+  if(!thread->writer_open)
+    fprintf(stderr, "[database] can't begin transaction: %s\n", sqlite3_errmsg(thread->writer));
+  return thread->writer_open;
+}
+
+// commits, or rolls back if that is asked for or the commit fails. returns TRUE if committed.
+static gboolean _database_end(sqlite3 *handle, gboolean commit)
+{
+  if(commit)
+  {
+    // a statement of another thread might still be running on the connection, give it a moment
+    int rc, tries = 0;
+    while((rc = sqlite3_exec(handle, "COMMIT", NULL, NULL, NULL)) == SQLITE_BUSY && tries++ < 1000)
+      g_usleep(1000);
+    if(rc != SQLITE_OK)
+    {
+      fprintf(stderr, "[database] can't commit transaction: %s\n", sqlite3_errmsg(handle));
+      commit = FALSE;
+    }
+  }
+  // some errors make sqlite roll back by itself
+  if(!commit && !sqlite3_get_autocommit(handle)
+     && sqlite3_exec(handle, "ROLLBACK TRANSACTION", NULL, NULL, NULL) != SQLITE_OK)
+    fprintf(stderr, "[database] can't roll back transaction: %s\n", sqlite3_errmsg(handle));
+  return commit;
+}
+
+gboolean dt_database_release_transaction(const dt_database_t *db, const gboolean rollback)
+{
+  dt_database_thread_t *thread = _database_thread_own_transaction(db);
+  if(thread)
+  {
+    if(rollback) thread->writer_rollback = TRUE;
+    gboolean committed = thread->writer_open && !thread->writer_rollback;
+    if(--thread->writer_depth == 0 && thread->writer_open)
+    {
+      committed = _database_end(thread->writer, committed);
+      thread->writer_open = FALSE;
+    }
+    return committed;
+  }
+
+  dt_database_t *d = (dt_database_t *)db;
+  if(rollback) d->transaction_rollback = TRUE;
+  gboolean committed = d->transaction_open && !d->transaction_rollback;
+
+  // the depth only drops to 0 once the changes are committed, see dt_database_get_reader()
+  if(d->transaction_depth == 1 && d->transaction_open)
+  {
+    committed = _database_end(d->handle, committed);
+    d->transaction_open = FALSE;
+  }
+  g_atomic_int_add(&d->transaction_depth, -1);
+  dt_pthread_mutex_unlock(&d->transaction_mutex);
+  return committed;
+}
+
 const gchar *dt_database_get_path(const struct dt_database_t *db)
 {
   return db->dbfilename;
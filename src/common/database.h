@@ -29,6 +29,30 @@ struct dt_database_t *dt_database_init(const char *alternative);
 void dt_database_destroy(const struct dt_database_t *);
 /** get handle */
 struct sqlite3 *dt_database_get(const struct dt_database_t *);
+/** get a read only handle of the calling thread. it sees no memory.* tables and only committed changes, but
+ * all of this thread's, in exchange it doesn't wait for other threads. this is the main handle if the
+ * database isn't in wal mode or while a transaction is open on it, and the thread's own connection during its
+ * own transaction. */
+struct sqlite3 *dt_database_get_reader(const struct dt_database_t *db);
+/** prepared statement for sql on handle (the main handle or the reader of this thread) from a cache of the
+ * calling thread. it comes reset and with cleared bindings, reset it when done but never finalize it. */
+struct sqlite3_stmt *dt_database_prepare_cached(const struct dt_database_t *db, struct sqlite3 *handle,
+                                                const char *sql);
+/** starts a transaction on the main handle. transactions are serialized between threads, the calling thread
+ * holds a lock until it releases the transaction again, which it always has to, even if this returns FALSE
+ * because sqlite couldn't begin one. nested transactions of the same thread become part of the outermost one.
+ * statements of other threads which don't use a transaction still end up in it, as they run on the same
+ * connection. */
+gboolean dt_database_start_transaction(const struct dt_database_t *db);
+/** starts a transaction on a connection of the calling thread's own, for long running writers. until it is
+ * released, dt_database_get() returns that connection in this thread and transactions it starts become part
+ * of this one. other threads don't wait for a lock, they keep reading what was committed before and their
+ * writes wait for the end of the transaction, so keep it short. it has no memory.* tables. without write
+ * ahead logging this is dt_database_start_transaction(). dt_database_release_transaction() releases it. */
+gboolean dt_database_start_own_transaction(const struct dt_database_t *db);
+/** ends the transaction. it is committed unless this or a nested release asked for a rollback, or the commit
+ * fails, in which case it is rolled back. returns TRUE if the changes (so far, if nested) are committed. */
+gboolean dt_database_release_transaction(const struct dt_database_t *db, const gboolean rollback);
 /** test if database is new */
 gboolean dt_database_is_new(const struct dt_database_t *db);
 /** Returns database path */
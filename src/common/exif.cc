@@ -42,6 +42,9 @@ extern "C" {
 #include <string>
 #include <sstream>
 #include <cassert>
+#include <algorithm>
+#include <map>
+#include <vector>
 
 #include <exiv2/easyaccess.hpp>
 #include <exiv2/xmp.hpp>
@@ -78,6 +81,9 @@ const char *dt_xmp_keys[]
 
 static const guint dt_xmp_keys_n = G_N_ELEMENTS(dt_xmp_keys); // the number of XmpBag XmpSeq keys that dt uses
 
+// number of images whose sidecar files are written at once by dt_exif_xmp_write_batch()
+#define DT_EXIF_XMP_BATCH 256
+
 
 /* a few helper functions inspired by
    https://projects.kde.org/projects/kde/kdegraphics/libs/libkexiv2/repository/revisions/master/entry/libkexiv2/kexiv2gps.cpp
@@ -897,27 +903,118 @@ int dt_exif_get_thumbnail(const char *path, uint8_t **buffer, size_t *size, char
   }
 }
 
+struct dt_exif_prefetch_t
+{
+  // the file itself, NULL if it couldn't be read
+  Exiv2::Image::AutoPtr image;
+  std::string error;
+  int have_mtime;
+  time_t mtime;
+  // its xmp sidecar, NULL if there is none
+  Exiv2::Image::AutoPtr xmp;
+};
+
+// parses the file, either from disk or from the given copy of its contents
+static void _exif_prefetch_image(dt_exif_prefetch_t *prefetch, const char *path, const uint8_t *data,
+                                 const size_t size)
+{
+  struct stat statbuf;
+  prefetch->have_mtime = !stat(path, &statbuf);
+  prefetch->mtime = prefetch->have_mtime ? statbuf.st_mtime : 0;
+  try
+  {
+    // the memory variant doesn't copy the data, it's only ever read
+    if(data)
+      prefetch->image = Exiv2::ImageFactory::open((const Exiv2::byte *)data, size);
+    else
+      prefetch->image = Exiv2::ImageFactory::open(path);
+    assert(prefetch->image.get() != 0);
+    prefetch->image->readMetadata();
+  }
+  catch(Exiv2::AnyError &e)
+  {
+    prefetch->image.reset();
+    prefetch->error = e.what();
+  }
+}
+
+dt_exif_prefetch_t *dt_exif_prefetch(const char *path, const char *xmp_path)
+{
+  dt_exif_prefetch_t *prefetch = new dt_exif_prefetch_t;
+  _exif_prefetch_image(prefetch, path, NULL, 0);
+  if(xmp_path && g_file_test(xmp_path, G_FILE_TEST_IS_REGULAR))
+  {
+    try
+    {
+      prefetch->xmp = Exiv2::ImageFactory::open(xmp_path);
+      assert(prefetch->xmp.get() != 0);
+      prefetch->xmp->readMetadata();
+    }
+    catch(Exiv2::AnyError &)
+    {
+      prefetch->xmp.reset();
+    }
+  }
+  return prefetch;
+}
+
+void dt_exif_prefetch_free(dt_exif_prefetch_t *prefetch)
+{
+  delete prefetch;
+}
+
 /** read the metadata of an image.
  * XMP data trumps IPTC data trumps EXIF data
  */
 int dt_exif_read(dt_image_t *img, const char *path)
+{
+  return dt_exif_read_prefetched(img, path, NULL);
+}
+
+int dt_exif_read_from_memory(dt_image_t *img, const char *path, const uint8_t *data, const size_t size)
+{
+  dt_exif_prefetch_t prefetch;
+  _exif_prefetch_image(&prefetch, path, data, size);
+  return dt_exif_read_prefetched(img, path, &prefetch);
+}
+
+int dt_exif_read_prefetched(dt_image_t *img, const char *path, dt_exif_prefetch_t *prefetch)
 {
   // at least set datetime taken to something useful in case there is no exif data in this file (pfm, png,
   // ...)
   struct stat statbuf;
+  time_t mtime = 0;
+  int have_mtime;
+  if(prefetch)
+  {
+    have_mtime = prefetch->have_mtime;
+    mtime = prefetch->mtime;
+  }
+  else if((have_mtime = !stat(path, &statbuf)))
+    mtime = statbuf.st_mtime;
 
-  if(!stat(path, &statbuf))
+  if(have_mtime)
   {
     struct tm result;
-    strftime(img->exif_datetime_taken, 20, "%Y:%m:%d %H:%M:%S", localtime_r(&statbuf.st_mtime, &result));
+    strftime(img->exif_datetime_taken, 20, "%Y:%m:%d %H:%M:%S", localtime_r(&mtime, &result));
+  }
+
+  if(prefetch && !prefetch->image.get())
+  {
+    std::cerr << "[exiv2] " << path << ": " << prefetch->error << std::endl;
+    return 1;
   }
 
   try
   {
-    Exiv2::Image::AutoPtr image;
-    image = Exiv2::ImageFactory::open(path);
-    assert(image.get() != 0);
-    image->readMetadata();
+    Exiv2::Image::AutoPtr opened;
+    if(!prefetch)
+    {
+      opened = Exiv2::ImageFactory::open(path);
+      assert(opened.get() != 0);
+      opened->readMetadata();
+    }
+    Exiv2::Image *image = prefetch ? prefetch->image.get() : opened.get();
     bool res = true;
 
     // EXIF metadata
@@ -1479,17 +1576,29 @@ static void _exif_import_tags(dt_image_t *img, Exiv2::XmpData::iterator &pos)
 
 // need a write lock on *img (non-const) to write stars (and soon color labels).
 int dt_exif_xmp_read(dt_image_t *img, const char *filename, const int history_only)
+{
+  return dt_exif_xmp_read_prefetched(img, filename, NULL, history_only);
+}
+
+int dt_exif_xmp_read_prefetched(dt_image_t *img, const char *filename, dt_exif_prefetch_t *prefetch,
+                                const int history_only)
 {
   // exclude pfm to avoid stupid errors on the console
   const char *c = filename + strlen(filename) - 4;
   if(c >= filename && !strcmp(c, ".pfm")) return 1;
+  // the sidecar didn't exist or couldn't be parsed when it was prefetched
+  if(prefetch && !prefetch->xmp.get()) return 1;
   try
   {
     // read xmp sidecar
-    Exiv2::Image::AutoPtr image;
-    image = Exiv2::ImageFactory::open(filename);
-    assert(image.get() != 0);
-    image->readMetadata();
+    Exiv2::Image::AutoPtr opened;
+    if(!prefetch)
+    {
+      opened = Exiv2::ImageFactory::open(filename);
+      assert(opened.get() != 0);
+      opened->readMetadata();
+    }
+    Exiv2::Image *image = prefetch ? prefetch->xmp.get() : opened.get();
     Exiv2::XmpData &xmpData = image->xmpData();
 
     sqlite3_stmt *stmt;
@@ -1786,33 +1895,211 @@ int dt_exif_xmp_read(dt_image_t *img, const char *filename, const int history_on
   return 0;
 }
 
-// helper to create an xmp data thing. throws exiv2 exceptions if stuff goes wrong.
-static void dt_exif_xmp_read_data(Exiv2::XmpData &xmpData, const int imgid)
+// a history item of an image, as stored in the database
+typedef struct dt_exif_xmp_history_t
 {
-  const int xmp_version = 1;
-  int stars = 1, raw_params = 0, history_end = -1;
-  double longitude = NAN, latitude = NAN;
-  gchar *filename = NULL;
-  // get stars and raw params from db
+  int32_t modversion, enabled, blendop_version, multi_priority;
+  bool has_operation, has_blendop_params;
+  std::string operation, multi_name;
+  std::string params, blendop_params; // the raw blobs, they get encoded when the xmp is put together
+} dt_exif_xmp_history_t;
+
+// a mask of an image, as stored in the database
+typedef struct dt_exif_xmp_mask_t
+{
+  int32_t id, type, version, nb;
+  std::string name, points, source;
+} dt_exif_xmp_mask_t;
+
+// everything from the database that goes into the xmp data of an image, so it can be put together
+// without touching the database. the defaults are used if the image doesn't exist anymore.
+typedef struct dt_exif_xmp_image_t
+{
+  int32_t imgid;
+  bool has_filename;
+  std::string filename;
+  int stars, raw_params, history_end;
+  double longitude, latitude;
+  std::vector<std::pair<int, std::string> > metadata;
+  std::vector<std::string> tags;         // all the levels of the attached tags, sorted and unique
+  std::vector<std::string> hierarchical; // the attached tags themselves
+  std::vector<int32_t> color_labels;
+  std::vector<dt_exif_xmp_mask_t> masks;
+  std::vector<dt_exif_xmp_history_t> history;
+} dt_exif_xmp_image_t;
+
+static void _exif_xmp_image_init(dt_exif_xmp_image_t &image, const int imgid)
+{
+  image.imgid = imgid;
+  image.has_filename = false;
+  image.stars = 1;
+  image.raw_params = 0;
+  image.history_end = -1;
+  image.longitude = image.latitude = NAN;
+}
+
+static inline std::string _exif_xmp_blob(sqlite3_stmt *stmt, const int col)
+{
+  const void *blob = sqlite3_column_blob(stmt, col);
+  if(!blob) return std::string();
+  return std::string((const char *)blob, sqlite3_column_bytes(stmt, col));
+}
+
+static inline std::string _exif_xmp_text(sqlite3_stmt *stmt, const int col)
+{
+  const char *text = (const char *)sqlite3_column_text(stmt, col);
+  return text ? std::string(text) : std::string();
+}
+
+// reads the database rows of all images in images[], with a handful of queries. ids is the comma separated
+// list of their ids, for the sql statements.
+static void _exif_xmp_gather(std::vector<dt_exif_xmp_image_t> &images, const char *ids)
+{
+  std::map<int32_t, size_t> index;
+  for(size_t k = 0; k < images.size(); k++) index[images[k].imgid] = k;
+
+  // sidecar writing and exports of many images read all of this, don't make them wait for the main handle
+  sqlite3 *db = dt_database_get_reader(darktable.db);
   sqlite3_stmt *stmt;
-  DT_DEBUG_SQLITE3_PREPARE_V2(
-      dt_database_get(darktable.db),
-      "select filename, flags, raw_parameters, longitude, latitude, history_end from images where id = ?1", -1, &stmt,
-      NULL);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
-  if(sqlite3_step(stmt) == SQLITE_ROW)
+  gchar *query = g_strdup_printf(
+      "select id, filename, flags, raw_parameters, longitude, latitude, history_end from images where id in (%s)",
+      ids);
+  DT_DEBUG_SQLITE3_PREPARE_V2(db, query, -1, &stmt, NULL);
+  g_free(query);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    std::map<int32_t, size_t>::iterator it = index.find(sqlite3_column_int(stmt, 0));
+    if(it == index.end()) continue;
+    dt_exif_xmp_image_t &image = images[it->second];
+    image.has_filename = sqlite3_column_text(stmt, 1) != NULL;
+    image.filename = _exif_xmp_text(stmt, 1);
+    image.stars = sqlite3_column_int(stmt, 2);
+    image.raw_params = sqlite3_column_int(stmt, 3);
+    if(sqlite3_column_type(stmt, 4) == SQLITE_FLOAT) image.longitude = sqlite3_column_double(stmt, 4);
+    if(sqlite3_column_type(stmt, 5) == SQLITE_FLOAT) image.latitude = sqlite3_column_double(stmt, 5);
+    image.history_end = sqlite3_column_int(stmt, 6);
+  }
+  sqlite3_finalize(stmt);
+
+  // the meta data
+  query = g_strdup_printf("select id, key, value from meta_data where id in (%s)", ids);
+  DT_DEBUG_SQLITE3_PREPARE_V2(db, query, -1, &stmt, NULL);
+  g_free(query);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    std::map<int32_t, size_t>::iterator it = index.find(sqlite3_column_int(stmt, 0));
+    if(it == index.end()) continue;
+    images[it->second].metadata.push_back(
+        std::make_pair(sqlite3_column_int(stmt, 1), _exif_xmp_text(stmt, 2)));
+  }
+  sqlite3_finalize(stmt);
+
+  // tags, the same as dt_tag_get_list() and dt_tag_get_hierarchical() would return
+  query = g_strdup_printf("SELECT DISTINCT tagged_images.imgid, T.id, T.name FROM tagged_images "
+                          "JOIN tags T on T.id = tagged_images.tagid "
+                          "WHERE tagged_images.imgid in (%s) AND NOT T.name LIKE \"darktable|%%\" "
+                          "ORDER BY tagged_images.imgid, T.name",
+                          ids);
+  DT_DEBUG_SQLITE3_PREPARE_V2(db, query, -1, &stmt, NULL);
+  g_free(query);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    std::map<int32_t, size_t>::iterator it = index.find(sqlite3_column_int(stmt, 0));
+    const char *name = (const char *)sqlite3_column_text(stmt, 2);
+    if(it == index.end() || !name) continue;
+    dt_exif_xmp_image_t &image = images[it->second];
+    image.hierarchical.push_back(name);
+    gchar **pch = g_strsplit(name, "|", -1);
+    for(size_t j = 0; pch && pch[j]; j++) image.tags.push_back(pch[j]);
+    g_strfreev(pch);
+  }
+  sqlite3_finalize(stmt);
+  for(size_t k = 0; k < images.size(); k++)
+  {
+    std::vector<std::string> &tags = images[k].tags;
+    std::sort(tags.begin(), tags.end());
+    tags.erase(std::unique(tags.begin(), tags.end()), tags.end());
+  }
+
+  // color labels
+  query = g_strdup_printf("select imgid, color from color_labels where imgid in (%s)", ids);
+  DT_DEBUG_SQLITE3_PREPARE_V2(db, query, -1, &stmt, NULL);
+  g_free(query);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
   {
-    filename = (gchar *)sqlite3_column_text(stmt, 0);
-    stars = sqlite3_column_int(stmt, 1);
-    raw_params = sqlite3_column_int(stmt, 2);
-    if(sqlite3_column_type(stmt, 3) == SQLITE_FLOAT) longitude = sqlite3_column_double(stmt, 3);
-    if(sqlite3_column_type(stmt, 4) == SQLITE_FLOAT) latitude = sqlite3_column_double(stmt, 4);
-    history_end = sqlite3_column_int(stmt, 5);
+    std::map<int32_t, size_t>::iterator it = index.find(sqlite3_column_int(stmt, 0));
+    if(it == index.end()) continue;
+    images[it->second].color_labels.push_back(sqlite3_column_int(stmt, 1));
   }
+  sqlite3_finalize(stmt);
+
+  // masks
+  query = g_strdup_printf(
+      "select imgid, formid, form, name, version, points, points_count, source from mask where imgid in (%s)",
+      ids);
+  DT_DEBUG_SQLITE3_PREPARE_V2(db, query, -1, &stmt, NULL);
+  g_free(query);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    std::map<int32_t, size_t>::iterator it = index.find(sqlite3_column_int(stmt, 0));
+    if(it == index.end()) continue;
+    dt_exif_xmp_mask_t mask;
+    mask.id = sqlite3_column_int(stmt, 1);
+    mask.type = sqlite3_column_int(stmt, 2);
+    mask.name = _exif_xmp_text(stmt, 3);
+    mask.version = sqlite3_column_int(stmt, 4);
+    mask.points = _exif_xmp_blob(stmt, 5);
+    mask.nb = sqlite3_column_int(stmt, 6);
+    mask.source = _exif_xmp_blob(stmt, 7);
+    images[it->second].masks.push_back(mask);
+  }
+  sqlite3_finalize(stmt);
+
+  // history stacks
+  query = g_strdup_printf("select imgid, num, module, operation, op_params, enabled, blendop_params, "
+                          "blendop_version, multi_priority, multi_name from history where imgid in (%s) "
+                          "order by imgid, num",
+                          ids);
+  DT_DEBUG_SQLITE3_PREPARE_V2(db, query, -1, &stmt, NULL);
+  g_free(query);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    std::map<int32_t, size_t>::iterator it = index.find(sqlite3_column_int(stmt, 0));
+    if(it == index.end()) continue;
+    dt_exif_xmp_history_t item;
+    item.modversion = sqlite3_column_int(stmt, 2);
+    item.has_operation = sqlite3_column_text(stmt, 3) != NULL;
+    item.operation = _exif_xmp_text(stmt, 3);
+    item.params = _exif_xmp_blob(stmt, 4);
+    item.enabled = sqlite3_column_int(stmt, 5);
+    item.has_blendop_params = sqlite3_column_blob(stmt, 6) != NULL;
+    item.blendop_params = _exif_xmp_blob(stmt, 6);
+    item.blendop_version = sqlite3_column_int(stmt, 7);
+    item.multi_priority = sqlite3_column_int(stmt, 8);
+    item.multi_name = _exif_xmp_text(stmt, 9);
+    images[it->second].history.push_back(item);
+  }
+  sqlite3_finalize(stmt);
+}
+
+static inline char *_exif_xmp_encode_string(const std::string &blob)
+{
+  return dt_exif_xmp_encode(blob.empty() ? NULL : (const unsigned char *)blob.data(), blob.size(), NULL);
+}
+
+// helper to create an xmp data thing from what has been read from the database. doesn't access the database
+// itself, so this can run on any thread. throws exiv2 exceptions if stuff goes wrong.
+static void _exif_xmp_fill_data(Exiv2::XmpData &xmpData, const dt_exif_xmp_image_t &image)
+{
+  const int xmp_version = 1;
+  const int stars = image.stars, raw_params = image.raw_params;
+  int history_end = image.history_end;
+  double longitude = image.longitude, latitude = image.latitude;
+
   xmpData["Xmp.xmp.Rating"] = ((stars & 0x7) == 6) ? -1 : (stars & 0x7); // rejected image = -1, others = 0..5
 
   // The original file name
-  if(filename) xmpData["Xmp.xmpMM.DerivedFrom"] = filename;
+  if(image.has_filename) xmpData["Xmp.xmpMM.DerivedFrom"] = image.filename;
 
   // GPS data
   if(!std::isnan(longitude) && !std::isnan(latitude))
@@ -1842,35 +2129,30 @@ static void dt_exif_xmp_read_data(Exiv2::XmpData &xmpData, const int imgid)
     g_free(lat_str);
     g_free(str);
   }
-  sqlite3_finalize(stmt);
 
   // the meta data
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "select key, value from meta_data where id = ?1",
-                              -1, &stmt, NULL);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
-  while(sqlite3_step(stmt) == SQLITE_ROW)
+  for(size_t k = 0; k < image.metadata.size(); k++)
   {
-    int key = sqlite3_column_int(stmt, 0);
-    switch(key)
+    const std::string &value = image.metadata[k].second;
+    switch(image.metadata[k].first)
     {
       case DT_METADATA_XMP_DC_CREATOR:
-        xmpData["Xmp.dc.creator"] = sqlite3_column_text(stmt, 1);
+        xmpData["Xmp.dc.creator"] = value;
         break;
       case DT_METADATA_XMP_DC_PUBLISHER:
-        xmpData["Xmp.dc.publisher"] = sqlite3_column_text(stmt, 1);
+        xmpData["Xmp.dc.publisher"] = value;
         break;
       case DT_METADATA_XMP_DC_TITLE:
-        xmpData["Xmp.dc.title"] = sqlite3_column_text(stmt, 1);
+        xmpData["Xmp.dc.title"] = value;
         break;
       case DT_METADATA_XMP_DC_DESCRIPTION:
-        xmpData["Xmp.dc.description"] = sqlite3_column_text(stmt, 1);
+        xmpData["Xmp.dc.description"] = value;
         break;
       case DT_METADATA_XMP_DC_RIGHTS:
-        xmpData["Xmp.dc.rights"] = sqlite3_column_text(stmt, 1);
+        xmpData["Xmp.dc.rights"] = value;
         break;
     }
   }
-  sqlite3_finalize(stmt);
 
   xmpData["Xmp.darktable.xmp_version"] = xmp_version;
   xmpData["Xmp.darktable.raw_params"] = raw_params;
@@ -1880,23 +2162,12 @@ static void dt_exif_xmp_read_data(Exiv2::XmpData &xmpData, const int imgid)
   else
     xmpData["Xmp.darktable.auto_presets_applied"] = 0;
 
-  // get tags from db, store in dublin core
+  // tags, stored in dublin core
   Exiv2::Value::AutoPtr v1 = Exiv2::Value::create(Exiv2::xmpSeq); // or xmpBag or xmpAlt.
   Exiv2::Value::AutoPtr v2 = Exiv2::Value::create(Exiv2::xmpSeq); // or xmpBag or xmpAlt.
 
-  GList *tags = dt_tag_get_list(imgid);
-  while(tags)
-  {
-    v1->read((char *)tags->data);
-    tags = g_list_next(tags);
-  }
-
-  GList *hierarchical = dt_tag_get_hierarchical(imgid);
-  while(hierarchical)
-  {
-    v2->read((char *)hierarchical->data);
-    hierarchical = g_list_next(hierarchical);
-  }
+  for(size_t k = 0; k < image.tags.size(); k++) v1->read(image.tags[k]);
+  for(size_t k = 0; k < image.hierarchical.size(); k++) v2->read(image.hierarchical[k]);
 
   if(v1->count() > 0) xmpData.add(Exiv2::XmpKey("Xmp.dc.subject"), v1.get());
   if(v2->count() > 0) xmpData.add(Exiv2::XmpKey("Xmp.lr.hierarchicalSubject"), v2.get());
@@ -1905,16 +2176,11 @@ static void dt_exif_xmp_read_data(Exiv2::XmpData &xmpData, const int imgid)
   // color labels
   char val[2048];
   Exiv2::Value::AutoPtr v = Exiv2::Value::create(Exiv2::xmpSeq); // or xmpBag or xmpAlt.
-  /* Already initialized v = Exiv2::Value::create(Exiv2::xmpSeq); // or xmpBag or xmpAlt.*/
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "select color from color_labels where imgid=?1",
-                              -1, &stmt, NULL);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
-  while(sqlite3_step(stmt) == SQLITE_ROW)
+  for(size_t k = 0; k < image.color_labels.size(); k++)
   {
-    snprintf(val, sizeof(val), "%d", sqlite3_column_int(stmt, 0));
+    snprintf(val, sizeof(val), "%d", image.color_labels[k]);
     v->read(val);
   }
-  sqlite3_finalize(stmt);
   if(v->count() > 0) xmpData.add(Exiv2::XmpKey("Xmp.darktable.colorlabels"), v.get());
 
   // masks:
@@ -1935,51 +2201,41 @@ static void dt_exif_xmp_read_data(Exiv2::XmpData &xmpData, const int imgid)
   // reset tv
   tvm.setXmpArrayType(Exiv2::XmpValue::xaNone);
 
-  DT_DEBUG_SQLITE3_PREPARE_V2(
-      dt_database_get(darktable.db),
-      "select imgid, formid, form, name, version, points, points_count, source from mask where imgid = ?1",
-      -1, &stmt, NULL);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
-  while(sqlite3_step(stmt) == SQLITE_ROW)
+  for(size_t k = 0; k < image.masks.size(); k++)
   {
-    int32_t mask_id = sqlite3_column_int(stmt, 1);
-    snprintf(val, sizeof(val), "%d", mask_id);
+    const dt_exif_xmp_mask_t &mask = image.masks[k];
+
+    snprintf(val, sizeof(val), "%d", mask.id);
     tvm.read(val);
     snprintf(key, sizeof(key), "Xmp.darktable.mask_id[%d]", num);
     xmpData.add(Exiv2::XmpKey(key), &tvm);
 
-    int32_t mask_type = sqlite3_column_int(stmt, 2);
-    snprintf(val, sizeof(val), "%d", mask_type);
+    snprintf(val, sizeof(val), "%d", mask.type);
     tvm.read(val);
     snprintf(key, sizeof(key), "Xmp.darktable.mask_type[%d]", num);
     xmpData.add(Exiv2::XmpKey(key), &tvm);
 
-    const char *mask_name = (const char *)sqlite3_column_text(stmt, 3);
-    tvm.read(mask_name);
+    tvm.read(mask.name);
     snprintf(key, sizeof(key), "Xmp.darktable.mask_name[%d]", num);
     xmpData.add(Exiv2::XmpKey(key), &tvm);
 
-    int32_t mask_version = sqlite3_column_int(stmt, 4);
-    snprintf(val, sizeof(val), "%d", mask_version);
+    snprintf(val, sizeof(val), "%d", mask.version);
     tvm.read(val);
     snprintf(key, sizeof(key), "Xmp.darktable.mask_version[%d]", num);
     xmpData.add(Exiv2::XmpKey(key), &tvm);
 
-    int32_t len = sqlite3_column_bytes(stmt, 5);
-    char *mask_d = dt_exif_xmp_encode((const unsigned char *)sqlite3_column_blob(stmt, 5), len, NULL);
+    char *mask_d = _exif_xmp_encode_string(mask.points);
     tvm.read(mask_d);
     snprintf(key, sizeof(key), "Xmp.darktable.mask[%d]", num);
     xmpData.add(Exiv2::XmpKey(key), &tvm);
     free(mask_d);
 
-    int32_t mask_nb = sqlite3_column_int(stmt, 6);
-    snprintf(val, sizeof(val), "%d", mask_nb);
+    snprintf(val, sizeof(val), "%d", mask.nb);
     tvm.read(val);
     snprintf(key, sizeof(key), "Xmp.darktable.mask_nb[%d]", num);
     xmpData.add(Exiv2::XmpKey(key), &tvm);
 
-    len = sqlite3_column_bytes(stmt, 7);
-    char *mask_src = dt_exif_xmp_encode((const unsigned char *)sqlite3_column_blob(stmt, 7), len, NULL);
+    char *mask_src = _exif_xmp_encode_string(mask.source);
     tvm.read(mask_src);
     snprintf(key, sizeof(key), "Xmp.darktable.mask_src[%d]", num);
     xmpData.add(Exiv2::XmpKey(key), &tvm);
@@ -1987,7 +2243,6 @@ static void dt_exif_xmp_read_data(Exiv2::XmpData &xmpData, const int imgid)
 
     num++;
   }
-  sqlite3_finalize(stmt);
 
 
   // history stack:
@@ -2008,68 +2263,52 @@ static void dt_exif_xmp_read_data(Exiv2::XmpData &xmpData, const int imgid)
   // reset tv
   tv.setXmpArrayType(Exiv2::XmpValue::xaNone);
 
-  DT_DEBUG_SQLITE3_PREPARE_V2(
-      dt_database_get(darktable.db),
-      "select imgid, num, module, operation, op_params, enabled, blendop_params, "
-      "blendop_version, multi_priority, multi_name from history where imgid = ?1 order by num",
-      -1, &stmt, NULL);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
-  while(sqlite3_step(stmt) == SQLITE_ROW)
+  for(size_t k = 0; k < image.history.size(); k++)
   {
-    int32_t modversion = sqlite3_column_int(stmt, 2);
-    snprintf(val, sizeof(val), "%d", modversion);
+    const dt_exif_xmp_history_t &item = image.history[k];
+
+    snprintf(val, sizeof(val), "%d", item.modversion);
     tv.read(val);
     snprintf(key, sizeof(key), "Xmp.darktable.history_modversion[%d]", num);
     xmpData.add(Exiv2::XmpKey(key), &tv);
 
-    int32_t enabled = sqlite3_column_int(stmt, 5);
-    snprintf(val, sizeof(val), "%d", enabled);
+    snprintf(val, sizeof(val), "%d", item.enabled);
     tv.read(val);
     snprintf(key, sizeof(key), "Xmp.darktable.history_enabled[%d]", num);
     xmpData.add(Exiv2::XmpKey(key), &tv);
 
-    const char *op = (const char *)sqlite3_column_text(stmt, 3);
-    if(!op) continue; // no op is fatal.
-    tv.read(op);
+    if(!item.has_operation) continue; // no op is fatal.
+    tv.read(item.operation);
     snprintf(key, sizeof(key), "Xmp.darktable.history_operation[%d]", num);
     xmpData.add(Exiv2::XmpKey(key), &tv);
 
     /* read and add history params */
-    int32_t len = sqlite3_column_bytes(stmt, 4);
-    char *vparams = dt_exif_xmp_encode((const unsigned char *)sqlite3_column_blob(stmt, 4), len, NULL);
+    char *vparams = _exif_xmp_encode_string(item.params);
     tv.read(vparams);
     snprintf(key, sizeof(key), "Xmp.darktable.history_params[%d]", num);
     xmpData.add(Exiv2::XmpKey(key), &tv);
     free(vparams);
 
     /* read and add blendop params */
-    const void *blob = sqlite3_column_blob(stmt, 6);
-    if(!blob) continue; // no params, no history item.
-    len = sqlite3_column_bytes(stmt, 6);
-    vparams = dt_exif_xmp_encode((const unsigned char *)blob, len, NULL);
+    if(!item.has_blendop_params) continue; // no params, no history item.
+    vparams = _exif_xmp_encode_string(item.blendop_params);
     tv.read(vparams);
     snprintf(key, sizeof(key), "Xmp.darktable.blendop_params[%d]", num);
     xmpData.add(Exiv2::XmpKey(key), &tv);
     free(vparams);
 
     /* read and add blendop version */
-    int32_t blversion = sqlite3_column_int(stmt, 7);
-    snprintf(val, sizeof(val), "%d", blversion);
+    snprintf(val, sizeof(val), "%d", item.blendop_version);
     tv.read(val);
     snprintf(key, sizeof(key), "Xmp.darktable.blendop_version[%d]", num);
     xmpData.add(Exiv2::XmpKey(key), &tv);
 
     /* read and add multi instances */
-    int32_t mprio = sqlite3_column_int(stmt, 8);
-    snprintf(val, sizeof(val), "%d", mprio);
+    snprintf(val, sizeof(val), "%d", item.multi_priority);
     tv.read(val);
     snprintf(key, sizeof(key), "Xmp.darktable.multi_priority[%d]", num);
     xmpData.add(Exiv2::XmpKey(key), &tv);
-    const char *mname = (const char *)sqlite3_column_text(stmt, 9);
-    if(mname)
-      tv.read(mname);
-    else
-      tv.read("");
+    tv.read(item.multi_name);
     snprintf(key, sizeof(key), "Xmp.darktable.multi_name[%d]", num);
     xmpData.add(Exiv2::XmpKey(key), &tv);
 
@@ -2078,10 +2317,17 @@ static void dt_exif_xmp_read_data(Exiv2::XmpData &xmpData, const int imgid)
 
   if(history_end == -1) history_end = num - 1;
   xmpData["Xmp.darktable.history_end"] = history_end;
+}
 
-  sqlite3_finalize(stmt);
-  g_list_free_full(tags, g_free);
-  g_list_free_full(hierarchical, g_free);
+// helper to create an xmp data thing. throws exiv2 exceptions if stuff goes wrong.
+static void dt_exif_xmp_read_data(Exiv2::XmpData &xmpData, const int imgid)
+{
+  std::vector<dt_exif_xmp_image_t> images(1);
+  _exif_xmp_image_init(images[0], imgid);
+  char ids[16];
+  snprintf(ids, sizeof(ids), "%d", imgid);
+  _exif_xmp_gather(images, ids);
+  _exif_xmp_fill_data(xmpData, images[0]);
 }
 
 int dt_exif_xmp_attach(const int imgid, const char *filename)
@@ -2141,16 +2387,9 @@ int dt_exif_xmp_attach(const int imgid, const char *filename)
   }
 }
 
-// write xmp sidecar file:
-int dt_exif_xmp_write(const int imgid, const char *filename)
+// merges the database contents of the image into the xmp sidecar file, creating it if needed
+static int _exif_xmp_write_file(const dt_exif_xmp_image_t &image, const char *filename)
 {
-  // refuse to write sidecar for non-existent image:
-  char imgfname[PATH_MAX] = { 0 };
-  gboolean from_cache = TRUE;
-
-  dt_image_full_path(imgid, imgfname, sizeof(imgfname), &from_cache);
-  if(!g_file_test(imgfname, G_FILE_TEST_IS_REGULAR)) return 1;
-
   try
   {
     Exiv2::XmpData xmpData;
@@ -2166,7 +2405,7 @@ int dt_exif_xmp_write(const int imgid, const char *filename)
     }
 
     // initialize xmp data:
-    dt_exif_xmp_read_data(xmpData, imgid);
+    _exif_xmp_fill_data(xmpData, image);
 
     // serialize the xmp data and output the xmp packet
     if(Exiv2::XmpParser::encode(xmpPacket, xmpData,
@@ -2190,11 +2429,77 @@ int dt_exif_xmp_write(const int imgid, const char *filename)
   }
 }
 
+// write xmp sidecar file:
+int dt_exif_xmp_write(const int imgid, const char *filename)
+{
+  // refuse to write sidecar for non-existent image:
+  char imgfname[PATH_MAX] = { 0 };
+  gboolean from_cache = TRUE;
+
+  dt_image_full_path(imgid, imgfname, sizeof(imgfname), &from_cache);
+  if(!g_file_test(imgfname, G_FILE_TEST_IS_REGULAR)) return 1;
+
+  std::vector<dt_exif_xmp_image_t> images(1);
+  _exif_xmp_image_init(images[0], imgid);
+  char ids[16];
+  snprintf(ids, sizeof(ids), "%d", imgid);
+  _exif_xmp_gather(images, ids);
+  return _exif_xmp_write_file(images[0], filename);
+}
+
+void dt_exif_xmp_write_batch(const int *imgids, const char *const *filenames, int *res, const int count)
+{
+  for(int begin = 0; begin < count; begin += DT_EXIF_XMP_BATCH)
+  {
+    const int end = MIN(count, begin + DT_EXIF_XMP_BATCH);
+    std::vector<dt_exif_xmp_image_t> images(end - begin);
+    std::vector<std::string> imgfnames(end - begin);
+    GString *ids = g_string_new(NULL);
+    for(int k = begin; k < end; k++)
+    {
+      _exif_xmp_image_init(images[k - begin], imgids[k]);
+      g_string_append_printf(ids, k > begin ? ",%d" : "%d", imgids[k]);
+
+      char imgfname[PATH_MAX] = { 0 };
+      gboolean from_cache = TRUE;
+      dt_image_full_path(imgids[k], imgfname, sizeof(imgfname), &from_cache);
+      imgfnames[k - begin] = imgfname;
+    }
+
+    // one set of queries for the whole batch, ..
+    _exif_xmp_gather(images, ids->str);
+    g_string_free(ids, TRUE);
+
+    // .. and the sidecars are put together and written in parallel
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) shared(images, imgfnames)
+#endif
+    for(int k = begin; k < end; k++)
+    {
+      // refuse to write sidecar for non-existent image:
+      if(!g_file_test(imgfnames[k - begin].c_str(), G_FILE_TEST_IS_REGULAR))
+        res[k] = 1;
+      else
+        res[k] = _exif_xmp_write_file(images[k - begin], filenames[k]);
+    }
+  }
+}
+
 static void dt_exif_log_handler(int log_level, const char *message)
 {
   if(log_level >= Exiv2::LogMsg::level()) fprintf(stderr, "[exiv2] %s\n", message);
 }
 
+// the xmp toolkit isn't thread safe by itself, exiv2 calls this around all accesses to it
+static GRecMutex _exif_xmp_mutex;
+static void _exif_xmp_lock(void *data, bool lock)
+{
+  if(lock)
+    g_rec_mutex_lock((GRecMutex *)data);
+  else
+    g_rec_mutex_unlock((GRecMutex *)data);
+}
+
 void dt_exif_init()
 {
   // mute exiv2:
@@ -2202,7 +2507,8 @@ void dt_exif_init()
   // preface the exiv2 messages with "[exiv2] "
   Exiv2::LogMsg::setHandler(&dt_exif_log_handler);
 
-  Exiv2::XmpParser::initialize();
+  // files may be read from several threads at once during import
+  Exiv2::XmpParser::initialize(&_exif_xmp_lock, &_exif_xmp_mutex);
   // this has te stay with the old url (namespace already propagated outside dt)
   Exiv2::XmpProperties::registerNs("http://darktable.sf.net/", "darktable");
   Exiv2::XmpProperties::registerNs("http://ns.adobe.com/lightroom/1.0/", "lr");
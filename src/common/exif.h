@@ -30,6 +30,19 @@ extern "C" {
  * struct. returns 0 on success. */
 int dt_exif_read(dt_image_t *img, const char *path);
 
+/** metadata of an image and its xmp sidecar, read from disk without touching the database or the image
+ * struct. this can be done in parallel, the _prefetched() functions below then interpret it. */
+typedef struct dt_exif_prefetch_t dt_exif_prefetch_t;
+dt_exif_prefetch_t *dt_exif_prefetch(const char *path, const char *xmp_path);
+void dt_exif_prefetch_free(dt_exif_prefetch_t *prefetch);
+
+/** same as dt_exif_read(), from prefetched data if that isn't NULL. */
+int dt_exif_read_prefetched(dt_image_t *img, const char *path, dt_exif_prefetch_t *prefetch);
+
+/** same as dt_exif_read(), parsing a copy of the whole file which has been read already. path is only used
+ * for the file modification time and messages. */
+int dt_exif_read_from_memory(dt_image_t *img, const char *path, const uint8_t *data, const size_t size);
+
 /** read exif data to image struct from given data blob, wherever you got it from. */
 int dt_exif_read_from_blob(dt_image_t *img, uint8_t *blob, const int size);
 
@@ -44,12 +57,21 @@ int dt_exif_write_blob(uint8_t *blob, uint32_t size, const char *path);
 /** write xmp sidecar file. */
 int dt_exif_xmp_write(const int imgid, const char *filename);
 
+/** write the xmp sidecar files filenames[i] of the images imgids[i]. the database is read with a few queries
+ * per batch of images and the files are put together and written in parallel. res[i] is set to what
+ * dt_exif_xmp_write() would have returned. */
+void dt_exif_xmp_write_batch(const int *imgids, const char *const *filenames, int *res, const int count);
+
 /** write xmp packet inside an image. */
 int dt_exif_xmp_attach(const int imgid, const char *filename);
 
 /** read xmp sidecar file. */
 int dt_exif_xmp_read(dt_image_t *img, const char *filename, const int history_only);
 
+/** same as dt_exif_xmp_read(), from prefetched data if that isn't NULL. */
+int dt_exif_xmp_read_prefetched(dt_image_t *img, const char *filename, dt_exif_prefetch_t *prefetch,
+                                const int history_only);
+
 /** fetch largest exif thumbnail jpg bytestream into buffer*/
 int dt_exif_get_thumbnail(const char *path, uint8_t **buffer, size_t *size, char **mime_type);
 
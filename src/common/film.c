@@ -25,7 +25,9 @@
 #include "common/dtpthread.h"
 #include "common/collection.h"
 #include "common/image_cache.h"
+#include "common/exif.h"
 #include "common/debug.h"
+#include "develop/pixelpipe_cache.h"
 #include "views/view.h"
 
 #include <stdio.h>
@@ -341,6 +343,70 @@ int _film_filename_cmp(gchar *a, gchar *b)
   return ret;
 }
 
+/* at most this many images, or images for this many seconds, are imported into the database within one
+   transaction. writes of other threads wait for its end. */
+#define DT_FILM_IMPORT_BATCH 64
+#define DT_FILM_IMPORT_BATCH_TIME 0.2
+
+/* the metadata of the files to import is read from disk by a number of threads, while the
+   import job itself is the only one to write them to the database. */
+typedef struct dt_film_import_prefetch_t
+{
+  gchar **files;
+  dt_exif_prefetch_t **prefetch;
+  gboolean *ready;
+  guint total;
+  guint next;    // next file to be read
+  guint written; // files already taken over by the writer
+  guint window;  // how far the readers may get ahead of the writer
+  int workers;   // number of readers running, the writer reads by itself if there are none
+  dt_pthread_mutex_t mutex;
+  pthread_cond_t cond;
+} dt_film_import_prefetch_t;
+
+static void *_film_import_prefetch_worker(void *data)
+{
+  dt_film_import_prefetch_t *p = (dt_film_import_prefetch_t *)data;
+  dt_pthread_mutex_lock(&p->mutex);
+  while(TRUE)
+  {
+    while(p->next < p->total && p->next >= p->written + p->window) dt_pthread_cond_wait(&p->cond, &p->mutex);
+    if(p->next >= p->total) break;
+    const guint i = p->next++;
+    dt_pthread_mutex_unlock(&p->mutex);
+
+    dt_exif_prefetch_t *prefetch = dt_image_import_prefetch(p->files[i], FALSE);
+
+    dt_pthread_mutex_lock(&p->mutex);
+    p->prefetch[i] = prefetch;
+    p->ready[i] = TRUE;
+    pthread_cond_broadcast(&p->cond);
+  }
+  dt_pthread_mutex_unlock(&p->mutex);
+  return NULL;
+}
+
+/* waits for the metadata of file i, and lets the readers continue. */
+static dt_exif_prefetch_t *_film_import_prefetch_take(dt_film_import_prefetch_t *p, const guint i)
+{
+  if(!p->workers) return dt_image_import_prefetch(p->files[i], FALSE);
+  dt_pthread_mutex_lock(&p->mutex);
+  while(!p->ready[i]) dt_pthread_cond_wait(&p->cond, &p->mutex);
+  dt_exif_prefetch_t *prefetch = p->prefetch[i];
+  p->prefetch[i] = NULL;
+  p->written = i + 1;
+  pthread_cond_broadcast(&p->cond);
+  dt_pthread_mutex_unlock(&p->mutex);
+  return prefetch;
+}
+
+/* ends the transaction of the current batch, and starts the next one if there is one. */
+static void _film_import_commit(const gboolean begin)
+{
+  if(!dt_database_release_transaction(darktable.db, FALSE)) dt_control_log(_("some images could not be imported"));
+  if(begin) dt_database_start_own_transaction(darktable.db);
+}
+
 void dt_film_import1(dt_film_t *film)
 {
   gboolean recursive = dt_conf_get_bool("ui_last/import_recursive");
@@ -405,10 +471,40 @@ void dt_film_import1(dt_film_t *film)
              total);
   dt_progress_t *progress = dt_control_progress_create(darktable.control, TRUE, message);
 
+  /* start reading the metadata in the background */
+  dt_film_import_prefetch_t prefetch;
+  const int nthreads = CLAMP(dt_conf_get_int("parallel_import_threads"), 1, 32);
+  prefetch.total = total;
+  prefetch.files = g_malloc_n(total, sizeof(gchar *));
+  prefetch.prefetch = g_malloc0_n(total, sizeof(dt_exif_prefetch_t *));
+  prefetch.ready = g_malloc0_n(total, sizeof(gboolean));
+  prefetch.next = prefetch.written = 0;
+  prefetch.window = 8 * nthreads;
+  dt_pthread_mutex_init(&prefetch.mutex, NULL);
+  pthread_cond_init(&prefetch.cond, NULL);
+  {
+    guint i = 0;
+    for(GList *image = images; image; image = g_list_next(image)) prefetch.files[i++] = image->data;
+  }
+  pthread_t *workers = g_malloc_n(nthreads, sizeof(pthread_t));
+  prefetch.workers = 0;
+  for(int k = 0; k < nthreads; k++)
+  {
+    if(pthread_create(&workers[prefetch.workers], NULL, _film_import_prefetch_worker, &prefetch))
+      fprintf(stderr, "[film_import] couldn't start a thread reading metadata\n");
+    else
+      prefetch.workers++;
+  }
+
+  /* write in batches, one transaction per insert is what makes large imports slow. the batches run on a
+     connection of their own, so other threads neither end up in them nor wait for more than one. */
+  dt_database_start_own_transaction(darktable.db);
+  double batch_start = dt_get_wtime();
 
   /* loop thru the images and import to current film roll */
   dt_film_t *cfr = film;
   GList *image = g_list_first(images);
+  guint current = 0;
   do
   {
     gchar *cdn = g_path_get_dirname((const gchar *)image->data);
@@ -421,6 +517,9 @@ void dt_film_import1(dt_film_t *film)
       {
         /* check if we can find a gpx data file to be auto applied
            to images in the jsut imported filmroll */
+        /* the job applying it has to see them */
+        _film_import_commit(TRUE);
+        batch_start = dt_get_wtime();
         g_dir_rewind(cfr->dir);
         const gchar *dfn = NULL;
         while((dfn = g_dir_read_name(cfr->dir)) != NULL)
@@ -459,7 +558,14 @@ void dt_film_import1(dt_film_t *film)
     g_free(cdn);
 
     /* import image */
-    dt_image_import(cfr->id, (const gchar *)image->data, FALSE);
+    dt_exif_prefetch_t *metadata = _film_import_prefetch_take(&prefetch, current);
+    dt_image_import_prefetched(cfr->id, (const gchar *)image->data, FALSE, metadata);
+    if(metadata) dt_exif_prefetch_free(metadata);
+    if(++current % DT_FILM_IMPORT_BATCH == 0 || dt_get_wtime() - batch_start > DT_FILM_IMPORT_BATCH_TIME)
+    {
+      _film_import_commit(TRUE);
+      batch_start = dt_get_wtime();
+    }
 
     fraction += 1.0 / total;
     dt_control_progress_set_progress(darktable.control, progress, fraction);
@@ -467,6 +573,15 @@ void dt_film_import1(dt_film_t *film)
 
   } while((image = g_list_next(image)) != NULL);
 
+  _film_import_commit(FALSE);
+  for(int k = 0; k < prefetch.workers; k++) pthread_join(workers[k], NULL);
+  g_free(workers);
+  pthread_cond_destroy(&prefetch.cond);
+  dt_pthread_mutex_destroy(&prefetch.mutex);
+  g_free(prefetch.files);
+  g_free(prefetch.prefetch);
+  g_free(prefetch.ready);
+
   // only redraw at the end, to not spam the cpu with exposure events
   dt_control_queue_redraw_center();
   dt_control_signal_raise(darktable.signals, DT_SIGNAL_TAG_CHANGED);
@@ -607,6 +722,8 @@ void dt_film_remove(const int id)
     const uint32_t imgid = sqlite3_column_int(stmt, 0);
     dt_image_local_copy_reset(imgid);
     dt_mipmap_cache_remove(darktable.mipmap_cache, imgid);
+    if(darktable.pixelpipe_cache)
+      dt_dev_pixelpipe_shared_cache_remove_image(darktable.pixelpipe_cache, imgid);
     dt_image_cache_remove(darktable.image_cache, imgid);
   }
   sqlite3_finalize(stmt);
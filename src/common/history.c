@@ -220,11 +220,11 @@ int dt_history_load_and_apply_on_selection(gchar *filename)
   return res;
 }
 
-int dt_history_copy_and_paste_on_image(int32_t imgid, int32_t dest_imgid, gboolean merge, GList *ops)
+// pastes the history of imgid onto all images in dest_imgs. the source items are read once and the database
+// work for all destinations happens in one transaction with statements prepared only once.
+static int _history_copy_and_paste_on_images(int32_t imgid, GList *dest_imgs, gboolean merge, GList *ops)
 {
   sqlite3_stmt *stmt;
-  if(imgid == dest_imgid) return 1;
-
   if(imgid == -1)
   {
     dt_control_log(_("you need to copy history from an image before you paste it onto another"));
@@ -235,32 +235,8 @@ int dt_history_copy_and_paste_on_image(int32_t imgid, int32_t dest_imgid, gboole
   const dt_view_t *cv = dt_view_manager_get_current_view(darktable.view_manager);
   if(cv->view((dt_view_t *)cv) == DT_VIEW_DARKROOM) dt_dev_write_history(darktable.develop);
 
-  /* if merge onto history stack, lets find history offest in destination image */
-  int32_t offs = 0;
-  if(merge)
-  {
-    /* apply on top of history stack */
-    // first trim the stack to get rid of whatever is above the selected entry
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                                "DELETE FROM history WHERE imgid = ?1 AND num >= (SELECT history_end FROM images WHERE id = imgid)", -1, &stmt, NULL);
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, dest_imgid);
-    sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
-
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                                "SELECT IFNULL(MAX(num), -1) FROM history WHERE imgid = ?1", -1, &stmt, NULL);
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, dest_imgid);
-    if(sqlite3_step(stmt) == SQLITE_ROW) offs = sqlite3_column_int(stmt, 0);
-  }
-  else
-  {
-    /* replace history stack */
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "delete from history where imgid = ?1", -1,
-                                &stmt, NULL);
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, dest_imgid);
-    sqlite3_step(stmt);
-  }
-  sqlite3_finalize(stmt);
+  // the temp table is shared with the other writers, so it is filled inside the transaction, too
+  gboolean ok = dt_database_start_transaction(darktable.db);
 
   /* delete all items from the temp styles_items, this table is used only to get a ROWNUM of the results */
   DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "DELETE FROM MEMORY.style_items", NULL, NULL, NULL);
@@ -298,9 +274,19 @@ int dt_history_copy_and_paste_on_image(int32_t imgid, int32_t dest_imgid, gboole
 
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), req, -1, &stmt, NULL);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
-  sqlite3_step(stmt);
+  ok &= (sqlite3_step(stmt) == SQLITE_DONE);
   sqlite3_finalize(stmt);
 
+  sqlite3_stmt *trim_stmt, *offs_stmt, *clear_stmt, *insert_stmt, *clear_mask_stmt, *copy_mask_stmt, *end_stmt;
+  // first trim the stack to get rid of whatever is above the selected entry
+  DT_DEBUG_SQLITE3_PREPARE_V2(
+      dt_database_get(darktable.db),
+      "DELETE FROM history WHERE imgid = ?1 AND num >= (SELECT history_end FROM images WHERE id = imgid)", -1,
+      &trim_stmt, NULL);
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT IFNULL(MAX(num), -1) FROM history WHERE imgid = ?1", -1, &offs_stmt, NULL);
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "delete from history where imgid = ?1", -1,
+                              &clear_stmt, NULL);
   /* copy the history items into the history of the dest image */
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
                               "INSERT INTO history "
@@ -308,75 +294,135 @@ int dt_history_copy_and_paste_on_image(int32_t imgid, int32_t dest_imgid, gboole
                               "version,multi_priority,multi_name) SELECT "
                               "?1,?2+rowid,module,operation,op_params,enabled,blendop_params,blendop_"
                               "version,multi_priority,multi_name FROM MEMORY.style_items",
-                              -1, &stmt, NULL);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, dest_imgid);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, offs);
-  sqlite3_step(stmt);
-  sqlite3_finalize(stmt);
-
-  if(merge && ops) _dt_history_cleanup_multi_instance(dest_imgid, offs);
+                              -1, &insert_stmt, NULL);
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "delete from mask where imgid = ?1", -1,
+                              &clear_mask_stmt, NULL);
+  DT_DEBUG_SQLITE3_PREPARE_V2(
+      dt_database_get(darktable.db),
+      "insert into mask (imgid, formid, form, name, version, points, points_count, source) select "
+      "?1, formid, form, name, version, points, points_count, source from mask where imgid = ?2",
+      -1, &copy_mask_stmt, NULL);
+  // always make the whole stack active
+  DT_DEBUG_SQLITE3_PREPARE_V2(
+      dt_database_get(darktable.db),
+      "UPDATE images SET history_end = (SELECT MAX(num) + 1 FROM history WHERE imgid = ?1) WHERE id = ?1", -1,
+      &end_stmt, NULL);
 
-  // we have to copy masks too
-  // what to do with existing masks ?
-  if(merge)
+  for(GList *iter = dest_imgs; iter && ok; iter = g_list_next(iter))
   {
-    // there's very little chance that we will have same shapes id.
-    // but we may want to handle this case anyway
-    // and it's not trivial at all !
+    const int32_t dest_imgid = GPOINTER_TO_INT(iter->data);
+    if(dest_imgid == imgid) continue;
+
+    /* if merge onto history stack, lets find history offest in destination image */
+    int32_t offs = 0;
+    if(merge)
+    {
+      /* apply on top of history stack */
+      DT_DEBUG_SQLITE3_BIND_INT(trim_stmt, 1, dest_imgid);
+      ok &= (sqlite3_step(trim_stmt) == SQLITE_DONE);
+      sqlite3_reset(trim_stmt);
+
+      DT_DEBUG_SQLITE3_BIND_INT(offs_stmt, 1, dest_imgid);
+      if(sqlite3_step(offs_stmt) == SQLITE_ROW) offs = sqlite3_column_int(offs_stmt, 0);
+      sqlite3_reset(offs_stmt);
+    }
+    else
+    {
+      /* replace history stack */
+      DT_DEBUG_SQLITE3_BIND_INT(clear_stmt, 1, dest_imgid);
+      ok &= (sqlite3_step(clear_stmt) == SQLITE_DONE);
+      sqlite3_reset(clear_stmt);
+    }
+
+    DT_DEBUG_SQLITE3_BIND_INT(insert_stmt, 1, dest_imgid);
+    DT_DEBUG_SQLITE3_BIND_INT(insert_stmt, 2, offs);
+    ok &= (sqlite3_step(insert_stmt) == SQLITE_DONE);
+    sqlite3_reset(insert_stmt);
+
+    if(merge && ops) _dt_history_cleanup_multi_instance(dest_imgid, offs);
+
+    // we have to copy masks too
+    // what to do with existing masks ?
+    if(merge)
+    {
+      // there's very little chance that we will have same shapes id.
+      // but we may want to handle this case anyway
+      // and it's not trivial at all !
+    }
+    else
+    {
+      // let's remove all existing shapes
+      DT_DEBUG_SQLITE3_BIND_INT(clear_mask_stmt, 1, dest_imgid);
+      ok &= (sqlite3_step(clear_mask_stmt) == SQLITE_DONE);
+      sqlite3_reset(clear_mask_stmt);
+    }
+
+    // let's copy now
+    DT_DEBUG_SQLITE3_BIND_INT(copy_mask_stmt, 1, dest_imgid);
+    DT_DEBUG_SQLITE3_BIND_INT(copy_mask_stmt, 2, imgid);
+    ok &= (sqlite3_step(copy_mask_stmt) == SQLITE_DONE);
+    sqlite3_reset(copy_mask_stmt);
+
+    DT_DEBUG_SQLITE3_BIND_INT(end_stmt, 1, dest_imgid);
+    ok &= (sqlite3_step(end_stmt) == SQLITE_DONE);
+    sqlite3_reset(end_stmt);
   }
-  else
+
+  sqlite3_finalize(trim_stmt);
+  sqlite3_finalize(offs_stmt);
+  sqlite3_finalize(clear_stmt);
+  sqlite3_finalize(insert_stmt);
+  sqlite3_finalize(clear_mask_stmt);
+  sqlite3_finalize(copy_mask_stmt);
+  sqlite3_finalize(end_stmt);
+
+  // all or nothing, the history of none of the images changes if one of them fails
+  if(!dt_database_release_transaction(darktable.db, !ok))
   {
-    // let's remove all existing shapes
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "delete from mask where imgid = ?1", -1, &stmt,
-                                NULL);
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, dest_imgid);
-    sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    dt_control_log(_("couldn't paste the history"));
+    return 1;
   }
 
-  // let's copy now
-  g_strlcpy(req, "insert into mask (imgid, formid, form, name, version, points, points_count, source) select "
-                 "?1, formid, form, name, version, points, points_count, source from mask where imgid = ?2",
-            sizeof(req));
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), req, -1, &stmt, NULL);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, dest_imgid);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, imgid);
-  sqlite3_step(stmt);
-  sqlite3_finalize(stmt);
+  for(GList *iter = dest_imgs; iter; iter = g_list_next(iter))
+  {
+    const int32_t dest_imgid = GPOINTER_TO_INT(iter->data);
+    if(dest_imgid == imgid) continue;
 
-  // always make the whole stack active
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "UPDATE images SET history_end = (SELECT MAX(num) + 1 FROM history WHERE imgid = ?1) WHERE id = ?1",
-                              -1, &stmt, NULL);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, dest_imgid);
-  sqlite3_step(stmt);
-  sqlite3_finalize(stmt);
+    /* if current image in develop reload history */
+    if(dt_dev_is_current_image(darktable.develop, dest_imgid))
+    {
+      dt_dev_reload_history_items(darktable.develop);
+      dt_dev_modulegroups_set(darktable.develop, dt_dev_modulegroups_get(darktable.develop));
+    }
 
-  /* if current image in develop reload history */
-  if(dt_dev_is_current_image(darktable.develop, dest_imgid))
-  {
-    dt_dev_reload_history_items(darktable.develop);
-    dt_dev_modulegroups_set(darktable.develop, dt_dev_modulegroups_get(darktable.develop));
+    /* update xmp file, this is queued and written in one go for all images */
+    dt_image_synch_xmp(dest_imgid);
+
+    dt_mipmap_cache_remove(darktable.mipmap_cache, dest_imgid);
   }
 
-  /* update xmp file */
-  dt_image_synch_xmp(dest_imgid);
+  return 0;
+}
 
-  dt_mipmap_cache_remove(darktable.mipmap_cache, dest_imgid);
+int dt_history_copy_and_paste_on_image(int32_t imgid, int32_t dest_imgid, gboolean merge, GList *ops)
+{
+  if(imgid == dest_imgid) return 1;
 
-  return 0;
+  GList *dest_imgs = g_list_append(NULL, GINT_TO_POINTER(dest_imgid));
+  const int res = _history_copy_and_paste_on_images(imgid, dest_imgs, merge, ops);
+  g_list_free(dest_imgs);
+  return res;
 }
 
 GList *dt_history_get_items(int32_t imgid, gboolean enabled)
 {
   GList *result = NULL;
-  sqlite3_stmt *stmt;
-
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "select num, operation, enabled, multi_name from history where imgid=?1 and "
-                              "num in (select MAX(num) from history hst2 where hst2.imgid=?1 and "
-                              "hst2.operation=history.operation group by multi_priority) order by num desc",
-                              -1, &stmt, NULL);
+  // only used for display, so it doesn't need to wait for writes in flight on the main handle
+  sqlite3_stmt *stmt = dt_database_prepare_cached(
+      darktable.db, dt_database_get_reader(darktable.db),
+      "select num, operation, enabled, multi_name from history where imgid=?1 and "
+      "num in (select MAX(num) from history hst2 where hst2.imgid=?1 and "
+      "hst2.operation=history.operation group by multi_priority) order by num desc");
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
   while(sqlite3_step(stmt) == SQLITE_ROW)
   {
@@ -416,6 +462,7 @@ GList *dt_history_get_items(int32_t imgid, gboolean enabled)
       g_free(mname);
     }
   }
+  sqlite3_reset(stmt);
   return result;
 }
 
@@ -423,10 +470,10 @@ char *dt_history_get_items_as_string(int32_t imgid)
 {
   GList *items = NULL;
   const char *onoff[2] = { _("off"), _("on") };
-  sqlite3_stmt *stmt;
-  DT_DEBUG_SQLITE3_PREPARE_V2(
-      dt_database_get(darktable.db),
-      "select operation, enabled, multi_name from history where imgid=?1 order by num desc", -1, &stmt, NULL);
+  // the tooltip of the lighttable, read without waiting for writes in flight on the main handle
+  sqlite3_stmt *stmt = dt_database_prepare_cached(
+      darktable.db, dt_database_get_reader(darktable.db),
+      "select operation, enabled, multi_name from history where imgid=?1 order by num desc");
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
 
   // collect all the entries in the history from the db
@@ -442,6 +489,7 @@ char *dt_history_get_items_as_string(int32_t imgid)
     items = g_list_append(items, name);
     g_free(multi_name);
   }
+  sqlite3_reset(stmt);
   char *result = dt_util_glist_to_str("\n", items);
   g_list_free_full(items, g_free);
   return result;
@@ -451,28 +499,22 @@ int dt_history_copy_and_paste_on_selection(int32_t imgid, gboolean merge, GList
 {
   if(imgid < 0) return 1;
 
-  int res = 0;
   sqlite3_stmt *stmt;
+  GList *dest_imgs = NULL;
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
                               "select * from selected_images where imgid != ?1", -1, &stmt, NULL);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
-  if(sqlite3_step(stmt) == SQLITE_ROW)
-  {
-    do
-    {
-      /* get imgid of selected image */
-      int32_t dest_imgid = sqlite3_column_int(stmt, 0);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+    dest_imgs = g_list_prepend(dest_imgs, GINT_TO_POINTER(sqlite3_column_int(stmt, 0)));
+  sqlite3_finalize(stmt);
 
-      /* paste history stack onto image id */
-      dt_history_copy_and_paste_on_image(imgid, dest_imgid, merge, ops);
+  if(!dest_imgs) return 1;
 
-    } while(sqlite3_step(stmt) == SQLITE_ROW);
-  }
-  else
-    res = 1;
-
-  sqlite3_finalize(stmt);
-  return res;
+  /* paste history stack onto all selected images at once */
+  dest_imgs = g_list_reverse(dest_imgs);
+  _history_copy_and_paste_on_images(imgid, dest_imgs, merge, ops);
+  g_list_free(dest_imgs);
+  return 0;
 }
 
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
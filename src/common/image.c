@@ -32,6 +32,7 @@
 #include "control/conf.h"
 #include "control/jobs.h"
 #include "develop/lightroom.h"
+#include "develop/pixelpipe_cache.h"
 #include <math.h>
 #include <sqlite3.h>
 #include <string.h>
@@ -174,17 +175,15 @@ gboolean dt_image_safe_remove(const int32_t imgid)
 
 void dt_image_full_path(const int imgid, char *pathname, size_t pathname_len, gboolean *from_cache)
 {
-  sqlite3_stmt *stmt;
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "select folder || '/' || filename from images, film_rolls where "
-                              "images.film_id = film_rolls.id and images.id = ?1",
-                              -1, &stmt, NULL);
+  sqlite3_stmt *stmt = dt_database_prepare_cached(darktable.db, dt_database_get(darktable.db),
+                                                  "select folder || '/' || filename from images, film_rolls "
+                                                  "where images.film_id = film_rolls.id and images.id = ?1");
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
   if(sqlite3_step(stmt) == SQLITE_ROW)
   {
     g_strlcpy(pathname, (char *)sqlite3_column_text(stmt, 0), pathname_len);
   }
-  sqlite3_finalize(stmt);
+  sqlite3_reset(stmt);
 
   if(*from_cache && !g_file_test(pathname, G_FILE_TEST_EXISTS))
   {
@@ -577,8 +576,9 @@ void dt_image_remove(const int32_t imgid)
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
   sqlite3_step(stmt);
   sqlite3_finalize(stmt);
-  // also clear all thumbnails in mipmap_cache.
+  // also clear all thumbnails in mipmap_cache, and the buffers other pipes left behind.
   dt_mipmap_cache_remove(darktable.mipmap_cache, imgid);
+  if(darktable.pixelpipe_cache) dt_dev_pixelpipe_shared_cache_remove_image(darktable.pixelpipe_cache, imgid);
 }
 
 int dt_image_altered(const uint32_t imgid)
@@ -703,21 +703,22 @@ void dt_image_read_duplicates(const uint32_t id, const char *filename)
 }
 
 
-uint32_t dt_image_import(const int32_t film_id, const char *filename, gboolean override_ignore_jpegs)
+// returns the lower case extension of filename if it is to be imported, NULL otherwise
+static char *_image_import_ext(const char *filename, gboolean override_ignore_jpegs)
 {
-  if(!g_file_test(filename, G_FILE_TEST_IS_REGULAR) || dt_util_get_file_size(filename) == 0) return 0;
+  if(!g_file_test(filename, G_FILE_TEST_IS_REGULAR) || dt_util_get_file_size(filename) == 0) return NULL;
   const char *cc = filename + strlen(filename);
   for(; *cc != '.' && cc > filename; cc--)
     ;
-  if(!strcmp(cc, ".dt")) return 0;
-  if(!strcmp(cc, ".dttags")) return 0;
-  if(!strcmp(cc, ".xmp")) return 0;
+  if(!strcmp(cc, ".dt")) return NULL;
+  if(!strcmp(cc, ".dttags")) return NULL;
+  if(!strcmp(cc, ".xmp")) return NULL;
   char *ext = g_ascii_strdown(cc + 1, -1);
   if(override_ignore_jpegs == FALSE && (!strcmp(ext, "jpg") || !strcmp(ext, "jpeg"))
      && dt_conf_get_bool("ui_last/import_ignore_jpegs"))
   {
     g_free(ext);
-    return 0;
+    return NULL;
   }
   int supported = 0;
   char **extensions = g_strsplit(dt_supported_extensions, ",", 100);
@@ -731,8 +732,32 @@ uint32_t dt_image_import(const int32_t film_id, const char *filename, gboolean o
   if(!supported)
   {
     g_free(ext);
-    return 0;
+    return NULL;
   }
+  return ext;
+}
+
+dt_exif_prefetch_t *dt_image_import_prefetch(const char *filename, gboolean override_ignore_jpegs)
+{
+  char *ext = _image_import_ext(filename, override_ignore_jpegs);
+  if(!ext) return NULL;
+  g_free(ext);
+  char dtfilename[PATH_MAX] = { 0 };
+  g_strlcpy(dtfilename, filename, sizeof(dtfilename));
+  g_strlcat(dtfilename, ".xmp", sizeof(dtfilename));
+  return dt_exif_prefetch(filename, dtfilename);
+}
+
+uint32_t dt_image_import(const int32_t film_id, const char *filename, gboolean override_ignore_jpegs)
+{
+  return dt_image_import_prefetched(film_id, filename, override_ignore_jpegs, NULL);
+}
+
+uint32_t dt_image_import_prefetched(const int32_t film_id, const char *filename, gboolean override_ignore_jpegs,
+                                    dt_exif_prefetch_t *prefetch)
+{
+  char *ext = _image_import_ext(filename, override_ignore_jpegs);
+  if(!ext) return 0;
   int rc;
   uint32_t id = 0;
   // select from images; if found => return
@@ -891,13 +916,13 @@ uint32_t dt_image_import(const int32_t film_id, const char *filename, gboolean o
   img->group_id = group_id;
 
   // read dttags and exif for database queries!
-  (void)dt_exif_read(img, filename);
+  (void)dt_exif_read_prefetched(img, filename, prefetch);
   char dtfilename[PATH_MAX] = { 0 };
   g_strlcpy(dtfilename, filename, sizeof(dtfilename));
   // dt_image_path_append_version(id, dtfilename, sizeof(dtfilename));
   g_strlcat(dtfilename, ".xmp", sizeof(dtfilename));
 
-  int res = dt_exif_xmp_read(img, dtfilename, 0);
+  int res = dt_exif_xmp_read_prefetched(img, dtfilename, prefetch, 0);
 
   // write through to db, but not to xmp.
   dt_image_cache_write_release(darktable.image_cache, img, DT_IMAGE_CACHE_RELAXED);
@@ -1456,12 +1481,58 @@ void dt_image_write_sidecar_file(int imgid)
   }
 }
 
+void dt_image_write_sidecar_files(GList *imgs)
+{
+  const int count = g_list_length(imgs);
+  if(count == 0) return;
+
+  int *imgids = (int *)malloc(sizeof(int) * count);
+  int *res = (int *)malloc(sizeof(int) * count);
+  char **filenames = (char **)malloc(sizeof(char *) * count);
+  int n = 0;
+  for(GList *iter = imgs; iter; iter = g_list_next(iter))
+  {
+    const int imgid = GPOINTER_TO_INT(iter->data);
+    if(imgid <= 0) continue;
+    gboolean from_cache = TRUE;
+    char filename[PATH_MAX] = { 0 };
+    dt_image_full_path(imgid, filename, sizeof(filename), &from_cache);
+    dt_image_path_append_version(imgid, filename, sizeof(filename));
+    g_strlcat(filename, ".xmp", sizeof(filename));
+    imgids[n] = imgid;
+    filenames[n] = g_strdup(filename);
+    n++;
+  }
+
+  dt_exif_xmp_write_batch(imgids, (const char *const *)filenames, res, n);
+
+  // put the timestamps of all written files into db at once
+  GString *ids = g_string_new(NULL);
+  for(int k = 0; k < n; k++)
+  {
+    if(!res[k]) g_string_append_printf(ids, ids->len ? ",%d" : "%d", imgids[k]);
+    g_free(filenames[k]);
+  }
+  if(ids->len)
+  {
+    gchar *query = g_strdup_printf("UPDATE images SET write_timestamp = STRFTIME('%%s', 'now') WHERE id IN (%s)",
+                                   ids->str);
+    DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), query, NULL, NULL, NULL);
+    g_free(query);
+  }
+  g_string_free(ids, TRUE);
+
+  free(filenames);
+  free(res);
+  free(imgids);
+}
 
 void dt_image_synch_xmp(const int selected)
 {
   if(selected > 0)
   {
-    dt_image_write_sidecar_file(selected);
+    if(dt_conf_get_bool("write_sidecar_files"))
+      dt_image_cache_write_sidecar_deferred(darktable.image_cache, selected);
   }
   else if(dt_conf_get_bool("write_sidecar_files"))
   {
@@ -1471,7 +1542,7 @@ void dt_image_synch_xmp(const int selected)
     while(sqlite3_step(stmt) == SQLITE_ROW)
     {
       const int imgid = sqlite3_column_int(stmt, 0);
-      dt_image_write_sidecar_file(imgid);
+      dt_image_cache_write_sidecar_deferred(darktable.image_cache, imgid);
     }
     sqlite3_finalize(stmt);
   }
@@ -1490,12 +1561,12 @@ void dt_image_synch_all_xmp(const gchar *pathname)
                                 -1, &stmt, NULL);
     DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, imgpath, -1, SQLITE_TRANSIENT);
     DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 2, imgfname, -1, SQLITE_TRANSIENT);
+    GList *imgs = NULL;
     while(sqlite3_step(stmt) == SQLITE_ROW)
-    {
-      const int imgid = sqlite3_column_int(stmt, 0);
-      dt_image_write_sidecar_file(imgid);
-    }
+      imgs = g_list_prepend(imgs, GINT_TO_POINTER(sqlite3_column_int(stmt, 0)));
     sqlite3_finalize(stmt);
+    dt_image_write_sidecar_files(imgs);
+    g_list_free(imgs);
     g_free(imgfname);
     g_free(imgpath);
   }
@@ -1513,6 +1584,7 @@ void dt_image_local_copy_synch(void)
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, DT_IMAGE_LOCAL_COPY);
 
   int count = 0;
+  GList *imgs = NULL;
 
   while(sqlite3_step(stmt) == SQLITE_ROW)
   {
@@ -1523,12 +1595,15 @@ void dt_image_local_copy_synch(void)
 
     if(!from_cache)
     {
-      dt_image_write_sidecar_file(imgid);
+      imgs = g_list_prepend(imgs, GINT_TO_POINTER(imgid));
       count++;
     }
   }
   sqlite3_finalize(stmt);
 
+  dt_image_write_sidecar_files(imgs);
+  g_list_free(imgs);
+
   if(count > 0)
   {
     char message[128];
@@ -198,6 +198,12 @@ void dt_image_print_exif(const dt_image_t *img, char *line, size_t line_len);
 void dt_image_read_duplicates(uint32_t id, const char *filename);
 /** imports a new image from raw/etc file and adds it to the data base and image cache. */
 uint32_t dt_image_import(int32_t film_id, const char *filename, gboolean override_ignore_jpegs);
+/** reads the metadata dt_image_import() needs from disk, without touching the database. can run in
+ *  parallel to other imports. returns NULL if the file isn't going to be imported anyways. */
+struct dt_exif_prefetch_t *dt_image_import_prefetch(const char *filename, gboolean override_ignore_jpegs);
+/** same as dt_image_import(), using the result of dt_image_import_prefetch() if that isn't NULL. */
+uint32_t dt_image_import_prefetched(int32_t film_id, const char *filename, gboolean override_ignore_jpegs,
+                                    struct dt_exif_prefetch_t *prefetch);
 /** removes the given image from the database. */
 void dt_image_remove(const int32_t imgid);
 /** duplicates the given image in the database with the duplicate getting the supplied version number. if that
@@ -293,6 +299,10 @@ gboolean dt_image_safe_remove(const int32_t imgid);
 void dt_image_local_copy_synch(void);
 // xmp functions:
 void dt_image_write_sidecar_file(int imgid);
+/** writes the xmp sidecar files of all images in the list at once, regardless of the write_sidecar_files
+ * setting. */
+void dt_image_write_sidecar_files(GList *imgs);
+/** queues writing the sidecar file of the image, or of all selected ones if selected is -1. */
 void dt_image_synch_xmp(const int selected);
 void dt_image_synch_all_xmp(const gchar *pathname);
 
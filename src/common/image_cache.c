@@ -22,6 +22,8 @@
 #include "common/image.h"
 #include "common/image_cache.h"
 #include "control/conf.h"
+#include "control/control.h"
+#include "control/jobs.h"
 #include "develop/develop.h"
 
 #include <sqlite3.h>
@@ -35,14 +37,14 @@ void dt_image_cache_allocate(void *data, dt_cache_entry_t *entry)
   entry->data = img;
   // load stuff from db and store in cache:
   char *str;
-  sqlite3_stmt *stmt;
-  DT_DEBUG_SQLITE3_PREPARE_V2(
-      dt_database_get(darktable.db),
+  // this runs for every image that gets into the cache, keep the statement around. thumbnail and export jobs
+  // come here, read on the connection of the thread so they don't wait for the main handle.
+  sqlite3_stmt *stmt = dt_database_prepare_cached(
+      darktable.db, dt_database_get_reader(darktable.db),
       "SELECT id, group_id, film_id, width, height, filename, maker, model, lens, exposure, "
       "aperture, iso, focal_length, datetime_taken, flags, crop, orientation, focus_distance, "
       "raw_parameters, longitude, latitude, color_matrix, colorspace, version, raw_black, raw_maximum FROM "
-      "images WHERE id = ?1",
-      -1, &stmt, NULL);
+      "images WHERE id = ?1");
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, entry->key);
   if(sqlite3_step(stmt) == SQLITE_ROW)
   {
@@ -116,7 +118,7 @@ void dt_image_cache_allocate(void *data, dt_cache_entry_t *entry)
     fprintf(stderr, "[image_cache_allocate] failed to open image %d from database: %s\n", entry->key,
             sqlite3_errmsg(dt_database_get(darktable.db)));
   }
-  sqlite3_finalize(stmt);
+  sqlite3_reset(stmt);
   img->cache_entry = entry; // init backref
   // could downgrade lock write->read on entry->lock if we were using concurrencykit..
   dt_image_refresh_makermodel(img);
@@ -143,11 +145,19 @@ void dt_image_cache_init(dt_image_cache_t *cache)
   dt_cache_set_allocate_callback(&cache->cache, &dt_image_cache_allocate, cache);
   dt_cache_set_cleanup_callback(&cache->cache, &dt_image_cache_deallocate, cache);
 
+  dt_pthread_mutex_init(&cache->sidecar_mutex, NULL);
+  cache->sidecar_pending = g_hash_table_new(NULL, NULL);
+  cache->sidecar_job_queued = 0;
+
   dt_print(DT_DEBUG_CACHE, "[image_cache] has %d entries\n", num);
 }
 
 void dt_image_cache_cleanup(dt_image_cache_t *cache)
 {
+  // the background jobs are gone by now, write what they didn't get to
+  dt_image_cache_write_sidecar_flush(cache);
+  g_hash_table_destroy(cache->sidecar_pending);
+  dt_pthread_mutex_destroy(&cache->sidecar_mutex);
   dt_cache_cleanup(&cache->cache);
 }
 
@@ -191,16 +201,14 @@ void dt_image_cache_read_release(dt_image_cache_t *cache, const dt_image_t *img)
 void dt_image_cache_write_release(dt_image_cache_t *cache, dt_image_t *img, dt_image_cache_write_mode_t mode)
 {
   if(img->id <= 0) return;
-  sqlite3_stmt *stmt;
-  DT_DEBUG_SQLITE3_PREPARE_V2(
-      dt_database_get(darktable.db),
+  sqlite3_stmt *stmt = dt_database_prepare_cached(
+      darktable.db, dt_database_get(darktable.db),
       "UPDATE images SET width = ?1, height = ?2, maker = ?3, model = ?4, "
       "lens = ?5, exposure = ?6, aperture = ?7, iso = ?8, focal_length = ?9, "
       "focus_distance = ?10, film_id = ?11, datetime_taken = ?12, flags = ?13, "
       "crop = ?14, orientation = ?15, raw_parameters = ?16, group_id = ?17, longitude = ?18, "
       "latitude = ?19, color_matrix = ?20, colorspace = ?21, raw_black = ?22, raw_maximum = ?23 WHERE id = "
-      "?24",
-      -1, &stmt, NULL);
+      "?24");
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, img->width);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, img->height);
   DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 3, img->exif_maker, -1, SQLITE_STATIC);
@@ -227,18 +235,60 @@ void dt_image_cache_write_release(dt_image_cache_t *cache, dt_image_t *img, dt_i
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 24, img->id);
   int rc = sqlite3_step(stmt);
   if(rc != SQLITE_DONE) fprintf(stderr, "[image_cache_write_release] sqlite3 error %d\n", rc);
-  sqlite3_finalize(stmt);
+  sqlite3_reset(stmt);
 
   // TODO: make this work in relaxed mode, too.
   if(mode == DT_IMAGE_CACHE_SAFE)
   {
     // rest about sidecars:
     // also synch dttags file:
-    dt_image_write_sidecar_file(img->id);
+    if(dt_conf_get_bool("write_sidecar_files")) dt_image_cache_write_sidecar_deferred(cache, img->id);
   }
   dt_cache_release(&cache->cache, img->cache_entry);
 }
 
+static int32_t _image_cache_write_sidecar_job_run(dt_job_t *job)
+{
+  dt_image_cache_write_sidecar_flush(darktable.image_cache);
+  return 0;
+}
+
+void dt_image_cache_write_sidecar_deferred(dt_image_cache_t *cache, const uint32_t imgid)
+{
+  if(imgid <= 0) return;
+  if(!darktable.gui || !dt_control_running())
+  {
+    dt_image_write_sidecar_file(imgid);
+    return;
+  }
+
+  dt_pthread_mutex_lock(&cache->sidecar_mutex);
+  g_hash_table_add(cache->sidecar_pending, GINT_TO_POINTER(imgid));
+  const int queue_job = !cache->sidecar_job_queued;
+  cache->sidecar_job_queued = 1;
+  dt_pthread_mutex_unlock(&cache->sidecar_mutex);
+
+  if(queue_job)
+  {
+    dt_job_t *job = dt_control_job_create(&_image_cache_write_sidecar_job_run, "write sidecar files");
+    if(!job || dt_control_add_job(darktable.control, DT_JOB_QUEUE_SYSTEM_BG, job))
+      dt_image_cache_write_sidecar_flush(cache);
+  }
+}
+
+void dt_image_cache_write_sidecar_flush(dt_image_cache_t *cache)
+{
+  // take all pending images, requests coming in from now on queue a new job
+  dt_pthread_mutex_lock(&cache->sidecar_mutex);
+  GList *imgs = g_hash_table_get_keys(cache->sidecar_pending);
+  g_hash_table_steal_all(cache->sidecar_pending);
+  cache->sidecar_job_queued = 0;
+  dt_pthread_mutex_unlock(&cache->sidecar_mutex);
+
+  if(imgs && dt_conf_get_bool("write_sidecar_files")) dt_image_write_sidecar_files(imgs);
+  g_list_free(imgs);
+}
+
 
 // remove the image from the cache
 void dt_image_cache_remove(dt_image_cache_t *cache, const uint32_t imgid)
@@ -24,6 +24,11 @@
 typedef struct dt_image_cache_t
 {
   dt_cache_t cache;
+
+  // ids of the images whose xmp sidecars are still to be written by a background job
+  dt_pthread_mutex_t sidecar_mutex;
+  GHashTable *sidecar_pending;
+  int sidecar_job_queued;
 }
 dt_image_cache_t;
 
@@ -61,8 +66,17 @@ void dt_image_cache_read_release(dt_image_cache_t *cache, const dt_image_t *img)
 // drops the write privileges on an image struct.
 // this triggers a write-through to sql, and if the setting
 // is present, also to xmp sidecar files (safe setting).
+// the latter happens shortly after, see dt_image_cache_write_sidecar_deferred().
 void dt_image_cache_write_release(dt_image_cache_t *cache, dt_image_t *img, dt_image_cache_write_mode_t mode);
 
+// queues writing the xmp sidecar file of the image. all pending sidecars are written
+// in one batch by a background job, so repeated requests for the same image before
+// that only cost one write. without a running gui the file is written right away.
+void dt_image_cache_write_sidecar_deferred(dt_image_cache_t *cache, const uint32_t imgid);
+
+// writes all pending sidecar files now.
+void dt_image_cache_write_sidecar_flush(dt_image_cache_t *cache);
+
 // remove the image from the cache
 void dt_image_cache_remove(dt_image_cache_t *cache, const uint32_t imgid);
 
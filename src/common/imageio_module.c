@@ -197,6 +197,11 @@ static int _default_storage_dimension(struct dt_imageio_module_storage_t *self,
 static void _default_storage_nop(struct dt_imageio_module_storage_t *self)
 {
 }
+/** Default implementation of flags, used if storage module does not implement flags() */
+static int _default_storage_flags(struct dt_imageio_module_storage_t *self)
+{
+  return 0;
+}
 
 static int dt_imageio_load_module_storage(dt_imageio_module_storage_t *module, const char *libname,
                                           const char *plugin_name)
@@ -251,6 +256,8 @@ static int dt_imageio_load_module_storage(dt_imageio_module_storage_t *module, c
     module->recommended_dimension = _default_storage_dimension;
   if(!g_module_symbol(module->module, "export_dispatched", (gpointer) & (module->export_dispatched)))
     module->export_dispatched = _default_storage_nop;
+  if(!g_module_symbol(module->module, "flags", (gpointer) & (module->flags)))
+    module->flags = _default_storage_flags;
 #ifdef USE_LUA
   {
     char pseudo_type_name[1024];
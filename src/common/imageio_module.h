@@ -34,6 +34,9 @@
 
 /** Flag for the format modules */
 #define FORMAT_FLAGS_SUPPORT_XMP 1
+#define FORMAT_FLAGS_NO_PARALLEL_EXPORT 2
+
+#define STORAGE_FLAGS_SUPPORT_PARALLEL 1
 
 /**
  * defines the plugin structure for image import and export.
@@ -178,6 +181,9 @@ typedef struct dt_imageio_module_storage_t
 
   void (*export_dispatched)(struct dt_imageio_module_storage_t *self);
 
+  /* sometimes we want to tell the world about what we can do, i.e. if store() may be called in parallel */
+  int (*flags)(struct dt_imageio_module_storage_t *self);
+
   luaA_Type parameter_lua_type;
 } dt_imageio_module_storage_t;
 
@@ -104,8 +104,6 @@ void dt_rawspeed_lookup_makermodel(const char *maker, const char *model,
 dt_imageio_retval_t dt_imageio_open_rawspeed(dt_image_t *img, const char *filename,
                                              dt_mipmap_buffer_t *mbuf)
 {
-  if(!img->exif_inited) (void)dt_exif_read(img, filename);
-
 #ifdef __WIN32__
   const size_t len = strlen(filename) + 1;
   wchar_t filen[len];
@@ -129,11 +127,18 @@ dt_imageio_retval_t dt_imageio_open_rawspeed(dt_image_t *img, const char *filena
   {
     dt_rawspeed_load_meta();
 
+    dt_times_t start;
+    dt_get_times(&start);
 #ifdef __APPLE__
     m = auto_ptr<FileMap>(f.readFile());
 #else
     m = unique_ptr<FileMap>(f.readFile());
 #endif
+    dt_show_times(&start, "[rawspeed] reading file", "%s", filename);
+
+    // the file is read only once, exiv2 gets the same copy as rawspeed.
+    if(!img->exif_inited)
+      (void)dt_exif_read_from_memory(img, filename, m->getData(0), m->getSize());
 
     RawParser t(m.get());
 #ifdef __APPLE__
@@ -319,6 +324,9 @@ dt_imageio_retval_t dt_imageio_open_rawspeed(dt_image_t *img, const char *filena
   {
     printf("[rawspeed] %s\n", exc.what());
 
+    // the other loaders still need the metadata if rawspeed couldn't even read the file
+    if(!img->exif_inited) (void)dt_exif_read(img, filename);
+
     /* if an exception is raised lets not retry or handle the
      specific ones, consider the file as corrupted */
     return DT_IMAGEIO_FILE_CORRUPTED;
@@ -326,6 +334,7 @@ dt_imageio_retval_t dt_imageio_open_rawspeed(dt_image_t *img, const char *filena
   catch(...)
   {
     printf("Unhandled exception in imageio_rawspeed\n");
+    if(!img->exif_inited) (void)dt_exif_read(img, filename);
     return DT_IMAGEIO_FILE_CORRUPTED;
   }
 
@@ -82,6 +82,8 @@ static void dt_metadata_set_exif(int id, const char *key, const char *value)
 
 static GList *dt_metadata_get_xmp(int id, const char *key, uint32_t *count)
 {
+  // exports read these for every image, they don't need to wait for the main handle
+  sqlite3 *db = dt_database_get_reader(darktable.db);
   GList *result = NULL;
   sqlite3_stmt *stmt;
   uint32_t local_count = 0;
@@ -94,13 +96,13 @@ static GList *dt_metadata_get_xmp(int id, const char *key, uint32_t *count)
     {
       if(id == -1)
       {
-        DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "select flags from images where id in "
-                                                                   "(select imgid from selected_images)",
+        DT_DEBUG_SQLITE3_PREPARE_V2(db, "select flags from images where id in "
+                                        "(select imgid from selected_images)",
                                     -1, &stmt, NULL);
       }
       else // single image under mouse cursor
       {
-        DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "select flags from images where id = ?1",
+        DT_DEBUG_SQLITE3_PREPARE_V2(db, "select flags from images where id = ?1",
                                     -1, &stmt, NULL);
         DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, id);
       }
@@ -117,7 +119,7 @@ static GList *dt_metadata_get_xmp(int id, const char *key, uint32_t *count)
     {
       if(id == -1)
       {
-        DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+        DT_DEBUG_SQLITE3_PREPARE_V2(db,
                                     "select name from tags join tagged_images on "
                                     "tagged_images.tagid = tags.id where imgid in "
                                     "(select imgid from selected_images)",
@@ -125,7 +127,7 @@ static GList *dt_metadata_get_xmp(int id, const char *key, uint32_t *count)
       }
       else // single image under mouse cursor
       {
-        DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+        DT_DEBUG_SQLITE3_PREPARE_V2(db,
                                     "select name from tags join tagged_images on "
                                     "tagged_images.tagid = tags.id where imgid = ?1",
                                     -1, &stmt, NULL);
@@ -142,14 +144,14 @@ static GList *dt_metadata_get_xmp(int id, const char *key, uint32_t *count)
     {
       if(id == -1)
       {
-        DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+        DT_DEBUG_SQLITE3_PREPARE_V2(db,
                                     "select color from color_labels where imgid in "
                                     "(select imgid from selected_images)",
                                     -1, &stmt, NULL);
       }
       else // single image under mouse cursor
       {
-        DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+        DT_DEBUG_SQLITE3_PREPARE_V2(db,
                                     "select color from color_labels where imgid=?1 order by color", -1, &stmt,
                                     NULL);
         DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, id);
@@ -168,7 +170,7 @@ static GList *dt_metadata_get_xmp(int id, const char *key, uint32_t *count)
   // So we got this far -- it has to be a generic key-value entry from meta_data
   if(id == -1)
   {
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+    DT_DEBUG_SQLITE3_PREPARE_V2(db,
                                 "select value from meta_data where id in "
                                 "(select imgid from selected_images) and key = ?1 order by value",
                                 -1, &stmt, NULL);
@@ -176,7 +178,7 @@ static GList *dt_metadata_get_xmp(int id, const char *key, uint32_t *count)
   }
   else // single image under mouse cursor
   {
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+    DT_DEBUG_SQLITE3_PREPARE_V2(db,
                                 "select value from meta_data where id = ?1 and key = ?2 order by value", -1,
                                 &stmt, NULL);
     DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, id);
@@ -205,6 +207,8 @@ static GList *dt_metadata_get_xmp(int id, const char *key, uint32_t *count)
 */
 static GList *dt_metadata_get_exif(int id, const char *key, uint32_t *count)
 {
+  // exports read these for every image, they don't need to wait for the main handle
+  sqlite3 *db = dt_database_get_reader(darktable.db);
   GList *result = NULL;
   sqlite3_stmt *stmt;
   uint32_t local_count = 0;
@@ -214,13 +218,13 @@ static GList *dt_metadata_get_exif(int id, const char *key, uint32_t *count)
   {
     if(id == -1)
     {
-      DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "select exposure from images where id in "
-                                                                 "(select imgid from selected_images)",
+      DT_DEBUG_SQLITE3_PREPARE_V2(db, "select exposure from images where id in "
+                                      "(select imgid from selected_images)",
                                   -1, &stmt, NULL);
     }
     else // single image under mouse cursor
     {
-      DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "select exposure from images where id = ?1",
+      DT_DEBUG_SQLITE3_PREPARE_V2(db, "select exposure from images where id = ?1",
                                   -1, &stmt, NULL);
       DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, id);
     }
@@ -229,13 +233,13 @@ static GList *dt_metadata_get_exif(int id, const char *key, uint32_t *count)
   {
     if(id == -1)
     {
-      DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "select aperture from images where id in "
-                                                                 "(select imgid from selected_images)",
+      DT_DEBUG_SQLITE3_PREPARE_V2(db, "select aperture from images where id in "
+                                      "(select imgid from selected_images)",
                                   -1, &stmt, NULL);
     }
     else // single image under mouse cursor
     {
-      DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "select aperture from images where id = ?1",
+      DT_DEBUG_SQLITE3_PREPARE_V2(db, "select aperture from images where id = ?1",
                                   -1, &stmt, NULL);
       DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, id);
     }
@@ -244,13 +248,13 @@ static GList *dt_metadata_get_exif(int id, const char *key, uint32_t *count)
   {
     if(id == -1)
     {
-      DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+      DT_DEBUG_SQLITE3_PREPARE_V2(db,
                                   "select iso from images where id in (select imgid from selected_images)",
                                   -1, &stmt, NULL);
     }
     else // single image under mouse cursor
     {
-      DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "select iso from images where id = ?1", -1,
+      DT_DEBUG_SQLITE3_PREPARE_V2(db, "select iso from images where id = ?1", -1,
                                   &stmt, NULL);
       DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, id);
     }
@@ -259,14 +263,14 @@ static GList *dt_metadata_get_exif(int id, const char *key, uint32_t *count)
   {
     if(id == -1)
     {
-      DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+      DT_DEBUG_SQLITE3_PREPARE_V2(db,
                                   "select focal_length from images where id in "
                                   "(select imgid from selected_images)",
                                   -1, &stmt, NULL);
     }
     else // single image under mouse cursor
     {
-      DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+      DT_DEBUG_SQLITE3_PREPARE_V2(db,
                                   "select focal_length from images where id = ?1", -1, &stmt, NULL);
       DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, id);
     }
@@ -279,14 +283,14 @@ static GList *dt_metadata_get_exif(int id, const char *key, uint32_t *count)
     {
       if(id == -1)
       {
-        DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+        DT_DEBUG_SQLITE3_PREPARE_V2(db,
                                     "select datetime_taken from images where id in "
                                     "(select imgid from selected_images)",
                                     -1, &stmt, NULL);
       }
       else // single image under mouse cursor
       {
-        DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+        DT_DEBUG_SQLITE3_PREPARE_V2(db,
                                     "select datetime_taken from images where id = ?1", -1, &stmt, NULL);
         DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, id);
       }
@@ -295,13 +299,13 @@ static GList *dt_metadata_get_exif(int id, const char *key, uint32_t *count)
     {
       if(id == -1)
       {
-        DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "select maker from images where id in "
-                                                                   "(select imgid from selected_images)",
+        DT_DEBUG_SQLITE3_PREPARE_V2(db, "select maker from images where id in "
+                                        "(select imgid from selected_images)",
                                     -1, &stmt, NULL);
       }
       else // single image under mouse cursor
       {
-        DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "select maker from images where id = ?1",
+        DT_DEBUG_SQLITE3_PREPARE_V2(db, "select maker from images where id = ?1",
                                     -1, &stmt, NULL);
         DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, id);
       }
@@ -310,13 +314,13 @@ static GList *dt_metadata_get_exif(int id, const char *key, uint32_t *count)
     {
       if(id == -1)
       {
-        DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "select model from images where id in "
-                                                                   "(select imgid from selected_images)",
+        DT_DEBUG_SQLITE3_PREPARE_V2(db, "select model from images where id in "
+                                        "(select imgid from selected_images)",
                                     -1, &stmt, NULL);
       }
       else // single image under mouse cursor
       {
-        DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "select model from images where id = ?1",
+        DT_DEBUG_SQLITE3_PREPARE_V2(db, "select model from images where id = ?1",
                                     -1, &stmt, NULL);
         DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, id);
       }
@@ -352,6 +356,8 @@ END:
 // for everything which doesn't fit anywhere else (our made up stuff)
 static GList *dt_metadata_get_dt(int id, const char *key, uint32_t *count)
 {
+  // exports read these for every image, they don't need to wait for the main handle
+  sqlite3 *db = dt_database_get_reader(darktable.db);
   GList *result = NULL;
   sqlite3_stmt *stmt;
   uint32_t local_count = 0;
@@ -360,13 +366,13 @@ static GList *dt_metadata_get_dt(int id, const char *key, uint32_t *count)
   {
     if(id == -1)
     {
-      DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "select lens from images where id in "
-                                                                 "(select imgid from selected_images)",
+      DT_DEBUG_SQLITE3_PREPARE_V2(db, "select lens from images where id in "
+                                      "(select imgid from selected_images)",
                                   -1, &stmt, NULL);
     }
     else // single image under mouse cursor
     {
-      DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "select lens from images where id = ?1", -1,
+      DT_DEBUG_SQLITE3_PREPARE_V2(db, "select lens from images where id = ?1", -1,
                                   &stmt, NULL);
       DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, id);
     }
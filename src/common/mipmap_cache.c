@@ -38,7 +38,6 @@
 #include <glib/gstdio.h>
 #include <errno.h>
 #include <xmmintrin.h>
-#include <sys/statvfs.h>
 
 #define DT_MIPMAP_CACHE_FILE_MAGIC 0xD71337
 #define DT_MIPMAP_CACHE_FILE_VERSION 23
@@ -201,6 +200,61 @@ void *dt_mipmap_cache_alloc(dt_mipmap_buffer_t *buf, const dt_image_t *img)
   return dsc + 1;
 }
 
+// decompress a jpg backing thumbnail from the disk cache into the entry, called by the thumbnail store
+static int _thumbnail_decompress(const uint8_t *blob, size_t length, void *data)
+{
+  dt_cache_entry_t *entry = (dt_cache_entry_t *)data;
+  dt_mipmap_cache_t *cache = darktable.mipmap_cache;
+  const dt_mipmap_size_t mip = get_size(entry->key);
+  struct dt_mipmap_buffer_dsc *dsc = entry->data;
+  dt_imageio_jpeg_t jpg;
+  if(dt_imageio_jpeg_decompress_header(blob, length, &jpg)
+     || (jpg.width > cache->max_width[mip] || jpg.height > cache->max_height[mip])
+     || dt_imageio_jpeg_decompress(&jpg, entry->data + sizeof(*dsc)))
+    return 1;
+  dsc->width = jpg.width;
+  dsc->height = jpg.height;
+  return 0;
+}
+
+// move the thumbnails of the old one-file-per-thumbnail layout into the thumbnail store,
+// once: the directory is removed afterwards so later starts don't look at it again.
+static void _thumbnail_import_legacy(dt_thumbnail_store_t *store, const char *dirname)
+{
+  GDir *dir = g_dir_open(dirname, 0, NULL);
+  if(!dir) return;
+  int count = 0;
+  const gchar *name;
+  while((name = g_dir_read_name(dir)))
+  {
+    char *end = NULL;
+    const unsigned long imgid = strtoul(name, &end, 10);
+    if(end == name || strcmp(end, ".jpg")) continue;
+    gchar *filename = g_build_filename(dirname, name, NULL);
+    gchar *blob = NULL;
+    gsize len = 0;
+    if(g_file_get_contents(filename, &blob, &len, NULL) && len > 0 && !dt_thumbnail_store_contains(store, imgid))
+    {
+      dt_thumbnail_store_write(store, imgid, (const uint8_t *)blob, len);
+      count++;
+    }
+    g_free(blob);
+    g_unlink(filename);
+    g_free(filename);
+  }
+  g_dir_close(dir);
+  dt_thumbnail_store_flush(store);
+  if(g_rmdir(dirname))
+    fprintf(stderr, "[mipmap_cache] couldn't remove `%s' after moving its thumbnails\n", dirname);
+  dt_print(DT_DEBUG_CACHE, "[mipmap_cache] moved %d thumbnails from `%s' into the thumbnail store\n", count, dirname);
+}
+
+static gboolean _thumbnail_on_disk(dt_mipmap_cache_t *cache, const dt_mipmap_size_t mip, const uint32_t imgid)
+{
+  if(mip >= DT_MIPMAP_F || (int)mip < DT_MIPMAP_0 || !cache->store[mip]) return FALSE;
+  return dt_thumbnail_store_contains(cache->store[mip], imgid);
+}
+
 // callback for the cache backend to initialize payload pointers
 void dt_mipmap_cache_allocate_dynamic(void *data, dt_cache_entry_t *entry)
 {
@@ -243,46 +297,18 @@ void dt_mipmap_cache_allocate_dynamic(void *data, dt_cache_entry_t *entry)
   assert(dsc->size >= sizeof(*dsc));
 
   int loaded_from_disk = 0;
-  if(mip < DT_MIPMAP_F)
+  if(mip < DT_MIPMAP_F && cache->store[mip] && dt_conf_get_bool("cache_disk_backend"))
   {
-    if(cache->cachedir[0] && dt_conf_get_bool("cache_disk_backend"))
+    // try and load from disk, if successful set flag
+    const uint32_t imgid = get_imgid(entry->key);
+    const int res = dt_thumbnail_store_read(cache->store[mip], imgid, _thumbnail_decompress, entry);
+    if(res > 0)
     {
-      // try and load from disk, if successful set flag
-      char filename[PATH_MAX] = {0};
-      snprintf(filename, sizeof(filename), "%s.d/%d/%d.jpg", cache->cachedir, mip, get_imgid(entry->key));
-      FILE *f = fopen(filename, "rb");
-      if(f)
-      {
-        long len = 0;
-        uint8_t *blob = 0;
-        fseek(f, 0, SEEK_END);
-        len = ftell(f);
-        if(len <= 0) goto read_error; // coverity madness
-        blob = (uint8_t *)malloc(len);
-        if(!blob) goto read_error;
-        fseek(f, 0, SEEK_SET);
-        int rd = fread(blob, sizeof(uint8_t), len, f);
-        if(rd != len) goto read_error;
-        dt_imageio_jpeg_t jpg;
-        if(dt_imageio_jpeg_decompress_header(blob, len, &jpg)
-           || (jpg.width > cache->max_width[mip] || jpg.height > cache->max_height[mip])
-           || dt_imageio_jpeg_decompress(&jpg, entry->data + sizeof(*dsc)))
-        {
-          fprintf(stderr, "[mipmap_cache] failed to decompress thumbnail for image %d from `%s'!\n", get_imgid(entry->key), filename);
-          goto read_error;
-        }
-        dsc->width = jpg.width;
-        dsc->height = jpg.height;
-        loaded_from_disk = 1;
-        if(0)
-        {
-read_error:
-          g_unlink(filename);
-        }
-        free(blob);
-        fclose(f);
-      }
+      fprintf(stderr, "[mipmap_cache] failed to decompress thumbnail for image %d from `%s'!\n", imgid,
+              cache->store[mip]->filename);
+      dt_thumbnail_store_remove(cache->store[mip], imgid);
     }
+    loaded_from_disk = (res == 0);
   }
 
   if(!loaded_from_disk)
@@ -299,9 +325,10 @@ void dt_mipmap_cache_deallocate_dynamic(void *data, dt_cache_entry_t *entry)
 {
   dt_mipmap_cache_t *cache = (dt_mipmap_cache_t *)data;
   const dt_mipmap_size_t mip = get_size(entry->key);
-  if(mip < DT_MIPMAP_F)
+  if(mip < DT_MIPMAP_F && cache->store[mip])
   {
     struct dt_mipmap_buffer_dsc *dsc = (struct dt_mipmap_buffer_dsc *)entry->data;
+    const uint32_t imgid = get_imgid(entry->key);
     // don't write skulls:
     if(dsc->width > 8 && dsc->height > 8)
     {
@@ -310,62 +337,22 @@ void dt_mipmap_cache_deallocate_dynamic(void *data, dt_cache_entry_t *entry)
         // also remove jpg backing (always try to do that, in case user just temporarily switched it off,
         // to avoid inconsistencies.
         // if(dt_conf_get_bool("cache_disk_backend"))
-        if(cache->cachedir[0])
-        {
-          char filename[PATH_MAX] = {0};
-          snprintf(filename, sizeof(filename), "%s.d/%d/%d.jpg", cache->cachedir, mip, get_imgid(entry->key));
-          g_unlink(filename);
-        }
+        dt_thumbnail_store_remove(cache->store[mip], imgid);
       }
-      else if(cache->cachedir[0] && dt_conf_get_bool("cache_disk_backend"))
+      // Don't write existing thumbnails as both performance and quality (lossy jpg) suffer
+      else if(dt_conf_get_bool("cache_disk_backend") && !dt_thumbnail_store_contains(cache->store[mip], imgid))
       {
-        // serialize to disk
-        char filename[PATH_MAX] = {0};
-        snprintf(filename, sizeof(filename), "%s.d/%d", cache->cachedir, mip);
-        int mkd = g_mkdir_with_parents(filename, 0750);
-        if(!mkd)
+        // serialize to disk. allocate temp memory, at least 1MB to be sure we fit:
+        const size_t bloblen = MAX(1<<20, cache->buffer_size[mip]);
+        uint8_t *blob = (uint8_t *)malloc(bloblen);
+        if(blob)
         {
-          snprintf(filename, sizeof(filename), "%s.d/%d/%d.jpg", cache->cachedir, mip, get_imgid(entry->key));
-          // Don't write existing files as both performance and quality (lossy jpg) suffer
-          FILE *f;
-          if (!g_file_test(filename, G_FILE_TEST_EXISTS) && (f = fopen(filename, "wb")))
-          {
-            uint8_t *blob = NULL;
-
-            // first check the disk isn't full
-            struct statvfs vfsbuf;
-            if (!statvfs(filename, &vfsbuf))
-            {
-              int64_t free_mb = ((vfsbuf.f_frsize * vfsbuf.f_bavail) >> 20);
-              if (free_mb < 100)
-              {
-                fprintf(stderr, "Aborting image write as only %ld MB free to write %s\n", free_mb, filename);
-                goto write_error;
-              }
-            }
-            else
-            {
-              fprintf(stderr, "Aborting image write since couldn't determine free space available to write %s\n", filename);
-              goto write_error;
-            }
-
-            // allocate temp memory, at least 1MB to be sure we fit:
-            size_t bloblen = MAX(1<<20, cache->buffer_size[mip]);
-            blob = (uint8_t *)malloc(bloblen);
-            if(!blob) goto write_error;
-            const int cache_quality = dt_conf_get_int("database_cache_quality");
-            const int32_t length
-              = dt_imageio_jpeg_compress(entry->data + sizeof(*dsc), blob, dsc->width, dsc->height, MIN(100, MAX(10, cache_quality)));
-            assert(length <= bloblen);
-            int written = fwrite(blob, sizeof(uint8_t), length, f);
-            if(written != length)
-            {
-write_error:
-              g_unlink(filename);
-            }
-            free(blob);
-            fclose(f);
-          }
+          const int cache_quality = dt_conf_get_int("database_cache_quality");
+          const int32_t length
+            = dt_imageio_jpeg_compress(entry->data + sizeof(*dsc), blob, dsc->width, dsc->height, MIN(100, MAX(10, cache_quality)));
+          assert(length <= bloblen);
+          if(length > 0) dt_thumbnail_store_write(cache->store[mip], imgid, blob, length);
+          free(blob);
         }
       }
     }
@@ -383,6 +370,22 @@ static uint32_t nearest_power_of_two(const uint32_t value)
 void dt_mipmap_cache_init(dt_mipmap_cache_t *cache)
 {
   dt_mipmap_cache_get_filename(cache->cachedir, sizeof(cache->cachedir));
+  // open the packed jpg backing of the thumbnails:
+  for(int k = DT_MIPMAP_0; k < DT_MIPMAP_F; k++) cache->store[k] = NULL;
+  if(cache->cachedir[0])
+  {
+    char filename[PATH_MAX] = { 0 };
+    snprintf(filename, sizeof(filename), "%s.d", cache->cachedir);
+    if(!g_mkdir_with_parents(filename, 0750))
+      for(int k = DT_MIPMAP_0; k < DT_MIPMAP_F; k++)
+      {
+        snprintf(filename, sizeof(filename), "%s.d/%d", cache->cachedir, k);
+        cache->store[k] = dt_thumbnail_store_open(filename);
+        // thumbnails written by older versions get moved into the store
+        if(cache->store[k] && g_file_test(filename, G_FILE_TEST_IS_DIR))
+          _thumbnail_import_legacy(cache->store[k], filename);
+      }
+  }
   // make sure static memory is initialized
   struct dt_mipmap_buffer_dsc *dsc = (struct dt_mipmap_buffer_dsc *)dt_mipmap_cache_static_dead_image;
   dead_image_f((dt_mipmap_buffer_t *)(dsc + 1));
@@ -464,6 +467,12 @@ void dt_mipmap_cache_cleanup(dt_mipmap_cache_t *cache)
   dt_cache_cleanup(&cache->mip_thumbs.cache);
   dt_cache_cleanup(&cache->mip_full.cache);
   dt_cache_cleanup(&cache->mip_f.cache);
+  // after the caches wrote back their thumbnails:
+  for(int k = DT_MIPMAP_0; k < DT_MIPMAP_F; k++)
+  {
+    dt_thumbnail_store_close(cache->store[k]);
+    cache->store[k] = NULL;
+  }
 }
 
 void dt_mipmap_cache_print(dt_mipmap_cache_t *cache)
@@ -576,12 +585,8 @@ void dt_mipmap_cache_get_with_caller(
   }
   else if(flags == DT_MIPMAP_PREFETCH_DISK)
   {
-    // only prefetch if the disk cache exists:
-    if(!cache->cachedir[0]) return;
-    char filename[PATH_MAX] = {0};
-    snprintf(filename, sizeof(filename), "%s.d/%d/%d.jpg", cache->cachedir, mip, key);
     // don't attempt to load if disk cache doesn't exist
-    if(!g_file_test(filename, G_FILE_TEST_EXISTS)) return;
+    if(!_thumbnail_on_disk(cache, mip, imgid)) return;
     if(mip > DT_MIPMAP_FULL || (int)mip < DT_MIPMAP_0)
       return; // remove the (int) once we no longer have to support gcc < 4.8 :/
     dt_control_add_job(darktable.control, DT_JOB_QUEUE_SYSTEM_FG, dt_image_load_job_create(imgid, mip));
@@ -720,13 +725,8 @@ void dt_mipmap_cache_get_with_caller(
     __sync_fetch_and_add(&(_get_cache(cache, mip)->stats_misses), 1);
     // in case we don't even have a disk cache for our requested thumbnail,
     // prefetch at least mip0, in case we have that in the disk caches:
-    if(cache->cachedir[0])
-    {
-      char filename[PATH_MAX] = {0};
-      snprintf(filename, sizeof(filename), "%s.d/%d/%d.jpg", cache->cachedir, mip, key);
-      if(!g_file_test(filename, G_FILE_TEST_EXISTS))
-        dt_mipmap_cache_get(cache, 0, imgid, DT_MIPMAP_0, DT_MIPMAP_PREFETCH_DISK, 0);
-    }
+    if(!_thumbnail_on_disk(cache, mip, imgid))
+      dt_mipmap_cache_get(cache, 0, imgid, DT_MIPMAP_0, DT_MIPMAP_PREFETCH_DISK, 0);
     // nothing found :(
     buf->buf = NULL;
     buf->imgid = 0;
@@ -932,6 +932,9 @@ static void _init_8(uint8_t *buf, uint32_t *width, uint32_t *height, const uint3
   if(!altered && !dt_conf_get_bool("never_use_embedded_thumb") && !incompatible)
   {
     const dt_image_orientation_t orientation = dt_image_get_orientation(imgid);
+    // the box the image has to fill before it's flipped
+    const int32_t max_wd = (orientation & ORIENTATION_SWAP_XY) ? ht : wd;
+    const int32_t max_ht = (orientation & ORIENTATION_SWAP_XY) ? wd : ht;
 
     // try to load the embedded thumbnail in raw
     gboolean from_cache = TRUE;
@@ -946,6 +949,7 @@ static void _init_8(uint8_t *buf, uint32_t *width, uint32_t *height, const uint3
       dt_imageio_jpeg_t jpg;
       if(!dt_imageio_jpeg_read_header(filename, &jpg))
       {
+        dt_imageio_jpeg_set_scale(&jpg, max_wd, max_ht);
         uint8_t *tmp = (uint8_t *)malloc(sizeof(uint8_t) * jpg.width * jpg.height * 4);
         if(!dt_imageio_jpeg_read(&jpg, tmp))
         {
@@ -960,7 +964,7 @@ static void _init_8(uint8_t *buf, uint32_t *width, uint32_t *height, const uint3
     {
       uint8_t *tmp = 0;
       int32_t thumb_width, thumb_height;
-      res = dt_imageio_large_thumbnail(filename, &tmp, &thumb_width, &thumb_height);
+      res = dt_imageio_large_thumbnail(filename, &tmp, &thumb_width, &thumb_height, max_wd, max_ht);
       if(!res)
       {
         // scale to fit
@@ -20,6 +20,7 @@
 
 #include "common/cache.h"
 #include "common/image.h"
+#include "common/thumbnail_store.h"
 
 
 // sizes stored in the mipmap cache, set to fixed values in mipmap_cache.c
@@ -97,6 +98,8 @@ typedef struct dt_mipmap_cache_t
   dt_mipmap_cache_one_t mip_f;
   dt_mipmap_cache_one_t mip_full;
   char cachedir[PATH_MAX]; // cached sha1sum filename for faster access
+  // packed jpg backing of the thumbnails on disk, one per mip level
+  dt_thumbnail_store_t *store[DT_MIPMAP_F];
 } dt_mipmap_cache_t;
 
 // dynamic memory allocation interface for imageio backend: a write locked
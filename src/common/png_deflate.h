@@ -0,0 +1,236 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DT_COMMON_PNG_DEFLATE_H
+#define DT_COMMON_PNG_DEFLATE_H
+
+#include "common/darktable.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+// the idat data of a png is one zlib stream over all filtered rows. we cut the image into groups of about
+// this many filtered bytes, which are filtered and deflated independently on all threads. all but the last
+// group end in a sync flush, so the raw deflate streams can just be concatenated, and only the zlib header and
+// the adler32 of the whole thing have to be added. the groups don't share a dictionary, which costs a little
+// compression at the start of each one, but that's lost in the noise at this size.
+#define DT_PNG_DEFLATE_GROUP_SIZE (1 << 20)
+
+// receives the consecutive pieces of the zlib stream, one idat chunk each. returns non-zero on error.
+typedef int (*dt_png_deflate_write_t)(void *user_data, const uint8_t *data, size_t len);
+
+static inline int _png_paeth(const int a, const int b, const int c)
+{
+  const int p = a + b - c;
+  const int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+  if(pa <= pb && pa <= pc) return a;
+  if(pb <= pc) return b;
+  return c;
+}
+
+// filters one row of packed rgb with the filter type the sum of absolute differences heuristic picks, the
+// same libpng uses for PNG_ALL_FILTERS. prev is the unfiltered row above, or zeros for the first one. out
+// holds the filter type byte followed by the row, cand is scratch space for 5 of those.
+static inline void _png_filter_row(const uint8_t *const row, const uint8_t *const prev, const size_t rowbytes,
+                                   const size_t pixelbytes, uint8_t *const cand, uint8_t *const out)
+{
+  uint8_t *c[5];
+  for(int f = 0; f < 5; f++)
+  {
+    c[f] = cand + f * (rowbytes + 1);
+    c[f][0] = f;
+    c[f]++;
+  }
+  for(size_t i = 0; i < pixelbytes; i++)
+  {
+    c[0][i] = row[i];
+    c[1][i] = row[i];
+    c[2][i] = row[i] - prev[i];
+    c[3][i] = row[i] - (prev[i] >> 1);
+    c[4][i] = row[i] - prev[i];
+  }
+  for(size_t i = pixelbytes; i < rowbytes; i++)
+  {
+    const int a = row[i - pixelbytes], b = prev[i], cc = prev[i - pixelbytes];
+    c[0][i] = row[i];
+    c[1][i] = row[i] - a;
+    c[2][i] = row[i] - b;
+    c[3][i] = row[i] - ((a + b) >> 1);
+    c[4][i] = row[i] - _png_paeth(a, b, cc);
+  }
+
+  uint64_t best_sum = UINT64_MAX;
+  int best = 0;
+  for(int f = 0; f < 5; f++)
+  {
+    uint64_t sum = 0;
+    for(size_t i = 0; i < rowbytes; i++) sum += abs((int8_t)c[f][i]);
+    if(sum < best_sum)
+    {
+      best_sum = sum;
+      best = f;
+    }
+  }
+  memcpy(out, cand + best * (rowbytes + 1), rowbytes + 1);
+}
+
+// packs row y of the 4 channel input into big endian rgb.
+static inline void _png_pack_row(const void *const in, const int width, const int bytes, const int y,
+                                 uint8_t *const out)
+{
+  if(bytes == 1)
+  {
+    const uint8_t *i8 = (const uint8_t *)in + (size_t)4 * width * y;
+    for(int x = 0; x < width; x++)
+      for(int k = 0; k < 3; k++) out[3 * x + k] = i8[4 * x + k];
+  }
+  else
+  {
+    const uint16_t *i16 = (const uint16_t *)in + (size_t)4 * width * y;
+    for(int x = 0; x < width; x++)
+      for(int k = 0; k < 3; k++)
+      {
+        out[6 * x + 2 * k] = i16[4 * x + k] >> 8;
+        out[6 * x + 2 * k + 1] = i16[4 * x + k] & 0xff;
+      }
+  }
+}
+
+// encodes the 4 channel 8 or 16 bit image in (the fourth channel is dropped) as the idat data of an
+// non-interlaced rgb png of the given bit depth and hands it to write in order.
+static int dt_png_deflate(const void *const in, const int width, const int height, const int bpp, const int level,
+                          dt_png_deflate_write_t write, void *user_data)
+{
+  const int bytes = bpp / 8;
+  const size_t rowbytes = (size_t)3 * bytes * width;
+  const int rows_per_group = CLAMPS((int)(DT_PNG_DEFLATE_GROUP_SIZE / (rowbytes + 1)), 1, height);
+  const size_t groupsize = (rowbytes + 1) * rows_per_group;
+  const int groups = (height + rows_per_group - 1) / rows_per_group;
+  const int batch = 2 * dt_get_num_threads();
+  // room for the zlib header in front, the adler32 at the end and the sync flush marker
+  const size_t bound = compressBound(groupsize) + 16;
+
+  uint8_t *filtered = malloc((size_t)batch * groupsize);
+  uint8_t *packed = malloc((size_t)batch * bound);
+  size_t *packed_size = malloc(sizeof(size_t) * batch);
+  uLong *adler = malloc(sizeof(uLong) * batch);
+  int rc = !filtered || !packed || !packed_size || !adler;
+
+  uLong checksum = adler32(0L, Z_NULL, 0);
+
+  for(int g0 = 0; g0 < groups && !rc; g0 += batch)
+  {
+    const int n = MIN(batch, groups - g0);
+    int failed = 0;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for(int g = 0; g < n; g++)
+    {
+      const int y0 = (g0 + g) * rows_per_group;
+      const int rows = MIN(rows_per_group, height - y0);
+      const int last = g0 + g == groups - 1;
+      uint8_t *const filt = filtered + (size_t)g * groupsize;
+      // two unfiltered rows and the five filter candidates
+      uint8_t *scratch = malloc(2 * rowbytes + 5 * (rowbytes + 1));
+      if(!scratch)
+      {
+        failed = 1;
+        continue;
+      }
+      uint8_t *prev = scratch, *row = scratch + rowbytes;
+      if(y0 > 0)
+        _png_pack_row(in, width, bytes, y0 - 1, prev);
+      else
+        memset(prev, 0, rowbytes);
+      for(int y = 0; y < rows; y++)
+      {
+        _png_pack_row(in, width, bytes, y0 + y, row);
+        _png_filter_row(row, prev, rowbytes, 3 * bytes, scratch + 2 * rowbytes, filt + (rowbytes + 1) * y);
+        uint8_t *tmp = prev;
+        prev = row;
+        row = tmp;
+      }
+      free(scratch);
+
+      adler[g] = adler32(0L, Z_NULL, 0);
+      adler[g] = adler32(adler[g], filt, (rowbytes + 1) * rows);
+
+      // raw deflate, leaving two bytes in front for the zlib header of the first group
+      z_stream z = { 0 };
+      if(deflateInit2(&z, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+      {
+        failed = 1;
+        continue;
+      }
+      z.next_in = filt;
+      z.avail_in = (rowbytes + 1) * rows;
+      z.next_out = packed + (size_t)g * bound + 2;
+      z.avail_out = bound - 6;
+      const int err = deflate(&z, last ? Z_FINISH : Z_SYNC_FLUSH);
+      if((last && err != Z_STREAM_END) || (!last && (err != Z_OK || z.avail_in || !z.avail_out))) failed = 1;
+      packed_size[g] = bound - 6 - z.avail_out;
+      deflateEnd(&z);
+    }
+    if(failed)
+    {
+      rc = 1;
+      break;
+    }
+
+    for(int g = 0; g < n && !rc; g++)
+    {
+      uint8_t *data = packed + (size_t)g * bound + 2;
+      size_t len = packed_size[g];
+      const int rows = MIN(rows_per_group, height - (g0 + g) * rows_per_group);
+      checksum = adler32_combine(checksum, adler[g], (rowbytes + 1) * rows);
+      if(g0 + g == 0)
+      {
+        // deflate with a 32k window, and the level hint as zlib would set it
+        const int flevel = level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3;
+        data -= 2;
+        len += 2;
+        data[0] = 0x78;
+        data[1] = flevel << 6;
+        data[1] += 31 - (data[0] * 256 + data[1]) % 31;
+      }
+      if(g0 + g == groups - 1)
+      {
+        data[len++] = checksum >> 24;
+        data[len++] = checksum >> 16;
+        data[len++] = checksum >> 8;
+        data[len++] = checksum;
+      }
+      rc = write(user_data, data, len);
+    }
+  }
+
+  free(filtered);
+  free(packed);
+  free(packed_size);
+  free(adler);
+  return rc;
+}
+
+#endif
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
@@ -467,118 +467,127 @@ gboolean dt_styles_create_from_image(const char *name, const char *description,
   return FALSE;
 }
 
-void dt_styles_apply_to_selection(const char *name, gboolean duplicate)
+// applies the style to all images in imgs. the style items are read once and the history of all images is
+// extended in one transaction, reusing the same prepared statements.
+static void _styles_apply_to_images(const char *name, gboolean duplicate, GList *imgs)
 {
-  gboolean selected = FALSE;
+  int id = 0;
+  sqlite3_stmt *stmt;
 
-  /* write current history changes so nothing gets lost, do that only in the darkroom as there is nothing to
-     be
-     save when in the lighttable (and it would write over current history stack) */
-  const dt_view_t *cv = dt_view_manager_get_current_view(darktable.view_manager);
-  if(cv->view((dt_view_t *)cv) == DT_VIEW_DARKROOM) dt_dev_write_history(darktable.develop);
+  if((id = dt_styles_get_id_by_name(name)) == 0) return;
 
-  /* for each selected image apply style */
-  sqlite3_stmt *stmt;
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "select * from selected_images", -1, &stmt, NULL);
-  while(sqlite3_step(stmt) == SQLITE_ROW)
+  /* check if we should make duplicates before applying style. this uses the temp style_items table, too. */
+  GList *newimgs = NULL;
+  for(GList *iter = imgs; iter; iter = g_list_next(iter))
   {
-    int imgid = sqlite3_column_int(stmt, 0);
-    dt_styles_apply_to_image(name, duplicate, imgid);
-    selected = TRUE;
+    const int32_t imgid = GPOINTER_TO_INT(iter->data);
+    int32_t newimgid = imgid;
+    if(duplicate)
+    {
+      newimgid = dt_image_duplicate(imgid);
+      if(newimgid == -1) continue;
+      dt_history_copy_and_paste_on_image(imgid, newimgid, FALSE, NULL);
+    }
+    newimgs = g_list_prepend(newimgs, GINT_TO_POINTER(newimgid));
   }
-  sqlite3_finalize(stmt);
+  newimgs = g_list_reverse(newimgs);
 
-  if(!selected) dt_control_log(_("no image selected!"));
-}
+  /* the temp table is shared with the other writers, so it is filled inside the transaction, too */
+  gboolean ok = dt_database_start_transaction(darktable.db);
 
-void dt_styles_create_from_selection()
-{
-  gboolean selected = FALSE;
-  /* for each selected create style */
-  sqlite3_stmt *stmt;
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "select * from selected_images", -1, &stmt, NULL);
-  while(sqlite3_step(stmt) == SQLITE_ROW)
-  {
-    int imgid = sqlite3_column_int(stmt, 0);
-    dt_gui_styles_dialog_new(imgid);
-    selected = TRUE;
-  }
+  /* delete all items from the temp styles_items, this table is used only to get a ROWNUM of the results */
+  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "DELETE FROM memory.style_items", NULL, NULL, NULL);
+
+  /* copy history items from styles onto temp table */
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "INSERT INTO MEMORY.style_items SELECT * FROM "
+                                                             "style_items WHERE styleid=?1 ORDER BY "
+                                                             "multi_priority DESC;",
+                              -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, id);
+  ok &= (sqlite3_step(stmt) == SQLITE_DONE);
   sqlite3_finalize(stmt);
 
-  if(!selected) dt_control_log(_("no image selected!"));
-}
+  guint tagid = 0;
+  gchar ntag[512] = { 0 };
+  g_snprintf(ntag, sizeof(ntag), "darktable|style|%s", name);
+  const gboolean have_tag = dt_tag_new(ntag, &tagid);
 
-void dt_styles_apply_to_image(const char *name, gboolean duplicate, int32_t imgid)
-{
-  int id = 0;
-  sqlite3_stmt *stmt;
-  int32_t newimgid;
+  sqlite3_stmt *trim_stmt, *offs_stmt, *insert_stmt, *end_stmt, *tag_stmt;
+  /* merge onto history stack, first trim the stack to get rid of whatever is above the selected entry */
+  DT_DEBUG_SQLITE3_PREPARE_V2(
+      dt_database_get(darktable.db),
+      "DELETE FROM history WHERE imgid = ?1 AND num >= (SELECT history_end FROM images WHERE id = imgid)", -1,
+      &trim_stmt, NULL);
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT IFNULL(MAX(num), -1) FROM history WHERE imgid = ?1", -1, &offs_stmt, NULL);
+  /* copy the style items into the history */
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "INSERT INTO history "
+                              "(imgid,num,module,operation,op_params,enabled,blendop_params,blendop_"
+                              "version,multi_priority,multi_name) SELECT "
+                              "?1,?2+rowid,module,operation,op_params,enabled,blendop_params,blendop_"
+                              "version,multi_priority,multi_name FROM MEMORY.style_items",
+                              -1, &insert_stmt, NULL);
+  /* always make the whole stack active */
+  DT_DEBUG_SQLITE3_PREPARE_V2(
+      dt_database_get(darktable.db),
+      "UPDATE images SET history_end = (SELECT MAX(num) + 1 FROM history WHERE imgid = ?1) WHERE id = ?1", -1,
+      &end_stmt, NULL);
+  /* add tag, the same as dt_tag_attach() */
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "INSERT OR REPLACE INTO tagged_images (imgid, tagid) VALUES (?1, ?2)", -1,
+                              &tag_stmt, NULL);
 
-  if((id = dt_styles_get_id_by_name(name)) != 0)
+  for(GList *iter = newimgs; iter && ok; iter = g_list_next(iter))
   {
-    /* check if we should make a duplicate before applying style */
-    if(duplicate)
-    {
-      newimgid = dt_image_duplicate(imgid);
-      if(newimgid != -1) dt_history_copy_and_paste_on_image(imgid, newimgid, FALSE, NULL);
-    }
-    else
-      newimgid = imgid;
+    const int32_t newimgid = GPOINTER_TO_INT(iter->data);
 
-    /* merge onto history stack, let's find history offest in destination image */
-    /* first trim the stack to get rid of whatever is above the selected entry */
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                                "DELETE FROM history WHERE imgid = ?1 AND num >= (SELECT history_end FROM images WHERE id = imgid)", -1, &stmt, NULL);
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, newimgid);
-    sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    DT_DEBUG_SQLITE3_BIND_INT(trim_stmt, 1, newimgid);
+    ok &= (sqlite3_step(trim_stmt) == SQLITE_DONE);
+    sqlite3_reset(trim_stmt);
 
     /* in sqlite ROWID starts at 1, while our num column starts at 0 */
     int32_t offs = -1;
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                                "SELECT IFNULL(MAX(num), -1) FROM history WHERE imgid = ?1", -1, &stmt, NULL);
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, newimgid);
-    if(sqlite3_step(stmt) == SQLITE_ROW) offs = sqlite3_column_int(stmt, 0);
-    sqlite3_finalize(stmt);
+    DT_DEBUG_SQLITE3_BIND_INT(offs_stmt, 1, newimgid);
+    if(sqlite3_step(offs_stmt) == SQLITE_ROW) offs = sqlite3_column_int(offs_stmt, 0);
+    sqlite3_reset(offs_stmt);
 
-    /* delete all items from the temp styles_items, this table is used only to get a ROWNUM of the results */
-    DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "DELETE FROM memory.style_items", NULL, NULL, NULL);
+    DT_DEBUG_SQLITE3_BIND_INT(insert_stmt, 1, newimgid);
+    DT_DEBUG_SQLITE3_BIND_INT(insert_stmt, 2, offs);
+    ok &= (sqlite3_step(insert_stmt) == SQLITE_DONE);
+    sqlite3_reset(insert_stmt);
 
-    /* copy history items from styles onto temp table */
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "INSERT INTO MEMORY.style_items SELECT * FROM "
-                                                               "style_items WHERE styleid=?1 ORDER BY "
-                                                               "multi_priority DESC;",
-                                -1, &stmt, NULL);
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, id);
-    sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    DT_DEBUG_SQLITE3_BIND_INT(end_stmt, 1, newimgid);
+    ok &= (sqlite3_step(end_stmt) == SQLITE_DONE);
+    sqlite3_reset(end_stmt);
 
-    /* copy the style items into the history */
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                                "INSERT INTO history "
-                                "(imgid,num,module,operation,op_params,enabled,blendop_params,blendop_"
-                                "version,multi_priority,multi_name) SELECT "
-                                "?1,?2+rowid,module,operation,op_params,enabled,blendop_params,blendop_"
-                                "version,multi_priority,multi_name FROM MEMORY.style_items",
-                                -1, &stmt, NULL);
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, newimgid);
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, offs);
-    sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    if(have_tag)
+    {
+      DT_DEBUG_SQLITE3_BIND_INT(tag_stmt, 1, newimgid);
+      DT_DEBUG_SQLITE3_BIND_INT(tag_stmt, 2, tagid);
+      ok &= (sqlite3_step(tag_stmt) == SQLITE_DONE);
+      sqlite3_reset(tag_stmt);
+    }
+  }
 
-    /* always make the whole stack active */
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                                "UPDATE images SET history_end = (SELECT MAX(num) + 1 FROM history WHERE imgid = ?1) WHERE id = ?1",
-                                -1, &stmt, NULL);
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, newimgid);
-    sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+  sqlite3_finalize(trim_stmt);
+  sqlite3_finalize(offs_stmt);
+  sqlite3_finalize(insert_stmt);
+  sqlite3_finalize(end_stmt);
+  sqlite3_finalize(tag_stmt);
 
-    /* add tag */
-    guint tagid = 0;
-    gchar ntag[512] = { 0 };
-    g_snprintf(ntag, sizeof(ntag), "darktable|style|%s", name);
-    if(dt_tag_new(ntag, &tagid)) dt_tag_attach(tagid, newimgid);
+  /* all or nothing, the style isn't applied to any of the images if one of them fails */
+  if(!dt_database_release_transaction(darktable.db, !ok))
+  {
+    dt_control_log(_("couldn't apply style '%s'"), name);
+    g_list_free(newimgs);
+    if(duplicate) dt_control_signal_raise(darktable.signals, DT_SIGNAL_COLLECTION_CHANGED);
+    return;
+  }
+
+  for(GList *iter = newimgs; iter; iter = g_list_next(iter))
+  {
+    const int32_t newimgid = GPOINTER_TO_INT(iter->data);
 
     /* if current image in develop reload history */
     if(dt_dev_is_current_image(darktable.develop, newimgid))
@@ -587,18 +596,70 @@ void dt_styles_apply_to_image(const char *name, gboolean duplicate, int32_t imgi
       dt_dev_modulegroups_set(darktable.develop, dt_dev_modulegroups_get(darktable.develop));
     }
 
-    /* update xmp file */
+    /* update xmp file, this is queued and written in one go for all images */
     dt_image_synch_xmp(newimgid);
 
     /* remove old obsolete thumbnails */
     dt_mipmap_cache_remove(darktable.mipmap_cache, newimgid);
+  }
+  g_list_free(newimgs);
 
-    /* if we have created a duplicate, reset collected images */
-    if(duplicate) dt_control_signal_raise(darktable.signals, DT_SIGNAL_COLLECTION_CHANGED);
+  /* if we have created a duplicate, reset collected images */
+  if(duplicate) dt_control_signal_raise(darktable.signals, DT_SIGNAL_COLLECTION_CHANGED);
+
+  /* redraw center view to update visible mipmaps */
+  dt_control_queue_redraw_center();
+}
 
-    /* redraw center view to update visible mipmaps */
-    dt_control_queue_redraw_center();
+void dt_styles_apply_to_selection(const char *name, gboolean duplicate)
+{
+  /* write current history changes so nothing gets lost, do that only in the darkroom as there is nothing to
+     be
+     save when in the lighttable (and it would write over current history stack) */
+  const dt_view_t *cv = dt_view_manager_get_current_view(darktable.view_manager);
+  if(cv->view((dt_view_t *)cv) == DT_VIEW_DARKROOM) dt_dev_write_history(darktable.develop);
+
+  /* apply style to all selected images at once */
+  GList *imgs = NULL;
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "select * from selected_images", -1, &stmt, NULL);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+    imgs = g_list_prepend(imgs, GINT_TO_POINTER(sqlite3_column_int(stmt, 0)));
+  sqlite3_finalize(stmt);
+
+  if(!imgs)
+  {
+    dt_control_log(_("no image selected!"));
+    return;
+  }
+
+  imgs = g_list_reverse(imgs);
+  _styles_apply_to_images(name, duplicate, imgs);
+  g_list_free(imgs);
+}
+
+void dt_styles_create_from_selection()
+{
+  gboolean selected = FALSE;
+  /* for each selected create style */
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "select * from selected_images", -1, &stmt, NULL);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    int imgid = sqlite3_column_int(stmt, 0);
+    dt_gui_styles_dialog_new(imgid);
+    selected = TRUE;
   }
+  sqlite3_finalize(stmt);
+
+  if(!selected) dt_control_log(_("no image selected!"));
+}
+
+void dt_styles_apply_to_image(const char *name, gboolean duplicate, int32_t imgid)
+{
+  GList *imgs = g_list_append(NULL, GINT_TO_POINTER(imgid));
+  _styles_apply_to_images(name, duplicate, imgs);
+  g_list_free(imgs);
 }
 
 void dt_styles_delete_by_name(const char *name)
@@ -279,20 +279,20 @@ uint32_t dt_tag_get_attached(gint imgid, GList **result, gboolean ignore_dt_tags
                                    "JOIN tags T on T.id = tagged_images.tagid "
                                    "WHERE tagged_images.imgid = %d %s ORDER BY T.name",
              imgid, ignore_dt_tags ? "AND NOT T.name LIKE \"darktable|%\"" : "");
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get_reader(darktable.db), query, -1, &stmt, NULL);
   }
   else
   {
     if(ignore_dt_tags)
       DT_DEBUG_SQLITE3_PREPARE_V2(
-          dt_database_get(darktable.db),
+          dt_database_get_reader(darktable.db),
           "SELECT DISTINCT T.id, T.name "
           "FROM tagged_images,tags as T "
           "WHERE tagged_images.imgid in (select imgid from selected_images)"
           "  AND T.id = tagged_images.tagid AND NOT T.name LIKE \"darktable|%\" ORDER BY T.name",
           -1, &stmt, NULL);
     else
-      DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+      DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get_reader(darktable.db),
                                   "SELECT DISTINCT T.id, T.name "
                                   "FROM tagged_images,tags as T "
                                   "WHERE tagged_images.imgid in (select imgid from selected_images)"
@@ -0,0 +1,516 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/thumbnail_store.h"
+
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/statvfs.h>
+
+#define DT_THUMBNAIL_STORE_MAGIC 0xD7B1095
+#define DT_THUMBNAIL_STORE_INDEX_MAGIC 0xD7B1096
+#define DT_THUMBNAIL_STORE_VERSION 1
+#define DT_THUMBNAIL_RECORD_MAGIC 0xD7B10B
+
+// append pending writes once they reach this size
+#define DT_THUMBNAIL_STORE_FLUSH_SIZE (4 << 20)
+// don't bother rewriting the data file for less garbage than this
+#define DT_THUMBNAIL_STORE_COMPACT_SIZE (16 << 20)
+// stop writing if the disk gets this full (in MB)
+#define DT_THUMBNAIL_STORE_MIN_FREE_MB 100
+
+// first bytes of the data file
+typedef struct dt_thumbnail_store_header_t
+{
+  uint32_t magic;
+  uint32_t version;
+  uint64_t generation;
+} dt_thumbnail_store_header_t;
+
+// precedes every blob in the data file, length 0 marks a removal
+typedef struct dt_thumbnail_record_t
+{
+  uint32_t magic;
+  uint32_t imgid;
+  uint32_t length;
+} dt_thumbnail_record_t;
+
+// first bytes of the index file, followed by count dt_thumbnail_index_entry_t
+typedef struct dt_thumbnail_index_header_t
+{
+  uint32_t magic;
+  uint32_t version;
+  uint64_t generation;
+  uint64_t size; // the data file size the index is valid for
+  uint64_t garbage;
+  uint64_t count;
+} dt_thumbnail_index_header_t;
+
+typedef struct dt_thumbnail_index_entry_t
+{
+  uint32_t imgid;
+  uint32_t length;
+  uint64_t offset;
+} dt_thumbnail_index_entry_t;
+
+// in memory table of contents
+typedef struct dt_thumbnail_store_entry_t
+{
+  uint64_t offset; // of the blob, not the record
+  uint32_t length;
+} dt_thumbnail_store_entry_t;
+
+static inline const uint8_t *_data(const dt_thumbnail_store_t *store, const uint64_t offset)
+{
+  if(offset >= store->size) return store->pending->data + (offset - store->size);
+  return (const uint8_t *)g_mapped_file_get_contents(store->map) + offset;
+}
+
+// update the table of contents for a record found at or appended to the data file
+static void _apply(dt_thumbnail_store_t *store, const uint32_t imgid, const uint64_t offset, const uint32_t length)
+{
+  const dt_thumbnail_store_entry_t *old
+      = (dt_thumbnail_store_entry_t *)g_hash_table_lookup(store->index, GUINT_TO_POINTER(imgid));
+  if(old) store->garbage += sizeof(dt_thumbnail_record_t) + old->length;
+  if(length)
+  {
+    dt_thumbnail_store_entry_t *e = (dt_thumbnail_store_entry_t *)malloc(sizeof(dt_thumbnail_store_entry_t));
+    e->offset = offset;
+    e->length = length;
+    g_hash_table_replace(store->index, GUINT_TO_POINTER(imgid), e);
+  }
+  else
+  {
+    g_hash_table_remove(store->index, GUINT_TO_POINTER(imgid));
+    store->garbage += sizeof(dt_thumbnail_record_t);
+  }
+}
+
+static int _map(dt_thumbnail_store_t *store)
+{
+  if(store->map) g_mapped_file_unref(store->map);
+  GError *error = NULL;
+  store->map = g_mapped_file_new(store->filename, FALSE, &error);
+  if(!store->map)
+  {
+    fprintf(stderr, "[thumbnail_store] could not map `%s': %s\n", store->filename, error->message);
+    g_error_free(error);
+    return 1;
+  }
+  store->size = g_mapped_file_get_length(store->map);
+  return 0;
+}
+
+static int _truncate(const char *filename, const uint64_t size)
+{
+  FILE *f = g_fopen(filename, "r+b");
+  if(!f) return 1;
+  const int err = ftruncate(fileno(f), size);
+  fclose(f);
+  return err;
+}
+
+// walk the records from offset to the end of the mapping. returns where the last complete record ends.
+static uint64_t _replay(dt_thumbnail_store_t *store, uint64_t offset)
+{
+  const uint8_t *data = (const uint8_t *)g_mapped_file_get_contents(store->map);
+  while(offset + sizeof(dt_thumbnail_record_t) <= store->size)
+  {
+    dt_thumbnail_record_t r;
+    memcpy(&r, data + offset, sizeof(r));
+    if(r.magic != DT_THUMBNAIL_RECORD_MAGIC || offset + sizeof(r) + r.length > store->size) break;
+    _apply(store, r.imgid, offset + sizeof(r), r.length);
+    offset += sizeof(r) + r.length;
+  }
+  return offset;
+}
+
+// returns the data file size the saved index is valid for, or 0 if it can't be used
+static uint64_t _load_index(dt_thumbnail_store_t *store)
+{
+  FILE *f = g_fopen(store->idx_filename, "rb");
+  if(!f) return 0;
+  uint64_t size = 0;
+  dt_thumbnail_index_header_t h;
+  if(fread(&h, sizeof(h), 1, f) != 1 || h.magic != DT_THUMBNAIL_STORE_INDEX_MAGIC
+     || h.version != DT_THUMBNAIL_STORE_VERSION || h.generation != store->generation || h.size > store->size
+     || h.size < sizeof(dt_thumbnail_store_header_t))
+    goto out;
+  for(uint64_t k = 0; k < h.count; k++)
+  {
+    dt_thumbnail_index_entry_t ie;
+    if(fread(&ie, sizeof(ie), 1, f) != 1 || !ie.length || ie.offset + ie.length > h.size)
+    {
+      g_hash_table_remove_all(store->index);
+      goto out;
+    }
+    _apply(store, ie.imgid, ie.offset, ie.length);
+  }
+  store->garbage = h.garbage;
+  size = h.size;
+out:
+  fclose(f);
+  return size;
+}
+
+static void _save_index(dt_thumbnail_store_t *store)
+{
+  gchar *tmp = g_strconcat(store->idx_filename, ".tmp", NULL);
+  FILE *f = g_fopen(tmp, "wb");
+  if(!f)
+  {
+    g_free(tmp);
+    return;
+  }
+  dt_thumbnail_index_header_t h = { DT_THUMBNAIL_STORE_INDEX_MAGIC, DT_THUMBNAIL_STORE_VERSION,
+                                    store->generation, store->size, store->garbage,
+                                    g_hash_table_size(store->index) };
+  int err = fwrite(&h, sizeof(h), 1, f) != 1;
+  GHashTableIter iter;
+  gpointer key, value;
+  g_hash_table_iter_init(&iter, store->index);
+  while(!err && g_hash_table_iter_next(&iter, &key, &value))
+  {
+    const dt_thumbnail_store_entry_t *e = (dt_thumbnail_store_entry_t *)value;
+    dt_thumbnail_index_entry_t ie = { GPOINTER_TO_UINT(key), e->length, e->offset };
+    err = fwrite(&ie, sizeof(ie), 1, f) != 1;
+  }
+  err |= fclose(f);
+#ifdef _WIN32
+  if(!err) g_unlink(store->idx_filename);
+#endif
+  if(err || g_rename(tmp, store->idx_filename))
+  {
+    fprintf(stderr, "[thumbnail_store] could not write index `%s'\n", store->idx_filename);
+    g_unlink(tmp);
+  }
+  g_free(tmp);
+}
+
+static int _write_header(FILE *f, const uint64_t generation)
+{
+  dt_thumbnail_store_header_t h = { DT_THUMBNAIL_STORE_MAGIC, DT_THUMBNAIL_STORE_VERSION, generation };
+  return fwrite(&h, sizeof(h), 1, f) != 1;
+}
+
+// forget everything that was written after the data file, except removals if keep_removals is set.
+// records which were superseded while pending never reach the data file, so they are no garbage either.
+static void _drop_pending(dt_thumbnail_store_t *store, const gboolean keep_removals)
+{
+  GByteArray *kept = g_byte_array_new();
+  uint64_t offset = 0, dropped = 0;
+  while(offset < store->pending->len)
+  {
+    dt_thumbnail_record_t r;
+    memcpy(&r, store->pending->data + offset, sizeof(r));
+    if(r.length)
+    {
+      const dt_thumbnail_store_entry_t *e
+          = (dt_thumbnail_store_entry_t *)g_hash_table_lookup(store->index, GUINT_TO_POINTER(r.imgid));
+      if(e && e->offset == store->size + offset + sizeof(r))
+        g_hash_table_remove(store->index, GUINT_TO_POINTER(r.imgid));
+      else
+        dropped += sizeof(r) + r.length;
+    }
+    else if(keep_removals)
+      g_byte_array_append(kept, (const guint8 *)&r, sizeof(r));
+    else
+      dropped += sizeof(r);
+    offset += sizeof(r) + r.length;
+  }
+  store->garbage -= MIN(store->garbage, dropped);
+  g_byte_array_unref(store->pending);
+  store->pending = kept;
+}
+
+static int _disk_full(const dt_thumbnail_store_t *store)
+{
+  struct statvfs vfsbuf;
+  if(statvfs(store->filename, &vfsbuf))
+  {
+    fprintf(stderr, "[thumbnail_store] couldn't determine free space available to write %s\n", store->filename);
+    return 1;
+  }
+  const int64_t free_mb = ((vfsbuf.f_frsize * vfsbuf.f_bavail) >> 20);
+  if(free_mb < DT_THUMBNAIL_STORE_MIN_FREE_MB)
+  {
+    fprintf(stderr, "[thumbnail_store] only %" PRId64 " MB free, not writing thumbnails to %s\n", free_mb,
+            store->filename);
+    return 1;
+  }
+  return 0;
+}
+
+// expects the write lock to be held
+static void _flush(dt_thumbnail_store_t *store)
+{
+  if(!store->pending->len) return;
+  if(!store->f)
+  {
+    _drop_pending(store, FALSE);
+    return;
+  }
+
+  // removals are small and must not get lost, or stale thumbnails would come back:
+  if(_disk_full(store)) _drop_pending(store, TRUE);
+  if(!store->pending->len) return;
+
+  const uint64_t size = store->size;
+  const size_t len = store->pending->len;
+  if(fwrite(store->pending->data, 1, len, store->f) != len || fflush(store->f))
+  {
+    fprintf(stderr, "[thumbnail_store] failed to append to `%s'\n", store->filename);
+    _drop_pending(store, FALSE);
+    if(_truncate(store->filename, size))
+    {
+      // whatever made it to the data file stays there as garbage
+      if(_map(store))
+      {
+        g_hash_table_remove_all(store->index);
+        store->size = size;
+        store->garbage = store->size;
+      }
+      else
+        store->garbage += store->size - size;
+      _save_index(store);
+    }
+    return;
+  }
+  g_byte_array_set_size(store->pending, 0);
+  if(_map(store) || store->size != size + len)
+  {
+    // can't serve anything from the data file any more, all of it is garbage
+    g_hash_table_remove_all(store->index);
+    store->size = size + len;
+    store->garbage = store->size;
+  }
+  // so a crash doesn't cost replaying the whole data file
+  _save_index(store);
+}
+
+// expects the write lock to be held
+static void _compact(dt_thumbnail_store_t *store)
+{
+  _flush(store);
+  if(!store->map) return;
+
+  gchar *tmp = g_strconcat(store->filename, ".tmp", NULL);
+  FILE *f = g_fopen(tmp, "wb");
+  if(!f)
+  {
+    g_free(tmp);
+    return;
+  }
+  const uint64_t generation = store->generation + 1;
+  int err = _write_header(f, generation);
+
+  // new offsets are only applied once the new file is in place
+  const guint count = g_hash_table_size(store->index);
+  uint64_t *offsets = (uint64_t *)malloc(sizeof(uint64_t) * MAX(count, 1));
+  uint64_t offset = sizeof(dt_thumbnail_store_header_t);
+  guint k = 0;
+  GHashTableIter iter;
+  gpointer key, value;
+  g_hash_table_iter_init(&iter, store->index);
+  while(!err && g_hash_table_iter_next(&iter, &key, &value))
+  {
+    const dt_thumbnail_store_entry_t *e = (dt_thumbnail_store_entry_t *)value;
+    dt_thumbnail_record_t r = { DT_THUMBNAIL_RECORD_MAGIC, GPOINTER_TO_UINT(key), e->length };
+    err = fwrite(&r, sizeof(r), 1, f) != 1 || fwrite(_data(store, e->offset), 1, e->length, f) != e->length;
+    offsets[k++] = offset + sizeof(r);
+    offset += sizeof(r) + e->length;
+  }
+  err |= fclose(f);
+
+  if(!err)
+  {
+    fclose(store->f);
+    g_mapped_file_unref(store->map);
+    store->map = NULL;
+#ifdef _WIN32
+    g_unlink(store->filename);
+#endif
+    err = g_rename(tmp, store->filename);
+    if(!err)
+    {
+      k = 0;
+      g_hash_table_iter_init(&iter, store->index);
+      while(g_hash_table_iter_next(&iter, &key, &value))
+        ((dt_thumbnail_store_entry_t *)value)->offset = offsets[k++];
+      store->generation = generation;
+      store->garbage = 0;
+    }
+    if(_map(store) || (!err && store->size != offset)) g_hash_table_remove_all(store->index);
+    store->f = g_fopen(store->filename, "ab");
+  }
+  if(err)
+  {
+    fprintf(stderr, "[thumbnail_store] failed to compact `%s'\n", store->filename);
+    g_unlink(tmp);
+  }
+  free(offsets);
+  g_free(tmp);
+}
+
+static void _free(dt_thumbnail_store_t *store)
+{
+  if(store->f) fclose(store->f);
+  if(store->map) g_mapped_file_unref(store->map);
+  g_hash_table_destroy(store->index);
+  g_byte_array_unref(store->pending);
+  dt_pthread_rwlock_destroy(&store->lock);
+  g_free(store->filename);
+  g_free(store->idx_filename);
+  free(store);
+}
+
+dt_thumbnail_store_t *dt_thumbnail_store_open(const char *base)
+{
+  dt_thumbnail_store_t *store = (dt_thumbnail_store_t *)calloc(1, sizeof(dt_thumbnail_store_t));
+  dt_pthread_rwlock_init(&store->lock, NULL);
+  store->filename = g_strconcat(base, ".pack", NULL);
+  store->idx_filename = g_strconcat(base, ".idx", NULL);
+  store->index = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, free);
+  store->pending = g_byte_array_new();
+
+  dt_thumbnail_store_header_t h = { 0 };
+  FILE *f = g_fopen(store->filename, "rb");
+  const int valid = f && fread(&h, sizeof(h), 1, f) == 1 && h.magic == DT_THUMBNAIL_STORE_MAGIC
+                    && h.version == DT_THUMBNAIL_STORE_VERSION;
+  if(f) fclose(f);
+  if(valid)
+    store->generation = h.generation;
+  else
+  {
+    // start from scratch
+    store->generation = g_get_real_time();
+    f = g_fopen(store->filename, "wb");
+    if(!f) goto error;
+    const int err = _write_header(f, store->generation);
+    if(fclose(f) || err) goto error;
+  }
+  if(_map(store)) goto error;
+
+  // the saved index covers everything up to its size, the rest is replayed from the records:
+  uint64_t offset = _load_index(store);
+  if(!offset)
+  {
+    g_hash_table_remove_all(store->index);
+    store->garbage = 0;
+    offset = sizeof(dt_thumbnail_store_header_t);
+  }
+  const uint64_t end = _replay(store, offset);
+  if(end < store->size)
+  {
+    // most likely we crashed while appending last time
+    fprintf(stderr, "[thumbnail_store] dropping %" PRIu64 " broken bytes at the end of `%s'\n",
+            store->size - end, store->filename);
+    g_mapped_file_unref(store->map);
+    store->map = NULL;
+    if(_truncate(store->filename, end) || _map(store)) goto error;
+  }
+
+  store->f = g_fopen(store->filename, "ab");
+  if(!store->f) goto error;
+  return store;
+
+error:
+  fprintf(stderr, "[thumbnail_store] could not open `%s'\n", store->filename);
+  _free(store);
+  return NULL;
+}
+
+void dt_thumbnail_store_close(dt_thumbnail_store_t *store)
+{
+  if(!store) return;
+  dt_pthread_rwlock_wrlock(&store->lock);
+  _flush(store);
+  if(store->garbage > DT_THUMBNAIL_STORE_COMPACT_SIZE && 2 * store->garbage > store->size) _compact(store);
+  _save_index(store);
+  dt_pthread_rwlock_unlock(&store->lock);
+  _free(store);
+}
+
+gboolean dt_thumbnail_store_contains(dt_thumbnail_store_t *store, const uint32_t imgid)
+{
+  dt_pthread_rwlock_rdlock(&store->lock);
+  const gboolean found = g_hash_table_contains(store->index, GUINT_TO_POINTER(imgid));
+  dt_pthread_rwlock_unlock(&store->lock);
+  return found;
+}
+
+int dt_thumbnail_store_read(dt_thumbnail_store_t *store, const uint32_t imgid,
+                            int (*read)(const uint8_t *blob, size_t length, void *data), void *data)
+{
+  int res = -1;
+  // hold the lock while read() runs, nobody may remap or grow the pending buffer underneath:
+  dt_pthread_rwlock_rdlock(&store->lock);
+  const dt_thumbnail_store_entry_t *e
+      = (dt_thumbnail_store_entry_t *)g_hash_table_lookup(store->index, GUINT_TO_POINTER(imgid));
+  if(e) res = read(_data(store, e->offset), e->length, data);
+  dt_pthread_rwlock_unlock(&store->lock);
+  return res;
+}
+
+int dt_thumbnail_store_write(dt_thumbnail_store_t *store, const uint32_t imgid, const uint8_t *blob,
+                             const size_t length)
+{
+  if(!length || length > UINT32_MAX) return 1;
+  dt_thumbnail_record_t r = { DT_THUMBNAIL_RECORD_MAGIC, imgid, length };
+  dt_pthread_rwlock_wrlock(&store->lock);
+  const uint64_t offset = store->size + store->pending->len + sizeof(r);
+  g_byte_array_append(store->pending, (const guint8 *)&r, sizeof(r));
+  g_byte_array_append(store->pending, blob, length);
+  _apply(store, imgid, offset, length);
+  if(store->pending->len >= DT_THUMBNAIL_STORE_FLUSH_SIZE) _flush(store);
+  dt_pthread_rwlock_unlock(&store->lock);
+  return 0;
+}
+
+void dt_thumbnail_store_remove(dt_thumbnail_store_t *store, const uint32_t imgid)
+{
+  dt_pthread_rwlock_wrlock(&store->lock);
+  if(g_hash_table_contains(store->index, GUINT_TO_POINTER(imgid)))
+  {
+    dt_thumbnail_record_t r = { DT_THUMBNAIL_RECORD_MAGIC, imgid, 0 };
+    g_byte_array_append(store->pending, (const guint8 *)&r, sizeof(r));
+    _apply(store, imgid, 0, 0);
+    if(store->pending->len >= DT_THUMBNAIL_STORE_FLUSH_SIZE) _flush(store);
+  }
+  dt_pthread_rwlock_unlock(&store->lock);
+}
+
+void dt_thumbnail_store_flush(dt_thumbnail_store_t *store)
+{
+  dt_pthread_rwlock_wrlock(&store->lock);
+  _flush(store);
+  dt_pthread_rwlock_unlock(&store->lock);
+}
+
+void dt_thumbnail_store_compact(dt_thumbnail_store_t *store)
+{
+  dt_pthread_rwlock_wrlock(&store->lock);
+  _compact(store);
+  dt_pthread_rwlock_unlock(&store->lock);
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
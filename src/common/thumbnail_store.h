@@ -0,0 +1,79 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef DT_THUMBNAIL_STORE_H
+#define DT_THUMBNAIL_STORE_H
+
+#include "common/dtpthread.h"
+
+#include <glib.h>
+#include <inttypes.h>
+#include <stdio.h>
+
+/**
+ * packed on-disk store for the compressed thumbnails of one mipmap level.
+ *
+ * all blobs live in one append-only data file <base>.pack, a record being a small
+ * header followed by the blob. removing an image appends an empty record. the data
+ * file is memory mapped, so reads hand out pointers into the mapping without copying.
+ * writes are collected in memory and appended in batches. the table of contents
+ * is kept in memory and saved to <base>.idx after every batch and on close; if that
+ * is missing or stale, the records after the last saved state are replayed from the
+ * data file.
+ * superseded records are garbage which gets dropped by rewriting the data file
+ * once it makes up more than half of it.
+ */
+typedef struct dt_thumbnail_store_t
+{
+  dt_pthread_rwlock_t lock;
+  gchar *filename;     // <base>.pack
+  gchar *idx_filename; // <base>.idx
+  uint64_t generation; // changes whenever the data file is rewritten
+  FILE *f;             // data file, opened for appending
+  GMappedFile *map;    // read-only mapping of the flushed part of the data file
+  uint64_t size;       // flushed bytes in the data file
+  uint64_t garbage;    // bytes in superseded records
+  GByteArray *pending; // records not yet written, logically following the flushed ones
+  GHashTable *index;   // imgid -> dt_thumbnail_store_entry_t
+} dt_thumbnail_store_t;
+
+/** open or create the store at base, returns NULL if it can't be used. */
+dt_thumbnail_store_t *dt_thumbnail_store_open(const char *base);
+/** flush pending writes, compact if worth it, save the index and free everything. */
+void dt_thumbnail_store_close(dt_thumbnail_store_t *store);
+
+/** true if a blob for imgid is stored. */
+gboolean dt_thumbnail_store_contains(dt_thumbnail_store_t *store, const uint32_t imgid);
+/** calls read() with the blob for imgid, which is only valid until read() returns.
+ *  returns -1 if there's no such blob, the return value of read() otherwise. */
+int dt_thumbnail_store_read(dt_thumbnail_store_t *store, const uint32_t imgid,
+                            int (*read)(const uint8_t *blob, size_t length, void *data), void *data);
+/** store a copy of the blob for imgid, replacing any previous one. */
+int dt_thumbnail_store_write(dt_thumbnail_store_t *store, const uint32_t imgid, const uint8_t *blob,
+                             const size_t length);
+/** forget the blob for imgid. */
+void dt_thumbnail_store_remove(dt_thumbnail_store_t *store, const uint32_t imgid);
+/** append all pending writes to the data file. */
+void dt_thumbnail_store_flush(dt_thumbnail_store_t *store);
+/** rewrite the data file without garbage. */
+void dt_thumbnail_store_compact(dt_thumbnail_store_t *store);
+
+#endif
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
@@ -181,15 +181,18 @@ typedef struct dt_control_t
   uint8_t *xprofile_data;
   int xprofile_size;
 
-  // job management
+  // job management. res_mutex only guards the reserved jobs, the queued ones are in the deques.
   int32_t running;
-  dt_pthread_mutex_t queue_mutex, cond_mutex, run_mutex;
+  dt_pthread_mutex_t res_mutex, cond_mutex, run_mutex;
   pthread_cond_t cond;
   int32_t num_threads;
   pthread_t *thread, kick_on_workers_thread;
 
-  GList *queues[DT_JOB_QUEUE_MAX];
-  size_t queue_length[DT_JOB_QUEUE_MAX];
+  struct dt_control_job_deque_t *deques; // one per worker thread, see jobs.c
+  // queued jobs overall, in DT_JOB_QUEUE_SYSTEM_FG and in DT_JOB_QUEUE_SYSTEM_PREFETCH
+  int32_t jobs_pending, fg_jobs, prefetch_jobs;
+  uint32_t next_deque;
+  uint64_t job_seq;
 
   dt_job_t *job_res[DT_CTL_WORKER_RESERVED];
   uint8_t new_res[DT_CTL_WORKER_RESERVED];
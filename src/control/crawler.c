@@ -53,129 +53,182 @@ typedef struct dt_control_crawler_result_t
 
 GList *dt_control_crawler_run()
 {
-  sqlite3_stmt *stmt, *inner_stmt;
+  sqlite3_stmt *film_stmt, *index_stmt, *stmt, *inner_stmt;
   GList *result = NULL;
   gboolean look_for_xmp = dt_conf_get_bool("write_sidecar_files");
+  // only look at film rolls whose directory changed since the last run. adding, removing or replacing
+  // a file changes the modification time of its directory, editing a file in place doesn't.
+  const gboolean incremental = dt_conf_get_bool("crawler_incremental");
+  int skipped = 0, found = 0;
 
+  sqlite3_prepare_v2(dt_database_get(darktable.db),
+                     "SELECT id, folder, crawler_mtime, crawler_inode FROM film_rolls ORDER BY id", -1, &film_stmt,
+                     NULL);
+  sqlite3_prepare_v2(dt_database_get(darktable.db),
+                     "UPDATE film_rolls SET crawler_mtime = ?1, crawler_inode = ?2 WHERE id = ?3", -1,
+                     &index_stmt, NULL);
   sqlite3_prepare_v2(dt_database_get(darktable.db),
                      "SELECT images.id, write_timestamp, version, folder || '/' || filename, flags "
-                     "FROM images, film_rolls WHERE images.film_id = film_rolls.id "
-                     "ORDER BY film_rolls.id, filename",
+                     "FROM images, film_rolls WHERE images.film_id = film_rolls.id AND film_rolls.id = ?1 "
+                     "ORDER BY filename",
                      -1, &stmt, NULL);
   sqlite3_prepare_v2(dt_database_get(darktable.db), "UPDATE images SET flags = ?1 WHERE id = ?2", -1,
                      &inner_stmt, NULL);
 
   // let's wrap this into a transaction, it might make it a little faster.
-  sqlite3_exec(dt_database_get(darktable.db), "BEGIN TRANSACTION", NULL, NULL, NULL);
+  dt_database_start_transaction(darktable.db);
 
-  while(sqlite3_step(stmt) == SQLITE_ROW)
+  while(sqlite3_step(film_stmt) == SQLITE_ROW)
   {
-    const int id = sqlite3_column_int(stmt, 0);
-    const time_t timestamp = sqlite3_column_int(stmt, 1);
-    const int version = sqlite3_column_int(stmt, 2);
-    gchar *image_path = (gchar *)sqlite3_column_text(stmt, 3);
-    int flags = sqlite3_column_int(stmt, 4);
-
-    // no need to look for xmp files if none get written anyway.
-    if(look_for_xmp)
+    const int film_id = sqlite3_column_int(film_stmt, 0);
+    const char *folder = (const char *)sqlite3_column_text(film_stmt, 1);
+
+    // taken before looking at the files, so changes while we are at it are found next time
+    struct stat dirbuf;
+    const gboolean exists = folder && stat(folder, &dirbuf) == 0;
+    // missing film rolls have nothing to report, but a full run still clears the flags of their txt and wav files
+    if(!exists && incremental) continue;
+    const gboolean indexed = sqlite3_column_type(film_stmt, 2) != SQLITE_NULL
+                             && sqlite3_column_type(film_stmt, 3) != SQLITE_NULL;
+    const gboolean unchanged = exists && indexed
+                               && (sqlite3_int64)dirbuf.st_mtime == sqlite3_column_int64(film_stmt, 2)
+                               && (sqlite3_int64)dirbuf.st_ino == sqlite3_column_int64(film_stmt, 3);
+    if(unchanged && incremental)
+    {
+      skipped++;
+      continue;
+    }
+    const int found_before = found;
+
+    sqlite3_bind_int(stmt, 1, film_id);
+    while(sqlite3_step(stmt) == SQLITE_ROW)
     {
-      // construct the xmp filename for this image
-      gchar xmp_path[PATH_MAX] = { 0 };
-      g_strlcpy(xmp_path, image_path, sizeof(xmp_path));
-      dt_image_path_append_version_no_db(version, xmp_path, sizeof(xmp_path));
-      size_t len = strlen(xmp_path);
-      if(len + 4 >= PATH_MAX) continue;
-      xmp_path[len++] = '.';
-      xmp_path[len++] = 'x';
-      xmp_path[len++] = 'm';
-      xmp_path[len++] = 'p';
-      xmp_path[len] = '\0';
-
-      struct stat statbuf;
-      if(stat(xmp_path, &statbuf) == -1) continue; // TODO: shall we report these?
-
-      // step 1: check if the xmp is newer than our db entry
-      // FIXME: allow for a few seconds difference?
-      if(timestamp < statbuf.st_mtime)
+      const int id = sqlite3_column_int(stmt, 0);
+      const time_t timestamp = sqlite3_column_int(stmt, 1);
+      const int version = sqlite3_column_int(stmt, 2);
+      gchar *image_path = (gchar *)sqlite3_column_text(stmt, 3);
+      int flags = sqlite3_column_int(stmt, 4);
+
+      // no need to look for xmp files if none get written anyway.
+      if(look_for_xmp)
       {
-        dt_control_crawler_result_t *item
-            = (dt_control_crawler_result_t *)malloc(sizeof(dt_control_crawler_result_t));
-        item->id = id;
-        item->timestamp_xmp = statbuf.st_mtime;
-        item->timestamp_db = timestamp;
-        item->image_path = g_strdup(image_path);
-        item->xmp_path = g_strdup(xmp_path);
-
-        result = g_list_append(result, item);
-        dt_print(DT_DEBUG_CONTROL, "[crawler] `%s' (id: %d) is a newer xmp file.\n", xmp_path, id);
+        // construct the xmp filename for this image
+        gchar xmp_path[PATH_MAX] = { 0 };
+        g_strlcpy(xmp_path, image_path, sizeof(xmp_path));
+        dt_image_path_append_version_no_db(version, xmp_path, sizeof(xmp_path));
+        size_t len = strlen(xmp_path);
+        if(len + 4 >= PATH_MAX) continue;
+        xmp_path[len++] = '.';
+        xmp_path[len++] = 'x';
+        xmp_path[len++] = 'm';
+        xmp_path[len++] = 'p';
+        xmp_path[len] = '\0';
+
+        struct stat statbuf;
+        if(stat(xmp_path, &statbuf) == -1) continue; // TODO: shall we report these?
+
+        // step 1: check if the xmp is newer than our db entry
+        // FIXME: allow for a few seconds difference?
+        if(timestamp < statbuf.st_mtime)
+        {
+          dt_control_crawler_result_t *item
+              = (dt_control_crawler_result_t *)malloc(sizeof(dt_control_crawler_result_t));
+          item->id = id;
+          item->timestamp_xmp = statbuf.st_mtime;
+          item->timestamp_db = timestamp;
+          item->image_path = g_strdup(image_path);
+          item->xmp_path = g_strdup(xmp_path);
+
+          result = g_list_append(result, item);
+          found++;
+          dt_print(DT_DEBUG_CONTROL, "[crawler] `%s' (id: %d) is a newer xmp file.\n", xmp_path, id);
+        }
+        // older timestamps are the case for all images after the db upgrade. better not report these
+        //       else if(timestamp > statbuf.st_mtime)
+        //         printf("`%s' (%d) has an older xmp file.\n", image_path, id);
       }
-      // older timestamps are the case for all images after the db upgrade. better not report these
-      //       else if(timestamp > statbuf.st_mtime)
-      //         printf("`%s' (%d) has an older xmp file.\n", image_path, id);
-    }
 
-    // step 2: check if the image has associated files (.txt, .wav)
-    size_t len = strlen(image_path);
-    char *c = image_path + len;
-    while((c > image_path) && (*c != '.')) *c-- = '\0';
-    len = c - image_path + 1;
+      // step 2: check if the image has associated files (.txt, .wav)
+      size_t len = strlen(image_path);
+      char *c = image_path + len;
+      while((c > image_path) && (*c != '.')) *c-- = '\0';
+      len = c - image_path + 1;
 
-    char *extra_path = g_strndup(image_path, len + 3);
+      char *extra_path = g_strndup(image_path, len + 3);
 
-    extra_path[len] = 't';
-    extra_path[len + 1] = 'x';
-    extra_path[len + 2] = 't';
-    gboolean has_txt = g_file_test(extra_path, G_FILE_TEST_EXISTS);
+      extra_path[len] = 't';
+      extra_path[len + 1] = 'x';
+      extra_path[len + 2] = 't';
+      gboolean has_txt = g_file_test(extra_path, G_FILE_TEST_EXISTS);
 
-    if(!has_txt)
-    {
-      extra_path[len] = 'T';
-      extra_path[len + 1] = 'X';
-      extra_path[len + 2] = 'T';
-      has_txt = g_file_test(extra_path, G_FILE_TEST_EXISTS);
-    }
+      if(!has_txt)
+      {
+        extra_path[len] = 'T';
+        extra_path[len + 1] = 'X';
+        extra_path[len + 2] = 'T';
+        has_txt = g_file_test(extra_path, G_FILE_TEST_EXISTS);
+      }
 
-    extra_path[len] = 'w';
-    extra_path[len + 1] = 'a';
-    extra_path[len + 2] = 'v';
-    gboolean has_wav = g_file_test(extra_path, G_FILE_TEST_EXISTS);
+      extra_path[len] = 'w';
+      extra_path[len + 1] = 'a';
+      extra_path[len + 2] = 'v';
+      gboolean has_wav = g_file_test(extra_path, G_FILE_TEST_EXISTS);
 
-    if(!has_wav)
-    {
-      extra_path[len] = 'W';
-      extra_path[len + 1] = 'A';
-      extra_path[len + 2] = 'V';
-      has_wav = g_file_test(extra_path, G_FILE_TEST_EXISTS);
+      if(!has_wav)
+      {
+        extra_path[len] = 'W';
+        extra_path[len + 1] = 'A';
+        extra_path[len + 2] = 'V';
+        has_wav = g_file_test(extra_path, G_FILE_TEST_EXISTS);
+      }
+
+      // TODO: decide if we want to remove the flag for images that lost their extra file. currently we do (the
+      // else cases)
+      int new_flags = flags;
+      if(has_txt)
+        new_flags |= DT_IMAGE_HAS_TXT;
+      else
+        new_flags &= ~DT_IMAGE_HAS_TXT;
+      if(has_wav)
+        new_flags |= DT_IMAGE_HAS_WAV;
+      else
+        new_flags &= ~DT_IMAGE_HAS_WAV;
+      if(flags != new_flags)
+      {
+        sqlite3_bind_int(inner_stmt, 1, new_flags);
+        sqlite3_bind_int(inner_stmt, 2, id);
+        sqlite3_step(inner_stmt);
+        sqlite3_reset(inner_stmt);
+        sqlite3_clear_bindings(inner_stmt);
+      }
+
+      g_free(extra_path);
     }
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
 
-    // TODO: decide if we want to remove the flag for images that lost their extra file. currently we do (the
-    // else cases)
-    int new_flags = flags;
-    if(has_txt)
-      new_flags |= DT_IMAGE_HAS_TXT;
-    else
-      new_flags &= ~DT_IMAGE_HAS_TXT;
-    if(has_wav)
-      new_flags |= DT_IMAGE_HAS_WAV;
-    else
-      new_flags &= ~DT_IMAGE_HAS_WAV;
-    if(flags != new_flags)
+    // only remember the directory once there is nothing left in it to deal with. if we reported newer xmp
+    // files and the user dismisses the dialog, the next incremental run has to find them again.
+    if(exists && !unchanged && found == found_before)
     {
-      sqlite3_bind_int(inner_stmt, 1, new_flags);
-      sqlite3_bind_int(inner_stmt, 2, id);
-      sqlite3_step(inner_stmt);
-      sqlite3_reset(inner_stmt);
-      sqlite3_clear_bindings(inner_stmt);
+      sqlite3_bind_int64(index_stmt, 1, dirbuf.st_mtime);
+      sqlite3_bind_int64(index_stmt, 2, dirbuf.st_ino);
+      sqlite3_bind_int(index_stmt, 3, film_id);
+      sqlite3_step(index_stmt);
+      sqlite3_reset(index_stmt);
+      sqlite3_clear_bindings(index_stmt);
     }
-
-    g_free(extra_path);
   }
 
-  sqlite3_exec(dt_database_get(darktable.db), "COMMIT", NULL, NULL, NULL);
+  dt_database_release_transaction(darktable.db, FALSE);
 
+  sqlite3_finalize(film_stmt);
+  sqlite3_finalize(index_stmt);
   sqlite3_finalize(stmt);
   sqlite3_finalize(inner_stmt);
 
+  if(skipped) dt_print(DT_DEBUG_CONTROL, "[crawler] skipped %d unchanged film rolls.\n", skipped);
+
   return result;
 }
 
@@ -20,10 +20,13 @@
 */
 
 #include "control/jobs.h"
+#ifndef DT_UNIT_TEST
 #include "control/control.h"
+#endif
 
 #define DT_CONTROL_FG_PRIORITY 4
 #define DT_CONTROL_MAX_JOBS 30
+#define DT_CONTROL_MAX_PREFETCH_JOBS 512
 
 /* the queue can have scheduled jobs but all
     the workers are sleeping, so this kicks the workers
@@ -51,8 +54,38 @@ typedef struct _dt_job_t
   dt_job_state_change_callback state_changed_cb;
 
   char description[DT_CONTROL_DESCRIPTION_LEN];
+
+  // links in the job deque of the worker the job is queued for
+  struct _dt_job_t *prev, *next;
+  int32_t deque; // -1 if not queued
+  uint64_t seq;  // for finding the oldest foreground job
 } _dt_job_t;
 
+/* every worker thread has its own deque with one list per queue, jobs added from a worker go
+   to its own deque and idle workers steal from the others. */
+typedef struct dt_control_job_deque_t
+{
+  dt_pthread_mutex_t mutex;
+  pthread_cond_t cond; // the worker sleeps on this one
+  int sleeping;
+  _dt_job_t *head[DT_JOB_QUEUE_MAX], *tail[DT_JOB_QUEUE_MAX]; // head is the next to run
+  size_t length[DT_JOB_QUEUE_MAX];
+  GHashTable *fg; // description -> GQueue of the queued jobs of the stacks with it, to find duplicates
+} dt_control_job_deque_t;
+
+/* DT_JOB_QUEUE_SYSTEM_FG and DT_JOB_QUEUE_SYSTEM_PREFETCH are stacks of limited size: the newest job runs
+   first, a job added again moves to the top and the oldest ones get dropped when there are too many. */
+static inline gboolean dt_control_queue_is_stack(const int q)
+{
+  return q == DT_JOB_QUEUE_SYSTEM_FG || q == DT_JOB_QUEUE_SYSTEM_PREFETCH;
+}
+
+// number of queued jobs of a stack
+static inline int32_t *dt_control_stack_count(dt_control_t *control, const int q)
+{
+  return q == DT_JOB_QUEUE_SYSTEM_PREFETCH ? &control->prefetch_jobs : &control->fg_jobs;
+}
+
 /** check if two jobs are to be considered equal. a simple memcmp won't work since the mutexes probably won't
    match
     we don't want to compare result, priority or state since these will change during the course of
@@ -64,7 +97,7 @@ typedef struct _dt_job_t
 static inline int dt_control_job_equal(_dt_job_t *j1, _dt_job_t *j2)
 {
   return (j1->execute == j2->execute && j1->state_changed_cb == j2->state_changed_cb && j1->queue == j2->queue
-          && g_strcmp0(j1->description, j2->description));
+          && !g_strcmp0(j1->description, j2->description));
 }
 
 static void dt_control_job_set_state(_dt_job_t *job, dt_job_state_t state)
@@ -110,6 +143,7 @@ dt_job_t *dt_control_job_create(dt_job_execute_callback execute, const char *msg
 
   job->execute = execute;
   job->state = DT_JOB_STATE_INITIALIZED;
+  job->deque = -1;
   dt_pthread_mutex_init(&job->state_mutex, NULL);
   dt_pthread_mutex_init(&job->wait_mutex, NULL);
   return job;
@@ -162,14 +196,14 @@ static int32_t dt_control_run_job_res(dt_control_t *control, int32_t res)
   if(((unsigned int)res) >= DT_CTL_WORKER_RESERVED) return -1;
 
   _dt_job_t *job = NULL;
-  dt_pthread_mutex_lock(&control->queue_mutex);
+  dt_pthread_mutex_lock(&control->res_mutex);
   if(control->new_res[res])
   {
     job = control->job_res[res];
     control->job_res[res] = NULL; // this job belongs to us now, the queue may not touch it any longer
   }
   control->new_res[res] = 0;
-  dt_pthread_mutex_unlock(&control->queue_mutex);
+  dt_pthread_mutex_unlock(&control->res_mutex);
   if(!job) return -1;
 
   /* change state to running */
@@ -195,7 +229,56 @@ static int32_t dt_control_run_job_res(dt_control_t *control, int32_t res)
   return 0;
 }
 
-static _dt_job_t *dt_control_schedule_job(dt_control_t *control)
+// the deque functions expect d->mutex to be held
+static void dt_control_deque_unlink(dt_control_job_deque_t *d, _dt_job_t *job)
+{
+  const int q = job->queue;
+  if(job->prev) job->prev->next = job->next;
+  else d->head[q] = job->next;
+  if(job->next) job->next->prev = job->prev;
+  else d->tail[q] = job->prev;
+  job->prev = job->next = NULL;
+  job->deque = -1;
+  d->length[q]--;
+  if(dt_control_queue_is_stack(q))
+  {
+    GQueue *same = (GQueue *)g_hash_table_lookup(d->fg, job->description);
+    if(same && g_queue_remove(same, job) && g_queue_is_empty(same))
+      g_hash_table_remove(d->fg, job->description);
+  }
+}
+
+static void dt_control_deque_push(dt_control_job_deque_t *d, const int index, _dt_job_t *job,
+                                  const gboolean front)
+{
+  const int q = job->queue;
+  if(front)
+  {
+    job->prev = NULL;
+    job->next = d->head[q];
+    if(d->head[q]) d->head[q]->prev = job;
+    else d->tail[q] = job;
+    d->head[q] = job;
+  }
+  else
+  {
+    job->next = NULL;
+    job->prev = d->tail[q];
+    if(d->tail[q]) d->tail[q]->next = job;
+    else d->head[q] = job;
+    d->tail[q] = job;
+  }
+  job->deque = index;
+  d->length[q]++;
+  if(dt_control_queue_is_stack(q))
+  {
+    GQueue *same = (GQueue *)g_hash_table_lookup(d->fg, job->description);
+    if(!same) g_hash_table_insert(d->fg, g_strdup(job->description), same = g_queue_new());
+    g_queue_push_tail(same, job);
+  }
+}
+
+static _dt_job_t *dt_control_deque_pick(dt_control_job_deque_t *d)
 {
   /*
    * job scheduling works like this:
@@ -208,54 +291,129 @@ static _dt_job_t *dt_control_schedule_job(dt_control_t *control)
    * - the jobs that didn't get picked this round get their priority incremented
    */
 
-  dt_pthread_mutex_lock(&control->queue_mutex);
-
   // find the job
   _dt_job_t *job = NULL;
   int winner_queue = DT_JOB_QUEUE_MAX;
   int max_priority = -1;
   for(int i = 0; i < DT_JOB_QUEUE_MAX; i++)
   {
-    if(control->queues[i] == NULL) continue;
-    _dt_job_t *_job = (_dt_job_t *)control->queues[i]->data;
-    if(_job->priority > max_priority)
+    if(d->head[i] == NULL) continue;
+    if(d->head[i]->priority > max_priority)
     {
-      max_priority = _job->priority;
-      job = _job;
+      max_priority = d->head[i]->priority;
+      job = d->head[i];
       winner_queue = i;
     }
   }
 
-  if(!job)
-  {
-    dt_pthread_mutex_unlock(&control->queue_mutex);
-    return NULL;
-  }
+  if(!job) return NULL;
 
-  // the order of the queues in control->queues matches our priority, and we only update job when the priority
+  // the order of the queues in d->head matches our priority, and we only update job when the priority
   // is strictly bigger
   // invariant -> job is the one we are looking for
 
   // remove the to be scheduled job from its queue
-  GList **queue = &control->queues[winner_queue];
-  *queue = g_list_delete_link(*queue, *queue);
-  control->queue_length[winner_queue]--;
+  dt_control_deque_unlink(d, job);
 
   // increment the priorities of the others
   for(int i = 0; i < DT_JOB_QUEUE_MAX; i++)
   {
-    if(i == winner_queue || control->queues[i] == NULL) continue;
-    ((_dt_job_t *)control->queues[i]->data)->priority++;
+    if(i == winner_queue || d->head[i] == NULL) continue;
+    d->head[i]->priority++;
   }
 
-  dt_pthread_mutex_unlock(&control->queue_mutex);
-
   return job;
 }
 
-static int32_t dt_control_run_job(dt_control_t *control)
+static _dt_job_t *dt_control_schedule_job(dt_control_t *control, const int worker)
 {
-  _dt_job_t *job = dt_control_schedule_job(control);
+  // our own deque first, then try to steal from the others. stealing uses the same rules as the owner
+  // would, so the priorities between the queues hold no matter which worker runs a job.
+  const int n = control->num_threads;
+  for(int k = 0; k < n; k++)
+  {
+    dt_control_job_deque_t *d = control->deques + (worker + k) % n;
+    dt_pthread_mutex_lock(&d->mutex);
+    _dt_job_t *job = dt_control_deque_pick(d);
+    dt_pthread_mutex_unlock(&d->mutex);
+    if(job)
+    {
+      __sync_fetch_and_sub(&control->jobs_pending, 1);
+      if(dt_control_queue_is_stack(job->queue))
+        __sync_fetch_and_sub(dt_control_stack_count(control, job->queue), 1);
+      return job;
+    }
+  }
+  return NULL;
+}
+
+// wake up one sleeping worker, preferably the one owning the deque we just added to
+static void dt_control_wake_worker(dt_control_t *control, const int preferred)
+{
+  const int n = control->num_threads;
+  for(int k = 0; k < n; k++)
+  {
+    dt_control_job_deque_t *d = control->deques + (preferred + k) % n;
+    dt_pthread_mutex_lock(&d->mutex);
+    const int sleeping = d->sleeping;
+    if(sleeping)
+    {
+      d->sleeping = 0;
+      pthread_cond_signal(&d->cond);
+    }
+    dt_pthread_mutex_unlock(&d->mutex);
+    if(sleeping) return;
+  }
+}
+
+static void dt_control_wake_all_workers(dt_control_t *control)
+{
+  for(int k = 0; k < control->num_threads; k++)
+  {
+    dt_control_job_deque_t *d = control->deques + k;
+    dt_pthread_mutex_lock(&d->mutex);
+    d->sleeping = 0;
+    pthread_cond_signal(&d->cond);
+    dt_pthread_mutex_unlock(&d->mutex);
+  }
+}
+
+// drop the oldest job of a stack, over all deques
+static void dt_control_discard_oldest_job(dt_control_t *control, const int q)
+{
+  int oldest = -1;
+  uint64_t oldest_seq = UINT64_MAX;
+  for(int k = 0; k < control->num_threads; k++)
+  {
+    dt_control_job_deque_t *d = control->deques + k;
+    dt_pthread_mutex_lock(&d->mutex);
+    // the tail of each deque is the oldest one in there
+    const _dt_job_t *last = d->tail[q];
+    if(last && last->seq < oldest_seq)
+    {
+      oldest_seq = last->seq;
+      oldest = k;
+    }
+    dt_pthread_mutex_unlock(&d->mutex);
+  }
+  if(oldest < 0) return;
+
+  dt_control_job_deque_t *d = control->deques + oldest;
+  dt_pthread_mutex_lock(&d->mutex);
+  _dt_job_t *last = d->tail[q];
+  if(last) dt_control_deque_unlink(d, last);
+  dt_pthread_mutex_unlock(&d->mutex);
+  if(!last) return;
+
+  __sync_fetch_and_sub(&control->jobs_pending, 1);
+  __sync_fetch_and_sub(dt_control_stack_count(control, q), 1);
+  dt_control_job_set_state(last, DT_JOB_STATE_DISCARDED);
+  dt_control_job_dispose(last);
+}
+
+static int32_t dt_control_run_job(dt_control_t *control, const int worker)
+{
+  _dt_job_t *job = dt_control_schedule_job(control, worker);
 
   if(!job) return -1;
 
@@ -297,7 +455,7 @@ int32_t dt_control_add_job_res(dt_control_t *control, _dt_job_t *job, int32_t re
   }
 
   // TODO: pthread cancel and restart in tough cases?
-  dt_pthread_mutex_lock(&control->queue_mutex);
+  dt_pthread_mutex_lock(&control->res_mutex);
 
   // if there is a job in the queue we have to discard that first
   if(control->job_res[res])
@@ -314,7 +472,7 @@ int32_t dt_control_add_job_res(dt_control_t *control, _dt_job_t *job, int32_t re
   control->job_res[res] = job;
   control->new_res[res] = 1;
 
-  dt_pthread_mutex_unlock(&control->queue_mutex);
+  dt_pthread_mutex_unlock(&control->res_mutex);
 
   dt_pthread_mutex_lock(&control->cond_mutex);
   pthread_cond_broadcast(&control->cond);
@@ -323,6 +481,8 @@ int32_t dt_control_add_job_res(dt_control_t *control, _dt_job_t *job, int32_t re
   return 0;
 }
 
+static __thread int worker_deque = -1;
+
 int dt_control_add_job(dt_control_t *control, dt_job_queue_t queue_id, _dt_job_t *job)
 {
   if(((unsigned int)queue_id) >= DT_JOB_QUEUE_MAX || !job)
@@ -333,53 +493,59 @@ int dt_control_add_job(dt_control_t *control, dt_job_queue_t queue_id, _dt_job_t
 
   job->queue = queue_id;
 
-  dt_pthread_mutex_lock(&control->queue_mutex);
+  // jobs added by a worker stay with it, all others get spread over the workers
+  const int target = worker_deque >= 0 ? worker_deque
+                                       : __sync_fetch_and_add(&control->next_deque, 1) % control->num_threads;
+  dt_control_job_deque_t *d = control->deques + target;
 
-  GList **queue = &control->queues[queue_id];
-  size_t length = control->queue_length[queue_id];
-
-  dt_print(DT_DEBUG_CONTROL, "[add_job] %ld | ", length);
+  dt_print(DT_DEBUG_CONTROL, "[add_job] %d | ", control->jobs_pending);
   dt_control_job_print(job);
   dt_print(DT_DEBUG_CONTROL, "\n");
 
-  if(queue_id == DT_JOB_QUEUE_SYSTEM_FG)
+  if(dt_control_queue_is_stack(queue_id))
   {
-    // this is a stack with limited size and bubble up and all that stuff
-    job->priority = DT_CONTROL_FG_PRIORITY;
-
-    // if the job is already in the queue -> move it to the top
-    for(GList *iter = *queue; iter; iter = g_list_next(iter))
+    // this is a stack with limited size and bubble up and all that stuff. prefetching only gets to run when
+    // nothing else is waiting, or once it waited long enough.
+    job->priority = queue_id == DT_JOB_QUEUE_SYSTEM_PREFETCH ? 0 : DT_CONTROL_FG_PRIORITY;
+    int32_t *count = dt_control_stack_count(control, queue_id);
+
+    // if the job is already in a queue -> move it to the top of ours
+    _dt_job_t *other_job = NULL;
+    for(int k = 0; k < control->num_threads && !other_job; k++)
     {
-      _dt_job_t *other_job = (_dt_job_t *)iter->data;
-      if(dt_control_job_equal(job, other_job))
-      {
-        dt_print(DT_DEBUG_CONTROL, "[add_job] found job already in queue: ");
-        dt_control_job_print(job);
-        dt_print(DT_DEBUG_CONTROL, "\n");
-
-        *queue = g_list_delete_link(*queue, iter);
-        length--;
-        dt_control_job_set_state(job, DT_JOB_STATE_DISCARDED);
-        dt_control_job_dispose(job);
-        job = other_job;
-        break; // there can't be any further copy in the list
-      }
+      dt_control_job_deque_t *other = control->deques + k;
+      dt_pthread_mutex_lock(&other->mutex);
+      GQueue *same = (GQueue *)g_hash_table_lookup(other->fg, job->description);
+      for(GList *iter = same ? same->head : NULL; iter && !other_job; iter = g_list_next(iter))
+        if(dt_control_job_equal(job, (_dt_job_t *)iter->data)) other_job = (_dt_job_t *)iter->data;
+      if(other_job) dt_control_deque_unlink(other, other_job);
+      dt_pthread_mutex_unlock(&other->mutex);
+    }
+    if(other_job)
+    {
+      dt_print(DT_DEBUG_CONTROL, "[add_job] found job already in queue: ");
+      dt_control_job_print(job);
+      dt_print(DT_DEBUG_CONTROL, "\n");
+
+      __sync_fetch_and_sub(&control->jobs_pending, 1);
+      __sync_fetch_and_sub(count, 1);
+      dt_control_job_set_state(job, DT_JOB_STATE_DISCARDED);
+      dt_control_job_dispose(job);
+      job = other_job;
     }
 
     // now we can add the new job to the list
-    *queue = g_list_prepend(*queue, job);
-    length++;
+    dt_pthread_mutex_lock(&d->mutex);
+    job->seq = __sync_add_and_fetch(&control->job_seq, 1);
+    dt_control_deque_push(d, target, job, TRUE);
+    dt_control_job_set_state(job, DT_JOB_STATE_QUEUED);
+    dt_pthread_mutex_unlock(&d->mutex);
+    __sync_fetch_and_add(&control->jobs_pending, 1);
 
     // and take care of the maximal queue size
-    if(length > DT_CONTROL_MAX_JOBS)
-    {
-      GList *last = g_list_last(*queue);
-      dt_control_job_set_state((_dt_job_t *)last->data, DT_JOB_STATE_DISCARDED);
-      *queue = g_list_delete_link(*queue, last);
-      length--;
-    }
-
-    control->queue_length[queue_id] = length;
+    const int32_t max_jobs
+        = queue_id == DT_JOB_QUEUE_SYSTEM_PREFETCH ? DT_CONTROL_MAX_PREFETCH_JOBS : DT_CONTROL_MAX_JOBS;
+    if(__sync_add_and_fetch(count, 1) > max_jobs) dt_control_discard_oldest_job(control, queue_id);
   }
   else
   {
@@ -388,16 +554,15 @@ int dt_control_add_job(dt_control_t *control, dt_job_queue_t queue_id, _dt_job_t
       job->priority = 0;
     else
       job->priority = DT_CONTROL_FG_PRIORITY;
-    *queue = g_list_append(*queue, job);
-    control->queue_length[queue_id]++;
+    dt_pthread_mutex_lock(&d->mutex);
+    dt_control_deque_push(d, target, job, FALSE);
+    dt_control_job_set_state(job, DT_JOB_STATE_QUEUED);
+    dt_pthread_mutex_unlock(&d->mutex);
+    __sync_fetch_and_add(&control->jobs_pending, 1);
   }
-  dt_control_job_set_state(job, DT_JOB_STATE_QUEUED);
-  dt_pthread_mutex_unlock(&control->queue_mutex);
 
-  // notify workers
-  dt_pthread_mutex_lock(&control->cond_mutex);
-  pthread_cond_broadcast(&control->cond);
-  dt_pthread_mutex_unlock(&control->cond_mutex);
+  // notify one worker, not all of them
+  dt_control_wake_worker(control, target);
 
   return 0;
 }
@@ -452,7 +617,10 @@ static void *dt_control_worker_kicker(void *ptr)
     dt_pthread_mutex_lock(&control->cond_mutex);
     pthread_cond_broadcast(&control->cond);
     dt_pthread_mutex_unlock(&control->cond_mutex);
+    dt_control_wake_all_workers(control);
   }
+  // make sure nobody sleeps through the shutdown:
+  dt_control_wake_all_workers(control);
   return NULL;
 }
 
@@ -464,17 +632,25 @@ static void *dt_control_work(void *ptr)
   worker_thread_parameters_t *params = (worker_thread_parameters_t *)ptr;
   dt_control_t *control = params->self;
   threadid = params->threadid;
+  worker_deque = params->threadid;
   free(params);
+  dt_control_job_deque_t *d = control->deques + worker_deque;
   // int32_t threadid = dt_control_get_threadid();
   while(dt_control_running())
   {
     // dt_print(DT_DEBUG_CONTROL, "[control_work] %d\n", threadid);
-    if(dt_control_run_job(control) < 0)
+    if(dt_control_run_job(control, worker_deque) < 0)
     {
-      // wait for a new job.
-      dt_pthread_mutex_lock(&control->cond_mutex);
-      dt_pthread_cond_wait(&control->cond, &control->cond_mutex);
-      dt_pthread_mutex_unlock(&control->cond_mutex);
+      // wait for a new job. jobs_pending is bumped before the adder looks for sleeping workers, so
+      // checking it with our mutex held can't miss a wakeup.
+      dt_pthread_mutex_lock(&d->mutex);
+      if(dt_control_running() && !__sync_fetch_and_add(&control->jobs_pending, 0))
+      {
+        d->sleeping = 1;
+        dt_pthread_cond_wait(&d->cond, &d->mutex);
+      }
+      d->sleeping = 0;
+      dt_pthread_mutex_unlock(&d->mutex);
     }
   }
   return NULL;
@@ -486,6 +662,17 @@ void dt_control_jobs_init(dt_control_t *control)
   // start threads
   control->num_threads = CLAMP(dt_conf_get_int("worker_threads"), 1, 8);
   control->thread = (pthread_t *)calloc(control->num_threads, sizeof(pthread_t));
+  control->deques = (dt_control_job_deque_t *)calloc(control->num_threads, sizeof(dt_control_job_deque_t));
+  for(int k = 0; k < control->num_threads; k++)
+  {
+    dt_pthread_mutex_init(&control->deques[k].mutex, NULL);
+    pthread_cond_init(&control->deques[k].cond, NULL);
+    control->deques[k].fg
+        = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_queue_free);
+  }
+  control->jobs_pending = control->fg_jobs = control->prefetch_jobs = 0;
+  control->next_deque = 0;
+  control->job_seq = 0;
   dt_pthread_mutex_lock(&control->run_mutex);
   control->running = 1;
   dt_pthread_mutex_unlock(&control->run_mutex);
@@ -516,6 +703,13 @@ void dt_control_jobs_init(dt_control_t *control)
 void dt_control_jobs_cleanup(dt_control_t *control)
 {
   free(control->thread);
+  for(int k = 0; k < control->num_threads; k++)
+  {
+    dt_pthread_mutex_destroy(&control->deques[k].mutex);
+    pthread_cond_destroy(&control->deques[k].cond);
+    g_hash_table_destroy(control->deques[k].fg);
+  }
+  free(control->deques);
 }
 
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
@@ -46,7 +46,8 @@ typedef enum dt_job_queue_t
   DT_JOB_QUEUE_SYSTEM_FG = 1, // thumbnail creation, ..., may be pushed out of the queue
   DT_JOB_QUEUE_USER_BG = 2,   // exports, ...
   DT_JOB_QUEUE_SYSTEM_BG = 3, // some lua stuff that may not be pushed out of the queue, ...
-  DT_JOB_QUEUE_MAX = 4
+  DT_JOB_QUEUE_SYSTEM_PREFETCH = 4, // thumbnail prefetch, ..., runs last, the oldest get pushed out
+  DT_JOB_QUEUE_MAX = 5
 } dt_job_queue_t;
 
 struct _dt_job_t;
@@ -79,6 +80,7 @@ int32_t dt_control_add_job_res(struct dt_control_t *s, dt_job_t *job, int32_t re
 
 int32_t dt_control_get_threadid();
 
+#ifndef DT_UNIT_TEST
 #ifdef HAVE_GPHOTO2
 #include "control/jobs/camera_jobs.h"
 #endif
@@ -86,6 +88,7 @@ int32_t dt_control_get_threadid();
 #include "control/jobs/develop_jobs.h"
 #include "control/jobs/film_jobs.h"
 #include "control/jobs/image_jobs.h"
+#endif
 
 #endif
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
@@ -182,35 +182,10 @@ static void dt_control_generic_images_job_cleanup(dt_job_t *job)
 
 static int32_t dt_control_write_sidecar_files_job_run(dt_job_t *job)
 {
-  int imgid = -1;
   dt_control_image_enumerator_t *params = dt_control_job_get_params(job);
-  GList *t = params->index;
-  sqlite3_stmt *stmt;
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "UPDATE images SET write_timestamp = STRFTIME('%s', 'now') WHERE id = ?1", -1,
-                              &stmt, NULL);
-  while(t)
-  {
-    gboolean from_cache = FALSE;
-    imgid = GPOINTER_TO_INT(t->data);
-    const dt_image_t *img = dt_image_cache_get(darktable.image_cache, (int32_t)imgid, 'r');
-    char dtfilename[PATH_MAX] = { 0 };
-    dt_image_full_path(img->id, dtfilename, sizeof(dtfilename), &from_cache);
-    dt_image_path_append_version(img->id, dtfilename, sizeof(dtfilename));
-    g_strlcat(dtfilename, ".xmp", sizeof(dtfilename));
-    if(!dt_exif_xmp_write(imgid, dtfilename))
-    {
-      // put the timestamp into db. this can't be done in exif.cc since that code gets called
-      // for the copy exporter, too
-      DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
-      sqlite3_step(stmt);
-      sqlite3_reset(stmt);
-      sqlite3_clear_bindings(stmt);
-    }
-    dt_image_cache_read_release(darktable.image_cache, img);
-    t = g_list_delete_link(t, t);
-  }
-  sqlite3_finalize(stmt);
+  dt_image_write_sidecar_files(params->index);
+  g_list_free(params->index);
+  params->index = NULL;
   free(params);
   return 0;
 }
@@ -622,7 +597,8 @@ static int32_t dt_control_remove_images_job_run(dt_job_t *job)
   // update remove status
   _set_remove_flag(imgs);
 
-  dt_collection_update(darktable.collection);
+  // the images leave the collection, its query stays the same
+  dt_collection_images_changed(darktable.collection, g_list_copy(t), FALSE);
 
   // We need a list of files to regenerate .xmp files if there are duplicates
   GList *list = _get_full_pathname(imgs);
@@ -647,7 +623,6 @@ static int32_t dt_control_remove_images_job_run(dt_job_t *job)
   }
   dt_control_progress_destroy(darktable.control, progress);
   dt_film_remove_empty();
-  dt_control_signal_raise(darktable.signals, DT_SIGNAL_FILMROLLS_CHANGED);
   dt_control_queue_redraw_center();
   free(params);
   return 0;
@@ -670,7 +645,8 @@ static int32_t dt_control_delete_images_job_run(dt_job_t *job)
 
   _set_remove_flag(imgs);
 
-  dt_collection_update(darktable.collection);
+  // the images leave the collection, its query stays the same
+  dt_collection_images_changed(darktable.collection, g_list_copy(t), FALSE);
 
   // We need a list of files to regenerate .xmp files if there are duplicates
   GList *list = _get_full_pathname(imgs);
@@ -782,7 +758,6 @@ static int32_t dt_control_delete_images_job_run(dt_job_t *job)
   g_list_free(list);
   dt_control_progress_destroy(darktable.control, progress);
   dt_film_remove_empty();
-  dt_control_signal_raise(darktable.signals, DT_SIGNAL_FILMROLLS_CHANGED);
   dt_control_queue_redraw_center();
   free(params);
   return 0;
@@ -951,9 +926,102 @@ static int32_t dt_control_local_copy_images_job_run(dt_job_t *job)
   return 0;
 }
 
+typedef struct dt_control_export_state_t
+{
+  dt_job_t *job;
+  dt_control_export_t *settings;
+  dt_imageio_module_format_t *mformat;
+  dt_imageio_module_storage_t *mstorage;
+  dt_imageio_module_data_t *sdata;
+  dt_imageio_module_data_t *fdata; // set up once, copied for every export thread
+  int parallel;
+  dt_progress_t *progress;
+
+  dt_pthread_mutex_t mutex; // protects everything below
+  pthread_cond_t cond;
+  GList *images;
+  guint total, started, finished;
+  guint tagid, etagid;
+  size_t memory_used, memory_budget;
+} dt_control_export_state_t;
+
+// pulls images off the list until it's empty or the job is cancelled. runs once per export thread.
+static void *dt_control_export_worker(void *data)
+{
+  dt_control_export_state_t *s = (dt_control_export_state_t *)data;
+
+  // get a thread-safe fdata struct (one jpeg struct per thread etc):
+  dt_imageio_module_data_t *fdata = s->fdata;
+  if(s->parallel)
+  {
+    fdata = s->mformat->get_params(s->mformat);
+    memcpy(fdata, s->fdata, s->mformat->params_size(s->mformat));
+  }
+
+  dt_pthread_mutex_lock(&s->mutex);
+  while(s->images && dt_control_job_get_state(s->job) != DT_JOB_STATE_CANCELLED)
+  {
+    const int imgid = GPOINTER_TO_INT(s->images->data);
+    s->images = g_list_delete_link(s->images, s->images);
+    const guint num = ++s->started;
+
+    // remove 'changed' tag from image
+    dt_tag_detach(s->tagid, imgid);
+    // make sure the 'exported' tag is set on the image
+    dt_tag_attach(s->etagid, imgid);
+    // check if image still exists:
+    char imgfilename[PATH_MAX] = { 0 };
+    gboolean available = FALSE;
+    size_t memory = 0;
+    const dt_image_t *image = dt_image_cache_get(darktable.image_cache, (int32_t)imgid, 'r');
+    if(image)
+    {
+      gboolean from_cache = TRUE;
+      dt_image_full_path(image->id, imgfilename, sizeof(imgfilename), &from_cache);
+      available = g_file_test(imgfilename, G_FILE_TEST_IS_REGULAR);
+      if(!available)
+      {
+        dt_control_log(_("image `%s' is currently unavailable"), image->filename);
+        fprintf(stderr, "image `%s' is currently unavailable", imgfilename);
+        // dt_image_remove(imgid);
+      }
+      // full input buffer plus the two cache lines of the export pipe, four floats per pixel:
+      memory = (size_t)3 * 4 * sizeof(float) * image->width * image->height;
+      dt_image_cache_read_release(darktable.image_cache, image);
+    }
+
+    if(available)
+    {
+      // wait for running exports to free up memory, but always let one through:
+      while(s->memory_used && s->memory_used + memory > s->memory_budget
+            && dt_control_job_get_state(s->job) != DT_JOB_STATE_CANCELLED)
+        dt_pthread_cond_wait(&s->cond, &s->mutex);
+      // don't start on this one if the job got cancelled while we were waiting
+      if(dt_control_job_get_state(s->job) == DT_JOB_STATE_CANCELLED) break;
+      s->memory_used += memory;
+      dt_pthread_mutex_unlock(&s->mutex);
+
+      // process, encode and write. while one thread writes, the others keep their pipes busy.
+      const int err = s->mstorage->store(s->mstorage, s->sdata, imgid, s->mformat, fdata, num, s->total,
+                                         s->settings->high_quality, s->settings->upscale);
+      if(err) dt_control_job_cancel(s->job);
+
+      dt_pthread_mutex_lock(&s->mutex);
+      s->memory_used -= memory;
+    }
+
+    s->finished++;
+    dt_control_progress_set_progress(darktable.control, s->progress, MIN(1.0, s->finished / (double)s->total));
+    pthread_cond_broadcast(&s->cond);
+  }
+  dt_pthread_mutex_unlock(&s->mutex);
+
+  if(s->parallel) s->mformat->free_params(s->mformat, fdata);
+  return NULL;
+}
+
 static int32_t dt_control_export_job_run(dt_job_t *job)
 {
-  int imgid = -1;
   dt_control_image_enumerator_t *params = (dt_control_image_enumerator_t *)dt_control_job_get_params(job);
   dt_control_export_t *settings = (dt_control_export_t *)params->data;
   GList *t = params->index;
@@ -1006,61 +1074,61 @@ static int32_t dt_control_export_job_run(dt_job_t *job)
   dt_progress_t *progress = dt_control_progress_create(control, TRUE, message);
   dt_control_progress_attach_job(control, progress, job);
 
-  double fraction = 0;
-
   // set up the fdata struct
   fdata->max_width = (settings->max_width != 0 && w != 0) ? MIN(w, settings->max_width) : MAX(w, settings->max_width);
   fdata->max_height = (settings->max_height != 0 && h != 0) ? MIN(h, settings->max_height) : MAX(h, settings->max_height);
   g_strlcpy(fdata->style, settings->style, sizeof(fdata->style));
   fdata->style_append = settings->style_append;
-  guint num = 0;
+
+  dt_control_export_state_t state = { 0 };
+  state.job = job;
+  state.settings = settings;
+  state.mformat = mformat;
+  state.mstorage = mstorage;
+  state.sdata = sdata;
+  state.fdata = fdata;
+  state.progress = progress;
+  state.images = t;
+  state.total = total;
   // Invariant: the tagid for 'darktable|changed' will not change while this function runs. Is this a
   // sensible assumption?
-  guint tagid = 0, etagid = 0;
-  dt_tag_new("darktable|changed", &tagid);
-  dt_tag_new("darktable|exported", &etagid);
-
-  while(t && dt_control_job_get_state(job) != DT_JOB_STATE_CANCELLED)
+  dt_tag_new("darktable|changed", &state.tagid);
+  dt_tag_new("darktable|exported", &state.etagid);
+  // leave half of the physical memory to the rest of the system (dt_get_total_memory() is in kb):
+  state.memory_budget = dt_get_total_memory() * (1024 / 2);
+  dt_pthread_mutex_init(&state.mutex, NULL);
+  pthread_cond_init(&state.cond, NULL);
+
+  // process several images at the same time if the storage and format can deal with it:
+  int num_threads = 1;
+  if((mstorage->flags(mstorage) & STORAGE_FLAGS_SUPPORT_PARALLEL)
+     && !(mformat->flags(fdata) & FORMAT_FLAGS_NO_PARALLEL_EXPORT))
+    num_threads = MIN(CLAMP(dt_conf_get_int("parallel_export_threads"), 1, 16), (int)total);
+  state.parallel = num_threads > 1;
+
+  if(state.parallel)
   {
-    if(!t)
-      imgid = 0;
-    else
+    pthread_t *threads = (pthread_t *)malloc(sizeof(pthread_t) * num_threads);
+    int started = 0;
+    for(int k = 0; k < num_threads; k++)
     {
-      imgid = GPOINTER_TO_INT(t->data);
-      t = g_list_delete_link(t, t);
-      num = total - g_list_length(t);
-    }
-
-    // remove 'changed' tag from image
-    dt_tag_detach(tagid, imgid);
-    // make sure the 'exported' tag is set on the image
-    dt_tag_attach(etagid, imgid);
-    // check if image still exists:
-    char imgfilename[PATH_MAX] = { 0 };
-    const dt_image_t *image = dt_image_cache_get(darktable.image_cache, (int32_t)imgid, 'r');
-    if(image)
-    {
-      gboolean from_cache = TRUE;
-      dt_image_full_path(image->id, imgfilename, sizeof(imgfilename), &from_cache);
-      if(!g_file_test(imgfilename, G_FILE_TEST_IS_REGULAR))
-      {
-        dt_control_log(_("image `%s' is currently unavailable"), image->filename);
-        fprintf(stderr, "image `%s' is currently unavailable", imgfilename);
-        // dt_image_remove(imgid);
-        dt_image_cache_read_release(darktable.image_cache, image);
-      }
+      if(pthread_create(&threads[started], NULL, dt_control_export_worker, &state))
+        fprintf(stderr, "[export_job] couldn't start export thread %d\n", k);
       else
-      {
-        dt_image_cache_read_release(darktable.image_cache, image);
-        if(mstorage->store(mstorage, sdata, imgid, mformat, fdata, num, total, settings->high_quality, settings->upscale) != 0)
-          dt_control_job_cancel(job);
-      }
+        started++;
     }
-
-    fraction += 1.0 / total;
-    if(fraction > 1.0) fraction = 1.0;
-    dt_control_progress_set_progress(control, progress, fraction);
+    // without any helpers we do it ourselves
+    if(!started) dt_control_export_worker(&state);
+    for(int k = 0; k < started; k++) pthread_join(threads[k], NULL);
+    free(threads);
   }
+  else
+    dt_control_export_worker(&state);
+
+  // in case we were cancelled:
+  g_list_free(state.images);
+  pthread_cond_destroy(&state.cond);
+  dt_pthread_mutex_destroy(&state.mutex);
 
   dt_control_progress_destroy(control, progress);
   if(mstorage->finalize_store) mstorage->finalize_store(mstorage, sdata);
@@ -46,10 +46,17 @@ typedef struct dt_signal_description
 
 static GType uint_arg[] = { G_TYPE_UINT };
 static GType pointer_2arg[] = { G_TYPE_POINTER, G_TYPE_POINTER };
+static GType pointer_uint_arg[] = { G_TYPE_POINTER, G_TYPE_UINT };
 static GType image_export_arg[]
     = { G_TYPE_UINT, G_TYPE_STRING, G_TYPE_POINTER, G_TYPE_POINTER, G_TYPE_POINTER, G_TYPE_POINTER };
 
 
+// runs after all handlers of DT_SIGNAL_COLLECTION_IMAGES_CHANGED
+static void _collection_images_changed_destroy(gpointer instance, GList *imgs, guint member,
+                                              gpointer user_data)
+{
+  g_list_free(imgs);
+}
 
 static dt_signal_description _signal_description[DT_SIGNAL_COUNT] = {
   /* Global signals */
@@ -68,6 +75,9 @@ static dt_signal_description _signal_description[DT_SIGNAL_COUNT] = {
 
   { "dt-collection-changed", NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__VOID, 0,
     NULL, NULL, FALSE }, // DT_SIGNAL_COLLECTION_CHANGED
+  { "dt-collection-images-changed", NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_generic, 2,
+    pointer_uint_arg, G_CALLBACK(_collection_images_changed_destroy),
+    FALSE }, // DT_SIGNAL_COLLECTION_IMAGES_CHANGED
   { "dt-tag-changed", NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__VOID, 0,
     NULL, NULL, FALSE }, // DT_SIGNAL_TAG_CHANGED
   { "dt-style-changed", NULL, NULL, G_TYPE_NONE, g_cclosure_marshal_VOID__VOID, 0,
@@ -62,6 +62,15 @@ typedef enum dt_signal_t
     */
   DT_SIGNAL_COLLECTION_CHANGED,
 
+  /** \brief This signal is raised when images joined or left the collection while its query stayed the same,
+    for example on import or when an image got rated out of the filter. listeners can follow without
+    rebuilding everything.
+    1 GList * : the image ids, freed once all handlers ran
+    2 uint32_t : TRUE if the images joined the collection, FALSE if they left it
+    no return
+    */
+  DT_SIGNAL_COLLECTION_IMAGES_CHANGED,
+
   /** \brief This signal is raised when a tag is added/deleted/changed  */
   DT_SIGNAL_TAG_CHANGED,
 
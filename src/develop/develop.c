@@ -29,6 +29,7 @@
 #include "develop/imageop.h"
 #include "develop/blend.h"
 #include "develop/lightroom.h"
+#include "develop/viewport_cache.h"
 #include "control/jobs.h"
 #include "control/control.h"
 #include "control/conf.h"
@@ -94,6 +95,12 @@ void dt_dev_init(dt_develop_t *dev, int32_t gui_attached)
     dev->preview_pipe = (dt_dev_pixelpipe_t *)malloc(sizeof(dt_dev_pixelpipe_t));
     dt_dev_pixelpipe_init(dev->pipe);
     dt_dev_pixelpipe_init_preview(dev->preview_pipe);
+    const int64_t viewport_cache_memory = dt_conf_get_int64("viewport_cache_memory");
+    if(viewport_cache_memory > 0)
+    {
+      dev->viewport_cache = (dt_dev_viewport_cache_t *)malloc(sizeof(dt_dev_viewport_cache_t));
+      dt_dev_viewport_cache_init(dev->viewport_cache, viewport_cache_memory);
+    }
 
     dev->histogram = (uint32_t *)calloc(4 * 256, sizeof(uint32_t));
     dev->histogram_pre_tonecurve = (uint32_t *)calloc(4 * 256, sizeof(uint32_t));
@@ -132,6 +139,11 @@ void dt_dev_cleanup(dt_develop_t *dev)
     dt_dev_pixelpipe_cleanup(dev->preview_pipe);
     free(dev->preview_pipe);
   }
+  if(dev->viewport_cache)
+  {
+    dt_dev_viewport_cache_cleanup(dev->viewport_cache);
+    free(dev->viewport_cache);
+  }
   while(dev->history)
   {
     free(((dt_dev_history_item_t *)dev->history->data)->params);
@@ -229,6 +241,9 @@ void dt_dev_process_preview_job(dt_develop_t *dev)
     dev->preview_input_changed = 0;
   }
 
+  // the profile covers this run, restarts included. earlier runs which were given up don't count.
+  dt_dev_pixelpipe_profile_reset(dev->preview_pipe);
+
 // always process the whole downsampled mipf buffer, to allow for fast scrolling and mip4 write-through.
 restart:
   if(dev->gui_leaving)
@@ -261,6 +276,7 @@ restart:
   }
 
   dev->preview_status = DT_DEV_PIXELPIPE_VALID;
+  dt_dev_pixelpipe_profile_write(dev->preview_pipe);
 
   dt_show_times(&start, "[dev_process_preview] pixel pipeline processing", NULL);
   dt_dev_average_delay_update(&start, &dev->preview_average_delay);
@@ -303,6 +319,7 @@ void dt_dev_process_image_job(dt_develop_t *dev)
     dt_dev_pixelpipe_cleanup_nodes(dev->pipe);
     dt_dev_pixelpipe_create_nodes(dev->pipe, dev);
     if(dev->image_force_reload) dt_dev_pixelpipe_flush_caches(dev->pipe);
+    if(dev->viewport_cache) dt_dev_viewport_cache_flush(dev->viewport_cache);
     dev->image_force_reload = 0;
     if(dev->gui_attached)
     {
@@ -320,6 +337,9 @@ void dt_dev_process_image_job(dt_develop_t *dev)
   int window_width, window_height, x, y, closeup;
   dt_dev_pixelpipe_change_t pipe_changed;
 
+  // the profile covers this run, restarts included. earlier runs which were given up don't count.
+  dt_dev_pixelpipe_profile_reset(dev->pipe);
+
 // adjust pipeline according to changed flag set by {add,pop}_history_item.
 restart:
   if(dev->gui_leaving)
@@ -364,7 +384,11 @@ restart:
   y = MAX(0, scale * dev->pipe->processed_height * (.5 + zoom_y) - ht / 2);
 
   dt_get_times(&start);
-  if(dt_dev_pixelpipe_process(dev->pipe, dev, x, y, wd, ht, scale))
+  // at 1:1 the user pans around, reuse the output tiles which are still visible.
+  const int err = (zoom == DT_ZOOM_1 && dev->viewport_cache)
+                      ? dt_dev_viewport_cache_process(dev->viewport_cache, dev->pipe, dev, x, y, wd, ht, scale)
+                      : dt_dev_pixelpipe_process(dev->pipe, dev, x, y, wd, ht, scale);
+  if(err)
   {
     // interrupted because image changed?
     if(dev->image_force_reload)
@@ -388,6 +412,7 @@ restart:
   // cool, we got a new image!
   dev->image_status = DT_DEV_PIXELPIPE_VALID;
   dev->image_loading = 0;
+  dt_dev_pixelpipe_profile_write(dev->pipe);
 
   dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
   // redraw the whole thing, to also update color picker values and histograms etc.
@@ -968,11 +993,13 @@ void dt_dev_read_history(dt_develop_t *dev)
   // maybe prepend auto-presets to history before loading it:
   auto_apply_presets(dev);
 
+  // every thumbnail and export reads the history, don't make them wait for the main handle
+  sqlite3 *db = dt_database_get_reader(darktable.db);
   sqlite3_stmt *stmt;
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "select imgid, num, module, operation, "
-                                                             "op_params, enabled, blendop_params, "
-                                                             "blendop_version, multi_priority, multi_name "
-                                                             "from history where imgid = ?1 order by num",
+  DT_DEBUG_SQLITE3_PREPARE_V2(db, "select imgid, num, module, operation, "
+                                  "op_params, enabled, blendop_params, "
+                                  "blendop_version, multi_priority, multi_name "
+                                  "from history where imgid = ?1 order by num",
                               -1, &stmt, NULL);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, dev->image_storage.id);
   dev->history_end = 0;
@@ -1143,8 +1170,7 @@ void dt_dev_read_history(dt_develop_t *dev)
   }
   sqlite3_finalize(stmt);
 
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "SELECT history_end FROM images WHERE id = ?1",
-                              -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_PREPARE_V2(db, "SELECT history_end FROM images WHERE id = ?1", -1, &stmt, NULL);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, dev->image_storage.id);
   if(sqlite3_step(stmt) == SQLITE_ROW) // seriously, this should never fail
   {
@@ -888,6 +888,11 @@ static void dt_iop_gui_off_callback(GtkToggleButton *togglebutton, gpointer user
   gtk_widget_queue_draw(GTK_WIDGET(togglebutton));
 }
 
+gboolean dt_iop_is_distorting(const dt_iop_module_t *module)
+{
+  return module->distort_transform != default_distort_transform;
+}
+
 gboolean dt_iop_is_hidden(dt_iop_module_t *module)
 {
   gboolean is_hidden = TRUE;
@@ -1358,6 +1363,8 @@ void dt_iop_commit_params(dt_iop_module_t *module, dt_iop_params_t *params,
 
     // assume process_cl is ready, commit_params can overwrite this.
     if(module->process_cl) piece->process_cl_ready = 1;
+    // assume the output is the same in all pipes, commit_params can overwrite this.
+    piece->type_variant = 0;
     module->commit_params(module, params, pipe, piece);
     for(int i = 0; i < length; i++) hash = ((hash << 5) + hash) ^ str[i];
     piece->hash = hash;
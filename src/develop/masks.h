@@ -236,6 +236,8 @@ int dt_masks_group_render(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece
                           float **buffer, int *roi, float scale);
 int dt_masks_group_render_roi(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece, dt_masks_form_t *form,
                               const dt_iop_roi_t *roi, float *buffer);
+/** hash of the geometry of the form, including all forms of a group, continuing the given hash */
+uint64_t dt_masks_form_hash(dt_develop_t *dev, dt_masks_form_t *form, uint64_t hash);
 
 // returns current masks version
 int dt_masks_version(void);
@@ -2614,9 +2614,12 @@ static int dt_brush_get_mask(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *pi
   return 1;
 }
 
-/** we write a falloff segment respecting limits of buffer */
-static inline void _brush_falloff_roi(float *buffer, int *p0, int *p1, int bw, int bh, float hardness,
-                                      float density)
+/** rows of the roi processed together when filling masks in parallel */
+#define DT_BRUSH_FILL_BAND 64
+
+/** we write a falloff segment respecting limits of buffer, and only to its rows y0 <= y < y1 */
+static inline void _brush_falloff_roi(float *buffer, const int *p0, const int *p1, int bw, int bh, float hardness,
+                                      float density, const int y0, const int y1)
 {
   // segment length (increase by 1 to avoid division-by-zero special case handling)
   const int l = sqrt((p1[0] - p0[0]) * (p1[0] - p0[0]) + (p1[1] - p0[1]) * (p1[1] - p0[1])) + 1;
@@ -2649,10 +2652,13 @@ static inline void _brush_falloff_roi(float *buffer, int *p0, int *p1, int bw, i
 
     float *buf = buffer + (size_t)y * bw + x;
 
-    *buf = fmaxf(*buf, op);
-    if(x + dx >= 0 && x + dx < bw)
-      buf[dpx] = fmaxf(buf[dpx], op); // this one is to avoid gaps due to int rounding
-    if(y + dy >= 0 && y + dy < bh)
+    if(y >= y0 && y < y1)
+    {
+      *buf = fmaxf(*buf, op);
+      if(x + dx >= 0 && x + dx < bw)
+        buf[dpx] = fmaxf(buf[dpx], op); // this one is to avoid gaps due to int rounding
+    }
+    if(y + dy >= 0 && y + dy < bh && y + dy >= y0 && y + dy < y1)
       buf[dpy] = fmaxf(buf[dpy], op); // this one is to avoid gaps due to int rounding
   }
 }
@@ -2749,21 +2755,54 @@ static int dt_brush_get_mask_roi(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t
     return 1;
   }
 
-  // now we fill the falloff
-  int p0[2], p1[2];
+  // now we fill the falloff. the segments are collected first and then drawn in parallel in bands of rows,
+  // which gives the same result as they are combined by their maximum.
+  int *segments = malloc(sizeof(int) * 4 * MAX(border_count - nb_corner * 3, 1));
+  int *index = malloc(sizeof(int) * MAX(border_count - nb_corner * 3, 1));
+  if(!segments || !index)
+  {
+    free(segments);
+    free(index);
+    free(points);
+    free(border);
+    free(payload);
+    return 0;
+  }
+  int nb_segments = 0;
   for(int i = nb_corner * 3; i < border_count; i++)
   {
-    p0[0] = points[i * 2];
-    p0[1] = points[i * 2 + 1];
-    p1[0] = border[i * 2];
-    p1[1] = border[i * 2 + 1];
+    int *seg = segments + 4 * nb_segments;
+    seg[0] = points[i * 2];
+    seg[1] = points[i * 2 + 1];
+    seg[2] = border[i * 2];
+    seg[3] = border[i * 2 + 1];
 
-    if(MAX(p0[0], p1[0]) < 0 || MIN(p0[0], p1[0]) >= width || MAX(p0[1], p1[1]) < 0
-       || MIN(p0[1], p1[1]) >= height)
+    if(MAX(seg[0], seg[2]) < 0 || MIN(seg[0], seg[2]) >= width || MAX(seg[1], seg[3]) < 0
+       || MIN(seg[1], seg[3]) >= height)
       continue;
 
-    _brush_falloff_roi(buffer, p0, p1, width, height, payload[i * 2], payload[i * 2 + 1]);
+    index[nb_segments++] = i;
+  }
+
+  const int bands = (height + DT_BRUSH_FILL_BAND - 1) / DT_BRUSH_FILL_BAND;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for(int b = 0; b < bands; b++)
+  {
+    const int y0 = b * DT_BRUSH_FILL_BAND;
+    const int y1 = MIN(y0 + DT_BRUSH_FILL_BAND, height);
+    for(int k = 0; k < nb_segments; k++)
+    {
+      const int *seg = segments + 4 * k;
+      // the stepping along the segment may round one row beyond its end points, plus one for the gaps
+      if(MAX(seg[1], seg[3]) + 2 < y0 || MIN(seg[1], seg[3]) - 2 >= y1) continue;
+      _brush_falloff_roi(buffer, seg, seg + 2, width, height, payload[index[k] * 2], payload[index[k] * 2 + 1],
+                         y0, y1);
+    }
   }
+  free(segments);
+  free(index);
 
   free(points);
   free(border);
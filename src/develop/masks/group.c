@@ -651,14 +651,59 @@ static int dt_group_get_mask_roi(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t
   return (nb_ok != 0);
 }
 
+// the rasterized mask depends on the shapes, the region of interest, the input dimensions of the pipe and
+// all distortions up to and including the module itself, which move the shapes around.
+static uint64_t _group_render_hash(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece,
+                                   dt_masks_form_t *form, const dt_iop_roi_t *roi)
+{
+  const dt_dev_pixelpipe_t *pipe = piece->pipe;
+  uint64_t hash = dt_masks_form_hash(module->dev, form, 5381);
+  const int32_t key[7] = { pipe->image.id, pipe->iwidth, pipe->iheight, roi->x, roi->y, roi->width, roi->height };
+  const float scale[2] = { pipe->iscale, roi->scale };
+  const char *str = (const char *)key;
+  for(size_t i = 0; i < sizeof(key); i++) hash = ((hash << 5) + hash) ^ str[i];
+  str = (const char *)scale;
+  for(size_t i = 0; i < sizeof(scale); i++) hash = ((hash << 5) + hash) ^ str[i];
+  for(GList *nodes = pipe->nodes; nodes; nodes = g_list_next(nodes))
+  {
+    const dt_dev_pixelpipe_iop_t *p = (dt_dev_pixelpipe_iop_t *)nodes->data;
+    if(p->module->priority > module->priority) break;
+    if(p->enabled && dt_iop_is_distorting(p->module))
+    {
+      str = (const char *)&p->hash;
+      for(size_t i = 0; i < sizeof(p->hash); i++) hash = ((hash << 5) + hash) ^ str[i];
+    }
+  }
+  return hash;
+}
+
 int dt_masks_group_render_roi(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece, dt_masks_form_t *form,
                               const dt_iop_roi_t *roi, float *buffer)
 {
   double start2 = dt_get_wtime();
   if(!form) return 0;
 
+  // drawn masks are expensive to rasterize, but rarely change while some other module is being edited
+  const size_t size = (size_t)roi->width * roi->height * sizeof(float);
+  const uint64_t hash = darktable.mask_cache ? _group_render_hash(module, piece, form, roi) : 0;
+  if(darktable.mask_cache)
+  {
+    dt_dev_pixelpipe_cache_line_t *line = dt_dev_pixelpipe_shared_cache_get(darktable.mask_cache, hash, size);
+    if(line)
+    {
+      memcpy(buffer, line->data, size);
+      dt_dev_pixelpipe_shared_cache_release(darktable.mask_cache, line);
+      if(darktable.unmuted & DT_DEBUG_PERF)
+        dt_print(DT_DEBUG_MASKS, "[masks] cached masks took %0.04f sec\n", dt_get_wtime() - start2);
+      return 1;
+    }
+  }
+
   int ok = dt_masks_get_mask_roi(module, piece, form, roi, buffer);
 
+  if(ok && darktable.mask_cache)
+    dt_dev_pixelpipe_shared_cache_put(darktable.mask_cache, hash, piece->pipe->image.id, buffer, size, NULL);
+
   if(darktable.unmuted & DT_DEBUG_PERF)
     dt_print(DT_DEBUG_MASKS, "[masks] render all masks took %0.04f sec\n", dt_get_wtime() - start2);
   return ok;
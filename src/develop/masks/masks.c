@@ -500,6 +500,47 @@ int dt_masks_get_mask_roi(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece
   return 0;
 }
 
+static uint64_t _masks_hash(uint64_t hash, const void *data, const size_t size)
+{
+  const char *str = (const char *)data;
+  for(size_t i = 0; i < size; i++) hash = ((hash << 5) + hash) ^ str[i];
+  return hash;
+}
+
+uint64_t dt_masks_form_hash(dt_develop_t *dev, dt_masks_form_t *form, uint64_t hash)
+{
+  hash = _masks_hash(hash, &form->type, sizeof(form->type));
+  hash = _masks_hash(hash, &form->formid, sizeof(form->formid));
+  hash = _masks_hash(hash, &form->version, sizeof(form->version));
+  hash = _masks_hash(hash, form->source, sizeof(form->source));
+
+  // same order as in dt_masks_get_mask(), clone forms have two type bits
+  size_t size = 0;
+  if(form->type & DT_MASKS_CIRCLE)
+    size = sizeof(dt_masks_point_circle_t);
+  else if(form->type & DT_MASKS_PATH)
+    size = sizeof(dt_masks_point_path_t);
+  else if(form->type & DT_MASKS_GROUP)
+    size = sizeof(dt_masks_point_group_t);
+  else if(form->type & DT_MASKS_GRADIENT)
+    size = sizeof(dt_masks_point_gradient_t);
+  else if(form->type & DT_MASKS_ELLIPSE)
+    size = sizeof(dt_masks_point_ellipse_t);
+  else if(form->type & DT_MASKS_BRUSH)
+    size = sizeof(dt_masks_point_brush_t);
+
+  for(GList *points = form->points; points; points = g_list_next(points))
+  {
+    hash = _masks_hash(hash, points->data, size);
+    if(form->type & DT_MASKS_GROUP)
+    {
+      dt_masks_form_t *sel = dt_masks_get_from_id(dev, ((dt_masks_point_group_t *)points->data)->formid);
+      if(sel) hash = dt_masks_form_hash(dev, sel, hash);
+    }
+  }
+  return hash;
+}
+
 int dt_masks_version(void)
 {
   return DEVELOP_MASKS_VERSION;
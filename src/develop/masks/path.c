@@ -2373,8 +2373,11 @@ static int _path_crop_to_roi(float *path, const int point_count, float xmin, flo
   return 1;
 }
 
-/** we write a falloff segment respecting limits of buffer */
-static void _path_falloff_roi(float *buffer, int *p0, int *p1, int bw, int bh)
+/** rows of the roi processed together when filling masks in parallel */
+#define DT_PATH_FILL_BAND 64
+
+/** we write a falloff segment respecting limits of buffer, and only to its rows y0 <= y < y1 */
+static void _path_falloff_roi(float *buffer, const int *p0, const int *p1, int bw, int y0, int y1)
 {
   // segment length
   const int l = sqrt((p1[0] - p0[0]) * (p1[0] - p0[0]) + (p1[1] - p0[1]) * (p1[1] - p0[1])) + 1;
@@ -2393,14 +2396,64 @@ static void _path_falloff_roi(float *buffer, int *p0, int *p1, int bw, int bh)
     const int y = (int)((float)i * ly / (float)l) + p0[1];
     const float op = 1.0 - (float)i / (float)l;
     float *buf = buffer + (size_t)y * bw + x;
-    if(x >= 0 && x < bw && y >= 0 && y < bh) buf[0] = fmaxf(buf[0], op);
-    if(x + dx >= 0 && x + dx < bw && y >= 0 && y < bh)
+    if(x >= 0 && x < bw && y >= y0 && y < y1) buf[0] = fmaxf(buf[0], op);
+    if(x + dx >= 0 && x + dx < bw && y >= y0 && y < y1)
       buf[dx] = fmaxf(buf[dx], op); // this one is to avoid gap due to int rounding
-    if(x >= 0 && x < bw && y + dy >= 0 && y + dy < bh)
+    if(x >= 0 && x < bw && y + dy >= y0 && y + dy < y1)
       buf[dpy] = fmaxf(buf[dpy], op); // this one is to avoid gap due to int rounding
   }
 }
 
+static int _path_cmp_int(const void *a, const void *b)
+{
+  return *(const int *)a - *(const int *)b;
+}
+
+// fills the inside of the path, given as its crossings with the rows of the roi. every row is independent:
+// the crossings are sorted, pixels crossed an even number of times drop out, and the spans between the
+// remaining pairs are set. this gives the same result as flagging the crossings and toggling a fill state
+// along the row, but only touches the inside of the path.
+static void _path_fill_rows(float *buffer, int *crossings, const int *row_start, const int width,
+                            const int height, const int xmax)
+{
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 16)
+#endif
+  for(int yy = 0; yy < height; yy++)
+  {
+    int *row = crossings + row_start[yy];
+    const int n = row_start[yy + 1] - row_start[yy];
+    if(n == 0) continue;
+    if(n > 16)
+      qsort(row, n, sizeof(int), _path_cmp_int);
+    else
+      for(int i = 1; i < n; i++)
+      {
+        const int v = row[i];
+        int j = i - 1;
+        for(; j >= 0 && row[j] > v; j--) row[j + 1] = row[j];
+        row[j + 1] = v;
+      }
+
+    // keep the pixels crossed an odd number of times
+    int m = 0;
+    for(int i = 0; i < n;)
+    {
+      int k = i + 1;
+      while(k < n && row[k] == row[i]) k++;
+      if((k - i) & 1) row[m++] = row[i];
+      i = k;
+    }
+
+    float *buf = buffer + (size_t)yy * width;
+    for(int i = 0; i < m; i += 2)
+    {
+      const int end = MIN(i + 1 < m ? row[i + 1] : MAX(xmax, row[i]), width - 1);
+      for(int xx = row[i]; xx <= end; xx++) buf[xx] = 1.0f;
+    }
+  }
+}
+
 static int dt_path_get_mask_roi(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece, dt_masks_form_t *form,
                                 const dt_iop_roi_t *roi, float *buffer)
 {
@@ -2596,68 +2649,89 @@ static int dt_path_get_mask_roi(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t
     {
       // all other cases
 
-      // edge-flag polygon fill: we write all the point around the path into the buffer
-      float xlast = cpoints[(points_count - 1) * 2];
-      float ylast = cpoints[(points_count - 1) * 2 + 1];
-
-      for(int i = nb_corner * 3; i < points_count; i++)
+      // scanline polygon fill: we collect where the edges of the path cross the rows of the roi,
+      // in two passes to first count and then store them per row.
+      int *row_start = calloc(height + 1, sizeof(int));
+      int *crossings = NULL;
+      if(row_start == NULL)
       {
-        float xstart = xlast;
-        float ystart = ylast;
-
-        float xend = xlast = cpoints[i * 2];
-        float yend = ylast = cpoints[i * 2 + 1];
+        free(cpoints);
+        free(points);
+        free(border);
+        return 0;
+      }
+      for(int pass = 0; pass < 2; pass++)
+      {
+        float xlast = cpoints[(points_count - 1) * 2];
+        float ylast = cpoints[(points_count - 1) * 2 + 1];
 
-        if(ystart > yend)
+        for(int i = nb_corner * 3; i < points_count; i++)
         {
-          float tmp;
-          tmp = ystart, ystart = yend, yend = tmp;
-          tmp = xstart, xstart = xend, xend = tmp;
-        }
+          float xstart = xlast;
+          float ystart = ylast;
 
-        const float m = (xstart - xend) / (ystart - yend); // we don't need special handling of ystart==yend
-                                                           // as following loop will take care
+          float xend = xlast = cpoints[i * 2];
+          float yend = ylast = cpoints[i * 2 + 1];
 
-        for(int yy = (int)ceilf(ystart); (float)yy < yend;
-            yy++) // this would normally never touch the last roi line => see comment further above
-        {
-          const float xcross = xstart + m * (yy - ystart);
+          if(ystart > yend)
+          {
+            float tmp;
+            tmp = ystart, ystart = yend, yend = tmp;
+            tmp = xstart, xstart = xend, xend = tmp;
+          }
+
+          const float m = (xstart - xend) / (ystart - yend); // we don't need special handling of ystart==yend
+                                                             // as following loop will take care
 
-          int xx = floorf(xcross);
-          if((float)xx + 0.5f <= xcross) xx++;
+          for(int yy = (int)ceilf(ystart); (float)yy < yend;
+              yy++) // this would normally never touch the last roi line => see comment further above
+          {
+            const float xcross = xstart + m * (yy - ystart);
 
-          if(xx < 0 || xx >= width || yy < 0 || yy >= height)
-            continue; // sanity check just to be on the safe side
+            int xx = floorf(xcross);
+            if((float)xx + 0.5f <= xcross) xx++;
 
-          size_t index = (size_t)yy * width + xx;
+            if(xx < 0 || xx >= width || yy < 0 || yy >= height)
+              continue; // sanity check just to be on the safe side
 
-          buffer[index] = 1.0f - buffer[index];
+            if(pass == 0)
+              row_start[yy + 1]++;
+            else
+              crossings[row_start[yy]++] = xx;
+          }
+        }
+
+        if(pass == 0)
+        {
+          for(int yy = 0; yy < height; yy++) row_start[yy + 1] += row_start[yy];
+          crossings = malloc(sizeof(int) * MAX(row_start[height], 1));
+          if(crossings == NULL) break;
+        }
+        else
+        {
+          // the second pass moved every start to the end of its row
+          for(int yy = height; yy > 0; yy--) row_start[yy] = row_start[yy - 1];
+          row_start[0] = 0;
         }
       }
+      if(crossings == NULL)
+      {
+        free(row_start);
+        free(cpoints);
+        free(points);
+        free(border);
+        return 0;
+      }
 
       if(darktable.unmuted & DT_DEBUG_PERF)
         dt_print(DT_DEBUG_MASKS, "[masks %s] path_fill draw path took %0.04f sec\n", form->name,
                  dt_get_wtime() - start2);
       start2 = dt_get_wtime();
 
-      // we fill the inside plain
-      // we don't need to deal with parts of shape outside of roi
-      xmin = fmaxf(xmin, 0);
-      xmax = fminf(xmax, width - 1);
-      ymin = fmaxf(ymin, 0);
-      ymax = fminf(ymax, height - 1);
-
-      for(int yy = ymin; yy <= ymax; yy++)
-      {
-        int state = 0;
-        for(int xx = xmin; xx <= xmax; xx++)
-        {
-          size_t index = (size_t)yy * width + xx;
-          float v = buffer[index];
-          if(v > 0.5f) state = !state;
-          if(state) buffer[index] = 1.0f;
-        }
-      }
+      // we fill the inside plain, the crossings are all within the roi already
+      _path_fill_rows(buffer, crossings, row_start, width, height, fminf(xmax, width - 1));
+      free(crossings);
+      free(row_start);
 
       if(darktable.unmuted & DT_DEBUG_PERF)
         dt_print(DT_DEBUG_MASKS, "[masks %s] path_fill fill plain took %0.04f sec\n", form->name,
@@ -2670,6 +2744,15 @@ static int dt_path_get_mask_roi(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t
   // deal with feather if it does not lie outside of roi
   if(!path_encircles_roi)
   {
+    // collect the segments first, they are then drawn in parallel in bands of rows
+    int *segments = malloc(sizeof(int) * 4 * MAX(border_count - nb_corner * 3, 1));
+    if(segments == NULL)
+    {
+      free(points);
+      free(border);
+      return 0;
+    }
+    int nb_segments = 0;
     int p0[2], p1[2];
     int last0[2] = { -100, -100 };
     int last1[2] = { -100, -100 };
@@ -2704,7 +2787,11 @@ static int dt_path_get_mask_roi(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t
       // and we draw the falloff
       if(last0[0] != p0[0] || last0[1] != p0[1] || last1[0] != p1[0] || last1[1] != p1[1])
       {
-        _path_falloff_roi(buffer, p0, p1, width, height);
+        int *seg = segments + 4 * nb_segments++;
+        seg[0] = p0[0];
+        seg[1] = p0[1];
+        seg[2] = p1[0];
+        seg[3] = p1[1];
         last0[0] = p0[0];
         last0[1] = p0[1];
         last1[0] = p1[0];
@@ -2712,6 +2799,25 @@ static int dt_path_get_mask_roi(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t
       }
     }
 
+    // the falloff is a maximum over all segments, so the order doesn't matter
+    const int bands = (height + DT_PATH_FILL_BAND - 1) / DT_PATH_FILL_BAND;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for(int b = 0; b < bands; b++)
+    {
+      const int y0 = b * DT_PATH_FILL_BAND;
+      const int y1 = MIN(y0 + DT_PATH_FILL_BAND, height);
+      for(int k = 0; k < nb_segments; k++)
+      {
+        const int *seg = segments + 4 * k;
+        // a segment touches the rows between its end points, and one more for rounding
+        if(MAX(seg[1], seg[3]) + 1 < y0 || MIN(seg[1], seg[3]) - 1 >= y1) continue;
+        _path_falloff_roi(buffer, seg, seg + 2, width, y0, y1);
+      }
+    }
+    free(segments);
+
     if(darktable.unmuted & DT_DEBUG_PERF)
       dt_print(DT_DEBUG_MASKS, "[masks %s] path_fill fill falloff took %0.04f sec\n", form->name,
                dt_get_wtime() - start2);
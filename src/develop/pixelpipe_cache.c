@@ -22,14 +22,9 @@
 #include <stdlib.h>
 
 
-// TODO: make cache global (needs to be thread safe then)
-// plan:
-// - look at mipmap_cache.c, for the full buffer allocs
-// - do that, but for `large' and `regular' buffers (full + export/dr mode), so 2 caches
-//   (in fact, maybe 3, one for preview pipes?)
-// - have at most 3 read locks all the time per pipe, get them at create time
-//   ping, pong, and priority buffer (focused plugin)
-// - drop read by the time another is requested (with priority, drop that, or alternating ping and pong?)
+// the per-pipe cache is a small working set of buffers owned by one pipe. buffers which are expensive
+// to recompute are additionally copied into darktable.pixelpipe_cache (the shared cache at the end of
+// this file) so other pipes and later runs can pick them up again.
 
 int dt_dev_pixelpipe_cache_init(dt_dev_pixelpipe_cache_t *cache, int entries, size_t size)
 {
@@ -221,6 +216,150 @@ void dt_dev_pixelpipe_cache_print(dt_dev_pixelpipe_cache_t *cache)
   printf("cache hit rate so far: %.3f\n", (cache->queries - cache->misses) / (float)cache->queries);
 }
 
+void dt_dev_pixelpipe_shared_cache_init(dt_dev_pixelpipe_shared_cache_t *cache, size_t cost_quota)
+{
+  dt_pthread_mutex_init(&cache->lock, NULL);
+  cache->hashtable = g_hash_table_new(g_int64_hash, g_int64_equal);
+  g_queue_init(&cache->lru);
+  cache->cost = 0;
+  cache->cost_quota = cost_quota;
+  cache->queries = cache->misses = 0;
+}
+
+static void _shared_cache_line_free(dt_dev_pixelpipe_cache_line_t *line)
+{
+  dt_free_align(line->data);
+  g_slice_free1(sizeof(*line), line);
+}
+
+// needs the cache lock to be held.
+// lines which are still being copied out are only unlinked, the last user frees them.
+static void _shared_cache_line_remove(dt_dev_pixelpipe_shared_cache_t *cache,
+                                      dt_dev_pixelpipe_cache_line_t *line)
+{
+  g_hash_table_remove(cache->hashtable, &line->hash);
+  g_queue_delete_link(&cache->lru, line->link);
+  line->link = NULL;
+  cache->cost -= line->size;
+  if(!line->users) _shared_cache_line_free(line);
+}
+
+void dt_dev_pixelpipe_shared_cache_cleanup(dt_dev_pixelpipe_shared_cache_t *cache)
+{
+  g_hash_table_destroy(cache->hashtable);
+  for(GList *l = cache->lru.head; l; l = g_list_next(l))
+    _shared_cache_line_free((dt_dev_pixelpipe_cache_line_t *)l->data);
+  g_queue_clear(&cache->lru);
+  dt_pthread_mutex_destroy(&cache->lock);
+}
+
+dt_dev_pixelpipe_cache_line_t *dt_dev_pixelpipe_shared_cache_get(dt_dev_pixelpipe_shared_cache_t *cache,
+                                                                 const uint64_t hash, const size_t size)
+{
+  if(!cache->cost_quota) return NULL;
+  dt_pthread_mutex_lock(&cache->lock);
+  cache->queries++;
+  dt_dev_pixelpipe_cache_line_t *line
+      = (dt_dev_pixelpipe_cache_line_t *)g_hash_table_lookup(cache->hashtable, &hash);
+  if(!line || line->size < size)
+  {
+    cache->misses++;
+    dt_pthread_mutex_unlock(&cache->lock);
+    return NULL;
+  }
+  line->users++;
+  // bubble up in lru queue:
+  g_queue_unlink(&cache->lru, line->link);
+  g_queue_push_tail_link(&cache->lru, line->link);
+  dt_pthread_mutex_unlock(&cache->lock);
+  return line;
+}
+
+void dt_dev_pixelpipe_shared_cache_release(dt_dev_pixelpipe_shared_cache_t *cache,
+                                           dt_dev_pixelpipe_cache_line_t *line)
+{
+  dt_pthread_mutex_lock(&cache->lock);
+  const int orphaned = (--line->users == 0) && !line->link;
+  dt_pthread_mutex_unlock(&cache->lock);
+  if(orphaned) _shared_cache_line_free(line);
+}
+
+void dt_dev_pixelpipe_shared_cache_put(dt_dev_pixelpipe_shared_cache_t *cache, const uint64_t hash,
+                                       const int32_t imgid, const void *data, const size_t size,
+                                       const float *processed_maximum)
+{
+  if(size == 0 || size > cache->cost_quota) return;
+
+  dt_pthread_mutex_lock(&cache->lock);
+  const int found = g_hash_table_contains(cache->hashtable, &hash);
+  dt_pthread_mutex_unlock(&cache->lock);
+  if(found) return;
+
+  // copy without holding the lock, these buffers can be huge.
+  dt_dev_pixelpipe_cache_line_t *line
+      = (dt_dev_pixelpipe_cache_line_t *)g_slice_alloc(sizeof(dt_dev_pixelpipe_cache_line_t));
+  line->data = dt_alloc_align(16, size);
+  if(!line->data)
+  {
+    g_slice_free1(sizeof(*line), line);
+    return;
+  }
+  memcpy(line->data, data, size);
+  line->hash = hash;
+  line->imgid = imgid;
+  line->size = size;
+  line->users = 0;
+  for(int k = 0; k < 3; k++) line->processed_maximum[k] = processed_maximum ? processed_maximum[k] : 1.0f;
+
+  dt_pthread_mutex_lock(&cache->lock);
+  // somebody else might have been faster:
+  if(g_hash_table_contains(cache->hashtable, &hash)) goto discard;
+
+  // evict from the lru end, skipping lines which are currently being copied out.
+  GList *l = cache->lru.head;
+  while(l && cache->cost + size > cache->cost_quota)
+  {
+    dt_dev_pixelpipe_cache_line_t *victim = (dt_dev_pixelpipe_cache_line_t *)l->data;
+    l = g_list_next(l);
+    if(victim->users) continue;
+    _shared_cache_line_remove(cache, victim);
+  }
+  if(cache->cost + size > cache->cost_quota) goto discard;
+
+  g_queue_push_tail(&cache->lru, line);
+  line->link = cache->lru.tail;
+  g_hash_table_insert(cache->hashtable, &line->hash, line);
+  cache->cost += size;
+  dt_pthread_mutex_unlock(&cache->lock);
+  return;
+
+discard:
+  dt_pthread_mutex_unlock(&cache->lock);
+  _shared_cache_line_free(line);
+}
+
+void dt_dev_pixelpipe_shared_cache_remove_image(dt_dev_pixelpipe_shared_cache_t *cache, const int32_t imgid)
+{
+  dt_pthread_mutex_lock(&cache->lock);
+  GList *l = cache->lru.head;
+  while(l)
+  {
+    dt_dev_pixelpipe_cache_line_t *line = (dt_dev_pixelpipe_cache_line_t *)l->data;
+    l = g_list_next(l);
+    if(line->imgid == imgid) _shared_cache_line_remove(cache, line);
+  }
+  dt_pthread_mutex_unlock(&cache->lock);
+}
+
+void dt_dev_pixelpipe_shared_cache_print(dt_dev_pixelpipe_shared_cache_t *cache)
+{
+  dt_pthread_mutex_lock(&cache->lock);
+  printf("[pixelpipe cache] fill %.2f/%.2f MB in %u lines, hit rate so far: %.3f\n",
+         cache->cost / (1024.0 * 1024.0), cache->cost_quota / (1024.0 * 1024.0), g_queue_get_length(&cache->lru),
+         cache->queries ? (cache->queries - cache->misses) / (float)cache->queries : 0.0f);
+  dt_pthread_mutex_unlock(&cache->lock);
+}
+
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
 // kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
@@ -18,6 +18,8 @@
 #ifndef DT_PIXELPIPE_CACHE_H
 #define DT_PIXELPIPE_CACHE_H
 
+#include "common/dtpthread.h"
+#include <glib.h>
 #include <inttypes.h>
 /**
  * implements a simple pixel cache suitable for caching float images
@@ -76,6 +78,57 @@ void dt_dev_pixelpipe_cache_invalidate(dt_dev_pixelpipe_cache_t *cache, void *da
 /** print out cache lines/hashes (debug). */
 void dt_dev_pixelpipe_cache_print(dt_dev_pixelpipe_cache_t *cache);
 
+/**
+ * process-wide cache for intermediate buffers, shared by all pixelpipes (full, preview, export, ..).
+ * the per-pipe cache above stays the working set of the pipe, expensive buffers are copied
+ * into this one and copied back out when another pipe (or the same pipe after its own cache
+ * has been cycled) asks for the same hash. it is thread safe and limited by a memory budget.
+ */
+typedef struct dt_dev_pixelpipe_cache_line_t
+{
+  uint64_t hash;
+  int32_t imgid;
+  size_t size;
+  float processed_maximum[3];
+  void *data;
+  int32_t users; // number of threads currently copying out of this line, protected by cache lock
+  GList *link;   // position in the lru queue
+} dt_dev_pixelpipe_cache_line_t;
+
+typedef struct dt_dev_pixelpipe_shared_cache_t
+{
+  dt_pthread_mutex_t lock;
+  GHashTable *hashtable; // hash -> line
+  GQueue lru;            // head is about to be evicted, tail is most recently used
+  size_t cost;           // bytes currently allocated
+  size_t cost_quota;     // bytes we are allowed to use, 0 disables the cache
+  // profiling:
+  uint64_t queries;
+  uint64_t misses;
+} dt_dev_pixelpipe_shared_cache_t;
+
+void dt_dev_pixelpipe_shared_cache_init(dt_dev_pixelpipe_shared_cache_t *cache, size_t cost_quota);
+void dt_dev_pixelpipe_shared_cache_cleanup(dt_dev_pixelpipe_shared_cache_t *cache);
+
+/** returns the line for the given hash if it holds at least size bytes, or NULL. the line can't be
+  * evicted until it is handed back via dt_dev_pixelpipe_shared_cache_release(). */
+dt_dev_pixelpipe_cache_line_t *dt_dev_pixelpipe_shared_cache_get(dt_dev_pixelpipe_shared_cache_t *cache,
+                                                                 const uint64_t hash, const size_t size);
+void dt_dev_pixelpipe_shared_cache_release(dt_dev_pixelpipe_shared_cache_t *cache,
+                                           dt_dev_pixelpipe_cache_line_t *line);
+
+/** copies the buffer into the cache, evicting least recently used lines to stay within the budget.
+  * processed_maximum may be NULL for buffers which aren't pixels. */
+void dt_dev_pixelpipe_shared_cache_put(dt_dev_pixelpipe_shared_cache_t *cache, const uint64_t hash,
+                                       const int32_t imgid, const void *data, const size_t size,
+                                       const float *processed_maximum);
+
+/** drops all lines belonging to the given image, in case its input pixels changed. */
+void dt_dev_pixelpipe_shared_cache_remove_image(dt_dev_pixelpipe_shared_cache_t *cache, const int32_t imgid);
+
+/** print out fill level and hit rate (debug). */
+void dt_dev_pixelpipe_shared_cache_print(dt_dev_pixelpipe_shared_cache_t *cache);
+
 #endif
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
@@ -128,6 +128,7 @@ int dt_dev_pixelpipe_init_cached(dt_dev_pixelpipe_t *pipe, size_t size, int32_t
   pipe->backbuf_size = size;
   if(!dt_dev_pixelpipe_cache_init(&(pipe->cache), entries, pipe->backbuf_size)) return 0;
   pipe->cache_obsolete = 0;
+  memset(&pipe->anchor, 0, sizeof(pipe->anchor));
   pipe->backbuf = NULL;
   pipe->processing = 0;
   pipe->shutdown = 0;
@@ -159,17 +160,121 @@ void dt_dev_pixelpipe_cleanup(dt_dev_pixelpipe_t *pipe)
   dt_dev_pixelpipe_cleanup_nodes(pipe);
   // so now it's safe to clean up cache:
   dt_dev_pixelpipe_cache_cleanup(&(pipe->cache));
+  dt_free_align(pipe->anchor.data);
+  pipe->anchor.data = NULL;
+  pipe->anchor.size = 0;
   dt_pthread_mutex_unlock(&pipe->backbuf_mutex);
   dt_pthread_mutex_destroy(&(pipe->backbuf_mutex));
   dt_pthread_mutex_destroy(&(pipe->busy_mutex));
 }
 
+gchar *dt_dev_pixelpipe_profile_json(dt_dev_pixelpipe_t *pipe)
+{
+  JsonBuilder *builder = json_builder_new();
+  json_builder_begin_object(builder);
+  json_builder_set_member_name(builder, "pipe");
+  json_builder_add_string_value(builder, _pipe_type_to_str(pipe->type));
+  json_builder_set_member_name(builder, "image");
+  json_builder_add_int_value(builder, pipe->image.id);
+  json_builder_set_member_name(builder, "width");
+  json_builder_add_int_value(builder, pipe->processed_width);
+  json_builder_set_member_name(builder, "height");
+  json_builder_add_int_value(builder, pipe->processed_height);
+  json_builder_set_member_name(builder, "cache_queries");
+  json_builder_add_int_value(builder, pipe->cache.queries);
+  json_builder_set_member_name(builder, "cache_misses");
+  json_builder_add_int_value(builder, pipe->cache.misses);
+
+  json_builder_set_member_name(builder, "modules");
+  json_builder_begin_array(builder);
+  for(GList *nodes = pipe->nodes; nodes; nodes = g_list_next(nodes))
+  {
+    const dt_dev_pixelpipe_iop_t *piece = (dt_dev_pixelpipe_iop_t *)nodes->data;
+    const dt_dev_pixelpipe_iop_stats_t *stats = &piece->stats;
+    if(!piece->enabled && !stats->processed) continue;
+    json_builder_begin_object(builder);
+    json_builder_set_member_name(builder, "op");
+    json_builder_add_string_value(builder, piece->module->op);
+    json_builder_set_member_name(builder, "instance");
+    json_builder_add_string_value(builder, piece->module->multi_name);
+    json_builder_set_member_name(builder, "enabled");
+    json_builder_add_boolean_value(builder, piece->enabled);
+    json_builder_set_member_name(builder, "processed");
+    json_builder_add_int_value(builder, stats->processed);
+    json_builder_set_member_name(builder, "cache_hits");
+    json_builder_add_int_value(builder, stats->cache_hits);
+    json_builder_set_member_name(builder, "shared_cache_hits");
+    json_builder_add_int_value(builder, stats->shared_hits);
+    json_builder_set_member_name(builder, "anchor_hits");
+    json_builder_add_int_value(builder, stats->anchor_hits);
+    json_builder_set_member_name(builder, "gpu");
+    json_builder_add_int_value(builder, stats->gpu);
+    json_builder_set_member_name(builder, "tiled");
+    json_builder_add_int_value(builder, stats->tiled);
+    json_builder_set_member_name(builder, "tiles");
+    json_builder_add_int_value(builder, stats->tiles);
+    json_builder_set_member_name(builder, "tile_width");
+    json_builder_add_int_value(builder, stats->tile_width);
+    json_builder_set_member_name(builder, "tile_height");
+    json_builder_add_int_value(builder, stats->tile_height);
+    json_builder_set_member_name(builder, "wall_time");
+    json_builder_add_double_value(builder, stats->wall);
+    json_builder_set_member_name(builder, "thread_cpu_time");
+    json_builder_add_double_value(builder, stats->thread_cpu);
+    json_builder_set_member_name(builder, "output_bytes");
+    json_builder_add_int_value(builder, stats->output_bytes);
+    json_builder_end_object(builder);
+  }
+  json_builder_end_array(builder);
+  json_builder_end_object(builder);
+
+  JsonGenerator *generator = json_generator_new();
+  JsonNode *root = json_builder_get_root(builder);
+  json_generator_set_root(generator, root);
+  gchar *json = json_generator_to_data(generator, NULL);
+  json_node_free(root);
+  g_object_unref(generator);
+  g_object_unref(builder);
+  return json;
+}
+
+void dt_dev_pixelpipe_profile_reset(dt_dev_pixelpipe_t *pipe)
+{
+  for(GList *nodes = pipe->nodes; nodes; nodes = g_list_next(nodes))
+  {
+    dt_dev_pixelpipe_iop_t *piece = (dt_dev_pixelpipe_iop_t *)nodes->data;
+    memset(&piece->stats, 0, sizeof(dt_dev_pixelpipe_iop_stats_t));
+  }
+}
+
+void dt_dev_pixelpipe_profile_write(dt_dev_pixelpipe_t *pipe)
+{
+  if(!darktable.pipe_profile) return;
+  gboolean active = FALSE;
+  for(GList *nodes = pipe->nodes; nodes && !active; nodes = g_list_next(nodes))
+  {
+    const dt_dev_pixelpipe_iop_t *piece = (dt_dev_pixelpipe_iop_t *)nodes->data;
+    active = piece->stats.processed || piece->stats.cache_hits || piece->stats.shared_hits;
+  }
+  if(!active) return;
+  gchar *json = dt_dev_pixelpipe_profile_json(pipe);
+  flockfile(darktable.pipe_profile);
+  fputs(json, darktable.pipe_profile);
+  fputc('\n', darktable.pipe_profile);
+  fflush(darktable.pipe_profile);
+  funlockfile(darktable.pipe_profile);
+  g_free(json);
+  dt_dev_pixelpipe_profile_reset(pipe);
+}
+
 void dt_dev_pixelpipe_cleanup_nodes(dt_dev_pixelpipe_t *pipe)
 {
   // FIXME: either this or all process() -> gdk mutices have to be changed!
   //        (this is a circular dependency on busy_mutex and the gdk mutex)
   dt_pthread_mutex_lock(&pipe->busy_mutex);
   pipe->shutdown = 1;
+  // whatever was processed since the last dt_dev_process_* run, or everything for the export pipes
+  dt_dev_pixelpipe_profile_write(pipe);
   // destroy all nodes
   GList *nodes = pipe->nodes;
   while(nodes)
@@ -186,6 +291,8 @@ void dt_dev_pixelpipe_cleanup_nodes(dt_dev_pixelpipe_t *pipe)
   }
   g_list_free(pipe->nodes);
   pipe->nodes = NULL;
+  pipe->anchor.piece = NULL;
+  pipe->anchor.hash = 0;
   dt_pthread_mutex_unlock(&pipe->busy_mutex);
 }
 
@@ -705,6 +812,117 @@ static void pixelpipe_picker_cl(int devid, dt_iop_module_t *module, cl_mem img,
 #endif
 
 
+// the shared cache sees buffers of all pipes. the input might be the downscaled mip_f, so mix that into the
+// hash, and the type of the pipe for those nodes up to module which told us in commit_params that their
+// output depends on it (demosaic quality, ..). all others can be shared between full and export pipes.
+static uint64_t _shared_cache_hash(const dt_dev_pixelpipe_t *pipe, const uint64_t hash, const int module)
+{
+  const int32_t key[4] = { dt_dev_pixelpipe_uses_downsampled_input((dt_dev_pixelpipe_t *)pipe), pipe->iwidth,
+                           pipe->iheight, pipe->mask_display };
+  uint64_t shared = hash;
+  const char *str = (const char *)key;
+  for(size_t i = 0; i < sizeof(key); i++) shared = ((shared << 5) + shared) ^ str[i];
+  GList *pieces = pipe->nodes;
+  for(int k = 0; k < module && pieces; k++, pieces = g_list_next(pieces))
+  {
+    const dt_dev_pixelpipe_iop_t *piece = (dt_dev_pixelpipe_iop_t *)pieces->data;
+    if(piece->enabled && piece->type_variant) shared = ((shared << 5) + shared) ^ piece->type_variant;
+  }
+  return shared;
+}
+
+static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, void **output,
+                                        void **cl_mem_output, int *out_bpp, const dt_iop_roi_t *roi_out,
+                                        GList *modules, GList *pieces, int pos);
+
+// a hit on the anchor skips the first pos nodes, and with them what they collect while being processed:
+// histograms, the color picker of the focused module and the live samples. don't use it while any of them
+// is wanted.
+static int _anchor_skips_collection(const dt_dev_pixelpipe_t *pipe, const dt_develop_t *dev, const int pos)
+{
+  GList *pieces = pipe->nodes;
+  for(int k = 0; k < pos && pieces; k++, pieces = g_list_next(pieces))
+  {
+    const dt_dev_pixelpipe_iop_t *piece = (dt_dev_pixelpipe_iop_t *)pieces->data;
+    if(!piece->enabled) continue;
+    if((piece->request_histogram & DT_REQUEST_ON)
+       && (dev->gui_attached || !(piece->request_histogram & DT_REQUEST_ONLY_IN_GUI)))
+      return 1;
+    if(dev->gui_attached && pipe == dev->preview_pipe
+       && ((piece->module == dev->gui_module && piece->module->request_color_pick != DT_REQUEST_COLORPICK_OFF)
+           || (darktable.lib->proxy.colorpicker.live_samples && !strcmp(piece->module->op, "gamma"))))
+      return 1;
+  }
+  return 0;
+}
+
+// obtains the input of the given node by recursing into the nodes in front of it, unless it is the
+// anchored node and its input didn't change. in that case we resume from the kept copy.
+static int _process_rec_input(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, dt_dev_pixelpipe_iop_t *piece,
+                              void **input, void **cl_mem_input, int *in_bpp, const dt_iop_roi_t *roi_in,
+                              GList *modules, GList *pieces, int pos)
+{
+  if(piece != pipe->anchor.piece)
+    return dt_dev_pixelpipe_process_rec(pipe, dev, input, cl_mem_input, in_bpp, roi_in, modules, pieces, pos);
+
+  dt_pthread_mutex_lock(&pipe->busy_mutex);
+  if(pipe->shutdown)
+  {
+    dt_pthread_mutex_unlock(&pipe->busy_mutex);
+    return 1;
+  }
+  if(_anchor_skips_collection(pipe, dev, pos))
+  {
+    pipe->anchor.hash = 0;
+    dt_pthread_mutex_unlock(&pipe->busy_mutex);
+    return dt_dev_pixelpipe_process_rec(pipe, dev, input, cl_mem_input, in_bpp, roi_in, modules, pieces, pos);
+  }
+  const uint64_t hash = dt_dev_pixelpipe_cache_hash(pipe->image.id, roi_in, pipe, pos);
+  if(pipe->anchor.hash == hash)
+  {
+    *input = pipe->anchor.data;
+    *cl_mem_input = NULL;
+    *in_bpp = pipe->anchor.bpp;
+    for(int k = 0; k < 3; k++) pipe->processed_maximum[k] = pipe->anchor.processed_maximum[k];
+    pipe->mask_display = pipe->anchor.mask_display;
+    piece->stats.anchor_hits++;
+    dt_pthread_mutex_unlock(&pipe->busy_mutex);
+    return 0;
+  }
+  dt_pthread_mutex_unlock(&pipe->busy_mutex);
+
+  if(dt_dev_pixelpipe_process_rec(pipe, dev, input, cl_mem_input, in_bpp, roi_in, modules, pieces, pos))
+    return 1;
+
+  // keep a copy, unless the valid data only lives on the gpu
+  if(*cl_mem_input != NULL) return 0;
+  dt_pthread_mutex_lock(&pipe->busy_mutex);
+  if(pipe->shutdown)
+  {
+    dt_pthread_mutex_unlock(&pipe->busy_mutex);
+    return 1;
+  }
+  const size_t size = (size_t)*in_bpp * roi_in->width * roi_in->height;
+  if(pipe->anchor.size < size)
+  {
+    dt_free_align(pipe->anchor.data);
+    pipe->anchor.data = dt_alloc_align(16, size);
+    pipe->anchor.size = pipe->anchor.data ? size : 0;
+  }
+  if(pipe->anchor.data)
+  {
+    memcpy(pipe->anchor.data, *input, size);
+    pipe->anchor.hash = hash;
+    pipe->anchor.bpp = *in_bpp;
+    for(int k = 0; k < 3; k++) pipe->anchor.processed_maximum[k] = pipe->processed_maximum[k];
+    pipe->anchor.mask_display = pipe->mask_display;
+  }
+  else
+    pipe->anchor.hash = 0;
+  dt_pthread_mutex_unlock(&pipe->busy_mutex);
+  return 0;
+}
+
 // recursive helper for process:
 static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, void **output,
                                         void **cl_mem_output, int *out_bpp, const dt_iop_roi_t *roi_out,
@@ -724,8 +942,8 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
     // skip this module?
     if(!piece->enabled
        || (dev->gui_module && dev->gui_module->operation_tags_filter() & module->operation_tags()))
-      return dt_dev_pixelpipe_process_rec(pipe, dev, output, cl_mem_output, out_bpp, &roi_in,
-                                          g_list_previous(modules), g_list_previous(pieces), pos - 1);
+      return _process_rec_input(pipe, dev, piece, output, cl_mem_output, out_bpp, &roi_in,
+                                g_list_previous(modules), g_list_previous(pieces), pos - 1);
   }
 
   const int bpp = get_output_bpp(module, pipe, piece, dev);
@@ -746,7 +964,10 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
     // dev->preview_pipe ? "[preview]" : "", hash);
     // copy over cached processed max for clipping:
     if(piece)
+    {
       for(int k = 0; k < 3; k++) pipe->processed_maximum[k] = piece->processed_maximum[k];
+      piece->stats.cache_hits++;
+    }
     else
       for(int k = 0; k < 3; k++) pipe->processed_maximum[k] = 1.0f;
     (void)dt_dev_pixelpipe_cache_get(&(pipe->cache), hash, bufsize, output);
@@ -755,6 +976,25 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
     // go to post-collect directly:
     goto post_process_collect_info;
   }
+  else if(modules && darktable.pixelpipe_cache)
+  {
+    // maybe another pipe (or an earlier run of this one) left the buffer in the shared cache:
+    dt_dev_pixelpipe_cache_line_t *line = dt_dev_pixelpipe_shared_cache_get(
+        darktable.pixelpipe_cache, _shared_cache_hash(pipe, hash, pos), bufsize);
+    if(line)
+    {
+      (void)dt_dev_pixelpipe_cache_get(&(pipe->cache), hash, bufsize, output);
+      for(int k = 0; k < 3; k++)
+        pipe->processed_maximum[k] = piece->processed_maximum[k] = line->processed_maximum[k];
+      piece->stats.shared_hits++;
+      dt_pthread_mutex_unlock(&pipe->busy_mutex);
+      // the line can't be evicted while we hold it, so copy without blocking the pipe:
+      memcpy(*output, line->data, bufsize);
+      dt_dev_pixelpipe_shared_cache_release(darktable.pixelpipe_cache, line);
+      goto post_process_collect_info;
+    }
+    dt_pthread_mutex_unlock(&pipe->busy_mutex);
+  }
   else
     dt_pthread_mutex_unlock(&pipe->busy_mutex);
 
@@ -856,8 +1096,8 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
 
     // recurse to get actual data of input buffer
     int in_bpp;
-    if(dt_dev_pixelpipe_process_rec(pipe, dev, &input, &cl_mem_input, &in_bpp, &roi_in,
-                                    g_list_previous(modules), g_list_previous(pieces), pos - 1))
+    if(_process_rec_input(pipe, dev, piece, &input, &cl_mem_input, &in_bpp, &roi_in, g_list_previous(modules),
+                          g_list_previous(pieces), pos - 1))
       return 1;
     piece = (dt_dev_pixelpipe_iop_t *)pieces->data;
 
@@ -927,6 +1167,7 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
 
     dt_times_t start;
     dt_get_times(&start);
+    const double start_cputime = dt_get_thread_cputime();
 
     dt_pixelpipe_flow_t pixelpipe_flow = (PIXELPIPE_FLOW_NONE | PIXELPIPE_FLOW_HISTOGRAM_NONE);
 
@@ -1789,6 +2030,15 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
     pixelpipe_flow &= ~(PIXELPIPE_FLOW_BLENDED_ON_GPU);
 #endif
 
+    dt_times_t end;
+    dt_get_times(&end);
+    piece->stats.processed++;
+    piece->stats.wall += end.clock - start.clock;
+    piece->stats.thread_cpu += dt_get_thread_cputime() - start_cputime;
+    piece->stats.output_bytes += bufsize;
+    if(pixelpipe_flow & PIXELPIPE_FLOW_PROCESSED_ON_GPU) piece->stats.gpu++;
+    if(pixelpipe_flow & PIXELPIPE_FLOW_PROCESSED_WITH_TILING) piece->stats.tiled++;
+
     char histogram_log[32] = "";
     if(!(pixelpipe_flow & PIXELPIPE_FLOW_HISTOGRAM_NONE))
     {
@@ -1813,9 +2063,20 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
             : pixelpipe_flow & PIXELPIPE_FLOW_BLENDED_ON_CPU ? "CPU" : "",
         _pipe_type_to_str(pipe->type));
     g_free(module_label);
+    piece->recomputed = 1;
     // in case we get this buffer from the cache, also get the processed max:
     for(int k = 0; k < 3; k++) piece->processed_maximum[k] = pipe->processed_maximum[k];
+
+    // publish to the shared cache, but only if the buffer took longer to compute than it takes to copy
+    // it around (assuming a conservative 1GB/s), and if the host buffer is actually valid.
+    const int publish = darktable.pixelpipe_cache && *cl_mem_output == NULL
+                        && end.clock - start.clock > bufsize / (double)(1u << 30);
+    const uint64_t shared_hash = publish ? _shared_cache_hash(pipe, hash, pos) : 0;
     dt_pthread_mutex_unlock(&pipe->busy_mutex);
+    // copied outside of the pipe lock, the output buffer stays ours until we return:
+    if(publish)
+      dt_dev_pixelpipe_shared_cache_put(darktable.pixelpipe_cache, shared_hash, pipe->image.id, *output,
+                                        bufsize, piece->processed_maximum);
     if(module == darktable.develop->gui_module)
     {
       // give the input buffer to the currently focussed plugin more weight.
@@ -2328,6 +2589,54 @@ static int dt_dev_pixelpipe_process_rec_and_backcopy(dt_dev_pixelpipe_t *pipe, d
 #endif
 }
 
+// flags all nodes whose params changed since the last complete run and moves the anchor in front of
+// the first of them. with nothing dirty, it goes in front of the focused module, which is likely to be
+// changed next.
+static void _pixelpipe_mark_dirty(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev)
+{
+  dt_pthread_mutex_lock(&pipe->busy_mutex);
+  dt_dev_pixelpipe_iop_t *first = NULL, *focused = NULL;
+  for(GList *nodes = pipe->nodes; nodes; nodes = g_list_next(nodes))
+  {
+    dt_dev_pixelpipe_iop_t *piece = (dt_dev_pixelpipe_iop_t *)nodes->data;
+    piece->dirty = (piece->hash != piece->processed_hash);
+    piece->recomputed = 0;
+    if(piece->dirty && !first) first = piece;
+    if(piece->module == dev->gui_module) focused = piece;
+  }
+  // only interactive pipes see the same module changed over and over again
+  dt_dev_pixelpipe_iop_t *anchor = NULL;
+  if(pipe->type == DT_DEV_PIXELPIPE_FULL || pipe->type == DT_DEV_PIXELPIPE_PREVIEW)
+    anchor = first ? first : focused ? focused : pipe->anchor.piece;
+  if(anchor != pipe->anchor.piece)
+  {
+    pipe->anchor.piece = anchor;
+    pipe->anchor.hash = 0;
+  }
+  dt_pthread_mutex_unlock(&pipe->busy_mutex);
+}
+
+// after a complete run, the current params are what the caches are based on. which nodes actually ran is
+// reported with -d perf (or -d dev), and counted as "processed" in the --pipe-profile output.
+static void _pixelpipe_mark_clean(dt_dev_pixelpipe_t *pipe)
+{
+  dt_pthread_mutex_lock(&pipe->busy_mutex);
+  GString *recomputed = (darktable.unmuted & (DT_DEBUG_PERF | DT_DEBUG_DEV)) ? g_string_new(NULL) : NULL;
+  for(GList *nodes = pipe->nodes; nodes; nodes = g_list_next(nodes))
+  {
+    dt_dev_pixelpipe_iop_t *piece = (dt_dev_pixelpipe_iop_t *)nodes->data;
+    piece->processed_hash = piece->hash;
+    piece->dirty = 0;
+    if(recomputed && piece->recomputed) g_string_append_printf(recomputed, " %s", piece->module->op);
+  }
+  if(recomputed)
+  {
+    dt_print(DT_DEBUG_PERF | DT_DEBUG_DEV, "[dev_pixelpipe] recomputed [%s]:%s\n",
+             _pipe_type_to_str(pipe->type), recomputed->len ? recomputed->str : " nothing");
+    g_string_free(recomputed, TRUE);
+  }
+  dt_pthread_mutex_unlock(&pipe->busy_mutex);
+}
 
 int dt_dev_pixelpipe_process(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, int x, int y, int width, int height,
                              float scale)
@@ -2350,13 +2659,19 @@ int dt_dev_pixelpipe_process(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, int x,
 
   dt_iop_roi_t roi = (dt_iop_roi_t){ x, y, width, height, scale };
   // printf("pixelpipe homebrew process start\n");
-  if(darktable.unmuted & DT_DEBUG_DEV) dt_dev_pixelpipe_cache_print(&pipe->cache);
+  if(darktable.unmuted & DT_DEBUG_DEV)
+  {
+    dt_dev_pixelpipe_cache_print(&pipe->cache);
+    if(darktable.pixelpipe_cache) dt_dev_pixelpipe_shared_cache_print(darktable.pixelpipe_cache);
+  }
 
   //  go through list of modules from the end:
   guint pos = g_list_length(dev->iop);
   GList *modules = g_list_last(dev->iop);
   GList *pieces = g_list_last(pipe->nodes);
 
+  _pixelpipe_mark_dirty(pipe, dev);
+
 // re-entry point: in case of late opencl errors we start all over again with opencl-support disabled
 restart:
 
@@ -2427,6 +2742,8 @@ restart:
     return 1;
   }
 
+  _pixelpipe_mark_clean(pipe);
+
   // terminate
   dt_pthread_mutex_lock(&pipe->backbuf_mutex);
   pipe->backbuf_hash = dt_dev_pixelpipe_cache_hash(pipe->image.id, &roi, pipe, 0);
@@ -2443,6 +2760,9 @@ restart:
 void dt_dev_pixelpipe_flush_caches(dt_dev_pixelpipe_t *pipe)
 {
   dt_dev_pixelpipe_cache_flush(&pipe->cache);
+  dt_pthread_mutex_lock(&pipe->busy_mutex);
+  pipe->anchor.hash = 0;
+  dt_pthread_mutex_unlock(&pipe->busy_mutex);
 }
 
 void dt_dev_pixelpipe_get_dimensions(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *dev, int width_in,
@@ -40,6 +40,22 @@ typedef struct dt_iop_roi_t
   float scale;
 } dt_iop_roi_t;
 
+/** profiling data of one node, accumulated over all runs of the pipe. */
+typedef struct dt_dev_pixelpipe_iop_stats_t
+{
+  uint32_t processed;    // number of times the module actually ran
+  uint32_t cache_hits;   // output found in the cache of the pipe
+  uint32_t shared_hits;  // output copied from the cache shared by all pipes
+  uint32_t anchor_hits;  // input taken from the anchor, the nodes in front were skipped
+  uint32_t gpu;          // runs processed with opencl
+  uint32_t tiled;        // runs which needed tiling
+  uint32_t tiles;        // tiles processed during those
+  int tile_width, tile_height; // largest tile, including overlap
+  double wall;           // seconds spent in process and blending
+  double thread_cpu;     // cpu seconds of the pipe thread during those, without the openmp workers
+  uint64_t output_bytes; // size of the output buffers, not what the module allocated meanwhile
+} dt_dev_pixelpipe_iop_stats_t;
+
 typedef struct dt_dev_pixelpipe_iop_t
 {
   struct dt_iop_module_t *module;  // the module in the dev operation stack
@@ -62,7 +78,12 @@ typedef struct dt_dev_pixelpipe_iop_t
   dt_iop_roi_t buf_in,
       buf_out;                // theoretical full buffer regions of interest, as passed through modify_roi_out
   int process_cl_ready;       // set this to 0 in commit_params to temporarily disable the use of process_cl
+  int type_variant;           // set this in commit_params if the output depends on the type of the pipe
   float processed_maximum[3]; // sensor saturation after this iop, used internally for caching
+  uint64_t processed_hash;    // hash as of the last complete run of the pipe
+  int dirty;                  // hash changed since the last complete run of the pipe
+  int recomputed;             // actually processed (not taken from a cache) during the last run
+  dt_dev_pixelpipe_iop_stats_t stats;
 } dt_dev_pixelpipe_iop_t;
 
 typedef enum dt_dev_pixelpipe_change_t
@@ -75,6 +96,22 @@ typedef enum dt_dev_pixelpipe_change_t
   DT_DEV_PIPE_ZOOMED = 1 << 3 // zoom event, preview pipe does not need changes
 } dt_dev_pixelpipe_change_t;
 
+/**
+ * copy of the input of one node, kept outside of the caches. interactive pipes anchor it in front of
+ * the first dirty node (or the focused module), so that while the user keeps changing that module the
+ * pipe always resumes right there, no matter what else got pushed through the caches meanwhile.
+ */
+typedef struct dt_dev_pixelpipe_anchor_t
+{
+  dt_dev_pixelpipe_iop_t *piece; // the node whose input is kept, or NULL
+  uint64_t hash;                 // cache hash of the kept buffer, 0 if there is none
+  void *data;
+  size_t size;                   // allocated bytes
+  int bpp;
+  float processed_maximum[3];
+  int mask_display;
+} dt_dev_pixelpipe_anchor_t;
+
 /**
  * this encapsulates the gegl pixel pipeline.
  * a develop module will need several of these:
@@ -87,6 +124,8 @@ typedef struct dt_dev_pixelpipe_t
   dt_dev_pixelpipe_cache_t cache;
   // set to non-zero in order to obsolete old cache entries on next pixelpipe run
   int cache_obsolete;
+  // resume point for re-processing after parameter changes
+  dt_dev_pixelpipe_anchor_t anchor;
   // input buffer
   float *input;
   // width and height of input buffer
@@ -157,7 +196,8 @@ void dt_dev_pixelpipe_get_dimensions(dt_dev_pixelpipe_t *pipe, struct dt_develop
 // destroys all allocated data.
 void dt_dev_pixelpipe_cleanup(dt_dev_pixelpipe_t *pipe);
 
-// flushes all cached data. useful if input pixels unexpectedly change.
+// flushes all data cached by this pipe. useful if input pixels unexpectedly change. the lines other pipes
+// share in darktable.pixelpipe_cache are dropped when the image goes away.
 void dt_dev_pixelpipe_flush_caches(dt_dev_pixelpipe_t *pipe);
 
 // wrapper for cleanup_nodes, create_nodes, synch_all and synch_top, decides upon changed event which one to
@@ -173,12 +213,20 @@ void dt_dev_pixelpipe_synch_all(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *d
 void dt_dev_pixelpipe_synch_top(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *dev);
 
 // process region of interest of pixels. returns 1 if pipe was altered during processing.
+// only nodes behind the first dirty one are re-evaluated if possible, piece->recomputed tells which were.
 int dt_dev_pixelpipe_process(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *dev, int x, int y, int width,
                              int height, float scale);
 // convenience method that does not gamma-compress the image.
 int dt_dev_pixelpipe_process_no_gamma(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *dev, int x, int y,
                                       int width, int height, float scale);
 
+// returns the profiling data of all nodes as a json object, free with g_free().
+gchar *dt_dev_pixelpipe_profile_json(dt_dev_pixelpipe_t *pipe);
+// clears the profiling data of all nodes.
+void dt_dev_pixelpipe_profile_reset(dt_dev_pixelpipe_t *pipe);
+// appends the profiling data of the nodes to the --pipe-profile file, one json object per line, and clears it.
+void dt_dev_pixelpipe_profile_write(dt_dev_pixelpipe_t *pipe);
+
 // disable given op and all that comes after it in the pipe:
 void dt_dev_pixelpipe_disable_after(dt_dev_pixelpipe_t *pipe, const char *op);
 // disable given op and all that comes before it in the pipe:
@@ -85,6 +85,15 @@ static inline int _align_down(int n, int a)
   return n % a != 0 ? (n / a) * a : n;
 }
 
+/* record the tiling decision in the profiling statistics of the piece */
+static inline void _tiling_profile(struct dt_dev_pixelpipe_iop_t *piece, const int tiles_x, const int tiles_y,
+                                   const int width, const int height)
+{
+  piece->stats.tiles += tiles_x * tiles_y;
+  piece->stats.tile_width = _max(piece->stats.tile_width, width);
+  piece->stats.tile_height = _max(piece->stats.tile_height, height);
+}
+
 
 void _print_roi(const dt_iop_roi_t *roi, const char *label)
 {
@@ -696,6 +705,7 @@ static void _default_process_tiling_ptp(struct dt_iop_module_t *self, struct dt_
   dt_print(DT_DEBUG_DEV,
            "[default_process_tiling_ptp] (%d x %d) tiles with max dimensions %d x %d and overlap %d\n",
            tiles_x, tiles_y, width, height, overlap);
+  _tiling_profile(piece, tiles_x, tiles_y, width, height);
 
   /* reserve input and output buffers for tiles */
   input = dt_alloc_align(64, (size_t)width * height * in_bpp);
@@ -967,6 +977,7 @@ static void _default_process_tiling_roi(struct dt_iop_module_t *self, struct dt_
            self->op, roi_in->width, roi_in->height);
   dt_print(DT_DEBUG_DEV, "[default_process_tiling_roi] (%d x %d) tiles with max dimensions %d x %d\n",
            tiles_x, tiles_y, width, height);
+  _tiling_profile(piece, tiles_x, tiles_y, width, height);
 
 
   /* store processed_maximum to be re-used and aggregated */
@@ -1294,6 +1305,7 @@ static int _default_process_tiling_cl_ptp(struct dt_iop_module_t *self, struct d
   dt_print(DT_DEBUG_OPENCL,
            "[default_process_tiling_cl_ptp] (%d x %d) tiles with max dimensions %d x %d and overlap %d\n",
            tiles_x, tiles_y, width, height, overlap);
+  _tiling_profile(piece, tiles_x, tiles_y, width, height);
 
   /* store processed_maximum to be re-used and aggregated */
   float processed_maximum_saved[3];
@@ -1665,6 +1677,7 @@ static int _default_process_tiling_cl_roi(struct dt_iop_module_t *self, struct d
   dt_print(DT_DEBUG_OPENCL,
            "[default_process_tiling_cl_roi] (%d x %d) tiles with max input dimensions %d x %d\n", tiles_x,
            tiles_y, width, height);
+  _tiling_profile(piece, tiles_x, tiles_y, width, height);
 
 
   /* store processed_maximum to be re-used and aggregated */
@@ -0,0 +1,301 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "develop/viewport_cache.h"
+#include "common/darktable.h"
+#include "develop/develop.h"
+#include "develop/imageop.h"
+#include "develop/pixelpipe_hb.h"
+#include "develop/tiling.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static guint _tile_hash(gconstpointer key)
+{
+  const dt_dev_viewport_tile_t *tile = (const dt_dev_viewport_tile_t *)key;
+  uint64_t hash = tile->hash;
+  const int32_t coords[2] = { tile->tx, tile->ty };
+  const char *str = (const char *)coords;
+  for(size_t i = 0; i < sizeof(coords); i++) hash = ((hash << 5) + hash) ^ str[i];
+  str = (const char *)&tile->scale;
+  for(size_t i = 0; i < sizeof(float); i++) hash = ((hash << 5) + hash) ^ str[i];
+  return (guint)(hash ^ (hash >> 32));
+}
+
+static gboolean _tile_equal(gconstpointer a, gconstpointer b)
+{
+  const dt_dev_viewport_tile_t *ta = (const dt_dev_viewport_tile_t *)a;
+  const dt_dev_viewport_tile_t *tb = (const dt_dev_viewport_tile_t *)b;
+  return ta->hash == tb->hash && ta->scale == tb->scale && ta->tx == tb->tx && ta->ty == tb->ty;
+}
+
+static void _tile_remove(dt_dev_viewport_cache_t *cache, dt_dev_viewport_tile_t *tile)
+{
+  g_hash_table_remove(cache->tiles, tile);
+  g_queue_delete_link(&cache->lru, tile->link);
+  dt_free_align(tile->data);
+  free(tile);
+}
+
+// copies a block of 4 byte pixels, strides are in pixels
+static void _copy_block(uint8_t *dst, const int dst_stride, const uint8_t *src, const int src_stride,
+                        const int width, const int height)
+{
+  for(int j = 0; j < height; j++)
+    memcpy(dst + (size_t)4 * j * dst_stride, src + (size_t)4 * j * src_stride, (size_t)4 * width);
+}
+
+void dt_dev_viewport_cache_init(dt_dev_viewport_cache_t *cache, size_t memory)
+{
+  memset(cache, 0, sizeof(dt_dev_viewport_cache_t));
+  cache->tiles = g_hash_table_new(_tile_hash, _tile_equal);
+  g_queue_init(&cache->lru);
+  cache->max_tiles = MAX(1, memory / ((size_t)4 * DT_DEV_VIEWPORT_TILE_SIZE * DT_DEV_VIEWPORT_TILE_SIZE));
+}
+
+// pixels of context a block needs around it to come out like a part of the whole image. modules with a
+// neighbourhood and no modify_roi_in (shadhi, lowpass, bloom, sharpen, ...) only report it as tiling overlap,
+// and the neighbourhoods add up along the pipe.
+static int _pipe_overlap(dt_dev_pixelpipe_t *pipe, const float scale)
+{
+  const dt_iop_roi_t roi
+      = (dt_iop_roi_t){ 0, 0, pipe->processed_width * scale, pipe->processed_height * scale, scale };
+  int overlap = 0;
+  for(GList *nodes = pipe->nodes; nodes; nodes = g_list_next(nodes))
+  {
+    dt_dev_pixelpipe_iop_t *piece = (dt_dev_pixelpipe_iop_t *)nodes->data;
+    if(!piece->enabled) continue;
+    dt_develop_tiling_t tiling = { 0 };
+    piece->module->tiling_callback(piece->module, piece, &roi, &roi, &tiling);
+    overlap += tiling.overlap;
+  }
+  return overlap;
+}
+
+void dt_dev_viewport_cache_cleanup(dt_dev_viewport_cache_t *cache)
+{
+  dt_dev_viewport_cache_flush(cache);
+  g_hash_table_destroy(cache->tiles);
+  for(int k = 0; k < 2; k++) dt_free_align(cache->buf[k]);
+}
+
+void dt_dev_viewport_cache_flush(dt_dev_viewport_cache_t *cache)
+{
+  while(!g_queue_is_empty(&cache->lru))
+    _tile_remove(cache, (dt_dev_viewport_tile_t *)g_queue_peek_head(&cache->lru));
+}
+
+// returns the tile if it is cached with the expected size
+static dt_dev_viewport_tile_t *_tile_get(dt_dev_viewport_cache_t *cache, const uint64_t hash, const float scale,
+                                         const int tx, const int ty, const int width, const int height)
+{
+  const dt_dev_viewport_tile_t key = { .hash = hash, .scale = scale, .tx = tx, .ty = ty };
+  dt_dev_viewport_tile_t *tile = (dt_dev_viewport_tile_t *)g_hash_table_lookup(cache->tiles, &key);
+  cache->queries++;
+  if(!tile || tile->width != width || tile->height != height)
+  {
+    cache->misses++;
+    return NULL;
+  }
+  g_queue_unlink(&cache->lru, tile->link);
+  g_queue_push_tail_link(&cache->lru, tile->link);
+  tile->request = cache->request;
+  return tile;
+}
+
+// copies the pixels out of src, which has a stride of src_stride pixels
+static dt_dev_viewport_tile_t *_tile_put(dt_dev_viewport_cache_t *cache, const uint64_t hash, const float scale,
+                                         const int tx, const int ty, const int width, const int height,
+                                         const uint8_t *src, const int src_stride)
+{
+  const dt_dev_viewport_tile_t key = { .hash = hash, .scale = scale, .tx = tx, .ty = ty };
+  dt_dev_viewport_tile_t *tile = (dt_dev_viewport_tile_t *)g_hash_table_lookup(cache->tiles, &key);
+  if(tile) _tile_remove(cache, tile);
+
+  // evict least recently used tiles, but none the current request still needs
+  while(g_queue_get_length(&cache->lru) >= cache->max_tiles)
+  {
+    dt_dev_viewport_tile_t *old = (dt_dev_viewport_tile_t *)g_queue_peek_head(&cache->lru);
+    if(old->request == cache->request) break;
+    _tile_remove(cache, old);
+  }
+
+  tile = (dt_dev_viewport_tile_t *)malloc(sizeof(dt_dev_viewport_tile_t));
+  if(!tile) return NULL;
+  *tile = key;
+  tile->width = width;
+  tile->height = height;
+  tile->request = cache->request;
+  tile->data = (uint8_t *)dt_alloc_align(16, (size_t)4 * width * height);
+  if(!tile->data)
+  {
+    free(tile);
+    return NULL;
+  }
+  _copy_block(tile->data, width, src, src_stride, width, height);
+  g_queue_push_tail(&cache->lru, tile);
+  tile->link = g_queue_peek_tail_link(&cache->lru);
+  g_hash_table_insert(cache->tiles, tile, tile);
+  return tile;
+}
+
+int dt_dev_viewport_cache_process(dt_dev_viewport_cache_t *cache, dt_dev_pixelpipe_t *pipe, dt_develop_t *dev,
+                                  int x, int y, int width, int height, float scale)
+{
+  const int T = DT_DEV_VIEWPORT_TILE_SIZE;
+  if(width <= 0 || height <= 0) return dt_dev_pixelpipe_process(pipe, dev, x, y, width, height, scale);
+
+  // with more context than a tile, processing the blocks would cost more than the whole viewport
+  const int overlap = _pipe_overlap(pipe, scale);
+  if(overlap > T) return dt_dev_pixelpipe_process(pipe, dev, x, y, width, height, scale);
+
+  // same condition under which the pipe would drop its own caches
+  if(pipe->cache_obsolete) dt_dev_viewport_cache_flush(cache);
+  cache->request++;
+
+  // the hash of all nodes, independent of the region of interest
+  const dt_iop_roi_t roi = (dt_iop_roi_t){ 0, 0, 0, 0, scale };
+  const uint64_t hash = dt_dev_pixelpipe_cache_hash(pipe->image.id, &roi, pipe, g_list_length(pipe->nodes));
+
+  // tiles are cut at the border of the processed image
+  const int ext_wd = MAX(x + width, (int)(pipe->processed_width * scale));
+  const int ext_ht = MAX(y + height, (int)(pipe->processed_height * scale));
+  const int tx0 = x / T, ty0 = y / T;
+  const int ntx = (x + width - 1) / T - tx0 + 1, nty = (y + height - 1) / T - ty0 + 1;
+
+  // the viewport is assembled in the buffer which isn't the backbuf right now
+  const int back = !cache->front;
+  const size_t size = (size_t)4 * width * height;
+  if(cache->buf_size[back] < size)
+  {
+    dt_free_align(cache->buf[back]);
+    cache->buf[back] = (uint8_t *)dt_alloc_align(16, size);
+    cache->buf_size[back] = cache->buf[back] ? size : 0;
+  }
+  dt_dev_viewport_tile_t **tiles = (dt_dev_viewport_tile_t **)calloc((size_t)ntx * nty, sizeof(*tiles));
+  if(!cache->buf[back] || !tiles)
+  {
+    free(tiles);
+    return dt_dev_pixelpipe_process(pipe, dev, x, y, width, height, scale);
+  }
+  uint8_t *buf = cache->buf[back];
+
+  int missing = 0;
+  for(int tj = 0; tj < nty; tj++)
+    for(int ti = 0; ti < ntx; ti++)
+    {
+      const int tx = tx0 + ti, ty = ty0 + tj;
+      tiles[tj * ntx + ti]
+          = _tile_get(cache, hash, scale, tx, ty, MIN(T, ext_wd - tx * T), MIN(T, ext_ht - ty * T));
+      if(!tiles[tj * ntx + ti]) missing++;
+    }
+
+  if(missing == ntx * nty)
+  {
+    // nothing to reuse, as after a parameter change. tile-aligned blocks would only cost time here, so
+    // process exactly the viewport and keep the tiles which are inside of it with all of their context,
+    // or whose context is cut by the border of the image anyway.
+    if(dt_dev_pixelpipe_process(pipe, dev, x, y, width, height, scale)) goto error;
+    _copy_block(buf, width, pipe->backbuf, width, width, height);
+    for(int tj = 0; tj < nty; tj++)
+      for(int ti = 0; ti < ntx; ti++)
+      {
+        const int tx = tx0 + ti, ty = ty0 + tj;
+        const int tw = MIN(T, ext_wd - tx * T), th = MIN(T, ext_ht - ty * T);
+        if((tx * T - x < overlap && x > 0) || (ty * T - y < overlap && y > 0)
+           || (x + width - tx * T - tw < overlap && x + width < ext_wd)
+           || (y + height - ty * T - th < overlap && y + height < ext_ht))
+          continue;
+        _tile_put(cache, hash, scale, tx, ty, tw, th,
+                  pipe->backbuf + (size_t)4 * ((ty * T - y) * width + tx * T - x), width);
+      }
+  }
+  else
+  {
+    // cover the missing tiles with few rectangular blocks, so the overlap the modules need around
+    // their region of interest is only paid a few times.
+    for(int tj = 0; tj < nty; tj++)
+      for(int ti = 0; ti < ntx; ti++)
+      {
+        if(tiles[tj * ntx + ti]) continue;
+        int ti1 = ti, tj1 = tj;
+        while(ti1 + 1 < ntx && !tiles[tj * ntx + ti1 + 1]) ti1++;
+        for(int grow = 1; grow && tj1 + 1 < nty;)
+        {
+          for(int u = ti; u <= ti1; u++)
+            if(tiles[(tj1 + 1) * ntx + u]) grow = 0;
+          if(grow) tj1++;
+        }
+
+        // the block with its overlap, which is cropped off again when the tiles are taken out
+        const int bx = MAX(0, (tx0 + ti) * T - overlap), by = MAX(0, (ty0 + tj) * T - overlap);
+        const int bw = MIN(ext_wd, (tx0 + ti1 + 1) * T + overlap) - bx;
+        const int bh = MIN(ext_ht, (ty0 + tj1 + 1) * T + overlap) - by;
+        if(dt_dev_pixelpipe_process(pipe, dev, bx, by, bw, bh, scale)) goto error;
+
+        for(int v = tj; v <= tj1; v++)
+          for(int u = ti; u <= ti1; u++)
+          {
+            const int tx = tx0 + u, ty = ty0 + v;
+            const int tw = MIN(T, ext_wd - tx * T), th = MIN(T, ext_ht - ty * T);
+            tiles[v * ntx + u] = _tile_put(cache, hash, scale, tx, ty, tw, th,
+                                           pipe->backbuf + (size_t)4 * ((ty * T - by) * bw + tx * T - bx), bw);
+            if(!tiles[v * ntx + u])
+            {
+              // out of memory, do it the old way
+              free(tiles);
+              return dt_dev_pixelpipe_process(pipe, dev, x, y, width, height, scale);
+            }
+          }
+      }
+
+    // assemble the viewport
+    for(int tj = 0; tj < nty; tj++)
+      for(int ti = 0; ti < ntx; ti++)
+      {
+        const dt_dev_viewport_tile_t *tile = tiles[tj * ntx + ti];
+        const int ox = tile->tx * T, oy = tile->ty * T;
+        const int ix0 = MAX(x, ox), ix1 = MIN(x + width, ox + tile->width);
+        const int iy0 = MAX(y, oy), iy1 = MIN(y + height, oy + tile->height);
+        _copy_block(buf + (size_t)4 * ((iy0 - y) * width + ix0 - x), width,
+                    tile->data + (size_t)4 * ((iy0 - oy) * tile->width + ix0 - ox), tile->width, ix1 - ix0,
+                    iy1 - iy0);
+      }
+  }
+  dt_print(DT_DEBUG_DEV, "[viewport_cache] processed %d of %d tiles, %u tiles cached\n", missing, ntx * nty,
+           g_queue_get_length(&cache->lru));
+
+  dt_pthread_mutex_lock(&pipe->backbuf_mutex);
+  const dt_iop_roi_t roi_out = (dt_iop_roi_t){ x, y, width, height, scale };
+  pipe->backbuf_hash = dt_dev_pixelpipe_cache_hash(pipe->image.id, &roi_out, pipe, 0);
+  pipe->backbuf = buf;
+  pipe->backbuf_width = width;
+  pipe->backbuf_height = height;
+  dt_pthread_mutex_unlock(&pipe->backbuf_mutex);
+  cache->front = back;
+  free(tiles);
+  return 0;
+
+error:
+  free(tiles);
+  return 1;
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
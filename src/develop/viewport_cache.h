@@ -0,0 +1,80 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef DT_DEV_VIEWPORT_CACHE_H
+#define DT_DEV_VIEWPORT_CACHE_H
+
+#include <glib.h>
+#include <inttypes.h>
+
+// edge length of a tile in output pixels, 256 kB each
+#define DT_DEV_VIEWPORT_TILE_SIZE 256
+
+/**
+ * caches the final output of the full pixelpipe in fixed-size tiles, keyed by the hash of the
+ * pipe, the scale and the tile coordinates. when the user pans around, only the tiles which just
+ * became visible are run through the pipe, the rest of the viewport is assembled from the cache.
+ * the blocks of missing tiles are processed with the overlap the modules report to tiling around
+ * them, so the tiles look the same as if the whole viewport had been processed at once.
+ */
+typedef struct dt_dev_viewport_tile_t
+{
+  uint64_t hash; // of all nodes of the pipe, see dt_dev_pixelpipe_cache_hash()
+  float scale;
+  int32_t tx, ty;        // tile coordinates, in multiples of DT_DEV_VIEWPORT_TILE_SIZE
+  int32_t width, height; // less than the tile size at the right and bottom border of the image
+  uint32_t request;      // last request which used this tile, these are never evicted
+  uint8_t *data;         // 4 bytes per pixel, like the backbuf of the pipe
+  GList *link;           // position in the lru queue
+} dt_dev_viewport_tile_t;
+
+typedef struct dt_dev_viewport_cache_t
+{
+  GHashTable *tiles; // dt_dev_viewport_tile_t -> itself
+  GQueue lru;        // head is about to be evicted, tail is most recently used
+  int32_t max_tiles;
+  uint32_t request;
+  // viewport assembled from the tiles, one of them is the backbuf of the pipe, the other one is filled
+  uint8_t *buf[2];
+  size_t buf_size[2];
+  int front;
+  // profiling:
+  uint64_t queries;
+  uint64_t misses;
+} dt_dev_viewport_cache_t;
+
+struct dt_dev_pixelpipe_t;
+struct dt_develop_t;
+
+/** keeps at most memory bytes of tiles, see the viewport_cache_memory conf key. */
+void dt_dev_viewport_cache_init(dt_dev_viewport_cache_t *cache, size_t memory);
+void dt_dev_viewport_cache_cleanup(dt_dev_viewport_cache_t *cache);
+
+/** drops all tiles, in case something which isn't part of the hash changed. */
+void dt_dev_viewport_cache_flush(dt_dev_viewport_cache_t *cache);
+
+/** like dt_dev_pixelpipe_process(), but only processes the part of the region of interest which
+ *  isn't cached yet. the pipe needs to be synched already. on success the assembled region is the
+ *  backbuf of the pipe. returns 1 if the pipe was altered during processing. */
+int dt_dev_viewport_cache_process(dt_dev_viewport_cache_t *cache, struct dt_dev_pixelpipe_t *pipe,
+                                  struct dt_develop_t *dev, int x, int y, int width, int height, float scale);
+
+#endif
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
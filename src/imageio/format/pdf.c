@@ -343,6 +343,12 @@ int levels(dt_imageio_module_data_t *p)
   return IMAGEIO_RGB | (((dt_imageio_pdf_params_t *)p)->bpp == 8 ? IMAGEIO_INT8 : IMAGEIO_INT16);
 }
 
+int flags(dt_imageio_module_data_t *data)
+{
+  // all images go into the one document kept in our params
+  return FORMAT_FLAGS_NO_PARALLEL_EXPORT;
+}
+
 const char *mime(dt_imageio_module_data_t *data)
 {
   return "application/pdf";
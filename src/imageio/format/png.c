@@ -34,9 +34,10 @@
 #include "common/colorspaces.h"
 #include "control/conf.h"
 #include "common/imageio_format.h"
+#include "common/png_deflate.h"
 #include "bauhaus/bauhaus.h"
 
-DT_MODULE(2)
+DT_MODULE(3)
 
 typedef struct dt_imageio_png_t
 {
@@ -45,6 +46,7 @@ typedef struct dt_imageio_png_t
   char style[128];
   gboolean style_append;
   int bpp;
+  int compression;
   FILE *f;
   png_structp png_ptr;
   png_infop info_ptr;
@@ -53,6 +55,7 @@ typedef struct dt_imageio_png_t
 typedef struct dt_imageio_png_gui_t
 {
   GtkWidget *bit_depth;
+  GtkWidget *compression;
 } dt_imageio_png_gui_t;
 
 /* Write EXIF data to PNG file.
@@ -120,6 +123,12 @@ static void PNGwriteRawProfile(png_struct *ping, png_info *ping_info, char *prof
   png_free(ping, text);
 }
 
+static int _write_idat(void *user_data, const uint8_t *data, size_t len)
+{
+  png_write_chunk((png_structp)user_data, (png_const_bytep) "IDAT", data, len);
+  return 0;
+}
+
 int write_image(dt_imageio_module_data_t *p_tmp, const char *filename, const void *ivoid, void *exif,
                 int exif_len, int imgid, int num, int total)
 {
@@ -155,13 +164,6 @@ int write_image(dt_imageio_module_data_t *p_tmp, const char *filename, const voi
 
   png_init_io(png_ptr, f);
 
-  png_set_compression_level(png_ptr, Z_BEST_COMPRESSION);
-  png_set_compression_mem_level(png_ptr, 8);
-  png_set_compression_strategy(png_ptr, Z_DEFAULT_STRATEGY);
-  png_set_compression_window_bits(png_ptr, 15);
-  png_set_compression_method(png_ptr, 8);
-  png_set_compression_buffer_size(png_ptr, 8192);
-
   png_set_IHDR(png_ptr, info_ptr, width, height, p->bpp, PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE,
                PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
 
@@ -195,32 +197,16 @@ int write_image(dt_imageio_module_data_t *p_tmp, const char *filename, const voi
 
   png_write_info(png_ptr, info_ptr);
 
-  /*
-   * Get rid of filler (OR ALPHA) bytes, pack XRGB/RGBX/ARGB/RGBA into
-   * RGB (4 channels -> 3 channels). The second parameter is not used.
-   */
-  png_set_filler(png_ptr, 0, PNG_FILLER_AFTER);
-
-  png_bytep *row_pointers = malloc((size_t)height * sizeof(png_bytep));
-
-  if(p->bpp > 8)
-  {
-    /* swap bytes of 16 bit files to most significant bit first */
-    png_set_swap(png_ptr);
-
-    for(unsigned i = 0; i < height; i++)
-      row_pointers[i] = (png_bytep)((uint16_t *)ivoid + (size_t)4 * i * width);
-  }
-  else
+  // the pixels are filtered and deflated in groups of rows on all threads, libpng only writes the chunks.
+  // png_write_end() insists on having seen libpng write the idat itself, so we end the file ourselves.
+  if(dt_png_deflate(ivoid, width, height, p->bpp, p->compression, _write_idat, png_ptr))
   {
-    for(unsigned i = 0; i < height; i++) row_pointers[i] = (uint8_t *)ivoid + (size_t)4 * i * width;
+    fclose(f);
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+    return 1;
   }
+  png_write_chunk(png_ptr, (png_const_bytep) "IEND", NULL, 0);
 
-  png_write_image(png_ptr, row_pointers);
-
-  free(row_pointers);
-
-  png_write_end(png_ptr, info_ptr);
   png_destroy_write_struct(&png_ptr, &info_ptr);
   fclose(f);
   return 0;
@@ -348,14 +334,14 @@ int read_image(dt_imageio_module_data_t *p_tmp, uint8_t *out)
 
 size_t params_size(dt_imageio_module_format_t *self)
 {
-  return sizeof(dt_imageio_module_data_t) + sizeof(int);
+  return sizeof(dt_imageio_module_data_t) + 2 * sizeof(int);
 }
 
 void *legacy_params(dt_imageio_module_format_t *self, const void *const old_params,
                     const size_t old_params_size, const int old_version, const int new_version,
                     size_t *new_size)
 {
-  if(old_version == 1 && new_version == 2)
+  if(old_version == 1 && new_version == 3)
   {
     typedef struct dt_imageio_png_v1_t
     {
@@ -379,6 +365,39 @@ void *legacy_params(dt_imageio_module_format_t *self, const void *const old_para
     g_strlcpy(n->style, o->style, sizeof(o->style));
     n->style_append = 0;
     n->bpp = o->bpp;
+    n->compression = Z_BEST_COMPRESSION;
+    n->f = o->f;
+    n->png_ptr = o->png_ptr;
+    n->info_ptr = o->info_ptr;
+    *new_size = self->params_size(self);
+    return n;
+  }
+  else if(old_version == 2 && new_version == 3)
+  {
+    typedef struct dt_imageio_png_v2_t
+    {
+      int max_width, max_height;
+      int width, height;
+      char style[128];
+      gboolean style_append;
+      int bpp;
+      FILE *f;
+      png_structp png_ptr;
+      png_infop info_ptr;
+    } dt_imageio_png_v2_t;
+
+    dt_imageio_png_v2_t *o = (dt_imageio_png_v2_t *)old_params;
+    dt_imageio_png_t *n = (dt_imageio_png_t *)malloc(sizeof(dt_imageio_png_t));
+
+    n->max_width = o->max_width;
+    n->max_height = o->max_height;
+    n->width = o->width;
+    n->height = o->height;
+    g_strlcpy(n->style, o->style, sizeof(o->style));
+    n->style_append = o->style_append;
+    n->bpp = o->bpp;
+    // that's what was hardcoded before
+    n->compression = Z_BEST_COMPRESSION;
     n->f = o->f;
     n->png_ptr = o->png_ptr;
     n->info_ptr = o->info_ptr;
@@ -395,6 +414,8 @@ void *get_params(dt_imageio_module_format_t *self)
     d->bpp = 8;
   else
     d->bpp = 16;
+  d->compression = CLAMP(dt_conf_get_int("plugins/imageio/format/png/compression"), Z_NO_COMPRESSION,
+                         Z_BEST_COMPRESSION);
   return d;
 }
 
@@ -413,6 +434,8 @@ int set_params(dt_imageio_module_format_t *self, const void *params, const int s
   else
     dt_bauhaus_combobox_set(g->bit_depth, 1);
   dt_conf_set_int("plugins/imageio/format/png/bpp", d->bpp);
+  dt_bauhaus_slider_set(g->compression, d->compression);
+  dt_conf_set_int("plugins/imageio/format/png/compression", d->compression);
   return 0;
 }
 
@@ -447,23 +470,30 @@ static void bit_depth_changed(GtkWidget *widget, gpointer user_data)
   dt_conf_set_int("plugins/imageio/format/png/bpp", bpp);
 }
 
+static void compression_changed(GtkWidget *widget, gpointer user_data)
+{
+  const int compression = (int)dt_bauhaus_slider_get(widget);
+  dt_conf_set_int("plugins/imageio/format/png/compression", compression);
+}
+
 void init(dt_imageio_module_format_t *self)
 {
 #ifdef USE_LUA
   luaA_struct(darktable.lua_state.state, dt_imageio_png_t);
   dt_lua_register_module_member(darktable.lua_state.state, self, dt_imageio_png_t, bpp, int);
+  dt_lua_register_module_member(darktable.lua_state.state, self, dt_imageio_png_t, compression, int);
 #endif
 }
 void cleanup(dt_imageio_module_format_t *self)
 {
 }
 
-// TODO: some quality/compression stuff?
 void gui_init(dt_imageio_module_format_t *self)
 {
   dt_imageio_png_gui_t *gui = (dt_imageio_png_gui_t *)malloc(sizeof(dt_imageio_png_gui_t));
   self->gui_data = (void *)gui;
   const int bpp = dt_conf_get_int("plugins/imageio/format/png/bpp");
+  const int compression = dt_conf_get_int("plugins/imageio/format/png/compression");
   self->widget = gtk_box_new(GTK_ORIENTATION_VERTICAL, DT_PIXEL_APPLY_DPI(5));
 
   gui->bit_depth = dt_bauhaus_combobox_new(NULL);
@@ -473,6 +503,15 @@ void gui_init(dt_imageio_module_format_t *self)
   dt_bauhaus_combobox_set(gui->bit_depth, bpp);
   gtk_box_pack_start(GTK_BOX(self->widget), gui->bit_depth, TRUE, TRUE, 0);
   g_signal_connect(G_OBJECT(gui->bit_depth), "value-changed", G_CALLBACK(bit_depth_changed), NULL);
+
+  gui->compression = dt_bauhaus_slider_new_with_range(NULL, Z_NO_COMPRESSION, Z_BEST_COMPRESSION, 1, 5, 0);
+  dt_bauhaus_widget_set_label(gui->compression, NULL, _("compression"));
+  dt_bauhaus_slider_set_default(gui->compression, 5);
+  dt_bauhaus_slider_set(gui->compression, compression);
+  g_object_set(G_OBJECT(gui->compression), "tooltip-text",
+               _("higher levels give smaller files and take longer to export"), (char *)NULL);
+  gtk_box_pack_start(GTK_BOX(self->widget), gui->compression, TRUE, TRUE, 0);
+  g_signal_connect(G_OBJECT(gui->compression), "value-changed", G_CALLBACK(compression_changed), NULL);
 }
 
 void gui_cleanup(dt_imageio_module_format_t *self)
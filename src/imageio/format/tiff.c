@@ -22,6 +22,7 @@
 #include <stddef.h>
 #include <inttypes.h>
 #include <tiffio.h>
+#include <zlib.h>
 #include "common/darktable.h"
 #include "common/imageio_module.h"
 #include "common/imageio.h"
@@ -33,6 +34,9 @@
 
 DT_MODULE(2)
 
+// compressed images are written in strips of about this many bytes, which are deflated in parallel
+#define DT_TIFF_STRIP_SIZE (256 * 1024)
+
 typedef struct dt_imageio_tiff_t
 {
   int max_width, max_height;
@@ -51,6 +55,99 @@ typedef struct dt_imageio_tiff_gui_t
 } dt_imageio_tiff_gui_t;
 
 
+// does to one row of interleaved rgb samples what libtiff does before compressing it with this predictor,
+// scratch needs to be as large as the row.
+static void _apply_predictor(uint8_t *row, uint8_t *scratch, const int width, const int bytes,
+                             const int predictor)
+{
+  const size_t samples = (size_t)width * 3;
+  if(predictor == 2)
+  {
+    // horizontal differencing of the samples, as integers
+    if(bytes == 1)
+      for(size_t k = samples - 1; k >= 3; k--) row[k] -= row[k - 3];
+    else if(bytes == 2)
+    {
+      uint16_t *v = (uint16_t *)row;
+      for(size_t k = samples - 1; k >= 3; k--) v[k] -= v[k - 3];
+    }
+    else
+    {
+      uint32_t *v = (uint32_t *)row;
+      for(size_t k = samples - 1; k >= 3; k--) v[k] -= v[k - 3];
+    }
+  }
+  else if(predictor == 3)
+  {
+    // floating point predictor: split the big endian bytes of the samples into planes, then horizontal
+    // differencing of all bytes of the row
+    const size_t size = samples * bytes;
+    memcpy(scratch, row, size);
+    for(size_t k = 0; k < samples; k++)
+      for(int b = 0; b < bytes; b++)
+#if G_BYTE_ORDER == G_BIG_ENDIAN
+        row[b * samples + k] = scratch[bytes * k + b];
+#else
+        row[(bytes - b - 1) * samples + k] = scratch[bytes * k + b];
+#endif
+    for(size_t k = size - 1; k >= 3; k--) row[k] -= row[k - 3];
+  }
+}
+
+// deflates strips of rows_per_strip rows on all threads and writes them in order. only for little endian hosts,
+// the raw strips need to be in the byte order of the file.
+static int _write_strips(TIFF *tif, const dt_imageio_tiff_t *d, const void *in_void, const int predictor,
+                         const int rows_per_strip)
+{
+  const int bytes = d->bpp / 8;
+  const size_t rowsize = (size_t)d->width * 3 * bytes;
+  const size_t stripsize = rowsize * rows_per_strip;
+  const int strips = (d->height + rows_per_strip - 1) / rows_per_strip;
+  const int batch = 2 * dt_get_num_threads();
+  const uLong bound = compressBound(stripsize);
+
+  uint8_t *raw = malloc((size_t)batch * stripsize);
+  uint8_t *scratch = malloc((size_t)batch * rowsize);
+  uint8_t *packed = malloc((size_t)batch * bound);
+  uLongf *packed_size = malloc(sizeof(uLongf) * batch);
+  int rc = !raw || !scratch || !packed || !packed_size;
+
+  for(int s0 = 0; s0 < strips && !rc; s0 += batch)
+  {
+    const int n = MIN(batch, strips - s0);
+    int failed = 0;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for(int s = 0; s < n; s++)
+    {
+      const int y0 = (s0 + s) * rows_per_strip;
+      const int rows = MIN(rows_per_strip, d->height - y0);
+      uint8_t *strip = raw + (size_t)s * stripsize;
+      for(int y = 0; y < rows; y++)
+      {
+        const uint8_t *in = (const uint8_t *)in_void + (size_t)4 * bytes * d->width * (y0 + y);
+        uint8_t *out = strip + (size_t)y * rowsize;
+        for(int x = 0; x < d->width; x++)
+          memcpy(out + (size_t)3 * bytes * x, in + (size_t)4 * bytes * x, 3 * bytes);
+        _apply_predictor(out, scratch + (size_t)s * rowsize, d->width, bytes, predictor);
+      }
+      packed_size[s] = bound;
+      if(compress2(packed + (size_t)s * bound, packed_size + s, strip, rowsize * rows, 9) != Z_OK) failed = 1;
+    }
+    if(failed) rc = 1;
+
+    for(int s = 0; s < n && !rc; s++)
+      if(TIFFWriteRawStrip(tif, s0 + s, packed + (size_t)s * bound, packed_size[s]) == -1) rc = 1;
+  }
+
+  free(raw);
+  free(scratch);
+  free(packed);
+  free(packed_size);
+  return rc;
+}
+
 int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const void *in_void, void *exif,
                 int exif_len, int imgid, int num, int total)
 {
@@ -64,6 +161,7 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
   void *rowdata = NULL;
 
   int rc = 1; // default to error
+  int predictor = 1;
 
   if(imgid > 0)
   {
@@ -100,22 +198,22 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
   if(d->compress == 1)
   {
     TIFFSetField(tif, TIFFTAG_COMPRESSION, (uint16_t)COMPRESSION_ADOBE_DEFLATE);
-    TIFFSetField(tif, TIFFTAG_PREDICTOR, (uint16_t)1);
+    TIFFSetField(tif, TIFFTAG_PREDICTOR, (uint16_t)(predictor = 1));
     TIFFSetField(tif, TIFFTAG_ZIPQUALITY, (uint16_t)9);
   }
   else if(d->compress == 2)
   {
     TIFFSetField(tif, TIFFTAG_COMPRESSION, (uint16_t)COMPRESSION_ADOBE_DEFLATE);
-    TIFFSetField(tif, TIFFTAG_PREDICTOR, (uint16_t)2);
+    TIFFSetField(tif, TIFFTAG_PREDICTOR, (uint16_t)(predictor = 2));
     TIFFSetField(tif, TIFFTAG_ZIPQUALITY, (uint16_t)9);
   }
   else if(d->compress == 3)
   {
     TIFFSetField(tif, TIFFTAG_COMPRESSION, (uint16_t)COMPRESSION_ADOBE_DEFLATE);
     if(d->bpp == 32)
-      TIFFSetField(tif, TIFFTAG_PREDICTOR, (uint16_t)3);
+      TIFFSetField(tif, TIFFTAG_PREDICTOR, (uint16_t)(predictor = 3));
     else
-      TIFFSetField(tif, TIFFTAG_PREDICTOR, (uint16_t)2);
+      TIFFSetField(tif, TIFFTAG_PREDICTOR, (uint16_t)(predictor = 2));
     TIFFSetField(tif, TIFFTAG_ZIPQUALITY, (uint16_t)9);
   }
   else // (d->compress == 0)
@@ -135,7 +233,9 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
   TIFFSetField(tif, TIFFTAG_IMAGELENGTH, (uint32_t)d->height);
   TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, (uint16_t)PHOTOMETRIC_RGB);
   TIFFSetField(tif, TIFFTAG_PLANARCONFIG, (uint16_t)PLANARCONFIG_CONTIG);
-  TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, (uint32_t)1);
+  const size_t rowsize = (d->width * 3) * d->bpp / 8;
+  const int rows_per_strip = d->compress ? CLAMP(DT_TIFF_STRIP_SIZE / rowsize, 1, d->height) : 1;
+  TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, (uint32_t)rows_per_strip);
   TIFFSetField(tif, TIFFTAG_ORIENTATION, (uint16_t)ORIENTATION_TOPLEFT);
 
   int resolution = dt_conf_get_int("metadata/resolution");
@@ -146,7 +246,12 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
     TIFFSetField(tif, TIFFTAG_RESOLUTIONUNIT, (uint16_t)RESUNIT_INCH);
   }
 
-  const size_t rowsize = (d->width * 3) * d->bpp / 8;
+  if(d->compress && G_BYTE_ORDER == G_LITTLE_ENDIAN)
+  {
+    rc = _write_strips(tif, d, in_void, predictor, rows_per_strip);
+    goto exit;
+  }
+
   if((rowdata = malloc(rowsize)) == NULL)
   {
     rc = 1;
@@ -277,6 +277,12 @@ int store(dt_imageio_module_storage_t *self, dt_imageio_module_data_t *sdata, co
           seq++;
         } while(g_file_test(filename, G_FILE_TEST_EXISTS));
       }
+      // reserve the name, other export threads must not pick it before we wrote the image:
+      if(!fail)
+      {
+        FILE *f = g_fopen(filename, "wb");
+        if(f) fclose(f);
+      }
     }
   } // end of critical block
   dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
@@ -285,6 +291,7 @@ int store(dt_imageio_module_storage_t *self, dt_imageio_module_data_t *sdata, co
   /* export image to file */
   if(dt_imageio_export(imgid, filename, format, fdata, high_quality, upscale, TRUE, self, sdata, num, total) != 0)
   {
+    if(!d->overwrite) g_unlink(filename);
     fprintf(stderr, "[imageio_storage_disk] could not export to file: `%s'!\n", filename);
     dt_control_log(_("could not export to file `%s'!"), filename);
     return 1;
@@ -297,6 +304,12 @@ int store(dt_imageio_module_storage_t *self, dt_imageio_module_data_t *sdata, co
   return 0;
 }
 
+int flags(dt_imageio_module_storage_t *self)
+{
+  // store() only touches shared state inside the critical block above
+  return STORAGE_FLAGS_SUPPORT_PARALLEL;
+}
+
 size_t params_size(dt_imageio_module_storage_t *self)
 {
   return sizeof(dt_imageio_disk_t) - sizeof(void *);
@@ -29,6 +29,9 @@
 #include <gtk/gtk.h>
 #include <stdlib.h>
 
+// grids larger than this are freed right after use instead of being kept for the next run
+#define DT_IOP_BILAT_KEEP_GRID (64 << 20)
+
 // this is the version of the modules parameters,
 // and includes version information about compile-time dt
 DT_MODULE_INTROSPECTION(1, dt_iop_bilat_params_t)
@@ -45,6 +48,7 @@ typedef struct dt_iop_bilat_data_t
   float sigma_r;
   float sigma_s;
   float detail;
+  dt_bilateral_t *grid; // kept from one run of process() to the next
 } dt_iop_bilat_data_t;
 
 typedef struct dt_iop_bilat_gui_data_t
@@ -160,6 +164,8 @@ void init_pipe(struct dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pi
 
 void cleanup_pipe(struct dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
 {
+  dt_iop_bilat_data_t *d = (dt_iop_bilat_data_t *)piece->data;
+  dt_bilateral_free(d->grid);
   free(piece->data);
   piece->data = NULL;
 }
@@ -178,12 +184,16 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, void *
   const float sigma_r = d->sigma_r; // does not depend on scale
   const float sigma_s = d->sigma_s / scale;
 
-  // TODO: better memory management.
-  dt_bilateral_t *b = dt_bilateral_init(roi_in->width, roi_in->height, sigma_s, sigma_r);
+  // reuse the grid of the last run, unless it would keep a lot of memory around
+  dt_bilateral_t *b = d->grid = dt_bilateral_reinit(d->grid, roi_in->width, roi_in->height, sigma_s, sigma_r);
   dt_bilateral_splat(b, (float *)i);
   dt_bilateral_blur(b);
   dt_bilateral_slice(b, (float *)i, (float *)o, d->detail);
-  dt_bilateral_free(b);
+  if(b->buf_size * sizeof(float) > DT_IOP_BILAT_KEEP_GRID)
+  {
+    dt_bilateral_free(b);
+    d->grid = NULL;
+  }
 }
 
 /** init, cleanup, commit to pipeline */
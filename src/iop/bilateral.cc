@@ -265,6 +265,8 @@ void commit_params(struct dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pix
   dt_iop_bilateral_params_t *p = (dt_iop_bilateral_params_t *)p1;
   dt_iop_bilateral_data_t *d = (dt_iop_bilateral_data_t *)piece->data;
   for(int k = 0; k < 5; k++) d->sigma[k] = p->sigma[k];
+  // thumbnails skip small radii
+  if(pipe->type == DT_DEV_PIXELPIPE_THUMBNAIL) piece->type_variant = pipe->type;
 }
 
 void init_pipe(struct dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
@@ -19,6 +19,7 @@
 #include "config.h"
 #endif
 #include "common/darktable.h"
+#include "common/clahe.h"
 #include "common/colorspaces.h"
 #include "develop/develop.h"
 #include "develop/imageop.h"
@@ -35,14 +36,25 @@
 
 #define CLIP(x) ((x < 0) ? 0.0 : (x > 1.0) ? 1.0 : x)
 
-#define ROUND_POSISTIVE(f) ((unsigned int)((f)+0.5))
+DT_MODULE(2)
 
-DT_MODULE(1)
+typedef enum dt_iop_rlce_mode_t
+{
+  RLCE_MODE_SLIDING = 0, // exact, one histogram per pixel
+  RLCE_MODE_TILES = 1    // one histogram per tile, interpolated
+} dt_iop_rlce_mode_t;
+
+typedef struct dt_iop_rlce_params1_t
+{
+  double radius;
+  double slope;
+} dt_iop_rlce_params1_t;
 
 typedef struct dt_iop_rlce_params_t
 {
   double radius;
   double slope;
+  dt_iop_rlce_mode_t mode;
 } dt_iop_rlce_params_t;
 
 typedef struct dt_iop_rlce_gui_data_t
@@ -50,12 +62,14 @@ typedef struct dt_iop_rlce_gui_data_t
   GtkBox *vbox1, *vbox2;
   GtkWidget *label1, *label2;
   GtkWidget *scale1, *scale2; // radie pixels, slope
+  GtkWidget *mode;
 } dt_iop_rlce_gui_data_t;
 
 typedef struct dt_iop_rlce_data_t
 {
   double radius;
   double slope;
+  dt_iop_rlce_mode_t mode;
 } dt_iop_rlce_data_t;
 
 const char *name()
@@ -73,14 +87,39 @@ int flags()
   return IOP_FLAGS_INCLUDE_IN_STYLES | IOP_FLAGS_DEPRECATED;
 }
 
+int legacy_params(dt_iop_module_t *self, const void *const old_params, const int old_version,
+                  void *new_params, const int new_version)
+{
+  if(old_version == 1 && new_version == 2)
+  {
+    const dt_iop_rlce_params1_t *old = old_params;
+    dt_iop_rlce_params_t *new = new_params;
+    new->radius = old->radius;
+    new->slope = old->slope;
+    new->mode = RLCE_MODE_SLIDING;
+    return 0;
+  }
+  return 1;
+}
+
 void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, void *ivoid, void *ovoid,
              const dt_iop_roi_t *roi_in, const dt_iop_roi_t *roi_out)
 {
   dt_iop_rlce_data_t *data = (dt_iop_rlce_data_t *)piece->data;
   const int ch = piece->colors;
 
-  // PASS1: Get a luminance map of image...
   float *luminance = (float *)malloc(((size_t)roi_out->width * roi_out->height) * sizeof(float));
+  float *dest = (float *)malloc(((size_t)roi_out->width * roi_out->height) * sizeof(float));
+  if(!luminance || !dest)
+  {
+    // out of memory, pass the image through unchanged
+    free(luminance);
+    free(dest);
+    memcpy(ovoid, ivoid, sizeof(float) * ch * roi_out->width * roi_out->height);
+    return;
+  }
+
+  // PASS1: Get a luminance map of image...
 // double lsmax=0.0,lsmin=1.0;
 #ifdef _OPENMP
 #pragma omp parallel for default(none) schedule(static) shared(luminance, roi_in, roi_out, ivoid)
@@ -102,127 +141,36 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, void *
 
   // Params
   const int rad = data->radius * roi_in->scale / piece->iscale;
-
-  const int bins = 256;
   const float slope = data->slope;
 
-// CLAHE
+  // CLAHE
+  if(data->mode == RLCE_MODE_TILES)
+    dt_clahe_tiled(luminance, dest, roi_out->width, roi_out->height, rad, slope);
+  else
+    dt_clahe_sliding(luminance, dest, roi_out->width, roi_out->height, rad, slope);
+
 #ifdef _OPENMP
-#pragma omp parallel for default(none) schedule(static) shared(luminance, roi_in, roi_out, ivoid, ovoid)
+#pragma omp parallel for default(none) schedule(static) shared(dest, roi_out, ivoid, ovoid)
 #endif
   for(int j = 0; j < roi_out->height; j++)
   {
-    int yMin = fmax(0, j - rad);
-    int yMax = fmin(roi_in->height, j + rad + 1);
-    int h = yMax - yMin;
-
-    int xMin0 = fmax(0, 0 - rad);
-    int xMax0 = fmin(roi_in->width - 1, rad);
-
-    int hist[bins + 1];
-    int clippedhist[bins + 1];
-    float dest[roi_out->width];
-
-    /* initially fill histogram */
-    memset(hist, 0, (bins + 1) * sizeof(int));
-    for(int yi = yMin; yi < yMax; ++yi)
-      for(int xi = xMin0; xi < xMax0; ++xi)
-        ++hist[ROUND_POSISTIVE(luminance[(size_t)yi * roi_in->width + xi] * (float)bins)];
-
-    // Destination row
-    memset(dest, 0, roi_out->width * sizeof(float));
-    float *ld = dest;
-
-    for(int i = 0; i < roi_out->width; i++)
-    {
-
-      int v = ROUND_POSISTIVE(luminance[(size_t)j * roi_in->width + i] * (float)bins);
-
-      int xMin = fmax(0, i - rad);
-      int xMax = i + rad + 1;
-      int w = fmin(roi_in->width, xMax) - xMin;
-      int n = h * w;
-
-      int limit = (int)(slope * n / bins + 0.5f);
-
-      /* remove left behind values from histogram */
-      if(xMin > 0)
-      {
-        int xMin1 = xMin - 1;
-        for(int yi = yMin; yi < yMax; ++yi)
-          --hist[ROUND_POSISTIVE(luminance[(size_t)yi * roi_in->width + xMin1] * (float)bins)];
-      }
-
-      /* add newly included values to histogram */
-      if(xMax <= roi_in->width)
-      {
-        int xMax1 = xMax - 1;
-        for(int yi = yMin; yi < yMax; ++yi)
-          ++hist[ROUND_POSISTIVE(luminance[(size_t)yi * roi_in->width + xMax1] * (float)bins)];
-      }
-
-      /* clip histogram and redistribute clipped entries */
-      memcpy(clippedhist, hist, (bins + 1) * sizeof(int));
-      int ce = 0, ceb = 0;
-      do
-      {
-        ceb = ce;
-        ce = 0;
-        for(int b = 0; b <= bins; b++)
-        {
-          int d = clippedhist[b] - limit;
-          if(d > 0)
-          {
-            ce += d;
-            clippedhist[b] = limit;
-          }
-        }
-
-        int d = (ce / (float)(bins + 1));
-        int m = ce % (bins + 1);
-        for(int h = 0; h <= bins; h++) clippedhist[h] += d;
-
-        if(m != 0)
-        {
-          int s = bins / (float)m;
-          for(int h = 0; h <= bins; h += s) ++clippedhist[h];
-        }
-      } while(ce != ceb);
-
-      /* build cdf of clipped histogram */
-      int hMin = bins;
-      for(int h = 0; h < hMin; h++)
-        if(clippedhist[h] != 0) hMin = h;
-
-      int cdf = 0;
-      for(int h = hMin; h <= v; h++) cdf += clippedhist[h];
-
-      int cdfMax = cdf;
-      for(int h = v + 1; h <= bins; h++) cdfMax += clippedhist[h];
-
-      int cdfMin = clippedhist[hMin];
-
-      *ld = (cdf - cdfMin) / (float)(cdfMax - cdfMin);
-
-      ld++;
-    }
-
     // Apply row
     float *in = ((float *)ivoid) + (size_t)j * roi_out->width * ch;
     float *out = ((float *)ovoid) + (size_t)j * roi_out->width * ch;
+    const float *ld = dest + (size_t)j * roi_out->width;
     for(int r = 0; r < roi_out->width; r++)
     {
       float H, S, L;
       rgb2hsl(in, &H, &S, &L);
       // hsl2rgb(out,H,S,( L / dest[r] ) * (L-lsmin) + lsmin );
-      hsl2rgb(out, H, S, dest[r]);
+      hsl2rgb(out, H, S, ld[r]);
       out += ch;
       in += ch;
-      ld++;
     }
   }
 
   // Cleanup
+  free(dest);
   free(luminance);
 }
 
@@ -244,7 +192,14 @@ static void slope_callback(GtkWidget *slider, gpointer user_data)
   dt_dev_add_history_item(darktable.develop, self, TRUE);
 }
 
-
+static void mode_callback(GtkWidget *widget, gpointer user_data)
+{
+  dt_iop_module_t *self = (dt_iop_module_t *)user_data;
+  if(self->dt->gui->reset) return;
+  dt_iop_rlce_params_t *p = (dt_iop_rlce_params_t *)self->params;
+  p->mode = dt_bauhaus_combobox_get(widget);
+  dt_dev_add_history_item(darktable.develop, self, TRUE);
+}
 
 void commit_params(struct dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pixelpipe_t *pipe,
                    dt_dev_pixelpipe_iop_t *piece)
@@ -257,6 +212,7 @@ void commit_params(struct dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pix
   dt_iop_rlce_data_t *d = (dt_iop_rlce_data_t *)piece->data;
   d->radius = p->radius;
   d->slope = p->slope;
+  d->mode = p->mode;
 #endif
 }
 
@@ -290,6 +246,7 @@ void gui_update(struct dt_iop_module_t *self)
   dt_iop_rlce_params_t *p = (dt_iop_rlce_params_t *)module->params;
   dt_bauhaus_slider_set(g->scale1, p->radius);
   dt_bauhaus_slider_set(g->scale2, p->slope);
+  dt_bauhaus_combobox_set(g->mode, p->mode);
 }
 
 void init(dt_iop_module_t *module)
@@ -300,7 +257,7 @@ void init(dt_iop_module_t *module)
   module->priority = 916; // module order created by iop_dependencies.py, do not edit!
   module->params_size = sizeof(dt_iop_rlce_params_t);
   module->gui_data = NULL;
-  dt_iop_rlce_params_t tmp = (dt_iop_rlce_params_t){ 64, 1.25 };
+  dt_iop_rlce_params_t tmp = (dt_iop_rlce_params_t){ 64, 1.25, RLCE_MODE_SLIDING };
   memcpy(module->params, &tmp, sizeof(dt_iop_rlce_params_t));
   memcpy(module->default_params, &tmp, sizeof(dt_iop_rlce_params_t));
 }
@@ -319,11 +276,13 @@ void gui_init(struct dt_iop_module_t *self)
   dt_iop_rlce_gui_data_t *g = (dt_iop_rlce_gui_data_t *)self->gui_data;
   dt_iop_rlce_params_t *p = (dt_iop_rlce_params_t *)self->params;
 
-  self->widget = GTK_WIDGET(gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0));
+  self->widget = GTK_WIDGET(gtk_box_new(GTK_ORIENTATION_VERTICAL, DT_GUI_IOP_MODULE_CONTROL_SPACING));
+  GtkWidget *hbox = GTK_WIDGET(gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0));
   g->vbox1 = GTK_BOX(gtk_box_new(GTK_ORIENTATION_VERTICAL, DT_GUI_IOP_MODULE_CONTROL_SPACING));
   g->vbox2 = GTK_BOX(gtk_box_new(GTK_ORIENTATION_VERTICAL, DT_GUI_IOP_MODULE_CONTROL_SPACING));
-  gtk_box_pack_start(GTK_BOX(self->widget), GTK_WIDGET(g->vbox1), FALSE, FALSE, 5);
-  gtk_box_pack_start(GTK_BOX(self->widget), GTK_WIDGET(g->vbox2), TRUE, TRUE, 5);
+  gtk_box_pack_start(GTK_BOX(hbox), GTK_WIDGET(g->vbox1), FALSE, FALSE, 5);
+  gtk_box_pack_start(GTK_BOX(hbox), GTK_WIDGET(g->vbox2), TRUE, TRUE, 5);
+  gtk_box_pack_start(GTK_BOX(self->widget), hbox, TRUE, TRUE, 0);
 
   g->label1 = dtgtk_reset_label_new(_("radius"), self, &p->radius, sizeof(float));
   gtk_box_pack_start(GTK_BOX(g->vbox1), g->label1, TRUE, TRUE, 0);
@@ -343,6 +302,18 @@ void gui_init(struct dt_iop_module_t *self)
 
   g_signal_connect(G_OBJECT(g->scale1), "value-changed", G_CALLBACK(radius_callback), self);
   g_signal_connect(G_OBJECT(g->scale2), "value-changed", G_CALLBACK(slope_callback), self);
+
+  g->mode = dt_bauhaus_combobox_new(self);
+  dt_bauhaus_widget_set_label(g->mode, NULL, _("method"));
+  dt_bauhaus_combobox_add(g->mode, _("sliding window"));
+  dt_bauhaus_combobox_add(g->mode, _("tiles"));
+  dt_bauhaus_combobox_set(g->mode, p->mode);
+  gtk_box_pack_start(GTK_BOX(self->widget), g->mode, TRUE, TRUE, 0);
+  g_object_set(G_OBJECT(g->mode), "tooltip-text",
+               _("sliding window equalizes around every pixel, tiles interpolates between "
+                 "equalized tiles and is much faster on large radii"),
+               (char *)NULL);
+  g_signal_connect(G_OBJECT(g->mode), "value-changed", G_CALLBACK(mode_callback), self);
 }
 
 void gui_cleanup(struct dt_iop_module_t *self)
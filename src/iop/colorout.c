@@ -566,6 +566,8 @@ void commit_params(struct dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pix
   d->lut[1][0] = -1.0f;
   d->lut[2][0] = -1.0f;
   piece->process_cl_ready = 1;
+  // export and display profiles differ
+  piece->type_variant = pipe->type;
 
   /* if we are exporting then check and set usage of override profile */
   if(pipe->type == DT_DEV_PIXELPIPE_EXPORT)
@@ -1202,6 +1202,8 @@ void commit_params(struct dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pix
   d->range = p->range;
   d->precedence = p->precedence;
   d->hue = p->hue;
+  // the full pipe might use the grid of the preview pipe
+  if(self->dev->gui_attached) piece->type_variant = pipe->type;
 
 #ifdef HAVE_OPENCL
   piece->process_cl_ready = (piece->process_cl_ready && !(darktable.opencl->avoid_atomics));
@@ -1907,6 +1907,10 @@ void commit_params(struct dt_iop_module_t *self, dt_iop_params_t *params, dt_dev
 
   // OpenCL can not (yet) green-equilibrate over full image.
   if(d->green_eq == DT_IOP_GREEN_EQ_FULL || d->green_eq == DT_IOP_GREEN_EQ_BOTH) piece->process_cl_ready = 0;
+
+  // the full pipe only matches export quality at the highest setting, thumbnails have their own
+  if((pipe->type == DT_DEV_PIXELPIPE_FULL && get_quality() < 2) || pipe->type == DT_DEV_PIXELPIPE_THUMBNAIL)
+    piece->type_variant = pipe->type;
 }
 
 void init_pipe(struct dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
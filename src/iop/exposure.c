@@ -432,6 +432,8 @@ void commit_params(struct dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pix
       if(p->deflicker_histogram_source == DEFLICKER_HISTOGRAM_SOURCE_THUMBNAIL)
       {
         d->mode = EXPOSURE_MODE_DEFLICKER;
+        // the full pipe takes the correction of the preview pipe
+        piece->type_variant = pipe->type;
 
         piece->request_histogram |= (DT_REQUEST_ON);
 
@@ -100,6 +100,7 @@ void commit_params(dt_iop_module_t *self, const dt_iop_params_t *const params, d
                    dt_dev_pixelpipe_iop_t *piece)
 {
   if(piece->pipe->type != DT_DEV_PIXELPIPE_EXPORT) piece->enabled = 0;
+  piece->type_variant = pipe->type;
 }
 
 void tiling_callback(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const dt_iop_roi_t *const roi_in,
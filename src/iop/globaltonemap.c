@@ -522,6 +522,8 @@ void commit_params(struct dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pix
   d->drago.bias = p->drago.bias;
   d->drago.max_light = p->drago.max_light;
   d->detail = p->detail;
+  // drago takes the maximum from the preview pipe in the gui
+  if(d->operator== OPERATOR_DRAGO && self->dev->gui_attached) piece->type_variant = pipe->type;
 
 #ifdef HAVE_OPENCL
   if(d->detail != 0.0f)
@@ -398,6 +398,8 @@ void commit_params(dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pixelpipe_
   if(p->mode == LEVELS_MODE_AUTOMATIC)
   {
     d->mode = LEVELS_MODE_AUTOMATIC;
+    // the full pipe takes the levels of the preview pipe
+    piece->type_variant = pipe->type;
 
     piece->request_histogram |= (DT_REQUEST_ON);
     self->request_histogram &= ~(DT_REQUEST_ON);
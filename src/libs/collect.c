@@ -1872,6 +1872,11 @@ static void collection_updated(gpointer instance, gpointer self)
   _lib_collect_gui_update(self);
 }
 
+static void collection_images_updated(gpointer instance, GList *imgs, guint member, gpointer self)
+{
+  _lib_collect_gui_update(self);
+}
+
 
 static void filmrolls_updated(gpointer instance, gpointer self)
 {
@@ -2128,6 +2133,9 @@ void gui_init(dt_lib_module_t *self)
   dt_control_signal_connect(darktable.signals, DT_SIGNAL_COLLECTION_CHANGED, G_CALLBACK(collection_updated),
                             self);
 
+  dt_control_signal_connect(darktable.signals, DT_SIGNAL_COLLECTION_IMAGES_CHANGED,
+                            G_CALLBACK(collection_images_updated), self);
+
   dt_control_signal_connect(darktable.signals, DT_SIGNAL_FILMROLLS_CHANGED, G_CALLBACK(filmrolls_updated),
                             self);
 
@@ -2145,6 +2153,7 @@ void gui_cleanup(dt_lib_module_t *self)
   for(int i = 0; i < MAX_RULES; i++) dt_gui_key_accel_block_on_focus_disconnect(d->rule[i].text);
 
   dt_control_signal_disconnect(darktable.signals, G_CALLBACK(collection_updated), self);
+  dt_control_signal_disconnect(darktable.signals, G_CALLBACK(collection_images_updated), self);
   dt_control_signal_disconnect(darktable.signals, G_CALLBACK(filmrolls_updated), self);
   dt_control_signal_disconnect(darktable.signals, G_CALLBACK(filmrolls_imported), self);
   dt_control_signal_disconnect(darktable.signals, G_CALLBACK(filmrolls_removed), self);
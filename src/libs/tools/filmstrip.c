@@ -99,6 +99,8 @@ static gboolean _lib_filmstrip_button_release_callback(GtkWidget *widget, GdkEve
                                                        gpointer user_data);
 /* signal callback for collection change */
 static void _lib_filmstrip_collection_changed_callback(gpointer instance, gpointer user_data);
+static void _lib_filmstrip_collection_images_callback(gpointer instance, GList *imgs, guint member,
+                                                      gpointer user_data);
 
 /* key accelerators callback */
 static gboolean _lib_filmstrip_copy_history_key_accel_callback(GtkAccelGroup *accel_group,
@@ -361,6 +363,8 @@ void gui_init(dt_lib_module_t *self)
   /* connect signal handler */
   dt_control_signal_connect(darktable.signals, DT_SIGNAL_COLLECTION_CHANGED,
                             G_CALLBACK(_lib_filmstrip_collection_changed_callback), (gpointer)self);
+  dt_control_signal_connect(darktable.signals, DT_SIGNAL_COLLECTION_IMAGES_CHANGED,
+                            G_CALLBACK(_lib_filmstrip_collection_images_callback), (gpointer)self);
   dt_control_signal_connect(darktable.signals, DT_SIGNAL_DEVELOP_MIPMAP_UPDATED,
                             G_CALLBACK(_lib_filmstrip_collection_changed_callback), (gpointer)self);
 }
@@ -370,6 +374,8 @@ void gui_cleanup(dt_lib_module_t *self)
   /* disconnect from signals */
   dt_control_signal_disconnect(darktable.signals, G_CALLBACK(_lib_filmstrip_collection_changed_callback),
                                (gpointer)self);
+  dt_control_signal_disconnect(darktable.signals, G_CALLBACK(_lib_filmstrip_collection_images_callback),
+                               (gpointer)self);
 
   /* unset viewmanager proxy */
   darktable.view_manager->proxy.filmstrip.module = NULL;
@@ -763,6 +769,12 @@ static void _lib_filmstrip_collection_changed_callback(gpointer instance, gpoint
   dt_control_queue_redraw_widget(self->widget);
 }
 
+static void _lib_filmstrip_collection_images_callback(gpointer instance, GList *imgs, guint member,
+                                                      gpointer user_data)
+{
+  _lib_filmstrip_collection_changed_callback(instance, user_data);
+}
+
 static void _lib_filmstrip_scroll_to_image(dt_lib_module_t *self, gint imgid, gboolean activate)
 {
   dt_lib_filmstrip_t *strip = (dt_lib_filmstrip_t *)self->data;
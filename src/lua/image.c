@@ -31,6 +31,7 @@
 #include "common/grouping.h"
 #include "common/history.h"
 #include "common/mipmap_cache.h"
+#include "develop/pixelpipe_cache.h"
 #include "metadata_gen.h"
 
 /***********************************************************************
@@ -91,6 +92,7 @@ static int drop_cache(lua_State *L)
   dt_lua_image_t imgid = -1;
   luaA_to(L, dt_lua_image_t, &imgid, -1);
   dt_mipmap_cache_remove(darktable.mipmap_cache, imgid);
+  if(darktable.pixelpipe_cache) dt_dev_pixelpipe_shared_cache_remove_image(darktable.pixelpipe_cache, imgid);
   return 0;
 }
 
@@ -75,6 +75,12 @@ static int default_dimension_wrapper(struct dt_imageio_module_storage_t *self, d
   return 0;
 };
 
+static int default_flags_wrapper(struct dt_imageio_module_storage_t *self)
+{
+  // calling back into lua from several export threads is not safe
+  return 0;
+}
+
 static int store_wrapper(struct dt_imageio_module_storage_t *self, struct dt_imageio_module_data_t *self_data,
                          const int imgid, dt_imageio_module_format_t *format, dt_imageio_module_data_t *fdata,
                          const int num, const int total, const gboolean high_quality, const gboolean upscale)
@@ -337,6 +343,7 @@ static dt_imageio_module_storage_t ref_storage = {
   .free_params = free_params_wrapper,
   .set_params = set_params_wrapper,
   .export_dispatched = empty_wrapper,
+  .flags = default_flags_wrapper,
   .parameter_lua_type = LUAA_INVALID_TYPE,
   .version = version_wrapper,
 
@@ -0,0 +1,138 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <sys/time.h>
+#include <omp.h>
+
+// scaling of the bilateral grid splat from one to all threads, against the old one which added into
+// the shared grid with atomics.
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#define CLAMPS(A, L, H) ((A) > (L) ? ((A) < (H) ? (A) : (H)) : (L))
+
+static void *dt_alloc_align(size_t alignment, size_t size)
+{
+  void *ptr = NULL;
+  if(posix_memalign(&ptr, alignment, size)) return NULL;
+  return ptr;
+}
+
+static void dt_free_align(void *mem)
+{
+  free(mem);
+}
+
+#include "common/bilateral.h"
+
+static inline double dt_get_wtime()
+{
+  struct timeval time;
+  gettimeofday(&time, NULL);
+  return time.tv_sec - 1290608000 + (1.0 / 1000000.0) * time.tv_usec;
+}
+
+static void splat_atomic(dt_bilateral_t *b, const float *const in)
+{
+  const int ox = 1;
+  const int oy = b->size_x;
+  const int oz = b->size_y * b->size_x;
+#pragma omp parallel for
+  for(int j = 0; j < b->height; j++)
+  {
+    size_t index = (size_t)4 * j * b->width;
+    for(int i = 0; i < b->width; i++)
+    {
+      float x, y, z;
+      const float L = in[index];
+      image_to_grid(b, i, j, L, &x, &y, &z);
+      const int xi = MIN((int)x, b->size_x - 2);
+      const int yi = MIN((int)y, b->size_y - 2);
+      const int zi = MIN((int)z, b->size_z - 2);
+      const float xf = x - xi;
+      const float yf = y - yi;
+      const float zf = z - zi;
+      const size_t grid_index = xi + b->size_x * (yi + b->size_y * zi);
+      for(int k = 0; k < 8; k++)
+      {
+        const size_t ii = grid_index + ((k & 1) ? ox : 0) + ((k & 2) ? oy : 0) + ((k & 4) ? oz : 0);
+        const float contrib = ((k & 1) ? xf : (1.0f - xf)) * ((k & 2) ? yf : (1.0f - yf))
+                              * ((k & 4) ? zf : (1.0f - zf)) * 100.0f / (b->sigma_s * b->sigma_s);
+#pragma omp atomic
+        b->buf[ii] += contrib;
+      }
+      index += 4;
+    }
+  }
+}
+
+int main(int argc, char *arg[])
+{
+  const int wd = argc > 1 ? atoi(arg[1]) : 4000;
+  const int ht = argc > 2 ? atoi(arg[2]) : 3000;
+  const float sigma_s = argc > 3 ? atof(arg[3]) : 50.0f;
+  const float sigma_r = argc > 4 ? atof(arg[4]) : 20.0f;
+  const int max_threads = omp_get_max_threads();
+
+  float *in = dt_alloc_align(16, sizeof(float) * 4 * wd * ht);
+  srand(1);
+  for(size_t k = 0; k < (size_t)wd * ht; k++)
+  {
+    const int i = k % wd, j = k / wd;
+    in[4 * k] = 50.0f + 40.0f * sinf(i * 0.003f) * cosf(j * 0.004f) + 10.0f * (rand() / (float)RAND_MAX - 0.5f);
+    in[4 * k + 1] = in[4 * k + 2] = in[4 * k + 3] = 0.0f;
+  }
+
+  dt_bilateral_t *ref = dt_bilateral_init(wd, ht, sigma_s, sigma_r);
+  dt_bilateral_t *b = NULL;
+  fprintf(stderr, "[bilateral] %dx%d, grid %zux%zux%zu\n", wd, ht, ref->size_x, ref->size_y, ref->size_z);
+  for(int threads = 1;; threads = MIN(2 * threads, max_threads))
+  {
+    omp_set_num_threads(threads);
+
+    memset(ref->buf, 0, sizeof(float) * ref->size_x * ref->size_y * ref->size_z);
+    double start = dt_get_wtime();
+    splat_atomic(ref, in);
+    const double t_atomic = dt_get_wtime() - start;
+
+    start = dt_get_wtime();
+    b = dt_bilateral_reinit(b, wd, ht, sigma_s, sigma_r);
+    dt_bilateral_splat(b, in);
+    const double t_slabs = dt_get_wtime() - start;
+
+    double max = 0.0;
+    for(size_t k = 0; k < ref->size_x * ref->size_y * ref->size_z; k++)
+      max = fmax(max, fabs(ref->buf[k] - b->buf[k]) / fmax(1.0, fabs(ref->buf[k])));
+    fprintf(stderr, "[bilateral] %2d threads: atomic %7.3fs, slabs %7.3fs (%5.1fx), max rel diff %g\n", threads,
+            t_atomic, t_slabs, t_atomic / t_slabs, max);
+    if(threads == max_threads) break;
+  }
+
+  dt_bilateral_free(ref);
+  dt_bilateral_free(b);
+  free(in);
+  exit(0);
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
@@ -20,9 +20,19 @@
 #define DT_UNIT_TEST
 // define dt alloc, so we don't need to include the rest of dt:
 #define dt_alloc_align(A, B) malloc(B)
+#define dt_free_align(A) free(A)
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
 
-// unit test for the concurrent hopscotch hashmap and the LRU cache built on top of it.
+#include <stdlib.h>
+#include <sys/time.h>
+static inline double dt_get_wtime()
+{
+  struct timeval time;
+  gettimeofday(&time, NULL);
+  return time.tv_sec - 1290608000 + (1.0 / 1000000.0) * time.tv_usec;
+}
+
+// unit test and contention benchmark for the sharded LRU cache.
 #include "common/cache.h"
 #include "common/cache.c"
 
@@ -33,98 +43,158 @@
 #include <omp.h>
 #endif
 
-int32_t alloc_dummy(void *data, const uint32_t key, int32_t *cost, void **buf)
+void alloc_dummy(void *data, dt_cache_entry_t *entry)
 {
-  *cost = 1; // also the default
-  *buf = (void *)(long int)key;
-  // request write lock for our buffer?
-  return 0;
+  entry->cost = 1; // also the default
+  entry->data = (void *)(long int)entry->key;
 }
 
-int main(int argc, char *arg[])
+void cleanup_dummy(void *data, dt_cache_entry_t *entry)
 {
-  dt_cache_t cache;
-  // dt_cache_init(&cache, 110000, 16, 64, 100000);
-  // really hammer it, make quota insanely low:
-  dt_cache_init(&cache, 110000, 16, 64, 100);
-  dt_cache_set_allocate_callback(&cache, alloc_dummy, NULL);
+  // nothing allocated
+}
+
+static int lru_check_consistency(dt_cache_t *cache)
+{
+  int cnt = 0;
+  for(uint32_t k = 0; k < (1u << cache->shard_bits); k++)
+  {
+    dt_cache_shard_t *shard = cache->shards + k;
+    int fwd = 0, bwd = 0;
+    for(dt_cache_entry_t *e = shard->lru_head; e; e = e->lru_next)
+    {
+      assert(_cache_shard(cache, e->key) == shard);
+      fwd++;
+    }
+    for(dt_cache_entry_t *e = shard->lru_tail; e; e = e->lru_prev) bwd++;
+    assert(fwd == bwd);
+    assert(fwd == (int)g_hash_table_size(shard->hashtable));
+    assert(fwd == (int)shard->cost);
+    cnt += fwd;
+  }
+  return cnt;
+}
 
+static void hammer(dt_cache_t *cache, const int num)
+{
 #ifdef _OPENMP
-#pragma omp parallel for default(none) schedule(guided) shared(cache, stderr) num_threads(16)
+#pragma omp parallel for schedule(guided) num_threads(16)
 #endif
-  for(int k = 0; k < 100000; k++)
+  for(int k = 0; k < num; k++)
   {
-    void *data = (void *)(long int)k;
-    const int size = 0; // dt_cache_size(&cache);
-    const int con1 = dt_cache_contains(&cache, k);
-    const int val1 = (int)(long int)dt_cache_read_get(&cache, k);
-    const int val2 = (int)(long int)dt_cache_read_get(&cache, k);
-    // fprintf(stderr, "\rinserted number %d, size %d, value %d - %d, contains %d - %d", k, size, val1, val2,
-    // con1, con2);
-    const int con2 = dt_cache_contains(&cache, k);
-    assert(con1 == 0);
-    assert(con2 == 1);
-    assert(val2 == k);
-    dt_cache_read_release(&cache, k);
-    dt_cache_read_release(&cache, k);
+    // a miss returns the new entry write locked (we have an allocate callback), so release in between:
+    dt_cache_entry_t *e1 = dt_cache_get(cache, k, 'r');
+    assert((int)(long int)e1->data == k);
+    dt_cache_release(cache, e1);
+    assert(dt_cache_contains(cache, k) || cache->cost_quota < 1000);
+    dt_cache_entry_t *e2 = dt_cache_get(cache, k, 'r');
+    assert((int)(long int)e2->data == k);
+    dt_cache_release(cache, e2);
   }
-  dt_cache_print_locked(&cache);
-  // fprintf(stderr, "\n");
-  fprintf(stderr, "[passed] inserting 100000 entries concurrently\n");
+}
 
-  const int size = dt_cache_size(&cache);
-  const int lru_cnt = lru_check_consistency(&cache);
-  const int lru_cnt_r = lru_check_consistency_reverse(&cache);
-  // fprintf(stderr, "lru list contains %d|%d/%d entries\n", lru_cnt, lru_cnt_r, size);
-  assert(size == lru_cnt);
-  assert(lru_cnt_r == lru_cnt);
-  fprintf(stderr, "[passed] cache lru consistency after removals, have %d entries left.\n", size);
+// a thumbnail storm: many threads reading a working set of keys a lot larger than the cache.
+static double bench(dt_cache_t *cache, const int threads, const int num)
+{
+  const double start = dt_get_wtime();
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(threads)
+#endif
+  for(int k = 0; k < num; k++)
+  {
+    const uint32_t key = (k * 7919u) % 200000u;
+    dt_cache_entry_t *e = dt_cache_get(cache, key, 'r');
+    dt_cache_release(cache, e);
+  }
+  return dt_get_wtime() - start;
+}
 
+int main(int argc, char *arg[])
+{
+  dt_cache_t cache;
+  // really hammer it, make quota insanely low:
+  dt_cache_init(&cache, 0, 100);
+  dt_cache_set_allocate_callback(&cache, alloc_dummy, NULL);
+  dt_cache_set_cleanup_callback(&cache, cleanup_dummy, NULL);
+  hammer(&cache, 100000);
+  fprintf(stderr, "[passed] inserting 100000 entries concurrently\n");
+  fprintf(stderr, "[passed] cache lru consistency after removals, have %d entries left.\n",
+          lru_check_consistency(&cache));
   dt_cache_cleanup(&cache);
 
-
-
   {
     // now a harder case: a cache with only one entry and a lot of threads fighting over it:
     dt_cache_t cache2;
-    // really hammer it, make quota insanely low:
-    // capacity 1 num threads 1 cache line size 64 ignored, quota 2 (80% => 1)
-    dt_cache_init(&cache2, 1, 1, 64, 2);
+    dt_cache_init(&cache2, 0, 1);
+    assert(cache2.shard_bits == 0);
     dt_cache_set_allocate_callback(&cache2, alloc_dummy, NULL);
-
-#ifdef _OPENMP
-#pragma omp parallel for default(none) schedule(guided) shared(cache2, stderr) num_threads(16)
-#endif
-    for(int k = 0; k < 100000; k++)
-    {
-      void *data = (void *)(long int)k;
-      const int size = 0; // dt_cache_size(&cache);
-      const int con1 = dt_cache_contains(&cache2, k);
-      const int val1 = (int)(long int)dt_cache_read_get(&cache2, k);
-      const int val2 = (int)(long int)dt_cache_read_get(&cache2, k);
-      // fprintf(stderr, "\rinserted number %d, size %d, value %d - %d, contains %d - %d", k, size, val1,
-      // val2, con1, con2);
-      const int con2 = dt_cache_contains(&cache2, k);
-      assert(con1 == 0);
-      assert(con2 == 1);
-      assert(val2 == k);
-      dt_cache_read_release(&cache2, k);
-      dt_cache_read_release(&cache2, k);
-    }
-    dt_cache_print_locked(&cache2);
-    // fprintf(stderr, "\n");
-    fprintf(stderr, "[passed] inserting 100000 entries concurrently\n");
-
-    const int size = dt_cache_size(&cache2);
-    const int lru_cnt = lru_check_consistency(&cache2);
-    const int lru_cnt_r = lru_check_consistency_reverse(&cache2);
-    // fprintf(stderr, "lru list contains %d|%d/%d entries\n", lru_cnt, lru_cnt_r, size);
-    assert(size == lru_cnt);
-    assert(lru_cnt_r == lru_cnt);
-    fprintf(stderr, "[passed] cache lru consistency after removals, have %d entries left.\n", size);
+    dt_cache_set_cleanup_callback(&cache2, cleanup_dummy, NULL);
+    hammer(&cache2, 100000);
+    fprintf(stderr, "[passed] inserting 100000 entries concurrently into a single slot\n");
+    fprintf(stderr, "[passed] cache lru consistency after removals, have %d entries left.\n",
+            lru_check_consistency(&cache2));
     dt_cache_cleanup(&cache2);
   }
 
+  {
+    // large quota: all shards in use, gc and remove need to keep the lists consistent.
+    dt_cache_t cache3;
+    dt_cache_init(&cache3, 0, 50000);
+    assert(cache3.shard_bits > 0);
+    dt_cache_set_allocate_callback(&cache3, alloc_dummy, NULL);
+    dt_cache_set_cleanup_callback(&cache3, cleanup_dummy, NULL);
+    hammer(&cache3, 100000);
+    for(int k = 0; k < 100000; k += 3) dt_cache_remove(&cache3, k);
+    dt_cache_gc(&cache3, 0.5f);
+    const int left = lru_check_consistency(&cache3);
+    assert(left == (int)cache3.cost);
+    fprintf(stderr, "[passed] %d shards consistent after remove and gc, have %d entries left.\n",
+            1 << cache3.shard_bits, left);
+    dt_cache_cleanup(&cache3);
+  }
+
+  {
+    // all entries of one shard are locked: inserting into it has to make room in the others.
+    dt_cache_t cache4;
+    dt_cache_init(&cache4, 0, 50000);
+    dt_cache_set_allocate_callback(&cache4, alloc_dummy, NULL);
+    dt_cache_set_cleanup_callback(&cache4, cleanup_dummy, NULL);
+    for(int k = 0; k < 40000; k++) dt_cache_release(&cache4, dt_cache_get(&cache4, k, 'r'));
+    dt_cache_shard_t *full = _cache_shard(&cache4, 0);
+    const int held_max = 50000;
+    dt_cache_entry_t **held = (dt_cache_entry_t **)calloc(held_max, sizeof(dt_cache_entry_t *));
+    int num_held = 0;
+    for(int k = 0; k < 40000; k++)
+      if(_cache_shard(&cache4, k) == full) held[num_held++] = dt_cache_get(&cache4, k, 'r');
+    for(uint32_t k = 100000; num_held < held_max && k < 1000000; k++)
+      if(_cache_shard(&cache4, k) == full)
+      {
+        held[num_held++] = dt_cache_get(&cache4, k, 'r');
+        assert(cache4.cost <= 0.8f * cache4.cost_quota + 1 || full->cost >= 0.8f * cache4.cost_quota);
+      }
+    for(int k = 0; k < num_held; k++) dt_cache_release(&cache4, held[k]);
+    free(held);
+    const int left = lru_check_consistency(&cache4);
+    assert(left == (int)cache4.cost);
+    fprintf(stderr, "[passed] gc evicts from the other shards when its own is locked, have %d entries left.\n",
+            left);
+    dt_cache_cleanup(&cache4);
+  }
+
+  // contention benchmark, 1 to 32 threads:
+  const int num = argc > 1 ? atoi(arg[1]) : 4000000;
+  for(int threads = 1; threads <= 32; threads *= 2)
+  {
+    dt_cache_t bcache;
+    dt_cache_init(&bcache, 0, 100000);
+    dt_cache_set_allocate_callback(&bcache, alloc_dummy, NULL);
+    dt_cache_set_cleanup_callback(&bcache, cleanup_dummy, NULL);
+    const double t = bench(&bcache, threads, num);
+    fprintf(stderr, "[bench] %2d threads, %d shards: %.3fs, %.2f Mget/s\n", threads, 1 << bcache.shard_bits, t,
+            num / t * 1e-6);
+    dt_cache_cleanup(&bcache);
+  }
+
   exit(0);
 }
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
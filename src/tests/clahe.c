@@ -0,0 +1,89 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <sys/time.h>
+#include "common/clahe.h"
+
+// benchmark of the sliding window against the tiled clahe of the local contrast module,
+// and how far the tiled output strays from the exact one.
+
+static inline double dt_get_wtime()
+{
+  struct timeval time;
+  gettimeofday(&time, NULL);
+  return time.tv_sec - 1290608000 + (1.0 / 1000000.0) * time.tv_usec;
+}
+
+int main(int argc, char *arg[])
+{
+  const int wd = argc > 1 ? atoi(arg[1]) : 1500;
+  const int ht = argc > 2 ? atoi(arg[2]) : 1000;
+  float *luminance = malloc(sizeof(float) * wd * ht);
+  float *exact = malloc(sizeof(float) * wd * ht);
+  float *tiled = malloc(sizeof(float) * wd * ht);
+
+  // smooth gradients with some structure and noise on top, clipped to [0,1] as in the module
+  srand(1);
+  for(int j = 0; j < ht; j++)
+    for(int i = 0; i < wd; i++)
+    {
+      const float v = 0.5f + 0.3f * sinf(i * 0.01f) * cosf(j * 0.013f) + 0.1f * sinf((i + j) * 0.2f)
+                      + 0.05f * (rand() / (float)RAND_MAX - 0.5f);
+      luminance[(size_t)j * wd + i] = fminf(1.0f, fmaxf(0.0f, v));
+    }
+
+  // radius 0 is still done with tiles of DT_CLAHE_MIN_TILE
+  const int radii[] = { 0, 8, 32, 64, 128 };
+  for(int r = 0; r < sizeof(radii) / sizeof(radii[0]); r++)
+  {
+    const int rad = radii[r];
+    const float slope = 1.25f;
+
+    double start = dt_get_wtime();
+    dt_clahe_sliding(luminance, exact, wd, ht, rad, slope);
+    const double t_exact = dt_get_wtime() - start;
+
+    start = dt_get_wtime();
+    dt_clahe_tiled(luminance, tiled, wd, ht, rad, slope);
+    const double t_tiled = dt_get_wtime() - start;
+
+    double sum = 0.0, max = 0.0;
+    for(size_t k = 0; k < (size_t)wd * ht; k++)
+    {
+      assert(tiled[k] >= 0.0f && tiled[k] <= 1.0f);
+      const double d = fabs(exact[k] - tiled[k]);
+      sum += d;
+      if(d > max) max = d;
+    }
+    fprintf(stderr, "[clahe] %dx%d radius %3d: sliding %7.3fs, tiles %7.3fs (%5.1fx), "
+                    "mean abs diff %.4f, max abs diff %.4f\n",
+            wd, ht, rad, t_exact, t_tiled, t_exact / t_tiled, sum / ((double)wd * ht), max);
+  }
+
+  free(luminance);
+  free(exact);
+  free(tiled);
+  exit(0);
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
@@ -0,0 +1,264 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sqlite3.h>
+
+// typical collection and tag queries of the lighttable, run by a few threads while another one keeps
+// writing image rows, like thumbnail and tagging jobs do. compares one shared connection with a memory
+// journal (what the library used to do) against write ahead logging with a read only connection per thread.
+
+#define NUM_IMAGES 50000
+#define NUM_FILMS 100
+#define NUM_TAGS 500
+#define SECONDS 3.0
+
+static inline double dt_get_wtime()
+{
+  struct timeval time;
+  gettimeofday(&time, NULL);
+  return time.tv_sec - 1290608000 + (1.0 / 1000000.0) * time.tv_usec;
+}
+
+typedef struct bench_t
+{
+  const char *filename;
+  sqlite3 *shared;  // the one connection of the old setup, also the writer with wal
+  int wal;
+  volatile int stop;
+} bench_t;
+
+typedef struct reader_t
+{
+  bench_t *bench;
+  int seed;
+  long queries;
+} reader_t;
+
+static void create_library(const char *filename)
+{
+  sqlite3 *db;
+  unlink(filename);
+  sqlite3_open(filename, &db);
+  sqlite3_exec(db, "PRAGMA page_size = 32768", NULL, NULL, NULL);
+  sqlite3_exec(db, "CREATE TABLE film_rolls (id INTEGER PRIMARY KEY, folder VARCHAR(1024))", NULL, NULL, NULL);
+  sqlite3_exec(db, "CREATE TABLE images (id INTEGER PRIMARY KEY, film_id INTEGER, filename VARCHAR, "
+                   "flags INTEGER, datetime_taken CHAR(20), write_timestamp INTEGER)",
+               NULL, NULL, NULL);
+  sqlite3_exec(db, "CREATE INDEX images_film_id_index ON images (film_id)", NULL, NULL, NULL);
+  sqlite3_exec(db, "CREATE TABLE tags (id INTEGER PRIMARY KEY, name VARCHAR)", NULL, NULL, NULL);
+  sqlite3_exec(db, "CREATE TABLE tagged_images (imgid INTEGER, tagid INTEGER, PRIMARY KEY (imgid, tagid))",
+               NULL, NULL, NULL);
+  sqlite3_exec(db, "CREATE INDEX tagged_images_tagid_index ON tagged_images (tagid)", NULL, NULL, NULL);
+
+  sqlite3_exec(db, "BEGIN TRANSACTION", NULL, NULL, NULL);
+  sqlite3_stmt *stmt;
+  sqlite3_prepare_v2(db, "INSERT INTO film_rolls (id, folder) VALUES (?1, ?2)", -1, &stmt, NULL);
+  for(int k = 1; k <= NUM_FILMS; k++)
+  {
+    char folder[64];
+    snprintf(folder, sizeof(folder), "/photos/%04d", k);
+    sqlite3_bind_int(stmt, 1, k);
+    sqlite3_bind_text(stmt, 2, folder, -1, SQLITE_TRANSIENT);
+    sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+  }
+  sqlite3_finalize(stmt);
+  sqlite3_prepare_v2(db, "INSERT INTO tags (id, name) VALUES (?1, ?2)", -1, &stmt, NULL);
+  for(int k = 1; k <= NUM_TAGS; k++)
+  {
+    char name[64];
+    snprintf(name, sizeof(name), "places|country %d|city %d", k % 20, k);
+    sqlite3_bind_int(stmt, 1, k);
+    sqlite3_bind_text(stmt, 2, name, -1, SQLITE_TRANSIENT);
+    sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+  }
+  sqlite3_finalize(stmt);
+  sqlite3_stmt *tag_stmt;
+  sqlite3_prepare_v2(db, "INSERT INTO images (id, film_id, filename, flags, datetime_taken) "
+                         "VALUES (?1, ?2, ?3, ?4, ?5)",
+                     -1, &stmt, NULL);
+  sqlite3_prepare_v2(db, "INSERT OR IGNORE INTO tagged_images (imgid, tagid) VALUES (?1, ?2)", -1, &tag_stmt,
+                     NULL);
+  srand(1);
+  for(int k = 1; k <= NUM_IMAGES; k++)
+  {
+    char name[64], date[32];
+    snprintf(name, sizeof(name), "IMG_%05d.CR2", k);
+    snprintf(date, sizeof(date), "2015:%02d:%02d 12:00:00", 1 + k % 12, 1 + k % 28);
+    sqlite3_bind_int(stmt, 1, k);
+    sqlite3_bind_int(stmt, 2, 1 + rand() % NUM_FILMS);
+    sqlite3_bind_text(stmt, 3, name, -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int(stmt, 4, rand() % 6);
+    sqlite3_bind_text(stmt, 5, date, -1, SQLITE_TRANSIENT);
+    sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    for(int t = 0; t < 4; t++)
+    {
+      sqlite3_bind_int(tag_stmt, 1, k);
+      sqlite3_bind_int(tag_stmt, 2, 1 + rand() % NUM_TAGS);
+      sqlite3_step(tag_stmt);
+      sqlite3_reset(tag_stmt);
+    }
+  }
+  sqlite3_finalize(stmt);
+  sqlite3_finalize(tag_stmt);
+  sqlite3_exec(db, "COMMIT", NULL, NULL, NULL);
+  sqlite3_close(db);
+}
+
+static void *reader_run(void *data)
+{
+  reader_t *r = (reader_t *)data;
+  bench_t *b = r->bench;
+  sqlite3 *db = b->shared;
+  if(b->wal)
+  {
+    sqlite3_open_v2(b->filename, &db, SQLITE_OPEN_READONLY, NULL);
+    sqlite3_busy_timeout(db, 1000);
+  }
+
+  // a film roll collection sorted by file name, the tags of a few images and the tag counts for a film roll
+  sqlite3_stmt *collection, *image_tags, *tag_counts;
+  sqlite3_prepare_v2(db, "SELECT id FROM images WHERE film_id = ?1 AND (flags & 7) >= 1 ORDER BY filename, id",
+                     -1, &collection, NULL);
+  sqlite3_prepare_v2(db, "SELECT T.name FROM tagged_images JOIN tags T ON T.id = tagged_images.tagid "
+                         "WHERE tagged_images.imgid = ?1 ORDER BY T.name",
+                     -1, &image_tags, NULL);
+  sqlite3_prepare_v2(db, "SELECT tagid, COUNT(*) FROM tagged_images WHERE imgid IN "
+                         "(SELECT id FROM images WHERE film_id = ?1) GROUP BY tagid ORDER BY 2 DESC",
+                     -1, &tag_counts, NULL);
+  unsigned int seed = r->seed;
+  while(!b->stop)
+  {
+    sqlite3_bind_int(collection, 1, 1 + rand_r(&seed) % NUM_FILMS);
+    while(sqlite3_step(collection) == SQLITE_ROW)
+      ;
+    sqlite3_reset(collection);
+    for(int k = 0; k < 10; k++)
+    {
+      sqlite3_bind_int(image_tags, 1, 1 + rand_r(&seed) % NUM_IMAGES);
+      while(sqlite3_step(image_tags) == SQLITE_ROW)
+        ;
+      sqlite3_reset(image_tags);
+    }
+    sqlite3_bind_int(tag_counts, 1, 1 + rand_r(&seed) % NUM_FILMS);
+    while(sqlite3_step(tag_counts) == SQLITE_ROW)
+      ;
+    sqlite3_reset(tag_counts);
+    r->queries += 12;
+  }
+  sqlite3_finalize(collection);
+  sqlite3_finalize(image_tags);
+  sqlite3_finalize(tag_counts);
+  if(b->wal) sqlite3_close(db);
+  return NULL;
+}
+
+static void run(const char *filename, const int wal, const int num_readers)
+{
+  bench_t b = { filename, NULL, wal, 0 };
+  sqlite3_open(filename, &b.shared);
+  if(wal)
+  {
+    sqlite3_exec(b.shared, "PRAGMA journal_mode = WAL", NULL, NULL, NULL);
+    sqlite3_exec(b.shared, "PRAGMA synchronous = NORMAL", NULL, NULL, NULL);
+  }
+  else
+  {
+    sqlite3_exec(b.shared, "PRAGMA journal_mode = DELETE", NULL, NULL, NULL);
+    sqlite3_exec(b.shared, "PRAGMA synchronous = OFF", NULL, NULL, NULL);
+    sqlite3_exec(b.shared, "PRAGMA journal_mode = MEMORY", NULL, NULL, NULL);
+  }
+
+  reader_t readers[num_readers];
+  pthread_t threads[num_readers];
+  for(int k = 0; k < num_readers; k++)
+  {
+    readers[k] = (reader_t){ &b, k + 1, 0 };
+    pthread_create(threads + k, NULL, reader_run, readers + k);
+  }
+
+  // the writer: rating and tagging single images, like dt_image_cache_write_release() and dt_tag_attach()
+  sqlite3_stmt *update, *tag;
+  sqlite3_prepare_v2(b.shared, "UPDATE images SET flags = ?1, write_timestamp = ?2 WHERE id = ?3", -1, &update,
+                     NULL);
+  sqlite3_prepare_v2(b.shared, "INSERT OR REPLACE INTO tagged_images (imgid, tagid) VALUES (?1, ?2)", -1, &tag,
+                     NULL);
+  long writes = 0;
+  unsigned int seed = 4711;
+  const double start = dt_get_wtime();
+  while(dt_get_wtime() - start < SECONDS)
+  {
+    const int imgid = 1 + rand_r(&seed) % NUM_IMAGES;
+    sqlite3_bind_int(update, 1, rand_r(&seed) % 6);
+    sqlite3_bind_int(update, 2, (int)writes);
+    sqlite3_bind_int(update, 3, imgid);
+    sqlite3_step(update);
+    sqlite3_reset(update);
+    sqlite3_bind_int(tag, 1, imgid);
+    sqlite3_bind_int(tag, 2, 1 + rand_r(&seed) % NUM_TAGS);
+    sqlite3_step(tag);
+    sqlite3_reset(tag);
+    writes += 2;
+  }
+  b.stop = 1;
+  const double elapsed = dt_get_wtime() - start;
+
+  long queries = 0;
+  for(int k = 0; k < num_readers; k++)
+  {
+    pthread_join(threads[k], NULL);
+    queries += readers[k].queries;
+  }
+  sqlite3_finalize(update);
+  sqlite3_finalize(tag);
+  sqlite3_close(b.shared);
+
+  fprintf(stderr, "[database] %-14s %d readers: %9.0f queries/s, %9.0f writes/s\n",
+          wal ? "wal, per thread" : "memory journal", num_readers, queries / elapsed, writes / elapsed);
+}
+
+int main(int argc, char *arg[])
+{
+  const char *filename = argc > 1 ? arg[1] : "/tmp/dt_database_bench.db";
+  create_library(filename);
+  const int readers[] = { 1, 2, 4, 8 };
+  for(int r = 0; r < sizeof(readers) / sizeof(readers[0]); r++)
+  {
+    run(filename, 0, readers[r]);
+    run(filename, 1, readers[r]);
+  }
+  unlink(filename);
+  char wal[1024];
+  snprintf(wal, sizeof(wal), "%s-wal", filename);
+  unlink(wal);
+  snprintf(wal, sizeof(wal), "%s-shm", filename);
+  unlink(wal);
+  exit(0);
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
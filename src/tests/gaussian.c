@@ -0,0 +1,436 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+// benchmark of the blocked recursive gaussian against the one which filtered a single column or row at a time,
+// and how far their results are apart.
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+static void *dt_alloc_align(size_t alignment, size_t size)
+{
+  void *ptr = NULL;
+  if(posix_memalign(&ptr, alignment, size)) return NULL;
+  return ptr;
+}
+
+static void dt_free_align(void *mem)
+{
+  free(mem);
+}
+
+// none of the opencl parts are needed here
+#define DT_OPENCL_H
+#include "common/gaussian.c"
+
+static inline double dt_get_wtime()
+{
+  struct timeval time;
+  gettimeofday(&time, NULL);
+  return time.tv_sec - 1290608000 + (1.0 / 1000000.0) * time.tv_usec;
+}
+
+// the implementation before blocking, as reference
+static void blur_ref(dt_gaussian_t *g, float *in, float *out)
+{
+
+  const int width = g->width;
+  const int height = g->height;
+  const int ch = g->channels;
+
+  float a0, a1, a2, a3, b1, b2, coefp, coefn;
+
+  compute_gauss_params(g->sigma, g->order, &a0, &a1, &a2, &a3, &b1, &b2, &coefp, &coefn);
+
+  float *temp = g->buf;
+
+  float *Labmax = g->max;
+  float *Labmin = g->min;
+
+// vertical blur column by column
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for(int i = 0; i < width; i++)
+  {
+    float xp[ch];
+    float yb[ch];
+    float yp[ch];
+    float xc[ch];
+    float yc[ch];
+    float xn[ch];
+    float xa[ch];
+    float yn[ch];
+    float ya[ch];
+
+    // forward filter
+    for(int k = 0; k < ch; k++)
+    {
+      xp[k] = CLAMPF(in[(size_t)i * ch + k], Labmin[k], Labmax[k]);
+      yb[k] = xp[k] * coefp;
+      yp[k] = yb[k];
+      xc[k] = yc[k] = xn[k] = xa[k] = yn[k] = ya[k] = 0.0f;
+    }
+
+    for(int j = 0; j < height; j++)
+    {
+      size_t offset = ((size_t)j * width + i) * ch;
+
+      for(int k = 0; k < ch; k++)
+      {
+        xc[k] = CLAMPF(in[offset + k], Labmin[k], Labmax[k]);
+        yc[k] = (a0 * xc[k]) + (a1 * xp[k]) - (b1 * yp[k]) - (b2 * yb[k]);
+
+        temp[offset + k] = yc[k];
+
+        xp[k] = xc[k];
+        yb[k] = yp[k];
+        yp[k] = yc[k];
+      }
+    }
+
+    // backward filter
+    for(int k = 0; k < ch; k++)
+    {
+      xn[k] = CLAMPF(in[((size_t)(height - 1) * width + i) * ch + k], Labmin[k], Labmax[k]);
+      xa[k] = xn[k];
+      yn[k] = xn[k] * coefn;
+      ya[k] = yn[k];
+    }
+
+    for(int j = height - 1; j > -1; j--)
+    {
+      size_t offset = ((size_t)j * width + i) * ch;
+
+      for(int k = 0; k < ch; k++)
+      {
+        xc[k] = CLAMPF(in[offset + k], Labmin[k], Labmax[k]);
+
+        yc[k] = (a2 * xn[k]) + (a3 * xa[k]) - (b1 * yn[k]) - (b2 * ya[k]);
+
+        xa[k] = xn[k];
+        xn[k] = xc[k];
+        ya[k] = yn[k];
+        yn[k] = yc[k];
+
+        temp[offset + k] += yc[k];
+      }
+    }
+  }
+
+// horizontal blur line by line
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for(int j = 0; j < height; j++)
+  {
+    float xp[ch];
+    float yb[ch];
+    float yp[ch];
+    float xc[ch];
+    float yc[ch];
+    float xn[ch];
+    float xa[ch];
+    float yn[ch];
+    float ya[ch];
+
+    // forward filter
+    for(int k = 0; k < ch; k++)
+    {
+      xp[k] = CLAMPF(temp[(size_t)j * width * ch + k], Labmin[k], Labmax[k]);
+      yb[k] = xp[k] * coefp;
+      yp[k] = yb[k];
+      xc[k] = yc[k] = xn[k] = xa[k] = yn[k] = ya[k] = 0.0f;
+    }
+
+    for(int i = 0; i < width; i++)
+    {
+      size_t offset = ((size_t)j * width + i) * ch;
+
+      for(int k = 0; k < ch; k++)
+      {
+        xc[k] = CLAMPF(temp[offset + k], Labmin[k], Labmax[k]);
+        yc[k] = (a0 * xc[k]) + (a1 * xp[k]) - (b1 * yp[k]) - (b2 * yb[k]);
+
+        out[offset + k] = yc[k];
+
+        xp[k] = xc[k];
+        yb[k] = yp[k];
+        yp[k] = yc[k];
+      }
+    }
+
+    // backward filter
+    for(int k = 0; k < ch; k++)
+    {
+      xn[k] = CLAMPF(temp[((size_t)(j + 1) * width - 1) * ch + k], Labmin[k], Labmax[k]);
+      xa[k] = xn[k];
+      yn[k] = xn[k] * coefn;
+      ya[k] = yn[k];
+    }
+
+    for(int i = width - 1; i > -1; i--)
+    {
+      size_t offset = ((size_t)j * width + i) * ch;
+
+      for(int k = 0; k < ch; k++)
+      {
+        xc[k] = CLAMPF(temp[offset + k], Labmin[k], Labmax[k]);
+
+        yc[k] = (a2 * xn[k]) + (a3 * xa[k]) - (b1 * yn[k]) - (b2 * ya[k]);
+
+        xa[k] = xn[k];
+        xn[k] = xc[k];
+        ya[k] = yn[k];
+        yn[k] = yc[k];
+
+        out[offset + k] += yc[k];
+      }
+    }
+  }
+}
+
+static void blur_4c_ref(dt_gaussian_t *g, float *in, float *out)
+{
+
+  const int width = g->width;
+  const int height = g->height;
+  const int ch = 4;
+
+  assert(g->channels == 4);
+
+  float a0, a1, a2, a3, b1, b2, coefp, coefn;
+
+  compute_gauss_params(g->sigma, g->order, &a0, &a1, &a2, &a3, &b1, &b2, &coefp, &coefn);
+
+  const __m128 Labmax = _mm_set_ps(g->max[3], g->max[2], g->max[1], g->max[0]);
+  const __m128 Labmin = _mm_set_ps(g->min[3], g->min[2], g->min[1], g->min[0]);
+
+  float *temp = g->buf;
+
+// vertical blur column by column
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for(int i = 0; i < width; i++)
+  {
+    __m128 xp = _mm_setzero_ps();
+    __m128 yb = _mm_setzero_ps();
+    __m128 yp = _mm_setzero_ps();
+    __m128 xc = _mm_setzero_ps();
+    __m128 yc = _mm_setzero_ps();
+    __m128 xn = _mm_setzero_ps();
+    __m128 xa = _mm_setzero_ps();
+    __m128 yn = _mm_setzero_ps();
+    __m128 ya = _mm_setzero_ps();
+
+    // forward filter
+    xp = MMCLAMPPS(_mm_load_ps(in + i * ch), Labmin, Labmax);
+    yb = _mm_mul_ps(_mm_set_ps1(coefp), xp);
+    yp = yb;
+
+    for(int j = 0; j < height; j++)
+    {
+      size_t offset = ((size_t)j * width + i) * ch;
+
+      xc = MMCLAMPPS(_mm_load_ps(in + offset), Labmin, Labmax);
+
+      yc = _mm_add_ps(
+          _mm_mul_ps(xc, _mm_set_ps1(a0)),
+          _mm_sub_ps(_mm_mul_ps(xp, _mm_set_ps1(a1)),
+                     _mm_add_ps(_mm_mul_ps(yp, _mm_set_ps1(b1)), _mm_mul_ps(yb, _mm_set_ps1(b2)))));
+
+      _mm_store_ps(temp + offset, yc);
+
+      xp = xc;
+      yb = yp;
+      yp = yc;
+    }
+
+    // backward filter
+    xn = MMCLAMPPS(_mm_load_ps(in + ((size_t)(height - 1) * width + i) * ch), Labmin, Labmax);
+    xa = xn;
+    yn = _mm_mul_ps(_mm_set_ps1(coefn), xn);
+    ya = yn;
+
+    for(int j = height - 1; j > -1; j--)
+    {
+      size_t offset = ((size_t)j * width + i) * ch;
+
+      xc = MMCLAMPPS(_mm_load_ps(in + offset), Labmin, Labmax);
+
+      yc = _mm_add_ps(
+          _mm_mul_ps(xn, _mm_set_ps1(a2)),
+          _mm_sub_ps(_mm_mul_ps(xa, _mm_set_ps1(a3)),
+                     _mm_add_ps(_mm_mul_ps(yn, _mm_set_ps1(b1)), _mm_mul_ps(ya, _mm_set_ps1(b2)))));
+
+      xa = xn;
+      xn = xc;
+      ya = yn;
+      yn = yc;
+
+      _mm_store_ps(temp + offset, _mm_add_ps(_mm_load_ps(temp + offset), yc));
+    }
+  }
+
+// horizontal blur line by line
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for(size_t j = 0; j < height; j++)
+  {
+    __m128 xp = _mm_setzero_ps();
+    __m128 yb = _mm_setzero_ps();
+    __m128 yp = _mm_setzero_ps();
+    __m128 xc = _mm_setzero_ps();
+    __m128 yc = _mm_setzero_ps();
+    __m128 xn = _mm_setzero_ps();
+    __m128 xa = _mm_setzero_ps();
+    __m128 yn = _mm_setzero_ps();
+    __m128 ya = _mm_setzero_ps();
+
+    // forward filter
+    xp = MMCLAMPPS(_mm_load_ps(temp + j * width * ch), Labmin, Labmax);
+    yb = _mm_mul_ps(_mm_set_ps1(coefp), xp);
+    yp = yb;
+
+    for(int i = 0; i < width; i++)
+    {
+      size_t offset = ((size_t)j * width + i) * ch;
+
+      xc = MMCLAMPPS(_mm_load_ps(temp + offset), Labmin, Labmax);
+
+      yc = _mm_add_ps(
+          _mm_mul_ps(xc, _mm_set_ps1(a0)),
+          _mm_sub_ps(_mm_mul_ps(xp, _mm_set_ps1(a1)),
+                     _mm_add_ps(_mm_mul_ps(yp, _mm_set_ps1(b1)), _mm_mul_ps(yb, _mm_set_ps1(b2)))));
+
+      _mm_store_ps(out + offset, yc);
+
+      xp = xc;
+      yb = yp;
+      yp = yc;
+    }
+
+    // backward filter
+    xn = MMCLAMPPS(_mm_load_ps(temp + ((size_t)(j + 1) * width - 1) * ch), Labmin, Labmax);
+    xa = xn;
+    yn = _mm_mul_ps(_mm_set_ps1(coefn), xn);
+    ya = yn;
+
+    for(int i = width - 1; i > -1; i--)
+    {
+      size_t offset = ((size_t)j * width + i) * ch;
+
+      xc = MMCLAMPPS(_mm_load_ps(temp + offset), Labmin, Labmax);
+
+      yc = _mm_add_ps(
+          _mm_mul_ps(xn, _mm_set_ps1(a2)),
+          _mm_sub_ps(_mm_mul_ps(xa, _mm_set_ps1(a3)),
+                     _mm_add_ps(_mm_mul_ps(yn, _mm_set_ps1(b1)), _mm_mul_ps(ya, _mm_set_ps1(b2)))));
+
+      xa = xn;
+      xn = xc;
+      ya = yn;
+      yn = yc;
+
+      _mm_store_ps(out + offset, _mm_add_ps(_mm_load_ps(out + offset), yc));
+    }
+  }
+}
+
+
+static void run(const int wd, const int ht, const int ch, const float sigma, const int order)
+{
+  const size_t size = (size_t)wd * ht * ch;
+  float *in = dt_alloc_align(64, sizeof(float) * size);
+  float *ref = dt_alloc_align(64, sizeof(float) * size);
+  float *out = dt_alloc_align(64, sizeof(float) * size);
+  const float max[4] = { 100.0f, 128.0f, 128.0f, 1.0f }, min[4] = { 0.0f, -128.0f, -128.0f, 0.0f };
+
+  srand(1);
+  for(size_t k = 0; k < size; k++) in[k] = max[k % ch] * (rand() / (float)RAND_MAX);
+
+  dt_gaussian_t *g = dt_gaussian_init(wd, ht, ch, max, min, sigma, order);
+
+  // once to fault in all buffers, so the timings below are fair
+  if(ch == 4)
+  {
+    blur_4c_ref(g, in, ref);
+    dt_gaussian_blur_4c(g, in, out);
+  }
+  else
+  {
+    blur_ref(g, in, ref);
+    dt_gaussian_blur(g, in, out);
+  }
+
+  double start = dt_get_wtime();
+  if(ch == 4)
+    blur_4c_ref(g, in, ref);
+  else
+    blur_ref(g, in, ref);
+  const double t_ref = dt_get_wtime() - start;
+
+  start = dt_get_wtime();
+  if(ch == 4)
+    dt_gaussian_blur_4c(g, in, out);
+  else
+    dt_gaussian_blur(g, in, out);
+  const double t_new = dt_get_wtime() - start;
+
+  double maxdiff = 0.0;
+  for(size_t k = 0; k < size; k++) maxdiff = fmax(maxdiff, fabs(ref[k] - out[k]));
+
+  fprintf(stderr, "[gaussian] %dx%d %dc sigma %5.1f order %d: columns %7.3fs, blocks %7.3fs (%4.1fx), "
+                  "max abs diff %g\n",
+          wd, ht, ch, sigma, order, t_ref, t_new, t_ref / t_new, maxdiff);
+
+  dt_gaussian_free(g);
+  dt_free_align(in);
+  dt_free_align(ref);
+  dt_free_align(out);
+}
+
+int main(int argc, char *arg[])
+{
+  const int wd = argc > 1 ? atoi(arg[1]) : 6000;
+  const int ht = argc > 2 ? atoi(arg[2]) : 4000;
+  const float sigmas[] = { 2.0f, 20.0f, 100.0f };
+  for(int s = 0; s < sizeof(sigmas) / sizeof(sigmas[0]); s++)
+  {
+    run(wd, ht, 1, sigmas[s], DT_IOP_GAUSSIAN_ZERO);
+    run(wd, ht, 3, sigmas[s], DT_IOP_GAUSSIAN_ZERO);
+    run(wd, ht, 4, sigmas[s], DT_IOP_GAUSSIAN_ZERO);
+  }
+  run(wd, ht, 4, 10.0f, DT_IOP_GAUSSIAN_ONE);
+  run(wd, ht, 1, 10.0f, DT_IOP_GAUSSIAN_TWO);
+  // odd sizes, for the blocks at the right and bottom border
+  run(wd + 7, ht + 3, 1, 10.0f, DT_IOP_GAUSSIAN_ZERO);
+  run(wd + 7, ht + 3, 4, 10.0f, DT_IOP_GAUSSIAN_ZERO);
+  exit(0);
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
@@ -0,0 +1,192 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define DT_UNIT_TEST
+#define _GNU_SOURCE
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include "common/dtpthread.h"
+#include "control/jobs.h"
+
+// just the parts of the control struct the job system needs, so we don't need to include the rest of dt:
+typedef struct dt_control_t
+{
+  int32_t running;
+  dt_pthread_mutex_t res_mutex, cond_mutex, run_mutex;
+  pthread_cond_t cond;
+  int32_t num_threads;
+  pthread_t *thread, kick_on_workers_thread;
+  struct dt_control_job_deque_t *deques;
+  int32_t jobs_pending, fg_jobs, prefetch_jobs;
+  uint32_t next_deque;
+  uint64_t job_seq;
+  dt_job_t *job_res[DT_CTL_WORKER_RESERVED];
+  uint8_t new_res[DT_CTL_WORKER_RESERVED];
+  pthread_t thread_res[DT_CTL_WORKER_RESERVED];
+} dt_control_t;
+
+static struct
+{
+  dt_control_t *control;
+  int num_openmp_threads;
+} darktable;
+
+static int num_workers = 1;
+
+#define DT_DEBUG_CONTROL 0
+static void dt_print(int type, const char *msg, ...)
+{
+}
+
+static inline double dt_get_wtime()
+{
+  struct timeval time;
+  gettimeofday(&time, NULL);
+  return time.tv_sec - 1290608000 + (1.0 / 1000000.0) * time.tv_usec;
+}
+
+static int dt_conf_get_int(const char *name)
+{
+  return num_workers;
+}
+
+static int dt_control_running()
+{
+  dt_pthread_mutex_lock(&darktable.control->run_mutex);
+  const int running = darktable.control->running;
+  dt_pthread_mutex_unlock(&darktable.control->run_mutex);
+  return running;
+}
+
+// unit test and throughput benchmark for the job scheduler.
+#include "control/jobs.c"
+
+static int32_t finished = 0, discarded = 0;
+
+static void count_state(dt_job_t *job, dt_job_state_t state)
+{
+  if(state == DT_JOB_STATE_FINISHED) __sync_fetch_and_add(&finished, 1);
+  if(state == DT_JOB_STATE_DISCARDED) __sync_fetch_and_add(&discarded, 1);
+}
+
+static int32_t nop_job(dt_job_t *job)
+{
+  return 0;
+}
+
+static int32_t spawn_job(dt_job_t *job)
+{
+  // these go to the deque of the running worker and get stolen by the idle ones
+  const int children = (int)(long int)dt_control_job_get_params(job);
+  for(int k = 0; k < children; k++)
+  {
+    dt_job_t *child = dt_control_job_create(nop_job, "child");
+    dt_control_job_set_state_callback(child, count_state);
+    dt_control_add_job(darktable.control, DT_JOB_QUEUE_USER_BG, child);
+  }
+  return 0;
+}
+
+static void add(dt_control_t *control, dt_job_queue_t queue, dt_job_execute_callback execute, void *params,
+                const char *description)
+{
+  dt_job_t *job = dt_control_job_create(execute, "%s", description);
+  dt_control_job_set_params(job, params);
+  dt_control_job_set_state_callback(job, count_state);
+  dt_control_add_job(control, queue, job);
+}
+
+static void wait_for(const int32_t total)
+{
+  while(__sync_fetch_and_add(&finished, 0) + __sync_fetch_and_add(&discarded, 0) < total) usleep(100);
+}
+
+int main(int argc, char *arg[])
+{
+  const int num = 200000;
+  for(num_workers = 1; num_workers <= 8; num_workers *= 2)
+  {
+    dt_control_t control = { 0 };
+    darktable.control = &control;
+    pthread_cond_init(&control.cond, NULL);
+    dt_pthread_mutex_init(&control.cond_mutex, NULL);
+    dt_pthread_mutex_init(&control.res_mutex, NULL);
+    dt_pthread_mutex_init(&control.run_mutex, NULL);
+    dt_control_jobs_init(&control);
+
+    // enqueue from outside, as the gui does
+    finished = discarded = 0;
+    double start = dt_get_wtime();
+    for(int k = 0; k < num; k++) add(&control, DT_JOB_QUEUE_SYSTEM_BG, nop_job, NULL, "job");
+    wait_for(num);
+    double end = dt_get_wtime();
+    assert(finished == num && discarded == 0);
+    fprintf(stderr, "[jobs] %d workers, external enqueue: %.0f jobs/s\n", num_workers, num / (end - start));
+
+    // enqueue from inside the workers
+    finished = discarded = 0;
+    start = dt_get_wtime();
+    const int children = 100;
+    for(int k = 0; k < num / children; k++)
+      add(&control, DT_JOB_QUEUE_USER_BG, spawn_job, (void *)(long int)children, "spawn");
+    wait_for(num / children * (children + 1));
+    end = dt_get_wtime();
+    assert(finished == num / children * (children + 1) && discarded == 0);
+    fprintf(stderr, "[jobs] %d workers, nested enqueue:   %.0f jobs/s\n", num_workers,
+            num / children * (children + 1) / (end - start));
+
+    // thumbnail storm: duplicates get merged and the foreground stack is bounded, but every job is
+    // either run or discarded exactly once
+    finished = discarded = 0;
+    start = dt_get_wtime();
+    char description[64];
+    for(int k = 0; k < num; k++)
+    {
+      snprintf(description, sizeof(description), "thumb %d", k % 1000);
+      add(&control, DT_JOB_QUEUE_SYSTEM_FG, nop_job, NULL, description);
+    }
+    wait_for(num);
+    end = dt_get_wtime();
+    assert(finished + discarded == num);
+    assert(__sync_fetch_and_add(&control.fg_jobs, 0) == 0 && __sync_fetch_and_add(&control.jobs_pending, 0) == 0);
+    fprintf(stderr, "[jobs] %d workers, foreground stack: %.0f jobs/s (%d run, %d discarded)\n", num_workers,
+            num / (end - start), finished, discarded);
+
+    // shut down like dt_control_shutdown() does
+    dt_pthread_mutex_lock(&control.cond_mutex);
+    dt_pthread_mutex_lock(&control.run_mutex);
+    control.running = 0;
+    dt_pthread_mutex_unlock(&control.run_mutex);
+    dt_pthread_mutex_unlock(&control.cond_mutex);
+    pthread_cond_broadcast(&control.cond);
+    pthread_join(control.kick_on_workers_thread, NULL);
+    for(int k = 0; k < control.num_threads; k++) pthread_join(control.thread[k], NULL);
+    for(int k = 0; k < DT_CTL_WORKER_RESERVED; k++) pthread_join(control.thread_res[k], NULL);
+    dt_control_jobs_cleanup(&control);
+  }
+  exit(0);
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
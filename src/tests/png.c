@@ -0,0 +1,174 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <sys/time.h>
+#include <omp.h>
+#include <png.h>
+
+// png export through libpng row by row against the row groups deflated on all threads, which are read back
+// with libpng to check they decode to the input.
+
+// the parts of common/darktable.h the deflate needs, without pulling in glib and the rest
+#define DARKTABLE_H
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define CLAMPS(A, L, H) ((A) > (L) ? ((A) < (H) ? (A) : (H)) : (L))
+#define dt_get_num_threads() omp_get_max_threads()
+
+#include "common/png_deflate.h"
+
+static inline double dt_get_wtime()
+{
+  struct timeval time;
+  gettimeofday(&time, NULL);
+  return time.tv_sec - 1290608000 + (1.0 / 1000000.0) * time.tv_usec;
+}
+
+static int write_idat(void *user_data, const uint8_t *data, size_t len)
+{
+  png_write_chunk((png_structp)user_data, (png_const_bytep) "IDAT", data, len);
+  return 0;
+}
+
+static long write_png(const char *filename, const void *in, const int wd, const int ht, const int bpp,
+                      const int level, const int parallel)
+{
+  FILE *f = fopen(filename, "wb");
+  if(!f) return -1;
+  png_structp png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  png_infop info_ptr = png_create_info_struct(png_ptr);
+  if(setjmp(png_jmpbuf(png_ptr)))
+  {
+    fclose(f);
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+    return -1;
+  }
+  png_init_io(png_ptr, f);
+  // the settings the export used before
+  png_set_compression_level(png_ptr, level);
+  png_set_compression_mem_level(png_ptr, 8);
+  png_set_compression_strategy(png_ptr, Z_DEFAULT_STRATEGY);
+  png_set_compression_window_bits(png_ptr, 15);
+  png_set_compression_buffer_size(png_ptr, 8192);
+  png_set_IHDR(png_ptr, info_ptr, wd, ht, bpp, PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE,
+               PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+  png_write_info(png_ptr, info_ptr);
+  if(parallel)
+  {
+    dt_png_deflate(in, wd, ht, bpp, level, write_idat, png_ptr);
+    png_write_chunk(png_ptr, (png_const_bytep) "IEND", NULL, 0);
+  }
+  else
+  {
+    png_set_filler(png_ptr, 0, PNG_FILLER_AFTER);
+    if(bpp > 8) png_set_swap(png_ptr);
+    png_bytep *rows = malloc(sizeof(png_bytep) * ht);
+    for(int j = 0; j < ht; j++) rows[j] = (png_bytep)in + (size_t)4 * (bpp / 8) * wd * j;
+    png_write_image(png_ptr, rows);
+    free(rows);
+    png_write_end(png_ptr, info_ptr);
+  }
+  png_destroy_write_struct(&png_ptr, &info_ptr);
+  const long size = ftell(f);
+  fclose(f);
+  return size;
+}
+
+// returns the number of samples which differ from the input, or -1 if libpng can't read the file.
+static long check_png(const char *filename, const void *in, const int wd, const int ht, const int bpp)
+{
+  FILE *f = fopen(filename, "rb");
+  if(!f) return -1;
+  png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  png_infop info_ptr = png_create_info_struct(png_ptr);
+  uint8_t *row = malloc((size_t)6 * wd);
+  if(setjmp(png_jmpbuf(png_ptr)))
+  {
+    free(row);
+    fclose(f);
+    png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+    return -1;
+  }
+  png_init_io(png_ptr, f);
+  png_read_info(png_ptr, info_ptr);
+  long diff = 0;
+  for(int j = 0; j < ht; j++)
+  {
+    png_read_row(png_ptr, row, NULL);
+    for(int i = 0; i < 3 * wd; i++)
+    {
+      const int k = 4 * (i / 3) + i % 3;
+      if(bpp == 8)
+        diff += row[i] != ((const uint8_t *)in)[(size_t)4 * wd * j + k];
+      else
+        diff += ((row[2 * i] << 8) | row[2 * i + 1]) != ((const uint16_t *)in)[(size_t)4 * wd * j + k];
+    }
+  }
+  png_read_end(png_ptr, NULL);
+  png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+  free(row);
+  fclose(f);
+  return diff;
+}
+
+int main(int argc, char *arg[])
+{
+  const int wd = argc > 1 ? atoi(arg[1]) : 4000;
+  const int ht = argc > 2 ? atoi(arg[2]) : 3000;
+  const int level = argc > 3 ? atoi(arg[3]) : 5;
+
+  uint16_t *in16 = malloc(sizeof(uint16_t) * 4 * wd * ht);
+  uint8_t *in8 = malloc(sizeof(uint8_t) * 4 * wd * ht);
+  srand(1);
+  for(size_t k = 0; k < (size_t)wd * ht; k++)
+  {
+    const int i = k % wd, j = k / wd;
+    for(int c = 0; c < 4; c++)
+    {
+      const float v = 0.5f + 0.4f * sinf(i * 0.003f * (c + 1)) * cosf(j * 0.004f) + 0.02f * (rand() / (float)RAND_MAX);
+      in16[4 * k + c] = CLAMPS(v, 0.0f, 1.0f) * 0xffff;
+      in8[4 * k + c] = in16[4 * k + c] >> 8;
+    }
+  }
+
+  for(int bpp = 8; bpp <= 16; bpp += 8)
+  {
+    const void *in = bpp == 8 ? (void *)in8 : (void *)in16;
+    double start = dt_get_wtime();
+    const long size_ref = write_png("/tmp/dt_png_libpng.png", in, wd, ht, bpp, level, 0);
+    const double t_ref = dt_get_wtime() - start;
+    start = dt_get_wtime();
+    const long size = write_png("/tmp/dt_png_parallel.png", in, wd, ht, bpp, level, 1);
+    const double t = dt_get_wtime() - start;
+    fprintf(stderr, "[png] %dx%d %2d bit level %d, %d threads: libpng %7.3fs %10ld bytes, parallel %7.3fs %10ld "
+                    "bytes (%5.1fx), %ld samples differ\n",
+            wd, ht, bpp, level, omp_get_max_threads(), t_ref, size_ref, t, size, t_ref / t,
+            check_png("/tmp/dt_png_parallel.png", in, wd, ht, bpp));
+  }
+
+  free(in16);
+  free(in8);
+  exit(0);
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-space on;
@@ -103,6 +103,20 @@ typedef struct dt_library_t
 
   int32_t collection_count;
 
+  /* image ids of the collection in display order, a copy of memory.collected_images. scrolling and prefetching
+   * only need a slice of it instead of stepping through the table with a growing offset. */
+  int32_t *collected;
+  int32_t collected_count, collected_alloc;
+
+  /* state of the thumbnail prefetch of the file manager */
+  struct
+  {
+    int32_t offset;   // at the last prefetch
+    double time;      // of the last prefetch
+    float velocity;   // in images per second, negative when scrolling up
+    guint idle_source; // upgrades the prefetched thumbnails once scrolling stopped
+  } prefetch;
+
   // stuff for the audio player
   GPid audio_player_pid;   // the pid of the child process
   int32_t audio_player_id; // the imgid of the image the audio is played for
@@ -260,17 +274,224 @@ void zoom_around_image(dt_library_t *lib, double pointerx, double pointery, int
   lib->images_in_row = new_images_in_row;
 }
 
+/* range of collection indices the thumbnail prefetch still cares about. prefetch jobs for images which scrolled
+ * out of it while they were queued return without loading anything. the gui thread sets it, the workers read it
+ * atomically; seeing one bound already updated and the other not yet only costs a thumbnail more or less. */
+static gint _prefetch_lo = 0, _prefetch_hi = 0;
+
+typedef struct dt_lighttable_prefetch_t
+{
+  int32_t imgid;
+  int32_t idx; // in the collection
+  dt_mipmap_size_t mip;
+} dt_lighttable_prefetch_t;
+
+static int32_t _prefetch_job_run(dt_job_t *job)
+{
+  dt_lighttable_prefetch_t *params = dt_control_job_get_params(job);
+
+  if(params->idx >= g_atomic_int_get(&_prefetch_lo) && params->idx < g_atomic_int_get(&_prefetch_hi))
+  {
+    dt_mipmap_buffer_t buf;
+    dt_mipmap_cache_get(darktable.mipmap_cache, &buf, params->imgid, params->mip, DT_MIPMAP_BLOCKING, 'r');
+    dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
+  }
+  free(params);
+  return 0;
+}
+
+static void _prefetch_image(int32_t imgid, int32_t idx, dt_mipmap_size_t mip)
+{
+  if(mip > DT_MIPMAP_FULL || (int)mip < DT_MIPMAP_0) return;
+  dt_job_t *job = dt_control_job_create(&_prefetch_job_run, "prefetch image %d mip %d", imgid, mip);
+  if(!job) return;
+  dt_lighttable_prefetch_t *params = (dt_lighttable_prefetch_t *)calloc(1, sizeof(dt_lighttable_prefetch_t));
+  if(!params)
+  {
+    dt_control_job_dispose(job);
+    return;
+  }
+  params->imgid = imgid;
+  params->idx = idx;
+  params->mip = mip;
+  dt_control_job_set_params(job, params);
+  // its own queue: the far ones, queued first, are the first to go when it fills up, and thumbnails on screen
+  // don't have to wait for them
+  dt_control_add_job(darktable.control, DT_JOB_QUEUE_SYSTEM_PREFETCH, job);
+}
+
+static gboolean _prefetch_idle(gpointer user_data)
+{
+  // scrolling stopped: prefetch again, this time with the size the thumbnails are shown in
+  dt_view_t *self = (dt_view_t *)user_data;
+  dt_library_t *lib = (dt_library_t *)self->data;
+  lib->prefetch.idle_source = 0;
+  lib->prefetch.velocity = 0.0f;
+  lib->offset_changed = TRUE;
+  dt_control_queue_redraw_center();
+  return FALSE;
+}
+
 static void _view_lighttable_collection_listener_callback(gpointer instance, gpointer user_data)
 {
   dt_view_t *self = (dt_view_t *)user_data;
   _update_collected_images(self);
 }
 
+/* copies at most count image ids of the collection, starting at offset. returns how many were copied. */
+static int32_t _collected_images_slice(const dt_library_t *lib, int32_t offset, int32_t count, int32_t *ids)
+{
+  if(offset < 0 || offset >= lib->collected_count) return 0;
+  const int32_t num = MIN(count, lib->collected_count - offset);
+  memcpy(ids, lib->collected + offset, sizeof(int32_t) * num);
+  return num;
+}
+
+/* inserts imgid into the collected images at its sort position. returns FALSE if the position can't be
+ * told. */
+static gboolean _insert_collected_image(dt_library_t *lib, int32_t imgid)
+{
+  for(int32_t k = 0; k < lib->collected_count; k++)
+    if(lib->collected[k] == imgid) return TRUE;
+
+  const int pos = dt_collection_image_sort_position(darktable.collection, imgid, lib->collected,
+                                                    lib->collected_count);
+  if(pos < 0) return FALSE;
+
+  sqlite3_stmt *stmt;
+  if(pos < lib->collected_count)
+  {
+    // take over the rowid of the image at pos and move everything from there on one row down. rowids are
+    // unique, so the rows are moved through negative values first.
+    int32_t rowid = -1;
+    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                                "SELECT rowid FROM memory.collected_images WHERE imgid = ?1", -1, &stmt,
+                                NULL);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, lib->collected[pos]);
+    if(sqlite3_step(stmt) == SQLITE_ROW) rowid = sqlite3_column_int(stmt, 0);
+    sqlite3_finalize(stmt);
+    if(rowid < 0) return FALSE;
+
+    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                                "UPDATE memory.collected_images SET rowid = -(rowid + 1) "
+                                "WHERE rowid >= ?1",
+                                -1, &stmt, NULL);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, rowid);
+    sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db),
+                          "UPDATE memory.collected_images SET rowid = -rowid WHERE rowid < 0", NULL, NULL,
+                          NULL);
+
+    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                                "INSERT INTO memory.collected_images (rowid, imgid) VALUES (?1, ?2)", -1,
+                                &stmt, NULL);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, rowid);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, imgid);
+    sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+
+    if(lib->full_preview_id != -1 && lib->full_preview_rowid >= rowid) lib->full_preview_rowid++;
+  }
+  else
+  {
+    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                                "INSERT INTO memory.collected_images (imgid) VALUES (?1)", -1, &stmt, NULL);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+    sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+  }
+
+  if(lib->collected_count == lib->collected_alloc)
+  {
+    lib->collected_alloc = MAX(1024, 2 * lib->collected_alloc);
+    lib->collected = realloc(lib->collected, sizeof(int32_t) * lib->collected_alloc);
+  }
+  memmove(lib->collected + pos + 1, lib->collected + pos, sizeof(int32_t) * (lib->collected_count - pos));
+  lib->collected[pos] = imgid;
+  lib->collected_count++;
+  return TRUE;
+}
+
+/* drops imgid from the collected images. returns FALSE if the full preview has to find another image. */
+static gboolean _remove_collected_image(dt_library_t *lib, int32_t imgid)
+{
+  if(imgid == lib->full_preview_id) return FALSE;
+
+  for(int32_t pos = 0; pos < lib->collected_count; pos++)
+    if(lib->collected[pos] == imgid)
+    {
+      sqlite3_stmt *stmt;
+      DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                                  "DELETE FROM memory.collected_images WHERE imgid = ?1", -1, &stmt, NULL);
+      DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+      sqlite3_step(stmt);
+      sqlite3_finalize(stmt);
+
+      memmove(lib->collected + pos, lib->collected + pos + 1,
+              sizeof(int32_t) * (lib->collected_count - pos - 1));
+      lib->collected_count--;
+      break;
+    }
+  return TRUE;
+}
+
+/* images joined or left the collection without its query changing, follow them instead of rebuilding */
+static void _view_lighttable_collection_images_callback(gpointer instance, GList *imgs, guint member,
+                                                        gpointer user_data)
+{
+  dt_view_t *self = (dt_view_t *)user_data;
+  dt_library_t *lib = (dt_library_t *)self->data;
+
+  for(GList *l = imgs; l; l = g_list_next(l))
+  {
+    const int32_t imgid = GPOINTER_TO_INT(l->data);
+    if(!(member ? _insert_collected_image(lib, imgid) : _remove_collected_image(lib, imgid)))
+    {
+      _update_collected_images(self);
+      break;
+    }
+  }
+
+  lib->collection_count = dt_collection_get_count(darktable.collection);
+  dt_control_queue_redraw_center();
+}
+
+/* called after an image changed in a way which might move it in or out of the collection, like its rating.
+ * instead of rebuilding the collection only that image joins or leaves it. that is not possible if the change
+ * might move it to another position, in that case everything is rebuilt. */
+static void _update_collected_image(dt_view_t *self, int32_t imgid)
+{
+  dt_library_t *lib = (dt_library_t *)self->data;
+  const dt_collection_params_t *params = dt_collection_params(darktable.collection);
+
+  gboolean collected = FALSE;
+  for(int32_t k = 0; k < lib->collected_count; k++)
+    if(lib->collected[k] == imgid)
+    {
+      collected = TRUE;
+      break;
+    }
+
+  const int member = dt_collection_image_is_member(darktable.collection, imgid);
+  if(member < 0 || imgid == lib->full_preview_id
+     || (params->sort == DT_COLLECTION_SORT_RATING && (params->query_flags & COLLECTION_QUERY_USE_SORT)))
+  {
+    _update_collected_images(self);
+    return;
+  }
+
+  if(member != collected)
+    dt_collection_images_changed(darktable.collection, g_list_prepend(NULL, GINT_TO_POINTER(imgid)), member);
+  else
+    dt_control_queue_redraw_center();
+}
+
 static void _update_collected_images(dt_view_t *self)
 {
   dt_library_t *lib = (dt_library_t *)self->data;
   sqlite3_stmt *stmt;
-  int32_t min_before = 0, min_after = 0;
+  int32_t full_preview_index = 0, min_after = 0;
 
   /* check if we can get a query from collection */
   const gchar *query = dt_collection_get_query(darktable.collection);
@@ -279,15 +500,18 @@ static void _update_collected_images(dt_view_t *self)
   // we have a new query for the collection of images to display. For speed reason we collect all images into
   // a temporary (in-memory) table (collected_images).
   //
-  // 0. get current lower rowid
+  // 0. get the current position of the full preview, images joining or leaving leave gaps in the rowids
   if (lib->full_preview_id != -1)
   {
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "SELECT MIN(rowid) FROM memory.collected_images",
-                                -1, &stmt, NULL);
+    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                                "SELECT COUNT(*) FROM memory.collected_images WHERE rowid < ?1", -1, &stmt,
+                                NULL);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, lib->full_preview_rowid);
     if(sqlite3_step(stmt) == SQLITE_ROW)
     {
-      min_before = sqlite3_column_int(stmt, 0);
+      full_preview_index = sqlite3_column_int(stmt, 0);
     }
+    sqlite3_finalize(stmt);
   }
 
   // 1. drop previous data
@@ -308,7 +532,22 @@ static void _update_collected_images(dt_view_t *self)
 
   g_free(ins_query);
 
-  // 3. get new low-bound, then update the full preview rowid accordingly
+  // 3. keep the image ids in memory, in display order
+  lib->collected_count = 0;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT imgid FROM memory.collected_images ORDER BY rowid", -1, &stmt, NULL);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    if(lib->collected_count == lib->collected_alloc)
+    {
+      lib->collected_alloc = MAX(1024, 2 * lib->collected_alloc);
+      lib->collected = realloc(lib->collected, sizeof(int32_t) * lib->collected_alloc);
+    }
+    lib->collected[lib->collected_count++] = sqlite3_column_int(stmt, 0);
+  }
+  sqlite3_finalize(stmt);
+
+  // 4. get new low-bound, then update the full preview rowid accordingly
   if (lib->full_preview_id != -1)
   {
     DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "SELECT MIN(rowid) FROM memory.collected_images",
@@ -321,7 +560,7 @@ static void _update_collected_images(dt_view_t *self)
     // note that this adjustement is needed as for a memory table the rowid doesn't start to 1 after the DELETE
     // above,
     // but rowid is incremented each time we INSERT.
-    lib->full_preview_rowid += (min_after - min_before);
+    lib->full_preview_rowid = min_after + full_preview_index;
 
     char col_query[128] = { 0 };
     snprintf(col_query, sizeof(col_query), "SELECT imgid FROM memory.collected_images WHERE rowid=%d", lib->full_preview_rowid);
@@ -410,6 +649,8 @@ void init(dt_view_t *self)
   /* setup collection listener and initialize main_query statement */
   dt_control_signal_connect(darktable.signals, DT_SIGNAL_COLLECTION_CHANGED,
                             G_CALLBACK(_view_lighttable_collection_listener_callback), (gpointer)self);
+  dt_control_signal_connect(darktable.signals, DT_SIGNAL_COLLECTION_IMAGES_CHANGED,
+                            G_CALLBACK(_view_lighttable_collection_images_callback), (gpointer)self);
 
   _view_lighttable_collection_listener_callback(NULL, self);
 
@@ -425,12 +666,16 @@ void init(dt_view_t *self)
 void cleanup(dt_view_t *self)
 {
   dt_control_signal_disconnect(darktable.signals, G_CALLBACK(_view_lighttable_collection_listener_callback), self);
+  dt_control_signal_disconnect(darktable.signals, G_CALLBACK(_view_lighttable_collection_images_callback),
+                               self);
 
   dt_library_t *lib = (dt_library_t *)self->data;
   dt_conf_set_float("lighttable/ui/zoom_x", lib->zoom_x);
   dt_conf_set_float("lighttable/ui/zoom_y", lib->zoom_y);
   if(lib->audio_player_id != -1) _stop_audio(lib);
+  if(lib->prefetch.idle_source) g_source_remove(lib->prefetch.idle_source);
   free(lib->full_res_thumb);
+  free(lib->collected);
   free(self->data);
 }
 
@@ -559,14 +804,6 @@ static int expose_filemanager(dt_view_t *self, cairo_t *cr, int32_t width, int32
   /* update scroll borders */
   dt_view_set_scrollbar(self, 0, 1, 1, offset, lib->collection_count, max_rows * iir);
 
-  /* let's reset and reuse the main_query statement */
-  DT_DEBUG_SQLITE3_CLEAR_BINDINGS(lib->statements.main_query);
-  DT_DEBUG_SQLITE3_RESET(lib->statements.main_query);
-
-  /* setup offset and row for the main query */
-  DT_DEBUG_SQLITE3_BIND_INT(lib->statements.main_query, 1, offset);
-  DT_DEBUG_SQLITE3_BIND_INT(lib->statements.main_query, 2, max_rows * iir);
-
   if(mouse_over_id != -1)
   {
     const dt_image_t *mouse_over_image = dt_image_cache_get(darktable.image_cache, mouse_over_id, 'r');
@@ -583,18 +820,8 @@ static int expose_filemanager(dt_view_t *self, cairo_t *cr, int32_t width, int32
   // group.
   int *query_ids = (int *)calloc(max_rows * max_cols, sizeof(int));
   if(!query_ids) goto after_drawing;
-  for(int row = 0; row < max_rows; row++)
-  {
-    for(int col = 0; col < max_cols; col++)
-    {
-      if(sqlite3_step(lib->statements.main_query) == SQLITE_ROW)
-        query_ids[row * iir + col] = sqlite3_column_int(lib->statements.main_query, 0);
-      else
-        goto end_query_cache;
-    }
-  }
+  _collected_images_slice(lib, offset, max_rows * max_cols, query_ids);
 
-end_query_cache:
   mouse_over_id = -1;
   cairo_save(cr);
   int current_image = 0;
@@ -868,30 +1095,53 @@ after_drawing:
   /* check if offset was changed and we need to prefetch thumbs */
   if(offset_changed)
   {
-    int32_t imgids_num = 0;
+    // estimate how fast we are scrolling, smoothed over a few steps. after a pause we start from scratch.
+    const double now = dt_get_wtime();
+    const double elapsed = now - lib->prefetch.time;
+    const float velocity = elapsed > 0.0 ? (offset - lib->prefetch.offset) / elapsed : 0.0f;
+    lib->prefetch.velocity = elapsed < 0.5 ? 0.5f * (lib->prefetch.velocity + velocity) : velocity;
+    lib->prefetch.offset = offset;
+    lib->prefetch.time = now;
+
+    // look ahead as far as we'll scroll in the next half second in the direction of travel, but at least half
+    // a screen, and one row the other way.
+    const int visible = max_rows * iir;
     const int prefetchrows = .5 * max_rows + 1;
-    int32_t imgids[prefetchrows * iir];
-
-    /* clear and reset main query */
-    DT_DEBUG_SQLITE3_CLEAR_BINDINGS(lib->statements.main_query);
-    DT_DEBUG_SQLITE3_RESET(lib->statements.main_query);
-
-    /* setup offest and row for prefetch */
-    DT_DEBUG_SQLITE3_BIND_INT(lib->statements.main_query, 1, offset + max_rows * iir);
-    DT_DEBUG_SQLITE3_BIND_INT(lib->statements.main_query, 2, prefetchrows * iir);
-
-    // prefetch jobs in inverse order: supersede previous jobs: most important last
-    while(sqlite3_step(lib->statements.main_query) == SQLITE_ROW && imgids_num < prefetchrows * iir)
-      imgids[imgids_num++] = sqlite3_column_int(lib->statements.main_query, 0);
-
+    const int ahead = iir * CLAMP((int)(fabsf(lib->prefetch.velocity) * 0.5f / iir) + 1, prefetchrows,
+                                  4 * max_rows);
+    const gboolean up = lib->prefetch.velocity < 0.0f;
+    const int32_t lo = MAX(0, offset - (up ? ahead : iir));
+    const int32_t hi = offset + visible + (up ? iir : ahead);
+    g_atomic_int_set(&_prefetch_lo, lo);
+    g_atomic_int_set(&_prefetch_hi, hi);
+
+    // scrolling by more than a screen per second: the thumbnails are only seen briefly, load smaller ones and
+    // upgrade them once we come to a halt.
     float imgwd = iir == 1 ? 0.97 : 0.8;
     dt_mipmap_size_t mip = dt_mipmap_cache_get_matching_size(darktable.mipmap_cache, imgwd * wd,
                                                              imgwd * (iir == 1 ? height : ht));
-    while(imgids_num > 0)
+    if(fabsf(lib->prefetch.velocity) > visible)
     {
-      imgids_num--;
-      dt_mipmap_buffer_t buf;
-      dt_mipmap_cache_get(darktable.mipmap_cache, &buf, imgids[imgids_num], mip, DT_MIPMAP_PREFETCH, 'r');
+      if(mip > DT_MIPMAP_0) mip--;
+      if(lib->prefetch.idle_source) g_source_remove(lib->prefetch.idle_source);
+      lib->prefetch.idle_source = g_timeout_add(250, _prefetch_idle, self);
+    }
+
+    // prefetch jobs in inverse order: supersede previous jobs: most important last
+    int32_t *imgids = (int32_t *)malloc(sizeof(int32_t) * (hi - lo));
+    if(imgids)
+    {
+      const int32_t behind_lo = up ? offset + visible : lo;
+      const int32_t behind_num = _collected_images_slice(lib, behind_lo, up ? iir : offset - lo, imgids);
+      for(int k = behind_num - 1; k >= 0; k--) _prefetch_image(imgids[k], behind_lo + k, mip);
+
+      const int32_t ahead_lo = up ? lo : offset + visible;
+      const int32_t ahead_num = _collected_images_slice(lib, ahead_lo, up ? offset - lo : ahead, imgids);
+      if(up)
+        for(int k = 0; k < ahead_num; k++) _prefetch_image(imgids[k], ahead_lo + k, mip);
+      else
+        for(int k = ahead_num - 1; k >= 0; k--) _prefetch_image(imgids[k], ahead_lo + k, mip);
+      free(imgids);
     }
   }
 
@@ -1121,17 +1371,11 @@ static int expose_zoomable(dt_view_t *self, cairo_t *cr, int32_t width, int32_t
       continue;
     }
 
-    /* clear and reset main query */
-    DT_DEBUG_SQLITE3_CLEAR_BINDINGS(lib->statements.main_query);
-    DT_DEBUG_SQLITE3_RESET(lib->statements.main_query);
-
-    DT_DEBUG_SQLITE3_BIND_INT(lib->statements.main_query, 1, offset);
-    DT_DEBUG_SQLITE3_BIND_INT(lib->statements.main_query, 2, max_cols);
     for(int col = 0; col < max_cols; col++)
     {
-      if(sqlite3_step(lib->statements.main_query) == SQLITE_ROW)
+      if(offset + col < lib->collected_count)
       {
-        id = sqlite3_column_int(lib->statements.main_query, 0);
+        id = lib->collected[offset + col];
 
         // set mouse over id
         if((zoom == 1 && mouse_over_id < 0) || ((!pan || track) && seli == col && selj == row && pointerx > 0
@@ -1258,9 +1502,10 @@ int expose_full_preview(dt_view_t *self, cairo_t *cr, int32_t width, int32_t hei
       dt_image_full_path(lib->full_preview_id, filename, sizeof(filename), &from_cache);
       free(lib->full_res_thumb);
       lib->full_res_thumb = NULL;
+      // the focus detection wants all the pixels there are
       if(!dt_imageio_large_thumbnail(filename, &lib->full_res_thumb,
                                                &lib->full_res_thumb_wd,
-                                               &lib->full_res_thumb_ht)) {
+                                               &lib->full_res_thumb_ht, 0, 0)) {
         lib->full_res_thumb_orientation = ORIENTATION_NONE;
         lib->full_res_thumb_id = lib->full_preview_id;
       }
@@ -1493,10 +1738,15 @@ static gboolean star_key_accel_callback(GtkAccelGroup *accel_group, GObject *acc
   mouse_over_id = dt_view_get_image_to_act_on();
 
   if(mouse_over_id <= 0)
+  {
     dt_ratings_apply_to_selection(num);
+    _update_collected_images(self);
+  }
   else
+  {
     dt_ratings_apply_to_image(mouse_over_id, num);
-  _update_collected_images(self);
+    _update_collected_image(self, mouse_over_id);
+  }
   return TRUE;
 }
 
@@ -1779,7 +2029,7 @@ int button_pressed(dt_view_t *self, double x, double y, double pressure, int whi
         }
         else
           dt_image_cache_write_release(darktable.image_cache, image, DT_IMAGE_CACHE_RELAXED);
-        _update_collected_images(self);
+        _update_collected_image(self, mouse_over_id);
         break;
       }
       case DT_VIEW_GROUP:
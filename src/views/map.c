@@ -78,6 +78,8 @@ static void _view_map_set_map_source_g_object(const dt_view_t *view, OsmGpsMapSo
 static void _view_map_check_preference_changed(gpointer instance, gpointer user_data);
 /* callback when the collection changs */
 static void _view_map_collection_changed(gpointer instance, gpointer user_data);
+static void _view_map_collection_images_changed(gpointer instance, GList *imgs, guint member,
+                                                gpointer user_data);
 /* callback when an image is selected in filmstrip, centers map */
 static void _view_map_filmstrip_activate_callback(gpointer instance, gpointer user_data);
 /* callback when an image is dropped from filmstrip */
@@ -334,6 +336,8 @@ void init(dt_view_t *self)
   /* connect collection changed signal */
   dt_control_signal_connect(darktable.signals, DT_SIGNAL_COLLECTION_CHANGED,
                             G_CALLBACK(_view_map_collection_changed), (gpointer)self);
+  dt_control_signal_connect(darktable.signals, DT_SIGNAL_COLLECTION_IMAGES_CHANGED,
+                            G_CALLBACK(_view_map_collection_images_changed), (gpointer)self);
   /* connect preference changed signal */
   dt_control_signal_connect(darktable.signals, DT_SIGNAL_PREFERENCES_CHANGE,
                             G_CALLBACK(_view_map_check_preference_changed), (gpointer)self);
@@ -344,6 +348,7 @@ void cleanup(dt_view_t *self)
   dt_map_t *lib = (dt_map_t *)self->data;
 
   dt_control_signal_disconnect(darktable.signals, G_CALLBACK(_view_map_collection_changed), self);
+  dt_control_signal_disconnect(darktable.signals, G_CALLBACK(_view_map_collection_images_changed), self);
   dt_control_signal_disconnect(darktable.signals, G_CALLBACK(_view_map_check_preference_changed), self);
 
   if(darktable.gui)
@@ -815,6 +820,12 @@ static void _view_map_collection_changed(gpointer instance, gpointer user_data)
   }
 }
 
+static void _view_map_collection_images_changed(gpointer instance, GList *imgs, guint member,
+                                                gpointer user_data)
+{
+  _view_map_collection_changed(instance, user_data);
+}
+
 static void _view_map_filmstrip_activate_callback(gpointer instance, gpointer user_data)
 {
   dt_view_t *self = (dt_view_t *)user_data;